@@ -123,6 +123,14 @@ void interrupts_init(bool verbose);
  */
 void interrupts_register_handler(uint8_t num, isr_handler_t handler);
 
+/**
+ * Detener el kernel mostrando una excepción no resuelta
+ * Es lo que ocurre con las excepciones sin handler; un handler que no
+ * pueda resolver la suya (p. ej. un page fault inválido) la llama
+ * @param regs: Registros guardados de la excepción
+ */
+void interrupts_panic(registers_t* regs) __attribute__((noreturn));
+
 /**
  * Handlers de excepciones (ISR 0-31)
  * Definidos en arch/x86/isr.S
@@ -8,6 +8,8 @@
 
 #include "../../lib/include/types.h"
 
+struct arena;
+
 /**
  * Configuración del sistema IPC
  */
@@ -79,6 +81,17 @@ int ipc_send(pid_t dest_pid, const void* msg, size_t size);
  */
 int ipc_recv(ipc_message_t* msg, int flags);
 
+/**
+ * Recibe un mensaje copiando su contenido en una arena
+ * El buffer se libera con la arena (arena_restore/arena_reset); no se debe
+ * llamar a ipc_free sobre el mensaje
+ * @param msg Estructura donde se almacenará el mensaje recibido
+ * @param flags Flags de comportamiento (IPC_BLOCK o IPC_NONBLOCKING)
+ * @param arena Arena para el buffer (NULL para usar kmalloc, como ipc_recv)
+ * @return E_OK en caso de éxito, código de error en caso contrario
+ */
+int ipc_recv_arena(ipc_message_t* msg, int flags, struct arena* arena);
+
 /**
  * Libera los recursos de un mensaje recibido
  * @param msg Mensaje a liberar
@@ -93,4 +106,17 @@ int ipc_free(ipc_message_t* msg);
  */
 void ipc_cleanup_queue(ipc_queue_t* queue);
 
+/**
+ * Asigna un mensaje de cola desde el cache slab de IPC
+ * Lo usan también las colas PMIC de los módulos
+ * @return Mensaje sin inicializar, o NULL si no hay memoria
+ */
+ipc_queue_message_t* ipc_message_alloc(void);
+
+/**
+ * Devuelve un mensaje de cola al cache slab de IPC
+ * @param msg Mensaje a liberar
+ */
+void ipc_message_free(ipc_queue_message_t* msg);
+
 #endif /* _KERNEL_IPC_H */
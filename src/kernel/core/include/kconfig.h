@@ -11,13 +11,16 @@
 // Variables globales de configuración del kernel
 extern bool kernel_debug_mode;
 extern bool kernel_verbose_mode;
+extern bool kernel_pae_mode;
 
 /**
  * Inicializa la configuración del kernel
  * @param debug Activar modo debug
  * @param verbose Activar modo verbose
+ * @param pae Usar paginación PAE (entradas de 64 bits, NX, memoria por
+ *            encima de 4GB)
  */
-void kconfig_init(bool debug, bool verbose);
+void kconfig_init(bool debug, bool verbose, bool pae);
 
 /**
  * Verifica si el modo debug está activo
@@ -35,4 +38,12 @@ static inline bool is_kverbose(void) {
     return kernel_verbose_mode;
 }
 
+/**
+ * Verifica si se pidió paginación PAE
+ * @return true si PAE está pedido (el VMM lo usa si la CPU lo admite)
+ */
+static inline bool is_kpae(void) {
+    return kernel_pae_mode;
+}
+
 #endif /* _KERNEL_KCONFIG_H */
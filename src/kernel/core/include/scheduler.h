@@ -11,6 +11,7 @@
 
 // Forward declaration para evitar dependencia circular
 struct ipc_queue;
+struct arena;
 
 /**
  * Estados de un proceso
@@ -82,6 +83,7 @@ typedef struct process {
     // Información de memoria
     uint32_t page_directory;         // Directorio de páginas (para VMM)
     uint32_t kernel_stack;           // Puntero al stack del kernel
+    struct arena* scratch_arena;     // Arena temporal (ver scheduler_get_scratch_arena)
     
     // Estadísticas
     uint32_t time_slices;            // Número de time slices usados
@@ -159,6 +161,16 @@ int scheduler_get_priority(uint32_t pid);
  */
 process_t* scheduler_get_current_process(void);
 
+/**
+ * Obtener la arena temporal del contexto actual
+ * Cada proceso tiene la suya (se crea en el primer uso y se destruye al
+ * terminar el proceso); antes de que haya procesos se usa una arena de
+ * arranque. Quien la use debe rodear su trabajo con arena_checkpoint y
+ * arena_restore y no conservar punteros fuera de ese ámbito
+ * @return Arena del contexto actual, o NULL si no hay memoria
+ */
+struct arena* scheduler_get_scratch_arena(void);
+
 /**
  * Obtener un proceso por su PID
  * @param pid: Process ID del proceso
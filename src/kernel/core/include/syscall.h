@@ -56,7 +56,27 @@
 #define INFO_PID        0   // Obtener PID actual
 #define INFO_UPTIME     1   // Tiempo desde el boot (en ticks)
 #define INFO_TIME       2   // Tiempo actual (timestamp)
-#define INFO_MEMORY     3   // Estadísticas de memoria
+#define INFO_MEMORY     3   // Estadísticas de memoria (3 uint32_t en KB)
+#define INFO_HEAP       4   // Estadísticas del heap del kernel (heap_stats_t)
+#define INFO_MEMORY_ZONES 5 // Memoria libre por zona (PMM_ZONE_COUNT uint32_t en KB)
+
+/**
+ * Protección para sys_map
+ * Con PAE (--pae) y una CPU con NX, las regiones sin PROT_EXEC no son
+ * ejecutables. Sin NX toda página legible es ejecutable y PROT_EXEC no
+ * cambia nada
+ */
+#define PROT_READ       0x1
+#define PROT_WRITE      0x2
+#define PROT_EXEC       0x4
+
+/**
+ * Flags de sys_map
+ */
+#define MAP_FIXED       0x01    // addr es la dirección exacta (alineada a página)
+#define MAP_POPULATE    0x02    // Asignar todas las páginas ya (sin page faults después)
+#define MAP_LARGE       0x04    // Páginas grandes (4MB, 2MB con PAE) si len es múltiplo (implica MAP_POPULATE)
+#define MAP_GUARD       0x08    // Una página sin mapear antes y después de la región
 
 /**
  * Wrapper genérico para syscalls
@@ -129,6 +149,11 @@ static inline int sys_wait(int *event_mask, uint32_t timeout) {
 }
 
 // === Memory ===
+/**
+ * Devuelve el inicio de la región (alineado a página) o un código E_*.
+ * Las direcciones de usuario pasan de 2GB, así que el resultado no se
+ * compara con 0: es un error si no está alineado a página
+ */
 static inline int sys_map(void *addr, size_t len, int prot, int flags) {
     return syscall(SYS_MAP, (uint32_t)addr, (uint32_t)len, (uint32_t)prot, (uint32_t)flags, 0);
 }
@@ -95,6 +95,63 @@ static void pic_send_eoi(uint8_t irq_num) {
     __asm__ volatile("outb %0, %1" : : "a"((uint8_t)PIC_EOI), "Nd"(PIC1_COMMAND));
 }
 
+/**
+ * Detiene el kernel mostrando una excepción no resuelta
+ * @param regs: Estructura con los registros guardados
+ */
+void interrupts_panic(registers_t* regs) {
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
+    vga_write("\n\n!!! KERNEL PANIC !!!\n");
+    vga_write("Unhandled Exception: ");
+    
+    if (regs->int_no < 32) {
+        vga_write(exception_messages[regs->int_no]);
+    } else {
+        vga_write("Unknown");
+    }
+    
+    vga_write("\nException #");
+    vga_write_dec(regs->int_no);
+    vga_write(" Error Code: ");
+    vga_write_hex(regs->err_code);
+    if (regs->int_no == ISR_PAGE_FAULT) {
+        uint32_t cr2;
+        __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+        vga_write(" CR2: ");
+        vga_write_hex(cr2);
+    }
+    vga_write("\n");
+    vga_write("EIP: ");
+    vga_write_hex(regs->eip);
+    vga_write(" CS: ");
+    vga_write_hex(regs->cs);
+    vga_write(" EFLAGS: ");
+    vga_write_hex(regs->eflags);
+    vga_write("\n");
+    vga_write("EAX: ");
+    vga_write_hex(regs->eax);
+    vga_write(" EBX: ");
+    vga_write_hex(regs->ebx);
+    vga_write(" ECX: ");
+    vga_write_hex(regs->ecx);
+    vga_write(" EDX: ");
+    vga_write_hex(regs->edx);
+    vga_write("\n");
+    vga_write("ESI: ");
+    vga_write_hex(regs->esi);
+    vga_write(" EDI: ");
+    vga_write_hex(regs->edi);
+    vga_write(" EBP: ");
+    vga_write_hex(regs->ebp);
+    vga_write(" ESP: ");
+    vga_write_hex(regs->esp);
+    vga_write("\n");
+    
+    // Detener el kernel
+    __asm__ volatile("cli; hlt");
+    while(1);
+}
+
 /**
  * Handler común de ISR (Interrupt Service Routine)
  * Llamado desde el código ensamblador en isr.S
@@ -107,50 +164,7 @@ void isr_handler(registers_t* regs) {
         handler(regs);
     } else {
         // Si no hay handler, mostrar mensaje de error
-        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
-        vga_write("\n\n!!! KERNEL PANIC !!!\n");
-        vga_write("Unhandled Exception: ");
-        
-        if (regs->int_no < 32) {
-            vga_write(exception_messages[regs->int_no]);
-        } else {
-            vga_write("Unknown");
-        }
-        
-        vga_write("\nException #");
-        vga_write_dec(regs->int_no);
-        vga_write(" Error Code: ");
-        vga_write_hex(regs->err_code);
-        vga_write("\n");
-        vga_write("EIP: ");
-        vga_write_hex(regs->eip);
-        vga_write(" CS: ");
-        vga_write_hex(regs->cs);
-        vga_write(" EFLAGS: ");
-        vga_write_hex(regs->eflags);
-        vga_write("\n");
-        vga_write("EAX: ");
-        vga_write_hex(regs->eax);
-        vga_write(" EBX: ");
-        vga_write_hex(regs->ebx);
-        vga_write(" ECX: ");
-        vga_write_hex(regs->ecx);
-        vga_write(" EDX: ");
-        vga_write_hex(regs->edx);
-        vga_write("\n");
-        vga_write("ESI: ");
-        vga_write_hex(regs->esi);
-        vga_write(" EDI: ");
-        vga_write_hex(regs->edi);
-        vga_write(" EBP: ");
-        vga_write_hex(regs->ebp);
-        vga_write(" ESP: ");
-        vga_write_hex(regs->esp);
-        vga_write("\n");
-        
-        // Detener el kernel
-        __asm__ volatile("cli; hlt");
-        while(1);
+        interrupts_panic(regs);
     }
 }
 
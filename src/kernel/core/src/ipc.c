@@ -13,6 +13,9 @@
 // Flag de inicialización
 static bool ipc_initialized = false;
 
+// Cache slab de mensajes en cola
+static kmem_cache_t* ipc_message_cache = NULL;
+
 /**
  * Inicializa el sistema IPC
  */
@@ -21,6 +24,14 @@ int ipc_init(bool kverbose) {
         return E_OK;
     }
 
+    // Los mensajes solo se copian hasta 'size', no hace falta ponerlos a cero
+    ipc_message_cache = kmem_cache_create("ipc_queue_message_t", sizeof(ipc_queue_message_t), 0, NULL);
+    if (ipc_message_cache == NULL) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[IPC] [ERROR] No se pudo crear el cache de mensajes\n");
+        return E_NOMEM;
+    }
+
     ipc_initialized = true;
     if (kverbose) {
         vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
@@ -42,6 +53,20 @@ void ipc_queue_init(ipc_queue_t* queue) {
     queue->count = 0;
 }
 
+/**
+ * Asigna un mensaje de cola desde el cache slab de IPC
+ */
+ipc_queue_message_t* ipc_message_alloc(void) {
+    return (ipc_queue_message_t*)kmem_cache_alloc(ipc_message_cache);
+}
+
+/**
+ * Devuelve un mensaje de cola al cache slab de IPC
+ */
+void ipc_message_free(ipc_queue_message_t* msg) {
+    kmem_cache_free(ipc_message_cache, msg);
+}
+
 /**
  * Envía un mensaje a otro proceso
  */
@@ -72,7 +97,7 @@ int ipc_send(pid_t dest_pid, const void* msg, size_t size) {
     }
 
     // Asignar memoria para el mensaje en cola
-    ipc_queue_message_t* queue_msg = (ipc_queue_message_t*)kmalloc(sizeof(ipc_queue_message_t));
+    ipc_queue_message_t* queue_msg = ipc_message_alloc();
     if (queue_msg == NULL) {
         return E_NOMEM;
     }
@@ -108,6 +133,13 @@ int ipc_send(pid_t dest_pid, const void* msg, size_t size) {
  * Recibe un mensaje de la cola del proceso actual
  */
 int ipc_recv(ipc_message_t* msg, int flags) {
+    return ipc_recv_arena(msg, flags, NULL);
+}
+
+/**
+ * Recibe un mensaje copiando su contenido en una arena
+ */
+int ipc_recv_arena(ipc_message_t* msg, int flags, arena_t* arena) {
     // Validar parámetros
     if (msg == NULL) {
         return E_INVAL;
@@ -149,7 +181,7 @@ int ipc_recv(ipc_message_t* msg, int flags) {
     current->ipc_queue.count--;
 
     // Asignar memoria para el buffer del mensaje
-    void* buffer = kmalloc(queue_msg->size);
+    void* buffer = arena != NULL ? arena_alloc(arena, queue_msg->size) : kmalloc(queue_msg->size);
     if (buffer == NULL) {
         // Error de memoria: devolver el mensaje a la cola
         queue_msg->next = current->ipc_queue.head;
@@ -170,7 +202,7 @@ int ipc_recv(ipc_message_t* msg, int flags) {
     msg->buffer = buffer;
 
     // Liberar el mensaje de la cola
-    kfree(queue_msg);
+    ipc_message_free(queue_msg);
 
     return E_OK;
 }
@@ -211,7 +243,7 @@ void ipc_cleanup_queue(ipc_queue_t* queue) {
     ipc_queue_message_t* current = queue->head;
     while (current != NULL) {
         ipc_queue_message_t* next = current->next;
-        kfree(current);
+        ipc_message_free(current);
         current = next;
     }
 
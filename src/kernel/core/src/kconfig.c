@@ -8,11 +8,13 @@
 // Variables globales de configuración
 bool kernel_debug_mode = false;
 bool kernel_verbose_mode = false;
+bool kernel_pae_mode = false;
 
 /**
  * Inicializa la configuración del kernel
  */
-void kconfig_init(bool debug, bool verbose) {
+void kconfig_init(bool debug, bool verbose, bool pae) {
     kernel_debug_mode = debug;
     kernel_verbose_mode = verbose;
+    kernel_pae_mode = pae;
 }
@@ -62,6 +62,8 @@ void kernel_main(uint32_t magic, multiboot_info_t* mbi) {
     bool kdebug = false;
     bool kverbose = false;
     bool ksubsystems = true;
+    bool kheapstats = false;
+    bool kpae = false;
 
     // Parsear CMDLINE
     if (mbi->flags & MULTIBOOT_INFO_CMDLINE) {
@@ -73,6 +75,16 @@ void kernel_main(uint32_t magic, multiboot_info_t* mbi) {
             kverbose = true;
         }
 
+        // Paginación PAE: entradas de 64 bits, NX y memoria por encima de 4GB
+        if (strstr((const char*)mbi->cmdline, "--pae")) {
+            kpae = true;
+        }
+
+        // Volcar las estadísticas del heap al terminar la inicialización
+        if (strstr((const char*)mbi->cmdline, "--heap-stats")) {
+            kheapstats = true;
+        }
+
         // Esto no debería usarse en producción, solo para pruebas
         // (Y también para poder apreciar el Banner xd)
         if (strstr((const char*)mbi->cmdline, "--no-subsystems")) {
@@ -81,7 +93,7 @@ void kernel_main(uint32_t magic, multiboot_info_t* mbi) {
     }
 
     // Inicializar configuración global del kernel
-    kconfig_init(kdebug, kverbose);
+    kconfig_init(kdebug, kverbose, kpae);
 
     // Verificar si el bootloader es compatible con Multiboot
     if (magic != MULTIBOOT_MAGIC) {
@@ -228,6 +240,16 @@ void kernel_main(uint32_t magic, multiboot_info_t* mbi) {
     // Inicializar el sistema de interrupciones (ISR, IRQ, PIC)
     interrupts_init(kverbose);
 
+    // Handler de page faults (demand paging): después de interrupts_init,
+    // que borra los handlers
+    if (vmm_fault_init() != E_OK) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[FAIL] Error al registrar el handler de page faults\n");
+        while(1) {
+            __asm__ volatile("hlt");
+        }
+    }
+
     if (kverbose) {
         vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
         vga_write("== Sistema de interrupciones inicializado ==\n\n");
@@ -436,6 +458,10 @@ void kernel_main(uint32_t magic, multiboot_info_t* mbi) {
         // TODO: Implementar carga de partición NeoOS
     }
 
+    if (kheapstats) {
+        heap_dump();
+    }
+
     // Transferir el control al scheduler (nunca retorna)
     vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
     scheduler_switch();
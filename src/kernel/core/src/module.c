@@ -7,6 +7,7 @@
 #include "../include/error.h"
 #include "../include/timer.h"
 #include "../include/ipc.h"
+#include "../include/scheduler.h"
 #include "../../lib/include/string.h"
 #include "../../memory/include/memory.h"
 #include "../../drivers/include/early_vga.h"
@@ -16,6 +17,7 @@ static module_t* module_list_head = NULL;
 static mid_t next_mid = 1;  // MID 0 está reservado
 static bool initialized = false;
 static uint32_t module_count = 0;
+static kmem_cache_t* module_cache = NULL;  // Cache slab de module_t
 
 /**
  * Busca un módulo por su MID
@@ -96,6 +98,13 @@ int module_manager_init(bool verbose) {
         vga_write("[MODULE] Inicializando Module Manager...\n");
     }
     
+    module_cache = kmem_cache_create("module_t", sizeof(module_t), 0, NULL);
+    if (module_cache == NULL) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[MODULE] [ERROR] No se pudo crear el cache de modulos\n");
+        return E_NOMEM;
+    }
+    
     module_list_head = NULL;
     next_mid = 1;
     module_count = 0;
@@ -133,7 +142,7 @@ mid_t module_load(const char* name) {
     }
     
     // Asignar memoria para el nuevo módulo
-    module_t* new_module = (module_t*)kmalloc(sizeof(module_t));
+    module_t* new_module = (module_t*)kmem_cache_zalloc(module_cache);
     if (new_module == NULL) {
         return E_NOMEM;
     }
@@ -195,7 +204,7 @@ int module_unload(mid_t mid) {
     module_remove_from_list(module);
     
     // Liberar memoria
-    kfree(module);
+    kmem_cache_free(module_cache, module);
     
     return E_OK;
 }
@@ -479,7 +488,7 @@ mid_t module_register_static(const char* name, module_entry_t* entry) {
     }
     
     // Asignar memoria para el nuevo módulo
-    module_t* new_module = (module_t*)kmalloc(sizeof(module_t));
+    module_t* new_module = (module_t*)kmem_cache_zalloc(module_cache);
     if (new_module == NULL) {
         return E_NOMEM;
     }
@@ -536,7 +545,7 @@ int module_send(mid_t mid, const void* msg, size_t size) {
     }
     
     // Crear nuevo mensaje
-    ipc_queue_message_t* new_msg = (ipc_queue_message_t*)kmalloc(sizeof(ipc_queue_message_t));
+    ipc_queue_message_t* new_msg = ipc_message_alloc();
     if (new_msg == NULL) {
         return E_NOMEM;
     }
@@ -604,7 +613,11 @@ int module_call(mid_t mid, const void* request, size_t request_size, void* respo
     }
     
     // Llamar al handler del módulo directamente (síncrono)
+    // Lo que el handler deje en la arena temporal se libera al volver
+    arena_t* scratch = scheduler_get_scratch_arena();
+    arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
     int result = module->entry->handle_message(request, request_size, response, response_size);
+    arena_restore(scratch, checkpoint);
     
     if (result == E_OK) {
         module->message_count++;
@@ -638,6 +651,7 @@ int module_process_messages(mid_t mid) {
     }
     
     int processed = 0;
+    arena_t* scratch = scheduler_get_scratch_arena();
     
     // Procesar todos los mensajes en cola
     while (module->ipc_queue.head != NULL) {
@@ -645,7 +659,9 @@ int module_process_messages(mid_t mid) {
         
         // Procesar mensaje (sin respuesta en este caso)
         size_t dummy_response_size = 0;
+        arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
         module->entry->handle_message(msg->data, msg->size, NULL, &dummy_response_size);
+        arena_restore(scratch, checkpoint);
         
         // Eliminar mensaje de la cola
         module->ipc_queue.head = msg->next;
@@ -655,7 +671,7 @@ int module_process_messages(mid_t mid) {
         module->ipc_queue.count--;
         
         // Liberar memoria
-        kfree(msg);
+        ipc_message_free(msg);
         
         processed++;
         module->message_count++;
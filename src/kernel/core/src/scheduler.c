@@ -29,6 +29,12 @@ static uint32_t next_pid = 1;
 // Total de procesos en el sistema
 static uint32_t total_processes = 0;
 
+// Cache slab de PCBs
+static kmem_cache_t* process_cache = NULL;
+
+// Arena temporal usada antes de que haya un proceso en ejecución
+static arena_t* boot_scratch_arena = NULL;
+
 // Flag para indicar si el scheduler está inicializado
 static bool scheduler_initialized = false;
 
@@ -206,7 +212,11 @@ void process_exit_handler(void) {
  */
 void idle_process_entry(void) {
     while (1) {
-        __asm__ volatile("hlt"); // Esperar a la siguiente interrupción
+        // Aprovechar el tiempo libre para limpiar memoria del heap y
+        // dormir solo cuando no quede trabajo pendiente
+        if (!memory_idle()) {
+            __asm__ volatile("hlt"); // Esperar a la siguiente interrupción
+        }
     }
 }
 
@@ -239,12 +249,20 @@ void scheduler_init(bool verbose) {
         process_table[i] = NULL;
     }
     
+    // Cache de PCBs (alineados a línea de caché)
+    process_cache = kmem_cache_create("process_t", sizeof(process_t), 0, NULL);
+    if (process_cache == NULL) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[SCHED] [ERROR] no se pudo crear el cache de procesos\n");
+        return;
+    }
+    
     // Crear el proceso idle
     if (verbose) {
         
     }
     
-    idle_process = (process_t*)kmalloc(sizeof(process_t));
+    idle_process = (process_t*)kmem_cache_zalloc(process_cache);
     if (idle_process == NULL) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
         vga_write("[SCHED] [ERROR] no se pudo asignar memoria para el proceso idle\n");
@@ -266,7 +284,7 @@ void scheduler_init(bool verbose) {
     if (idle_process->kernel_stack == 0) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
         vga_write("[SCHED] [ERROR] no se pudo asignar stack para el proceso idle\n");
-        kfree(idle_process);
+        kmem_cache_free(process_cache, idle_process);
         idle_process = NULL;
         return;
     }
@@ -320,10 +338,10 @@ uint32_t scheduler_create_process(const char* name, void (*entry_point)(void), p
 
     __asm__ volatile("cli");
 
-    process_t* process = (process_t*)kmalloc(sizeof(process_t));
+    process_t* process = (process_t*)kmem_cache_zalloc(process_cache);
     if (!process) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        vga_write("[SCHED] [ERROR] kmalloc falló al asignar PCB\n");
+        vga_write("[SCHED] [ERROR] kmem_cache_zalloc falló al asignar PCB\n");
         __asm__ volatile("sti");
         return 0;
     }
@@ -331,10 +349,10 @@ uint32_t scheduler_create_process(const char* name, void (*entry_point)(void), p
     // Validar que la dirección retornada esté alineada
     if (((uintptr_t)process & 0xF) != 0) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        vga_write("[SCHED] [ERROR] kmalloc retornó dirección no alineada: ");
+        vga_write("[SCHED] [ERROR] kmem_cache_zalloc retornó dirección no alineada: ");
         vga_write_hex((uint32_t)process);
         vga_write("\n");
-        kfree(process);
+        kmem_cache_free(process_cache, process);
         __asm__ volatile("sti");
         return 0;
     }
@@ -353,7 +371,7 @@ uint32_t scheduler_create_process(const char* name, void (*entry_point)(void), p
         vga_write("[SCHED] [ERROR] PID inválido: ");
         vga_write_dec(new_pid);
         vga_write("\n");
-        kfree(process);
+        kmem_cache_free(process_cache, process);
         __asm__ volatile("sti");
         return 0;
     }
@@ -375,7 +393,7 @@ uint32_t scheduler_create_process(const char* name, void (*entry_point)(void), p
         vga_write(", Obtenido: ");
         vga_write_dec(process->pid);
         vga_write("\n");
-        kfree(process);
+        kmem_cache_free(process_cache, process);
         __asm__ volatile("sti");
         return 0;
     }
@@ -393,7 +411,7 @@ uint32_t scheduler_create_process(const char* name, void (*entry_point)(void), p
     // Stack del kernel
     process->kernel_stack = (uint32_t)kmalloc(KERNEL_STACK_SIZE);
     if (!process->kernel_stack) {
-        kfree(process);
+        kmem_cache_free(process_cache, process);
         __asm__ volatile("sti");
         return 0;
     }
@@ -408,7 +426,15 @@ uint32_t scheduler_create_process(const char* name, void (*entry_point)(void), p
     process->ebp = 0;
     process->eip = (uint32_t)entry_point;
     process->eflags = 0x202;
-    process->page_directory = 0;
+
+    // Espacio de direcciones propio con la parte del kernel compartida
+    process->page_directory = (uint32_t)vmm_create_address_space();
+    if (process->page_directory == 0) {
+        kfree((void*)process->kernel_stack);
+        kmem_cache_free(process_cache, process);
+        __asm__ volatile("sti");
+        return 0;
+    }
 
     // Inicializar cola IPC
     process->ipc_queue.head = NULL;
@@ -447,12 +473,12 @@ uint32_t scheduler_create_process(const char* name, void (*entry_point)(void), p
  * DELICATE BEHAVIOR WARNING:
  * Si el proceso es current_process, scheduler_switch() cambia el contexto
  * y NUNCA vuelve aquí en el contexto del proceso terminado.
- * El kfree(process) se ejecuta en el contexto del NUEVO proceso.
+ * El kmem_cache_free(process) se ejecuta en el contexto del NUEVO proceso.
  * 
  * Esto funciona porque:
  * 1. El ESP ya no apunta al stack del proceso muerto
  * 2. No hay referencias colgantes al PCB
- * 3. La tabla se limpia antes del kfree
+ * 3. La tabla se limpia antes de liberar el PCB
  * 
  * Con SMP o cleanup diferido, esto necesitaría redesign.
  */
@@ -495,7 +521,7 @@ int scheduler_terminate_process(uint32_t pid) {
     
     // Si es el proceso actual, hacer context switch
     // WARNING: scheduler_switch() NUNCA retorna en el contexto del proceso muerto
-    // El cleanup (kfree) se ejecutará en el contexto del nuevo proceso
+    // El cleanup (liberar stack y PCB) se ejecutará en el contexto del nuevo proceso
     bool is_current = (process == current_process);
     if (is_current) {
         // Las interrupciones se rehabilitan en scheduler_switch
@@ -512,9 +538,13 @@ int scheduler_terminate_process(uint32_t pid) {
     if (process->kernel_stack != 0) {
         kfree((void*)process->kernel_stack);
     }
+
+    vmm_destroy_address_space((page_directory_t*)process->page_directory);
+
+    arena_destroy(process->scratch_arena);
     
     // Liberar el PCB
-    kfree(process);
+    kmem_cache_free(process_cache, process);
     
     // Restaurar interrupciones si no hicimos switch
     if (!is_current) {
@@ -601,6 +631,22 @@ process_t* scheduler_select_next(void) {
     return idle_process;
 }
 
+/**
+ * Carga el espacio de direcciones de un proceso si no es el activo
+ * Los procesos sin directorio propio (el idle) usan el del kernel. Como
+ * las páginas del kernel son globales, recargar CR3 solo invalida las de
+ * usuario
+ */
+static inline void scheduler_switch_address_space(process_t* process) {
+    page_directory_t* page_dir = process->page_directory != 0
+        ? (page_directory_t*)process->page_directory
+        : vmm_get_kernel_directory();
+
+    if (page_dir != vmm_get_current_directory()) {
+        vmm_switch_directory(page_dir);
+    }
+}
+
 /**
  * Realizar un context switch
  * Guarda el contexto del proceso actual y carga el contexto del nuevo proceso
@@ -633,6 +679,8 @@ void scheduler_switch(void) {
         // Creamos un "contexto falso" temporal en el stack del kernel actual
         // para que switch_context pueda guardar algo (aunque no lo usaremos nunca)
         uint32_t dummy_esp = 0;
+
+        scheduler_switch_address_space(next_process);
         
         // Llamar a switch_context normalmente
         // El dummy_esp guardará el estado del kernel, pero nunca volveremos aquí
@@ -681,10 +729,9 @@ void scheduler_switch(void) {
     
     current_process = next_process;
     
-    // TODO: Cambiar el page directory si es necesario (cuando esté implementado VMM)
-    // if (next_process->page_directory != 0) {
-    //     switch_page_directory(next_process->page_directory);
-    // }
+    // Cambiar de espacio de direcciones solo si el nuevo proceso usa otro
+    // directorio (el stack del kernel está mapeado en todos)
+    scheduler_switch_address_space(next_process);
     
     // Realizar el context switch en assembly
     // Esta función guarda el ESP del proceso actual y carga el ESP del nuevo proceso
@@ -892,6 +939,17 @@ process_t* scheduler_get_current_process(void) {
     return current_process;
 }
 
+/**
+ * Obtener la arena temporal del contexto actual
+ */
+arena_t* scheduler_get_scratch_arena(void) {
+    arena_t** slot = current_process != NULL ? &current_process->scratch_arena : &boot_scratch_arena;
+    if (*slot == NULL) {
+        *slot = arena_create(0);
+    }
+    return *slot;
+}
+
 /**
  * Obtener un proceso por su PID
  */
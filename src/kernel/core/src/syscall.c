@@ -25,8 +25,15 @@ int syscall_dispatch(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_
             return ipc_send((pid_t)arg1, (const void*)arg2, (size_t)arg3);
         
         case SYS_RECV: {
+            // El buffer intermedio vive en la arena temporal del proceso
+            // y se descarta al terminar la copia
+            arena_t* scratch = scheduler_get_scratch_arena();
+            if (scratch == NULL) {
+                return E_NOMEM;
+            }
+            arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
             ipc_message_t msg;
-            int result = ipc_recv(&msg, (int)arg4);
+            int result = ipc_recv_arena(&msg, (int)arg4, scratch);
             if (result == E_OK && msg.size > 0) {
                 // Copiar el mensaje al buffer del usuario
                 pid_t *src = (pid_t*)arg1;
@@ -43,10 +50,9 @@ int syscall_dispatch(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_
                         dst[i] = src_buf[i];
                     }
                 }
-                ipc_free(&msg);
-                return msg.size;  // Retornar tamaño del mensaje
             }
-            return result;
+            arena_restore(scratch, checkpoint);
+            return result == E_OK ? (int)msg.size : result;  // Retornar tamaño del mensaje
         }
         
         case SYS_CALL:
@@ -91,14 +97,30 @@ int syscall_dispatch(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_
             return E_NOT_IMPL;
         
         // ===== Memory Management =====
-        case SYS_MAP:
-            // TODO: Implementar mapeo de memoria para userspace
-            // Por ahora solo funciona en kernel space
-            return E_NOT_IMPL;
+        case SYS_MAP: {
+            uint32_t addr = arg1;
+            uint32_t prot = arg3;
+            uint32_t flags = arg4;
+
+            if ((prot & ~(PROT_READ | PROT_WRITE | PROT_EXEC)) != 0 ||
+                (flags & ~(MAP_FIXED | MAP_POPULATE | MAP_LARGE | MAP_GUARD)) != 0) {
+                return E_INVAL;
+            }
+
+            uint32_t options = 0;
+            if (flags & MAP_FIXED) options |= VMM_MAP_FIXED;
+            if (flags & MAP_POPULATE) options |= VMM_MAP_POPULATE;
+            if (flags & MAP_LARGE) options |= VMM_MAP_LARGE;
+            if (flags & MAP_GUARD) options |= VMM_MAP_GUARD;
+
+            // Sin PROT_EXEC la región es no ejecutable (con PAE y NX)
+            uint32_t page_flags = ((prot & PROT_WRITE) ? PAGE_WRITE : 0) | ((prot & PROT_EXEC) ? 0 : PAGE_NX);
+            int result = vmm_map_user(vmm_get_current_directory(), &addr, arg2, page_flags, options);
+            return result == E_OK ? (int)addr : result;
+        }
         
         case SYS_UNMAP:
-            // TODO: Implementar unmapping
-            return E_NOT_IMPL;
+            return vmm_unmap_user(vmm_get_current_directory(), arg1, arg2);
         
         case SYS_GRANT:
             // TODO: Implementar compartir memoria entre procesos
@@ -133,13 +155,25 @@ int syscall_dispatch(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_
                     // Obtener info de memoria
                     uint32_t *mem_info = (uint32_t*)buf;
                     uint32_t total_kb, used_kb, free_kb;
-                    memory_get_info(&total_kb, &used_kb, &free_kb);
+                    memory_get_info(&total_kb, &used_kb, &free_kb, NULL);
                     mem_info[0] = total_kb;
                     mem_info[1] = used_kb;
                     mem_info[2] = free_kb;
                     return E_OK;
                 }
                 
+                case INFO_HEAP: {
+                    // Estadísticas y fragmentación del heap
+                    heap_get_stats((heap_stats_t*)buf);
+                    return E_OK;
+                }
+                
+                case INFO_MEMORY_ZONES: {
+                    // Memoria libre de cada zona (DMA, LOW, HIGH)
+                    memory_get_info(NULL, NULL, NULL, (uint32_t*)buf);
+                    return E_OK;
+                }
+                
                 default:
                     return E_INVAL;
             }
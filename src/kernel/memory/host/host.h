@@ -0,0 +1,221 @@
+/**
+ * NeoOS - Memory Host Harness
+ * Interfaz entre las dos mitades del harness del asignador en el host
+ *
+ * El lado kernel (host_kernel.c) compila pmm.c y heap.c sin modificar con
+ * los headers del kernel; el lado host (host_mock.c, memhost.c) usa la
+ * libc. Como types.h y stdint.h no pueden convivir en una misma unidad,
+ * esta interfaz solo usa tipos básicos de C.
+ */
+
+#ifndef _MEMHOST_HOST_H
+#define _MEMHOST_HOST_H
+
+// Memoria física simulada por defecto (MB)
+#define HOST_PHYS_DEFAULT_MB 64
+
+// Límite: la memoria física se mapea 1:1 y debe caber en el identity map
+#define HOST_PHYS_MAX_MB 120
+
+// La "imagen del kernel" ocupa [1MB, HOST_KERNEL_END); el PMM coloca su
+// bitmap en HOST_KERNEL_END
+#define HOST_KERNEL_END 0x00200000
+
+// Memoria baja que el host no deja mapear (vm.mmap_min_addr); el mapa de
+// memoria simulado la marca como reservada
+#define HOST_LOW_RESERVED 0x00010000
+
+// Memoria alta (-H): una región por encima de 4GB, como la de una máquina
+// con más de 4GB, y otra entre el identity map y el hueco de PCI (donde el
+// PMM puede colocar los descriptores de marco). Se mapean 1:1 igual que la
+// baja, sobre el mismo memfd disperso
+#define HOST_MID_START   0x10000000UL
+#define HOST_MID_MB      16
+#define HOST_HIGH_START  0x100000000ULL
+#define HOST_HIGH_MAX_MB 256
+
+// Marcos de la memoria simulada con la alta (números de página hasta el
+// final de la región por encima de 4GB)
+#define HOST_FRAME_LIMIT ((HOST_HIGH_START >> 12) + (HOST_HIGH_MAX_MB << 8))
+
+/**
+ * Estado del asignador tras una operación
+ */
+typedef struct {
+    unsigned long mapped_bytes;     // Bytes mapeados del heap
+    unsigned long used_bytes;       // Bytes en bloques ocupados del heap
+    unsigned long free_bytes;       // Bytes en bloques libres del heap
+    unsigned long largest_free;     // Mayor bloque libre del heap
+    unsigned int fragmentation;     // Fragmentación externa del heap (%)
+    unsigned int kv_pages;          // Páginas de kvmalloc
+    unsigned int frames_used;       // Marcos del PMM en uso
+} host_heap_info_t;
+
+/*
+ * Lado kernel (host_kernel.c)
+ */
+
+/**
+ * Inicializa PMM, heap y kvmalloc sobre la memoria simulada
+ * @param phys_size Bytes de memoria baja
+ * @param high_mb MB por encima de 4GB (0: sin memoria alta ni intermedia)
+ * @return 0 si fue exitoso, código de error del kernel en caso contrario
+ */
+int host_kernel_init(unsigned int phys_size, unsigned int high_mb);
+
+/**
+ * Comprueba los invariantes del heap (tags, footers, fusión, listas
+ * libres, bitmap de clases y contabilidad). Llama a host_fail si alguno
+ * no se cumple
+ * @param deep Si no es 0, verifica también que los bloques HEAP_ZERO
+ *             contienen ceros
+ */
+void host_heap_check(int deep);
+
+/**
+ * Comprueba que el contador de páginas libres del PMM coincide con su
+ * bitmap, que los descriptores de marco son coherentes con él, que las
+ * páginas protegidas siguen reservadas y los invariantes del buddy
+ */
+void host_pmm_check(void);
+
+/**
+ * Obtiene el estado actual del asignador
+ */
+void host_heap_info(host_heap_info_t* info);
+
+/**
+ * Marcos del PMM en uso
+ */
+unsigned int host_frames_used(void);
+
+/*
+ * VMM (host_vmm.c)
+ */
+
+// Características de la CPU simulada para host_vmm_select
+#define HOST_CPU_PSE 0x1
+#define HOST_CPU_PGE 0x2
+#define HOST_CPU_PAE 0x4
+#define HOST_CPU_NX  0x8
+
+/**
+ * Invalidaciones del TLB que ha pedido el VMM
+ */
+typedef struct {
+    unsigned long invlpg;           // invlpg de una página
+    unsigned long reloads;          // Recargas de CR3 (vacía lo no global)
+    unsigned long global;           // Vaciados enteros con CR4.PGE
+} host_vmm_tlb_t;
+
+/**
+ * Fija la CPU simulada y elige el formato de las page tables
+ * (vmm_select_mode). Se llama antes de host_kernel_init, como en el
+ * arranque
+ * @param features HOST_CPU_* de la CPU simulada; PAE se pide si la CPU
+ *                 lo tiene
+ * @return 1 si el VMM usará PAE, 0 si usará 2 niveles
+ */
+int host_vmm_select(unsigned int features);
+
+/**
+ * Inicializa el VMM real (vmm_init y vmm_fault_init) sobre el PMM
+ * @return 0 si fue exitoso, código de error del kernel en caso contrario
+ */
+int host_vmm_init(void);
+
+/**
+ * Activa o desactiva las páginas grandes de usuario, como si la CPU no
+ * tuviera PSE
+ */
+void host_vmm_set_large(int enable);
+
+/**
+ * Tamaño de una página grande: 4MB, o 2MB con PAE
+ */
+unsigned int host_vmm_large_size(void);
+
+/**
+ * Indica si las páginas con PAGE_NX llevan el bit 63 (PAE con NX)
+ */
+int host_vmm_nx(void);
+
+/**
+ * Simula un page fault: activa el espacio de direcciones y llama al
+ * handler del VMM con CR2 = addr
+ * @return 0 si el VMM lo resolvió, -1 si el kernel entró en panic
+ */
+int host_vmm_fault(void* dir, unsigned int addr, unsigned int err_code);
+
+/**
+ * Entrada que traduce addr: la de su page table, o la del directorio si
+ * es una página grande o no hay tabla
+ */
+unsigned long long host_vmm_entry(void* dir, unsigned int addr);
+
+/**
+ * Contadores acumulados de invalidación del TLB
+ */
+void host_vmm_tlb(host_vmm_tlb_t* tlb);
+
+/**
+ * Regiones de un espacio de direcciones
+ */
+unsigned int host_vmm_regions(void* dir);
+
+/**
+ * Comprueba los invariantes del VMM: regiones alineadas y sin solapes
+ * (guardas incluidas), entradas del kernel iguales en todos los
+ * espacios, páginas de usuario solo dentro de regiones y con el NX de su
+ * región, PDPT de cada espacio (PAE), copy-on-write sin escritura y el
+ * refcount de cada marco igual a sus mapeos
+ */
+void host_vmm_check(void);
+
+/*
+ * Lado host (host_mock.c)
+ */
+
+/**
+ * Reserva la memoria física simulada y los rangos virtuales del heap, de
+ * kvmalloc, de los descriptores de marco y de kmap
+ * @param high_mb MB por encima de 4GB; con memoria alta también existe
+ *                la región intermedia
+ * @return 0 si fue exitoso, -1 si no se pudieron reservar
+ */
+int host_memory_setup(unsigned int phys_mb, unsigned int high_mb);
+
+/**
+ * Indica si [phys, phys + size) está en la memoria física simulada
+ */
+int host_phys_present(unsigned long long phys, unsigned long long size);
+
+/**
+ * Refleja un mapeo del VMM real (slots de kmap y descriptores de marco)
+ * en el espacio de direcciones del host
+ * @param phys Marco inicial, o 0 para quitar el mapeo
+ * @param size Bytes (múltiplo de 4KB)
+ */
+void host_map_phys(unsigned long virt, unsigned long long phys, unsigned long size);
+
+/**
+ * Aborta la ejecución informando de un invariante roto
+ */
+void host_fail(const char* what) __attribute__((noreturn));
+
+/**
+ * Número de mensajes de error ([ERROR]/[FAIL]) escritos por el kernel
+ */
+unsigned long host_vga_errors(void);
+
+/**
+ * Activa el eco de la salida VGA del kernel por stderr
+ */
+void host_vga_echo(int enable);
+
+/**
+ * Páginas mapeadas actualmente con vmm_map_page
+ */
+unsigned long host_mapped_pages(void);
+
+#endif /* _MEMHOST_HOST_H */
@@ -0,0 +1,334 @@
+/**
+ * NeoOS - Memory Host Harness (lado kernel)
+ * PMM y heap compilados en el host para pruebas y benchmarks
+ *
+ * pmm.c y heap.c se incluyen sin modificar en esta unidad para que las
+ * comprobaciones de invariantes puedan recorrer sus estructuras internas
+ * (variables static). Todo lo demás (slab, kvmalloc, arenas, kconfig) se
+ * compila aparte desde src/ tal cual.
+ */
+
+#include "host.h"
+
+// Los descriptores de marco solo siguen a los bitmaps si acaban antes de
+// 4MB: con memoria alta (-H) no caben y el PMM los coloca en la región
+// intermedia, que el VMM real mapea en KERNEL_FRAMES_START
+#define PMM_PAGES_LOW_MAX 0x00400000
+
+#include "../src/pmm.c"
+#include "../src/heap.c"
+
+// Fin de la "imagen del kernel": el PMM coloca aquí su bitmap
+uint32_t kernel_end = HOST_KERNEL_END;
+
+// Marcos en uso justo después de inicializar
+static uint32_t host_frames_base = 0;
+
+/**
+ * Construye la información de Multiboot de una máquina con phys_size
+ * bytes: memoria convencional, hueco de la BIOS y memoria superior y, con
+ * high_mb, la región intermedia y la de encima de 4GB
+ * Los primeros HOST_LOW_RESERVED bytes se declaran reservados porque el
+ * host no permite mapearlos. El mapa se escribe dentro de la imagen del
+ * kernel
+ */
+static void host_build_mbi(multiboot_info_t* mbi, uint32_t phys_size, uint32_t high_mb) {
+    const uint64_t ranges[][3] = {
+        { 0,                 HOST_LOW_RESERVED, MULTIBOOT_MEMORY_RESERVED },
+        { HOST_LOW_RESERVED, 0x9FC00,           MULTIBOOT_MEMORY_AVAILABLE },
+        { 0x9FC00,           KERNEL_START,      MULTIBOOT_MEMORY_RESERVED },
+        { KERNEL_START,      phys_size,         MULTIBOOT_MEMORY_AVAILABLE },
+        { HOST_MID_START,    HOST_MID_START + (HOST_MID_MB << 20), MULTIBOOT_MEMORY_AVAILABLE },
+        { HOST_HIGH_START,   HOST_HIGH_START + ((uint64_t)high_mb << 20), MULTIBOOT_MEMORY_AVAILABLE },
+    };
+    uint32_t count = sizeof(ranges) / sizeof(ranges[0]) - (high_mb != 0 ? 0 : 2);
+    multiboot_mmap_entry_t* mmap = (multiboot_mmap_entry_t*)KERNEL_START;
+
+    for (uint32_t i = 0; i < count; i++) {
+        mmap[i].size = sizeof(multiboot_mmap_entry_t) - sizeof(mmap[i].size);
+        mmap[i].addr = ranges[i][0];
+        mmap[i].len = ranges[i][1] - ranges[i][0];
+        mmap[i].type = ranges[i][2];
+    }
+
+    memset(mbi, 0, sizeof(multiboot_info_t));
+    mbi->flags = MULTIBOOT_INFO_MEMORY | MULTIBOOT_INFO_MEM_MAP;
+    mbi->mem_lower = 639;
+    mbi->mem_upper = (phys_size - KERNEL_START) / 1024;
+    mbi->mmap_addr = (uint32_t)(uintptr_t)mmap;
+    mbi->mmap_length = count * sizeof(multiboot_mmap_entry_t);
+}
+
+/**
+ * Inicializa PMM, heap y kvmalloc sobre la memoria simulada
+ */
+int host_kernel_init(unsigned int phys_size, unsigned int high_mb) {
+    multiboot_info_t mbi;
+    host_build_mbi(&mbi, phys_size, high_mb);
+
+    int result = pmm_init(&mbi, false, false);
+    if (result == E_OK) {
+        result = heap_init(KERNEL_HEAP_START, KERNEL_HEAP_SIZE, false, false);
+    }
+    if (result == E_OK) {
+        result = kvmalloc_init();
+    }
+
+    host_frames_base = pmm_total_pages - pmm_free_count;
+    return result;
+}
+
+/**
+ * Comprueba los invariantes del heap
+ */
+void host_heap_check(int deep) {
+    heap_block_t* block = (heap_block_t*)(heap_start + HEAP_MIN_ALIGN - HEAP_TAG_SIZE);
+    bool prev_used = true;
+    uint32_t free_blocks = 0;
+    uint32_t dirty_blocks = 0;
+    uint32_t used_blocks = 0;
+    size_t used_bytes = 0;
+    size_t free_bytes = 0;
+
+    // Recorrido por dirección: tags, footers y fusión
+    while (heap_block_size(block) != 0) {
+        size_t size = heap_block_size(block);
+
+        if ((uintptr_t)block + size > heap_current - HEAP_TAG_SIZE) {
+            host_fail("bloque fuera de la zona gestionada");
+        }
+        if (size < HEAP_MIN_BLOCK_SIZE || (size & HEAP_FLAG_MASK) != 0) {
+            host_fail("tamaño de bloque invalido");
+        }
+        if (heap_prev_used(block) != prev_used) {
+            host_fail("HEAP_PREV_USED no coincide con el bloque anterior");
+        }
+
+        if (heap_block_used(block)) {
+            used_blocks++;
+            used_bytes += size;
+        } else {
+            if (!prev_used) {
+                host_fail("dos bloques libres adyacentes sin fusionar");
+            }
+            if (*heap_footer(block) != size) {
+                host_fail("footer distinto del tamaño del bloque");
+            }
+            free_blocks++;
+            free_bytes += size;
+            if (!heap_block_zero(block)) {
+                dirty_blocks++;
+            } else if (deep) {
+                uint8_t* data = (uint8_t*)(block + 1);
+                for (; data < (uint8_t*)heap_footer(block); data++) {
+                    if (*data != 0) {
+                        host_fail("bloque HEAP_ZERO con datos distintos de cero");
+                    }
+                }
+            }
+        }
+
+        prev_used = heap_block_used(block);
+        block = heap_next_block(block);
+    }
+
+    if ((uintptr_t)block != heap_current - HEAP_TAG_SIZE || !heap_block_used(block)) {
+        host_fail("epilogo fuera de su sitio");
+    }
+    if (heap_mapped_end < heap_current || (heap_mapped_end & PAGE_OFFSET_MASK) != 0 ||
+        heap_mapped_end > heap_end) {
+        host_fail("heap_mapped_end incoherente");
+    }
+
+    // Listas libres: cada bloque está libre, en su clase y bien enlazado
+    uint32_t listed = 0;
+    for (uint32_t index = 0; index < HEAP_BIN_COUNT; index++) {
+        bool bit = (heap_bin_bitmap[index / 32] & (1U << (index % 32))) != 0;
+        if (bit != (heap_bins[index] != NULL)) {
+            host_fail("bitmap de clases distinto de las listas");
+        }
+
+        heap_block_t* prev = NULL;
+        for (heap_block_t* free = heap_bins[index]; free != NULL; free = free->free_next) {
+            if (heap_block_used(free) || heap_bin_index(heap_block_size(free)) != index) {
+                host_fail("bloque ocupado o fuera de su clase en una lista libre");
+            }
+            if (free->free_prev != prev) {
+                host_fail("enlace free_prev roto");
+            }
+            if (++listed > free_blocks) {
+                host_fail("lista libre con ciclos o bloques repetidos");
+            }
+            prev = free;
+        }
+    }
+    if (listed != free_blocks) {
+        host_fail("bloques libres que no estan en ninguna lista");
+    }
+    if (dirty_blocks != heap_dirty_blocks) {
+        host_fail("heap_dirty_blocks no coincide con los bloques sucios");
+    }
+
+    // Contabilidad de la telemetría
+    if (used_bytes != heap_used_bytes || used_blocks != heap_used_blocks) {
+        host_fail("contadores de uso distintos del recorrido");
+    }
+    if (HEAP_PROFILING) {
+        size_t site_bytes = heap_site_other.live_bytes;
+        uint32_t site_count = heap_site_other.live_count;
+        for (uint32_t i = 0; i < HEAP_PROFILE_SITES; i++) {
+            site_bytes += heap_sites[i].live_bytes;
+            site_count += heap_sites[i].live_count;
+        }
+        if (site_bytes != used_bytes || site_count != used_blocks) {
+            host_fail("la suma por call site no coincide con el uso total");
+        }
+    }
+
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+    if (stats.free_blocks != free_blocks || stats.free_bytes != free_bytes) {
+        host_fail("heap_get_stats no coincide con el recorrido");
+    }
+}
+
+/**
+ * Comprueba el bitmap del PMM, los descriptores de marco y los bitmaps
+ * del buddy allocator
+ */
+void host_pmm_check(void) {
+    uint32_t free_pages = 0;
+
+    for (uint32_t page = 0; page < pmm_total_pages; page++) {
+        page_t* desc = &pmm_pages[page];
+
+        if (!pmm_bitmap_test(page)) {
+            if (pmm_page_is_protected(page)) {
+                host_fail("pagina protegida marcada como libre");
+            }
+            if (desc->refcount != 0 || desc->flags != 0 || desc->link != 0) {
+                host_fail("descriptor de una pagina libre sin limpiar");
+            }
+            free_pages++;
+        } else if (desc->flags & PAGE_FRAME_RESERVED) {
+            if (desc->refcount != 0) {
+                host_fail("pagina reservada con referencias");
+            }
+        } else if (desc->refcount == 0) {
+            host_fail("pagina ocupada sin referencias ni reserva");
+        }
+        if (pmm_page_is_protected(page) && !(desc->flags & PAGE_FRAME_RESERVED)) {
+            host_fail("pagina protegida sin PAGE_FRAME_RESERVED");
+        }
+    }
+
+    if (free_pages != pmm_free_count) {
+        host_fail("pmm_free_count no coincide con el bitmap");
+    }
+
+    // En cada zona, cada página libre está en exactamente un bloque libre,
+    // y cada bloque libre es maximal: su buddy no está libre en el mismo
+    // orden. Las zonas son contiguas y cubren toda la memoria
+    uint32_t covered = 0;
+    uint32_t zone_start = 0;
+    for (uint32_t z = 0; z < PMM_ZONE_COUNT; z++) {
+        pmm_zone_t* zone = &pmm_zones[z];
+        uint32_t zone_covered = 0;
+
+        if (zone->start != zone_start ||
+            (zone->pages != 0 && (zone->start & ((1U << PMM_MAX_ORDER) - 1)) != 0)) {
+            host_fail("zona no contigua o no alineada al bloque maximo");
+        }
+        zone_start += zone->pages;
+
+        for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++) {
+            pmm_free_area_t* area = &zone->areas[order];
+            uint32_t blocks = 0;
+
+            // Resúmenes: un bit por palabra no vacía del nivel inferior; el
+            // cursor nunca deja atrás una palabra no vacía
+            for (uint32_t word = 0; word < area->words; word++) {
+                bool summary = (area->summary[word / 32] & (1U << (word % 32))) != 0;
+                if (summary != (area->map[word] != 0)) {
+                    host_fail("resumen del buddy distinto de su bitmap");
+                }
+            }
+            for (uint32_t group = 0; group < (area->words + 31) / 32; group++) {
+                bool top = (area->top[group / 32] & (1U << (group % 32))) != 0;
+                if (top != (area->summary[group] != 0)) {
+                    host_fail("nivel superior del buddy distinto del resumen");
+                }
+                if (top && group / 32 < area->cursor) {
+                    host_fail("cursor del buddy por delante de bloques libres");
+                }
+            }
+
+            for (uint32_t block = 0; block < area->words * 32; block++) {
+                if (!pmm_buddy_test(zone, order, block)) {
+                    continue;
+                }
+                blocks++;
+
+                uint32_t first = zone->start + (block << order);
+                if ((block << order) + (1U << order) > zone->pages) {
+                    host_fail("bloque libre del buddy fuera de su zona");
+                }
+                for (uint32_t page = first; page < first + (1U << order); page++) {
+                    if (pmm_bitmap_test(page)) {
+                        host_fail("bloque libre del buddy con paginas ocupadas");
+                    }
+                }
+                if (order < PMM_MAX_ORDER && pmm_buddy_test(zone, order, block ^ 1)) {
+                    host_fail("dos buddies libres sin fusionar");
+                }
+                for (uint32_t lower = 0; lower < order; lower++) {
+                    uint32_t sub_end = ((block << order) + (1U << order)) >> lower;
+                    for (uint32_t sub = (block << order) >> lower; sub < sub_end; sub++) {
+                        if (pmm_buddy_test(zone, lower, sub)) {
+                            host_fail("bloque libre solapado con otro de menor orden");
+                        }
+                    }
+                }
+                zone_covered += 1U << order;
+            }
+            if (blocks != area->free) {
+                host_fail("contador de bloques libres distinto del bitmap del orden");
+            }
+        }
+
+        if (zone_covered != zone->free) {
+            host_fail("paginas libres de la zona distintas de sus bloques");
+        }
+        covered += zone_covered;
+    }
+
+    if (zone_start != pmm_total_pages) {
+        host_fail("las zonas no cubren toda la memoria");
+    }
+    if (covered != free_pages) {
+        host_fail("paginas libres fuera de los bloques del buddy");
+    }
+}
+
+/**
+ * Obtiene el estado actual del asignador
+ */
+void host_heap_info(host_heap_info_t* info) {
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+
+    info->mapped_bytes = stats.mapped_bytes;
+    info->used_bytes = stats.used_bytes;
+    info->free_bytes = stats.free_bytes;
+    info->largest_free = stats.largest_free;
+    info->fragmentation = stats.fragmentation;
+    info->kv_pages = stats.kv_pages;
+    info->frames_used = host_frames_used();
+}
+
+/**
+ * Marcos del PMM en uso desde la inicialización
+ */
+unsigned int host_frames_used(void) {
+    return pmm_total_pages - pmm_free_count - host_frames_base;
+}
@@ -0,0 +1,296 @@
+/**
+ * NeoOS - Memory Host Harness (mocks)
+ * Memoria física, VMM y VGA simulados para ejecutar el asignador en el host
+ *
+ * La memoria física es un memfd. Se mapea 1:1 en [HOST_LOW_RESERVED,
+ * phys_size), igual que el identity map del kernel, así que el bitmap del
+ * PMM y los slabs pequeños (que usan marcos por su dirección física)
+ * funcionan sin cambios. Con memoria alta el memfd llega hasta pasados
+ * 4GB (disperso: solo ocupan las regiones simuladas) y las regiones
+ * intermedia y alta también se mapean 1:1; el kmap simulado las alcanza
+ * igual, y el VMM real refleja sus slots de kmap con host_map_phys.
+ * vmm_map_page mapea el mismo marco del memfd en la dirección virtual pedida: el heap y kvmalloc ven exactamente los marcos
+ * que les dio el PMM, con el contenido que dejó su usuario anterior.
+ *
+ * Los rangos del heap y de kvmalloc se reservan sin acceso; tocar una
+ * página no mapeada produce SIGSEGV como produciría un page fault.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "host.h"
+
+// Constantes del kernel que el lado host necesita (memory.h)
+#define HOST_PAGE_SIZE  4096
+#define HOST_HEAP_START 0xC0000000UL
+#define HOST_HEAP_SIZE  0x10000000UL
+#define HOST_KV_START   0xD0000000UL
+#define HOST_KV_SIZE    0x10000000UL
+#define HOST_FRAMES_START 0xE0000000UL
+#define HOST_FRAMES_SIZE  0x10000000UL
+#define HOST_KMAP_START 0xFFC00000UL
+#define HOST_KMAP_SIZE  (32 * HOST_PAGE_SIZE)
+#define HOST_PAGE_COUNT (1UL << 20)
+
+// Valor con el que se llena la memoria física al arrancar: el kernel no
+// debe suponer que un marco nuevo viene a cero
+#define HOST_POISON 0xA5
+
+static int phys_fd = -1;
+static uint32_t phys_limit = 0;
+static uint64_t high_limit = 0;     // Fin de la memoria alta (0 = sin ella)
+
+// Marco mapeado en cada página virtual (0 = no mapeada)
+static uint64_t* page_frames = NULL;
+static unsigned long mapped_pages = 0;
+
+static unsigned long vga_errors = 0;
+static int vga_echo = 0;
+
+// Directorio de páginas ficticio (solo se compara por dirección)
+static uint32_t kernel_directory_stub;
+
+// Del lado kernel (pmm.c): vmm_unmap_range suelta los marcos
+void pmm_free_page(uint64_t page);
+
+/**
+ * Aborta la ejecución informando de un invariante roto
+ */
+void host_fail(const char* what) {
+    fprintf(stderr, "memhost: FALLO: %s\n", what);
+    abort();
+}
+
+/**
+ * Reserva un rango de direcciones fijo
+ */
+static int host_reserve(unsigned long start, unsigned long size, int prot, int flags, int fd, unsigned long offset) {
+    void* addr = mmap((void*)start, size, prot, flags | MAP_FIXED_NOREPLACE, fd, (off_t)offset);
+    if (addr == MAP_FAILED || addr != (void*)start) {
+        fprintf(stderr, "memhost: no se pudo reservar %#lx-%#lx\n", start, start + size);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Reserva la memoria física simulada y los rangos virtuales
+ */
+int host_memory_setup(unsigned int phys_mb, unsigned int high_mb) {
+    phys_limit = phys_mb << 20;
+    high_limit = high_mb != 0 ? HOST_HIGH_START + ((uint64_t)high_mb << 20) : 0;
+
+    phys_fd = memfd_create("neoos-phys", 0);
+    if (phys_fd < 0 || ftruncate(phys_fd, high_limit != 0 ? (off_t)high_limit : (off_t)phys_limit) != 0) {
+        perror("memhost: memfd");
+        return -1;
+    }
+
+    page_frames = calloc(HOST_PAGE_COUNT, sizeof(uint64_t));
+    if (page_frames == NULL) {
+        return -1;
+    }
+
+    if (host_reserve(HOST_LOW_RESERVED, phys_limit - HOST_LOW_RESERVED, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, phys_fd, HOST_LOW_RESERVED) != 0 ||
+        host_reserve(HOST_HEAP_START, HOST_HEAP_SIZE, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) != 0 ||
+        host_reserve(HOST_KV_START, HOST_KV_SIZE, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) != 0 ||
+        host_reserve(HOST_FRAMES_START, HOST_FRAMES_SIZE, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) != 0 ||
+        host_reserve(HOST_KMAP_START, HOST_KMAP_SIZE, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) != 0) {
+        return -1;
+    }
+    memset((void*)(uintptr_t)HOST_LOW_RESERVED, HOST_POISON, phys_limit - HOST_LOW_RESERVED);
+
+    if (high_limit != 0) {
+        unsigned long mid_size = (unsigned long)HOST_MID_MB << 20;
+        unsigned long high_size = (unsigned long)(high_limit - HOST_HIGH_START);
+        if (host_reserve(HOST_MID_START, mid_size, PROT_READ | PROT_WRITE, MAP_SHARED, phys_fd, HOST_MID_START) != 0 ||
+            host_reserve(HOST_HIGH_START, high_size, PROT_READ | PROT_WRITE, MAP_SHARED, phys_fd, HOST_HIGH_START) != 0) {
+            return -1;
+        }
+        memset((void*)HOST_MID_START, HOST_POISON, mid_size);
+        memset((void*)(uintptr_t)HOST_HIGH_START, HOST_POISON, high_size);
+    }
+    return 0;
+}
+
+/**
+ * Indica si [phys, phys + size) está en la memoria física simulada
+ */
+int host_phys_present(unsigned long long phys, unsigned long long size) {
+    unsigned long long end = phys + size;
+    if (phys >= HOST_LOW_RESERVED && end <= phys_limit) {
+        return 1;
+    }
+    return high_limit != 0 &&
+           ((phys >= HOST_MID_START && end <= HOST_MID_START + ((unsigned long long)HOST_MID_MB << 20)) ||
+            (phys >= HOST_HIGH_START && end <= high_limit));
+}
+
+/**
+ * Refleja un mapeo del VMM real en el espacio de direcciones del host
+ */
+void host_map_phys(unsigned long virt, unsigned long long phys, unsigned long size) {
+    void* addr;
+    if (phys == 0) {
+        addr = mmap((void*)virt, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    } else {
+        if (!host_phys_present(phys, size)) {
+            host_fail("mapeo del VMM sobre un marco fuera de la memoria fisica");
+        }
+        addr = mmap((void*)virt, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, phys_fd, (off_t)phys);
+    }
+    if (addr == MAP_FAILED) {
+        host_fail("mmap de un mapeo del VMM");
+    }
+}
+
+/*
+ * VMM
+ */
+
+void* vmm_get_kernel_directory(void) {
+    return &kernel_directory_stub;
+}
+
+/**
+ * Toda la memoria física del host está mapeada 1:1: kmap no necesita slots
+ */
+void* kmap(uint64_t phys) {
+    return (void*)(uintptr_t)phys;
+}
+
+void kunmap(void* addr) {
+    (void)addr;
+}
+
+int vmm_map_page(void* dir, uint32_t virt, uint64_t phys, uint32_t flags) {
+    (void)dir;
+    (void)flags;
+
+    if ((virt & (HOST_PAGE_SIZE - 1)) != 0 || (phys & (HOST_PAGE_SIZE - 1)) != 0) {
+        host_fail("vmm_map_page con direccion no alineada");
+    }
+    if (!host_phys_present(phys, HOST_PAGE_SIZE)) {
+        host_fail("vmm_map_page con un marco fuera de la memoria fisica");
+    }
+    if (virt < HOST_HEAP_START || virt >= HOST_KV_START + HOST_KV_SIZE) {
+        host_fail("vmm_map_page fuera de los rangos del heap y kvmalloc");
+    }
+    if (page_frames[virt / HOST_PAGE_SIZE] != 0) {
+        host_fail("vmm_map_page sobre una pagina ya mapeada");
+    }
+
+    void* addr = mmap((void*)(uintptr_t)virt, HOST_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_FIXED, phys_fd, (off_t)phys);
+    if (addr == MAP_FAILED) {
+        host_fail("mmap del marco");
+    }
+
+    page_frames[virt / HOST_PAGE_SIZE] = phys;
+    mapped_pages++;
+    return 0;
+}
+
+void vmm_unmap_page(void* dir, uint32_t virt) {
+    (void)dir;
+
+    if (page_frames[virt / HOST_PAGE_SIZE] == 0) {
+        host_fail("vmm_unmap_page sobre una pagina no mapeada");
+    }
+
+    mmap((void*)(uintptr_t)virt, HOST_PAGE_SIZE, PROT_NONE,
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    page_frames[virt / HOST_PAGE_SIZE] = 0;
+    mapped_pages--;
+}
+
+int vmm_map_range(void* dir, uint32_t virt, const uint64_t* frames, uint64_t phys,
+                  uint32_t count, uint32_t flags) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t frame = frames != NULL ? frames[i] : phys + (uint64_t)i * HOST_PAGE_SIZE;
+        vmm_map_page(dir, virt + i * HOST_PAGE_SIZE, frame, flags);
+    }
+    return 0;
+}
+
+uint32_t vmm_unmap_range(void* dir, uint32_t virt, uint32_t count, int release) {
+    uint32_t unmapped = 0;
+
+    // Como en el kernel, las páginas no mapeadas se saltan
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t page = virt + i * HOST_PAGE_SIZE;
+        uint64_t frame = page_frames[page / HOST_PAGE_SIZE];
+        if (frame == 0) {
+            continue;
+        }
+        vmm_unmap_page(dir, page);
+        if (release) {
+            pmm_free_page(frame);
+        }
+        unmapped++;
+    }
+    return unmapped;
+}
+
+uint64_t vmm_get_physical(void* dir, uint32_t virt) {
+    (void)dir;
+
+    if (virt < phys_limit) {
+        return virt;  // Identity map
+    }
+    uint64_t frame = page_frames[virt / HOST_PAGE_SIZE];
+    return frame != 0 ? frame + (virt & (HOST_PAGE_SIZE - 1)) : 0;
+}
+
+unsigned long host_mapped_pages(void) {
+    return mapped_pages;
+}
+
+/*
+ * VGA
+ */
+
+void vga_set_color(int fg, int bg) {
+    (void)fg;
+    (void)bg;
+}
+
+void vga_write(const char* str) {
+    if (strstr(str, "[ERROR]") != NULL || strstr(str, "[FAIL]") != NULL) {
+        vga_errors++;
+    }
+    if (vga_echo) {
+        fputs(str, stderr);
+    }
+}
+
+void vga_write_hex(uint32_t value) {
+    if (vga_echo) {
+        fprintf(stderr, "0x%08X", value);
+    }
+}
+
+void vga_write_dec(uint32_t value) {
+    if (vga_echo) {
+        fprintf(stderr, "%u", value);
+    }
+}
+
+unsigned long host_vga_errors(void) {
+    return vga_errors;
+}
+
+void host_vga_echo(int enable) {
+    vga_echo = enable;
+}
@@ -0,0 +1,442 @@
+/**
+ * NeoOS - Memory Host Harness (VMM)
+ * vmm.c compilado en el host para probar regiones, page faults,
+ * copy-on-write y mapeo de rangos
+ *
+ * vmm.c se incluye sin modificar. Las instrucciones privilegiadas
+ * (vmm_cpu.h) se sustituyen por las de abajo: CR3, invlpg y el vaciado
+ * del TLB solo se cuentan, CR2 y CPUID devuelven lo que fija la prueba
+ * (también PAE y NX, para recorrer las tablas de 64 bits).
+ * Las page tables y los directorios salen del PMM real y se recorren por
+ * el identity map simulado, así que los marcos y sus referencias son los
+ * mismos que ve el resto del harness. Los marcos de la memoria alta se
+ * recorren con el kmap real: invlpg sobre un slot refleja su PTE en el
+ * host (host_map_phys), y al activar la paginación se refleja el mapeo de
+ * los descriptores de marco en KERNEL_FRAMES_START.
+ *
+ * El heap y kvmalloc siguen usando el VMM simulado de host_mock.c: las
+ * funciones que existen en los dos se renombran aquí con el prefijo
+ * host_vmm_. Los estáticos de vmm.c (directorio del kernel, tabla de
+ * kmap, PDPT) quedan en el binario del host; su dirección solo llega a CR3,
+ * a la PDPT del kernel y a la entrada de la ventana de kmap, que el
+ * harness no recorre.
+ */
+
+#define vmm_map_page host_vmm_map_page
+#define vmm_unmap_page host_vmm_unmap_page
+#define vmm_map_range host_vmm_map_range
+#define vmm_unmap_range host_vmm_unmap_range
+#define vmm_get_physical host_vmm_get_physical
+#define vmm_get_kernel_directory host_vmm_get_kernel_directory
+#define kmap host_vmm_kmap
+#define kunmap host_vmm_kunmap
+
+#include "../../lib/include/types.h"
+
+// Instrucciones privilegiadas simuladas
+#define VMM_CPU_HOST
+
+static uint32_t host_cpu_features = 0;
+static bool host_cpu_nx = false;
+static bool host_nx_enabled = false;
+static uint32_t host_cr2 = 0;
+static uint32_t host_tsc = 0;
+static unsigned long host_invlpg = 0;
+static unsigned long host_cr3_loads = 0;
+static unsigned long host_global_flushes = 0;
+
+// Reflejan en el host los mapeos de vmm.c (definidas tras incluirlo)
+static bool host_vmm_sync_kmap(uint32_t virt);
+static void host_vmm_sync_frames(void);
+
+static inline void cpu_load_cr3(uint32_t phys_addr) {
+    (void)phys_addr;
+    host_cr3_loads++;
+}
+
+static inline void cpu_enable_paging(void) {
+    host_vmm_sync_frames();
+}
+
+static inline void cpu_enable_cr4(uint32_t bits) {
+    (void)bits;
+}
+
+static inline void cpu_enable_nx(void) {
+    host_nx_enabled = true;
+}
+
+static inline void cpu_invlpg(uint32_t virt) {
+    // Como el "memory" de la instrucción real: la PTE recién escrita (con
+    // stores de 32 bits en PAE) se lee después de escribirse
+    __asm__ volatile("" ::: "memory");
+    // Los slots de kmap no cuentan: dependen de dónde cayó cada page table
+    if (!host_vmm_sync_kmap(virt)) {
+        host_invlpg++;
+    }
+}
+
+static inline void cpu_flush_tlb(bool global) {
+    if (global) {
+        host_global_flushes++;
+    } else {
+        host_cr3_loads++;
+    }
+}
+
+static inline uint32_t cpu_read_cr2(void) {
+    return host_cr2;
+}
+
+static inline uint32_t cpu_features(void) {
+    return host_cpu_features;
+}
+
+static inline bool cpu_has_nx(void) {
+    return host_cpu_nx;
+}
+
+static inline uint32_t cpu_irq_save(void) {
+    return 0;
+}
+
+static inline void cpu_irq_restore(uint32_t eflags) {
+    (void)eflags;
+}
+
+static inline uint32_t cpu_read_tsc(void) {
+    return host_tsc += 100;
+}
+
+static inline void cpu_clear_bit(volatile uint32_t* word, uint32_t bit) {
+    *word &= ~(1U << bit);
+}
+
+#include "../src/vmm.c"
+#include "host.h"
+
+// Referencias de las page tables de usuario a cada marco (host_vmm_check)
+// y marcos con alguna, para no recorrer toda la memoria alta
+#define HOST_FRAMES HOST_FRAME_LIMIT
+static uint16_t host_frame_refs[HOST_FRAMES];
+static uint32_t host_frame_list[HOST_FRAMES];
+static uint32_t host_frame_count = 0;
+
+// Handler registrado por vmm_fault_init y punto de vuelta de un panic
+static isr_handler_t host_fault_handler = NULL;
+static void* host_panic_jump[5];
+static bool host_panic_armed = false;
+
+/*
+ * Mapeos reflejados en el host
+ */
+
+/**
+ * Un slot de kmap cambió (invlpg): mapea su marco o lo quita
+ *
+ * @return true si virt es un slot de kmap
+ */
+static bool host_vmm_sync_kmap(uint32_t virt) {
+    if (virt < KERNEL_KMAP_START || virt >= KERNEL_KMAP_START + KERNEL_KMAP_SLOTS * PAGE_SIZE) {
+        return false;
+    }
+    vmm_entry_t pte = vmm_entry_get(vmm_kmap_table, vmm_get_table_index(virt));
+    host_map_phys(virt, (pte & PAGE_PRESENT) ? vmm_entry_frame(pte) : 0, PAGE_SIZE);
+    return true;
+}
+
+/**
+ * La paginación se activa: refleja las entradas de KERNEL_FRAMES_START
+ */
+static void host_vmm_sync_frames(void) {
+    for (uint32_t virt = KERNEL_FRAMES_START; virt - KERNEL_FRAMES_START < KERNEL_FRAMES_SIZE; virt += vmm_large_size) {
+        vmm_entry_t pde = vmm_entry_get(kernel_directory, vmm_get_dir_index(virt));
+        if (!(pde & PAGE_PRESENT)) {
+            continue;
+        }
+        if (!(pde & PAGE_LARGE)) {
+            host_fail("descriptores de marco mapeados sin paginas grandes");
+        }
+        host_map_phys(virt, vmm_entry_large(pde), vmm_large_size);
+    }
+}
+
+/*
+ * Interrupciones simuladas
+ */
+
+void interrupts_register_handler(uint8_t num, isr_handler_t handler) {
+    if (num == ISR_PAGE_FAULT) {
+        host_fault_handler = handler;
+    }
+}
+
+/**
+ * Un fallo que el VMM no resuelve vuelve a host_vmm_fault
+ */
+void interrupts_panic(registers_t* regs) {
+    (void)regs;
+    if (!host_panic_armed) {
+        host_fail("panic del kernel fuera de un page fault");
+    }
+    host_panic_armed = false;
+    __builtin_longjmp(host_panic_jump, 1);
+}
+
+/*
+ * Interfaz con memhost
+ */
+
+/**
+ * Fija la CPU simulada y elige el formato de las page tables
+ */
+int host_vmm_select(unsigned int features) {
+    host_cpu_features = CPUID_EDX_TSC;
+    if (features & HOST_CPU_PSE) {
+        host_cpu_features |= CPUID_EDX_PSE;
+    }
+    if (features & HOST_CPU_PGE) {
+        host_cpu_features |= CPUID_EDX_PGE;
+    }
+    if (features & HOST_CPU_PAE) {
+        host_cpu_features |= CPUID_EDX_PAE;
+    }
+    host_cpu_nx = (features & HOST_CPU_NX) != 0;
+
+    return vmm_select_mode((features & HOST_CPU_PAE) != 0) ? 1 : 0;
+}
+
+/**
+ * Inicializa el VMM sobre el PMM ya inicializado
+ */
+int host_vmm_init(void) {
+    int result = vmm_init(false, false);
+    if (result == E_OK && vmm_nx != host_nx_enabled) {
+        host_fail("EFER.NXE no coincide con el uso del bit NX");
+    }
+    if (result == E_OK) {
+        result = vmm_fault_init();
+    }
+    return result;
+}
+
+/**
+ * Activa o desactiva las páginas grandes de usuario (como si la CPU no
+ * tuviera PSE); el identity map no cambia
+ */
+void host_vmm_set_large(int enable) {
+    vmm_large = enable != 0;
+}
+
+/**
+ * Tamaño de una página grande: 4MB, o 2MB con PAE
+ */
+unsigned int host_vmm_large_size(void) {
+    return vmm_large_size;
+}
+
+/**
+ * Las páginas con PAGE_NX llevan el bit 63
+ */
+int host_vmm_nx(void) {
+    return vmm_nx;
+}
+
+/**
+ * Simula un page fault en un espacio de direcciones
+ */
+int host_vmm_fault(void* dir, unsigned int addr, unsigned int err_code) {
+    registers_t regs;
+    memset(&regs, 0, sizeof(regs));
+    regs.int_no = ISR_PAGE_FAULT;
+    regs.err_code = err_code;
+
+    if (host_fault_handler == NULL) {
+        host_fail("vmm_fault_init no registro el handler de page faults");
+    }
+    if (dir != current_directory) {
+        vmm_switch_directory((page_directory_t*)dir);
+    }
+
+    host_cr2 = addr;
+    if (__builtin_setjmp(host_panic_jump)) {
+        return -1;
+    }
+    host_panic_armed = true;
+    host_fault_handler(&regs);
+    host_panic_armed = false;
+    return 0;
+}
+
+/**
+ * Entrada que traduce una dirección: la de la page table, o la del
+ * directorio si es una página grande o no está presente
+ */
+unsigned long long host_vmm_entry(void* dir, unsigned int addr) {
+    vmm_entry_t pde = vmm_entry_get(dir, vmm_get_dir_index(addr));
+    if (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE)) {
+        return pde;
+    }
+    void* table = kmap(vmm_entry_frame(pde));
+    vmm_entry_t entry = vmm_entry_get(table, vmm_get_table_index(addr));
+    kunmap(table);
+    return entry;
+}
+
+/**
+ * Contadores de invalidación del TLB
+ */
+void host_vmm_tlb(host_vmm_tlb_t* tlb) {
+    tlb->invlpg = host_invlpg;
+    tlb->reloads = host_cr3_loads;
+    tlb->global = host_global_flushes;
+}
+
+/**
+ * Regiones de un espacio de direcciones
+ */
+unsigned int host_vmm_regions(void* dir) {
+    unsigned int count = 0;
+    for (vmm_region_t* region = vmm_regions; region != NULL; region = region->next) {
+        count += region->page_dir == dir;
+    }
+    return count;
+}
+
+/**
+ * Comprueba que un espacio de direcciones está en la lista de espacios
+ */
+static bool host_vmm_is_space(page_directory_t* page_dir) {
+    for (uint32_t dir = vmm_spaces; dir != 0; dir = pmm_get_page(dir)->link) {
+        if ((page_directory_t*)(uintptr_t)dir == page_dir) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Suma una referencia de una page table de usuario a un marco
+ */
+static void host_vmm_ref(phys_addr_t frame) {
+    page_t* page = pmm_get_page(frame);
+    if (page == NULL || page->refcount == 0 || frame / PAGE_SIZE >= HOST_FRAMES) {
+        host_fail("pagina de usuario mapeada sobre un marco libre");
+    }
+    if (host_frame_refs[frame / PAGE_SIZE]++ == 0) {
+        host_frame_list[host_frame_count++] = (uint32_t)(frame / PAGE_SIZE);
+    }
+}
+
+/**
+ * Una página de usuario tiene el NX de su región, y el bit 63 solo si
+ * tiene PAGE_NX y EFER.NXE está activo
+ */
+static void host_vmm_check_nx(vmm_entry_t entry, const vmm_region_t* region) {
+    if ((entry & PAGE_NX) != (region->flags & PAGE_NX) ||
+        ((entry & VMM_ENTRY_NX) != 0) != (vmm_nx && (entry & PAGE_NX))) {
+        host_fail("pagina de usuario con un NX distinto del de su region");
+    }
+}
+
+/**
+ * Comprueba los invariantes del VMM
+ */
+void host_vmm_check(void) {
+
+    // Regiones: alineadas, de usuario, de un espacio vivo y sin solaparse
+    // (guardas incluidas) con otra del mismo espacio
+    for (vmm_region_t* region = vmm_regions; region != NULL; region = region->next) {
+        if (!host_vmm_is_space(region->page_dir)) {
+            host_fail("region de un espacio de direcciones destruido");
+        }
+        if (((region->start | region->end | region->guard) & PAGE_OFFSET_MASK) != 0 ||
+            region->start >= region->end || region->start - region->guard < USER_SPACE_START ||
+            region->end + region->guard > USER_SPACE_END) {
+            host_fail("region mal alineada o fuera del espacio de usuario");
+        }
+        for (vmm_region_t* other = region->next; other != NULL; other = other->next) {
+            if (other->page_dir == region->page_dir &&
+                other->start - other->guard < region->end + region->guard &&
+                other->end + other->guard > region->start - region->guard) {
+                host_fail("dos regiones (o sus guardas) se solapan");
+            }
+        }
+    }
+
+    for (uint32_t dir = vmm_spaces; dir != 0; dir = pmm_get_page(dir)->link) {
+        page_directory_t* page_dir = (page_directory_t*)(uintptr_t)dir;
+
+        // Con PAE, la PDPT del espacio apunta a sus cuatro directorios
+        if (vmm_pae) {
+            uint64_t* pdpt = (uint64_t*)(uintptr_t)vmm_cr3(page_dir);
+            for (uint32_t i = 0; i < VMM_PDPT_ENTRIES; i++) {
+                if (((uintptr_t)pdpt & 31) != 0 || pdpt[i] != ((dir + i * PAGE_SIZE) | PAGE_PRESENT) ||
+                    !(pmm_get_page(dir + i * PAGE_SIZE)->flags & PAGE_FRAME_TABLE)) {
+                    host_fail("PDPT de un espacio que no apunta a sus directorios");
+                }
+            }
+        }
+
+        for (uint32_t i = 0; i < vmm_dir_entries(); i++) {
+            vmm_entry_t pde = vmm_entry_get(page_dir, i);
+            if (vmm_is_kernel_index(i)) {
+                if (pde != vmm_entry_get(kernel_directory, i)) {
+                    host_fail("entrada del kernel distinta de kernel_directory");
+                }
+                continue;
+            }
+            if (!(pde & PAGE_PRESENT)) {
+                continue;
+            }
+
+            uint32_t base = i << vmm_dir_shift;
+            if (pde & PAGE_LARGE) {
+                if ((vmm_entry_frame(pde) & (vmm_large_size - 1)) != 0 || !(pde & PAGE_USER)) {
+                    host_fail("pagina grande de usuario mal formada");
+                }
+                vmm_region_t* region = vmm_region_find(page_dir, base);
+                if (region == NULL || vmm_region_find(page_dir, base + vmm_large_size - PAGE_SIZE) == NULL) {
+                    host_fail("pagina grande fuera de una region");
+                }
+                host_vmm_check_nx(pde, region);
+                for (uint32_t j = 0; j < vmm_table_entries; j++) {
+                    host_vmm_ref(vmm_entry_large(pde) + (phys_addr_t)j * PAGE_SIZE);
+                }
+                continue;
+            }
+
+            page_t* table_frame = pmm_get_page(vmm_entry_frame(pde));
+            if (table_frame->refcount != 1 || !(table_frame->flags & PAGE_FRAME_TABLE)) {
+                host_fail("page table de usuario sin PAGE_FRAME_TABLE o compartida");
+            }
+            void* table = kmap(vmm_entry_frame(pde));
+            for (uint32_t j = 0; j < vmm_table_entries; j++) {
+                vmm_entry_t pte = vmm_entry_get(table, j);
+                if (!(pte & PAGE_PRESENT)) {
+                    continue;
+                }
+                if (!(pte & PAGE_USER) || ((pte & PAGE_COW) && (pte & PAGE_WRITE))) {
+                    host_fail("pagina de usuario sin PAGE_USER o COW escribible");
+                }
+                vmm_region_t* region = vmm_region_find(page_dir, base + j * PAGE_SIZE);
+                if (region == NULL) {
+                    host_fail("pagina de usuario fuera de una region (o en una guarda)");
+                }
+                host_vmm_check_nx(pte, region);
+                host_vmm_ref(vmm_entry_frame(pte));
+            }
+            kunmap(table);
+        }
+    }
+
+    // Cada marco de usuario tiene exactamente una referencia por mapeo
+    for (uint32_t i = 0; i < host_frame_count; i++) {
+        uint32_t page = host_frame_list[i];
+        if (host_frame_refs[page] != pmm_get_page((phys_addr_t)page * PAGE_SIZE)->refcount) {
+            host_fail("refcount de un marco distinto de sus mapeos");
+        }
+        host_frame_refs[page] = 0;
+    }
+    host_frame_count = 0;
+}
@@ -0,0 +1,2257 @@
+/**
+ * NeoOS - Memory Host Harness
+ * Pruebas de propiedades y benchmark por trazas del asignador del kernel
+ *
+ * Uso:
+ *   memhost stress [-s semilla] [-n ops]   Pruebas de propiedades de heap, PMM y VMM
+ *                  [-P] [-H MB]            (-P: VMM con PAE y NX; -H: memoria
+ *                                          por encima de 4GB)
+ *   memhost bench [-s semilla]             Cargas integradas (boot, churn, ipc, frag)
+ *   memhost replay traza...                Reproduce trazas grabadas
+ *   memhost gen carga [-s semilla]         Escribe la traza de una carga integrada
+ * Opciones comunes: -m MB de memoria física, -v muestra la salida VGA
+ *
+ * Formato de traza (una operación por línea, '#' inicia un comentario):
+ *   a <id> <size>            kmalloc
+ *   A <id> <size> <align>    kmalloc_aligned
+ *   z <id> <size>            kzalloc
+ *   r <id> <size>            krealloc
+ *   f <id>                   kfree
+ *   i                        heap_idle_zero hasta que no quede trabajo
+ *   s                        heap_shrink
+ *
+ * Cada carga y cada traza se ejecuta en un proceso hijo con el asignador
+ * recién inicializado.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "host.h"
+
+// API del kernel (memory.h) con tipos de C
+typedef uint64_t phys_addr_t;
+void* kmalloc(unsigned long size);
+void* kzalloc(unsigned long size);
+void* kcalloc(unsigned long count, unsigned long size);
+void* kmalloc_aligned(unsigned long size, unsigned long align);
+void* krealloc(void* ptr, unsigned long size);
+void kfree(void* ptr);
+unsigned long heap_shrink(void);
+int heap_idle_zero(void);
+phys_addr_t pmm_alloc_page(void);
+void pmm_free_page(phys_addr_t page);
+phys_addr_t pmm_alloc_pages(uint32_t order);
+phys_addr_t pmm_alloc_pages_zone(uint32_t order, uint32_t zone);
+void pmm_free_pages(phys_addr_t addr, uint32_t order);
+uint32_t pmm_get_free_pages(void);
+uint32_t pmm_get_total_pages(void);
+void* pmm_get_page(phys_addr_t addr);
+uint32_t pmm_get_pages_block(phys_addr_t* phys);
+uint32_t pmm_get_free_blocks(uint32_t order);
+uint32_t pmm_page_ref(phys_addr_t addr);
+phys_addr_t pmm_alloc_page_zone(uint32_t zone);
+uint32_t pmm_get_zone_free_pages(uint32_t zone);
+uint32_t pmm_alloc_batch(uint32_t count, phys_addr_t* frames, uint32_t zone);
+void pmm_reserve_range(phys_addr_t addr, uint32_t size);
+void pmm_free_range(phys_addr_t addr, uint32_t size);
+phys_addr_t pmm_alloc_zeroed_page(void);
+int pmm_zero_pool_fill(void);
+_Bool pmm_zero_pages(phys_addr_t addr, uint32_t count);
+uint32_t pmm_zero_pool_drain(void);
+void pmm_get_zero_stats(uint32_t* hits, uint32_t* misses, uint32_t* pooled);
+void* kmalloc_p(unsigned long size, phys_addr_t* phys);
+void* kmalloc_ap(unsigned long size, phys_addr_t* phys);
+
+// VMM simulado (host_mock.c)
+void* vmm_get_kernel_directory(void);
+phys_addr_t vmm_get_physical(void* dir, uint32_t virt);
+
+// VMM real (host_vmm.c renombra lo que también da el simulado)
+void* vmm_create_address_space(void);
+void vmm_destroy_address_space(void* dir);
+void* vmm_clone_address_space(void* dir);
+void vmm_switch_directory(void* dir);
+int vmm_region_create(void* dir, uint32_t start, uint32_t size, uint32_t flags);
+int vmm_region_destroy(void* dir, uint32_t start);
+void vmm_get_fault_stats(uint32_t* minor, uint32_t* avg_cycles, uint32_t* max_cycles);
+void vmm_get_cow_stats(uint32_t* breaks, uint32_t* copies);
+int vmm_map_user(void* dir, uint32_t* addr, uint32_t size, uint32_t flags, uint32_t options);
+int vmm_unmap_user(void* dir, uint32_t addr, uint32_t size);
+int host_vmm_map_range(void* dir, uint32_t virt, const phys_addr_t* frames, phys_addr_t phys, uint32_t count,
+                       uint32_t flags);
+uint32_t host_vmm_unmap_range(void* dir, uint32_t virt, uint32_t count, _Bool release);
+phys_addr_t host_vmm_get_physical(void* dir, uint32_t virt);
+void* host_vmm_get_kernel_directory(void);
+
+// Orden máximo del buddy allocator y zona DMA (memory.h)
+#define PMM_MAX_ORDER 10
+#define ZONE_DMA      0
+#define ZONE_LOW      1
+#define ZONE_HIGH     2
+#define ZONE_DMA_END  0x01000000
+
+// Flags de página, espacio de usuario y códigos de error (memory.h,
+// error.h) y bits del código de error de un page fault
+#define PAGE_PRESENT     0x001
+#define PAGE_WRITE       0x002
+#define PAGE_USER        0x004
+#define PAGE_LARGE       0x080
+#define PAGE_GLOBAL      0x100
+#define PAGE_COW         0x200
+#define PAGE_NX          0x800
+#define PAGE_FRAME       0x000FFFFFFFFFF000ULL
+#define ENTRY_NX         (1ULL << 63)
+#define USER_SPACE_START 0x08000000U
+#define USER_SPACE_END   0xC0000000U
+#define PF_PRESENT       0x1
+#define PF_WRITE         0x2
+#define PF_USER          0x4
+#define PF_FETCH         0x10
+#define E_OK             0
+#define E_NOMEM          (-2)
+#define E_INVAL          (-3)
+#define E_NOENT          (-4)
+#define E_EXISTS         (-5)
+
+// Opciones de vmm_map_user (memory.h)
+#define VMM_MAP_FIXED    0x01
+#define VMM_MAP_POPULATE 0x02
+#define VMM_MAP_LARGE    0x04
+#define VMM_MAP_GUARD    0x08
+
+// Ventana de los descriptores de marco reubicados (memory.h)
+#define KERNEL_FRAMES_START 0xE0000000U
+
+// Páginas de la región de la prueba de demand paging
+#define STRESS_REGION_PAGES 256
+
+// Espacios de direcciones vivos de la prueba de copy-on-write
+#define STRESS_COW_SPACES 3
+
+// Rangos de la prueba de vmm_map_range: ventana de dos page tables y
+// páginas hasta las que se usa invlpg (VMM_INVLPG_MAX)
+#define STRESS_MAP_WINDOW  (2 * large_page_size)
+#define STRESS_MAP_PAGES   96
+#define STRESS_MAP_KERNEL  0xF0000000U
+#define VMM_INVLPG_MAX     32
+
+// Prueba de vmm_map_user: regiones vivas del modelo y páginas máximas de
+// cada una
+#define STRESS_USER_REGIONS 16
+#define STRESS_USER_PAGES   32
+
+// Cada cuántas operaciones se muestrea la fragmentación
+#define SAMPLE_INTERVAL 256
+
+// Huecos de la prueba de propiedades del heap
+#define STRESS_SLOTS 4096
+
+// Marcos que la prueba del PMM retiene a la vez
+#define STRESS_FRAMES 8192
+
+// Páginas máximas de un lote y de un rango en la prueba de rangos
+#define STRESS_BATCH 256
+#define STRESS_RANGE 2048
+
+// Bloques vivos de la prueba de kmalloc_p/kmalloc_ap
+#define STRESS_PHYS_SLOTS 64
+
+/*
+ * Trazas
+ */
+
+typedef struct {
+    char op;
+    uint32_t id;
+    uint32_t size;
+    uint32_t align;
+} trace_op_t;
+
+typedef struct {
+    const char* name;
+    trace_op_t* ops;
+    size_t count;
+    size_t capacity;
+    uint32_t ids;                   // Mayor id usado + 1
+} trace_t;
+
+typedef struct {
+    unsigned long ops;
+    unsigned long failures;
+    double seconds;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+    unsigned long peak_kb;
+    unsigned int frag_final;
+    unsigned int frag_max;
+} bench_result_t;
+
+static unsigned int phys_mb = HOST_PHYS_DEFAULT_MB;
+static unsigned int high_mb = 0;    // -H: memoria por encima de 4GB (MB)
+static uint32_t seed = 1;
+
+// CPU simulada del VMM (-P: PAE con NX) y lo que eligió el VMM: tamaño de
+// una página grande (4MB, o 2MB con PAE) y bit 63 en las páginas PAGE_NX
+static unsigned int cpu_features = HOST_CPU_PSE | HOST_CPU_PGE;
+static uint32_t large_page_size = 0x00400000U;
+static int nx_mode = 0;
+
+static void trace_emit(trace_t* trace, char op, uint32_t id, uint32_t size, uint32_t align) {
+    if (trace->count == trace->capacity) {
+        trace->capacity = trace->capacity ? trace->capacity * 2 : 4096;
+        trace->ops = realloc(trace->ops, trace->capacity * sizeof(trace_op_t));
+        if (trace->ops == NULL) {
+            host_fail("sin memoria para la traza");
+        }
+    }
+    trace->ops[trace->count++] = (trace_op_t){ op, id, size, align };
+    if (id >= trace->ids) {
+        trace->ids = id + 1;
+    }
+}
+
+static int trace_load(trace_t* trace, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char line[128];
+    unsigned long number = 0;
+    memset(trace, 0, sizeof(*trace));
+    trace->name = path;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        number++;
+        char op = 0;
+        unsigned int id = 0, size = 0, align = 0;
+        int fields = sscanf(line, " %c %u %u %u", &op, &id, &size, &align);
+        if (fields <= 0 || op == '#') {
+            continue;
+        }
+
+        int needed = op == 'A' ? 4 : (op == 'a' || op == 'z' || op == 'r') ? 3 : op == 'f' ? 2 : 1;
+        if (strchr("aAzrfis", op) == NULL || fields < needed) {
+            fprintf(stderr, "%s:%lu: operacion invalida\n", path, number);
+            fclose(file);
+            return -1;
+        }
+        trace_emit(trace, op, id, size, align);
+    }
+
+    fclose(file);
+    return 0;
+}
+
+static void trace_print(const trace_t* trace, FILE* out) {
+    fprintf(out, "# carga %s, semilla %u\n", trace->name, seed);
+    for (size_t i = 0; i < trace->count; i++) {
+        const trace_op_t* op = &trace->ops[i];
+        switch (op->op) {
+            case 'A': fprintf(out, "A %u %u %u\n", op->id, op->size, op->align); break;
+            case 'f': fprintf(out, "f %u\n", op->id); break;
+            case 'i':
+            case 's': fprintf(out, "%c\n", op->op); break;
+            default:  fprintf(out, "%c %u %u\n", op->op, op->id, op->size); break;
+        }
+    }
+}
+
+/*
+ * Cargas integradas
+ * Siguen los patrones de asignación del kernel: estructuras de arranque,
+ * creación y destrucción de procesos y colas IPC
+ */
+
+static uint32_t rng_next(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static uint32_t rng_range(uint32_t* state, uint32_t lo, uint32_t hi) {
+    return lo + rng_next(state) % (hi - lo + 1);
+}
+
+// Tamaño de un mensaje IPC: casi todos pequeños, algunos de hasta 4KB
+static uint32_t ipc_message_size(uint32_t* rng) {
+    uint32_t r = rng_next(rng) % 100;
+    return r < 70 ? rng_range(rng, 16, 128) : r < 95 ? rng_range(rng, 129, 1024) : rng_range(rng, 1025, 4096);
+}
+
+/**
+ * Arranque: tablas y descriptores de larga vida, stacks, buffers grandes
+ * (ramdisk, filesystem) y mucha memoria temporal de inicialización
+ */
+static void gen_boot(trace_t* trace, uint32_t* rng) {
+    uint32_t id = 0;
+    uint32_t pending[64];
+    uint32_t pending_count = 0;
+
+    trace_emit(trace, 'a', id++, 256, 0);                   // Tabla de procesos
+    for (int i = 0; i < 48; i++) {
+        trace_emit(trace, 'a', id++, rng_range(rng, 32, 320), 0);   // Módulos, dispositivos
+    }
+    for (int i = 0; i < 8; i++) {
+        trace_emit(trace, 'a', id++, 4096, 0);              // Stacks del kernel
+    }
+    trace_emit(trace, 'z', id++, 1024 * 1024, 0);           // Ramdisk
+    trace_emit(trace, 'a', id++, 2 * 1024 * 1024, 0);       // Buffer de early_neofs
+    for (int i = 0; i < 4; i++) {
+        trace_emit(trace, 'A', id++, 4096, 4096);           // Estructuras alineadas a página
+    }
+
+    // Inicialización: buffers temporales que se liberan pronto y algunos
+    // que se quedan
+    for (int i = 0; i < 6000; i++) {
+        uint32_t r = rng_next(rng) % 100;
+        if (r < 55 || pending_count == 0) {
+            uint32_t size = r < 30 ? rng_range(rng, 8, 64) : rng_range(rng, 64, 1024);
+            trace_emit(trace, r % 7 == 0 ? 'z' : 'a', id, size, 0);
+            if (pending_count < 64 && r % 10 != 0) {
+                pending[pending_count++] = id;
+            }
+            id++;
+        } else {
+            uint32_t index = rng_next(rng) % pending_count;
+            trace_emit(trace, 'f', pending[index], 0, 0);
+            pending[index] = pending[--pending_count];
+        }
+    }
+
+    trace_emit(trace, 'i', 0, 0, 0);
+}
+
+/**
+ * Procesos: cada uno tiene PCB, stack, arena temporal y nombre; se crean
+ * y terminan constantemente entre asignaciones temporales
+ */
+static void gen_churn(trace_t* trace, uint32_t* rng) {
+    enum { MAX_PROCS = 64, PROC_IDS = 4 };
+    uint32_t procs[MAX_PROCS][PROC_IDS];
+    uint32_t proc_count = 0;
+    uint32_t transient[32];
+    uint32_t transient_count = 0;
+    uint32_t id = 0;
+
+    for (int step = 0; step < 40000; step++) {
+        uint32_t r = rng_next(rng) % 100;
+
+        if (r < 40 && proc_count < MAX_PROCS) {
+            uint32_t* proc = procs[proc_count++];
+            proc[0] = id;
+            trace_emit(trace, 'z', id++, 128, 0);           // PCB
+            proc[1] = id;
+            trace_emit(trace, 'a', id++, 4096, 0);          // Stack del kernel
+            proc[2] = id;
+            trace_emit(trace, 'a', id++, 4096, 0);          // Arena temporal
+            proc[3] = id;
+            trace_emit(trace, 'a', id++, rng_range(rng, 8, 32), 0);  // Nombre
+        } else if (r < 80 && proc_count > 0) {
+            uint32_t index = rng_next(rng) % proc_count;
+            uint32_t first = rng_next(rng) % PROC_IDS;
+            for (int k = 0; k < PROC_IDS; k++) {
+                trace_emit(trace, 'f', procs[index][(first + k) % PROC_IDS], 0, 0);
+            }
+            memcpy(procs[index], procs[--proc_count], sizeof(procs[0]));
+        } else if (transient_count < 32 && (r & 1)) {
+            transient[transient_count++] = id;
+            trace_emit(trace, 'a', id++, rng_range(rng, 16, 1024), 0);
+        } else if (transient_count > 0) {
+            uint32_t index = rng_next(rng) % transient_count;
+            trace_emit(trace, 'f', transient[index], 0, 0);
+            transient[index] = transient[--transient_count];
+        }
+
+        if (step % 2000 == 1999) {
+            trace_emit(trace, 'i', 0, 0, 0);
+        }
+        if (step % 10000 == 9999) {
+            trace_emit(trace, 's', 0, 0, 0);
+        }
+    }
+}
+
+/**
+ * Tormenta IPC: colas FIFO de hasta 32 mensajes por proceso; cada envío
+ * copia el mensaje a un buffer nuevo y cada recepción lo libera
+ */
+static void gen_ipc(trace_t* trace, uint32_t* rng) {
+    enum { QUEUES = 8, DEPTH = 32 };
+    uint32_t queues[QUEUES][DEPTH];
+    uint32_t head[QUEUES] = { 0 };
+    uint32_t length[QUEUES] = { 0 };
+    uint32_t id = 1;
+    uint32_t log_size = 256;
+
+    trace_emit(trace, 'a', 0, log_size, 0);                 // Buffer de log que crece
+
+    for (int step = 0; step < 80000; step++) {
+        uint32_t q = rng_next(rng) % QUEUES;
+
+        if ((rng_next(rng) & 1) && length[q] < DEPTH) {
+            queues[q][(head[q] + length[q]) % DEPTH] = id;
+            length[q]++;
+            trace_emit(trace, 'a', id++, ipc_message_size(rng), 0);
+        } else if (length[q] > 0) {
+            trace_emit(trace, 'f', queues[q][head[q]], 0, 0);
+            head[q] = (head[q] + 1) % DEPTH;
+            length[q]--;
+        }
+
+        if (step % 500 == 499) {
+            log_size = log_size < 32768 ? log_size * 2 : 256;
+            trace_emit(trace, 'r', 0, log_size, 0);
+        }
+    }
+}
+
+/**
+ * Fragmentación: huecos grandes entre bloques pequeños de larga vida que
+ * las peticiones posteriores no pueden aprovechar
+ */
+static void gen_frag(trace_t* trace, uint32_t* rng) {
+    enum { PAIRS = 3000 };
+    uint32_t id = 0;
+
+    for (int i = 0; i < PAIRS; i++) {
+        trace_emit(trace, 'a', id++, 48, 0);
+        trace_emit(trace, 'a', id++, rng_range(rng, 1500, 2500), 0);
+    }
+    for (uint32_t i = 1; i < 2 * PAIRS; i += 2) {
+        trace_emit(trace, 'f', i, 0, 0);
+    }
+    for (int i = 0; i < 2000; i++) {
+        trace_emit(trace, 'a', id++, 3000, 0);
+    }
+    for (uint32_t i = 0; i < id; i += 2) {
+        if (i % 2 == 0 && (i < 2 * PAIRS || rng_next(rng) % 2 == 0)) {
+            trace_emit(trace, 'f', i, 0, 0);
+        }
+    }
+    trace_emit(trace, 's', 0, 0, 0);
+}
+
+typedef struct {
+    const char* name;
+    void (*generate)(trace_t* trace, uint32_t* rng);
+} workload_t;
+
+static const workload_t workloads[] = {
+    { "boot",  gen_boot },
+    { "churn", gen_churn },
+    { "ipc",   gen_ipc },
+    { "frag",  gen_frag },
+};
+
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+static void workload_generate(const workload_t* workload, trace_t* trace) {
+    uint32_t rng = seed != 0 ? seed : 1;
+    memset(trace, 0, sizeof(*trace));
+    trace->name = workload->name;
+    workload->generate(trace, &rng);
+}
+
+/*
+ * Reproducción
+ */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void kernel_setup(void) {
+    if (host_memory_setup(phys_mb, high_mb) != 0) {
+        exit(2);
+    }
+    if (host_kernel_init(phys_mb << 20, high_mb) != 0) {
+        host_fail("no se pudo inicializar el asignador");
+    }
+}
+
+static void replay(const trace_t* trace, bench_result_t* result) {
+    void** ptrs = calloc(trace->ids, sizeof(void*));
+    uint32_t* latency = malloc((trace->count + 1) * sizeof(uint32_t));
+    if (ptrs == NULL || latency == NULL) {
+        host_fail("sin memoria para la reproduccion");
+    }
+
+    host_heap_info_t info;
+    uint64_t total = 0;
+    unsigned long peak = 0;
+
+    memset(result, 0, sizeof(*result));
+
+    for (size_t i = 0; i < trace->count; i++) {
+        const trace_op_t* op = &trace->ops[i];
+        void* ptr = NULL;
+        uint64_t start = now_ns();
+
+        switch (op->op) {
+            case 'a': ptr = ptrs[op->id] = kmalloc(op->size); break;
+            case 'A': ptr = ptrs[op->id] = kmalloc_aligned(op->size, op->align); break;
+            case 'z': ptr = ptrs[op->id] = kzalloc(op->size); break;
+            case 'r':
+                ptr = krealloc(ptrs[op->id], op->size);
+                if (ptr != NULL) {
+                    ptrs[op->id] = ptr;
+                }
+                break;
+            case 'f':
+                kfree(ptrs[op->id]);
+                ptrs[op->id] = NULL;
+                break;
+            case 'i':
+                while (heap_idle_zero()) {
+                }
+                continue;
+            case 's':
+                heap_shrink();
+                continue;
+        }
+
+        uint64_t elapsed = now_ns() - start;
+        latency[result->ops++] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+        total += elapsed;
+
+        if (op->op != 'f' && ptr == NULL) {
+            result->failures++;
+        } else if (op->op != 'f' && op->op != 'r') {
+            memset(ptr, 0x5A, op->size < 64 ? op->size : 64);  // Tocar la memoria como un usuario real
+        }
+
+        unsigned long frames = host_frames_used();
+        if (frames > peak) {
+            peak = frames;
+        }
+        if (i % SAMPLE_INTERVAL == 0) {
+            host_heap_info(&info);
+            if (info.fragmentation > result->frag_max) {
+                result->frag_max = info.fragmentation;
+            }
+        }
+    }
+
+    host_heap_info(&info);
+    host_heap_check(0);
+
+    result->seconds = (double)total / 1e9;
+    result->peak_kb = peak * 4;
+    result->frag_final = info.fragmentation;
+    if (info.fragmentation > result->frag_max) {
+        result->frag_max = info.fragmentation;
+    }
+    if (result->ops > 0) {
+        qsort(latency, result->ops, sizeof(uint32_t), compare_u32);
+        result->p50 = latency[result->ops / 2];
+        result->p99 = latency[(result->ops * 99) / 100];
+        result->max = latency[result->ops - 1];
+    }
+
+    free(latency);
+    free(ptrs);
+}
+
+static void print_header(void) {
+    printf("%-12s %8s %8s %7s %7s %8s %9s %6s %9s %6s\n",
+           "carga", "ops", "Mops/s", "p50 ns", "p99 ns", "max ns", "pico KB", "frag%", "fragmax%", "fallos");
+}
+
+static void print_result(const char* name, const bench_result_t* result) {
+    double mops = result->seconds > 0 ? (double)result->ops / result->seconds / 1e6 : 0;
+    printf("%-12s %8lu %8.2f %7u %7u %8u %9lu %6u %9u %6lu\n",
+           name, result->ops, mops, result->p50, result->p99, result->max,
+           result->peak_kb, result->frag_final, result->frag_max, result->failures);
+    fflush(stdout);
+}
+
+/**
+ * Ejecuta una traza en un proceso hijo con el asignador recién iniciado
+ * @return 0 si terminó bien
+ */
+static int run_isolated(const trace_t* trace, const workload_t* workload, const char* path) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0) {
+        trace_t loaded;
+        if (workload != NULL) {
+            workload_generate(workload, &loaded);
+            trace = &loaded;
+        } else if (path != NULL) {
+            if (trace_load(&loaded, path) != 0) {
+                _exit(2);
+            }
+            trace = &loaded;
+        }
+
+        kernel_setup();
+        bench_result_t result;
+        replay(trace, &result);
+        print_result(trace->name, &result);
+        _exit(host_vga_errors() != 0 ? 3 : 0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "memhost: %s fallo (estado %d)\n",
+                workload != NULL ? workload->name : path, status);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Pruebas de propiedades
+ */
+
+typedef struct {
+    uint8_t* ptr;
+    uint32_t size;
+    uint8_t tag;
+} slot_t;
+
+static void slot_fill(slot_t* slot) {
+    memset(slot->ptr, slot->tag, slot->size);
+}
+
+static void slot_verify(const slot_t* slot, uint32_t size) {
+    for (uint32_t k = 0; k < size; k++) {
+        if (slot->ptr[k] != slot->tag) {
+            host_fail("contenido de un bloque vivo modificado (solapamiento)");
+        }
+    }
+}
+
+static uint32_t stress_size(uint32_t* rng) {
+    uint32_t r = rng_next(rng) % 1000;
+    if (r < 600) return rng_range(rng, 1, 64);
+    if (r < 900) return rng_range(rng, 65, 1024);
+    if (r < 980) return rng_range(rng, 1025, 16384);
+    if (r < 995) return rng_range(rng, 16385, 65535);
+    return rng_range(rng, 65536, 512 * 1024);           // Va a kvmalloc
+}
+
+static void check_pointer(const slot_t* slot, uint32_t align) {
+    uintptr_t addr = (uintptr_t)slot->ptr;
+    if ((addr & (align - 1)) != 0) {
+        host_fail("puntero mal alineado");
+    }
+    if (addr < 0xC0000000UL || addr + slot->size > 0xE0000000UL) {
+        host_fail("puntero fuera de los rangos del heap y kvmalloc");
+    }
+}
+
+/**
+ * Operaciones aleatorias sobre el heap comprobando contenido, alineación,
+ * ceros de kzalloc y los invariantes de división y fusión
+ */
+static void stress_heap(uint32_t* rng, long ops) {
+    static slot_t slots[STRESS_SLOTS];
+    unsigned int frames_base = host_frames_used();
+    long failures = 0;
+    long checks = 0;
+
+    for (long it = 0; it < ops; it++) {
+        slot_t* slot = &slots[rng_next(rng) % STRESS_SLOTS];
+
+        if (slot->ptr != NULL) {
+            slot_verify(slot, slot->size);
+            if (rng_next(rng) % 4 == 0) {
+                uint32_t size = stress_size(rng);
+                uint8_t* ptr = krealloc(slot->ptr, size);
+                if (ptr == NULL) {
+                    failures++;
+                    continue;  // El bloque original sigue siendo válido
+                }
+                slot->ptr = ptr;
+                slot_verify(slot, size < slot->size ? size : slot->size);
+                slot->size = size;
+                check_pointer(slot, 16);
+            } else {
+                kfree(slot->ptr);
+                slot->ptr = NULL;
+                continue;
+            }
+        } else {
+            uint32_t kind = rng_next(rng) % 8;
+            uint32_t align = 16;
+            slot->size = stress_size(rng);
+
+            if (kind == 0) {
+                align = 32U << (rng_next(rng) % 8);
+                slot->ptr = kmalloc_aligned(slot->size, align);
+            } else if (kind < 3) {
+                slot->ptr = kzalloc(slot->size);
+            } else if (kind == 3) {
+                slot->ptr = kcalloc(slot->size, 1);
+            } else {
+                slot->ptr = kmalloc(slot->size);
+            }
+
+            if (slot->ptr == NULL) {
+                failures++;
+                continue;
+            }
+            check_pointer(slot, align);
+            if (kind >= 1 && kind <= 3) {
+                for (uint32_t k = 0; k < slot->size; k++) {
+                    if (slot->ptr[k] != 0) {
+                        host_fail("kzalloc/kcalloc devolvio memoria sucia");
+                    }
+                }
+            }
+        }
+
+        slot->tag = (uint8_t)rng_next(rng);
+        slot_fill(slot);
+
+        if (rng_next(rng) % 64 == 0) {
+            heap_shrink();
+        }
+        if (rng_next(rng) % 16 == 0) {
+            for (int q = rng_next(rng) % 32; q > 0 && heap_idle_zero(); q--) {
+            }
+        }
+        if (it % 4096 == 0) {
+            host_heap_check(++checks % 8 == 0);
+        }
+    }
+
+    for (int i = 0; i < STRESS_SLOTS; i++) {
+        if (slots[i].ptr != NULL) {
+            slot_verify(&slots[i], slots[i].size);
+            kfree(slots[i].ptr);
+            slots[i].ptr = NULL;
+        }
+    }
+    while (heap_idle_zero()) {
+    }
+    host_heap_check(1);
+    heap_shrink();
+    host_heap_check(1);
+
+    // Solo pueden quedar la primera página del heap y el slab vacío que
+    // retiene el cache de descriptores de kvmalloc
+    if (host_frames_used() > frames_base + 2) {
+        host_fail("marcos sin devolver tras liberar todo");
+    }
+
+    printf("heap: %ld ops, %ld fallos por falta de memoria, %ld comprobaciones\n", ops, failures, checks);
+}
+
+/**
+ * Comprueba que la dirección física de kmalloc_p/kmalloc_ap vale para
+ * todo el bloque: cada página del bloque está en phys + su desplazamiento
+ */
+static void check_physical(const slot_t* slot, phys_addr_t phys, uint32_t align) {
+    void* dir = vmm_get_kernel_directory();
+    uintptr_t addr = (uintptr_t)slot->ptr;
+
+    if ((addr & (align - 1)) != 0 || (phys & (align - 1)) != 0) {
+        host_fail("kmalloc_p/kmalloc_ap mal alineado");
+    }
+    if (vmm_get_physical(dir, (uint32_t)addr) != phys) {
+        host_fail("kmalloc_p/kmalloc_ap devolvio otra direccion fisica");
+    }
+    for (uint32_t offset = 4096 - (uint32_t)(addr & 4095); offset < slot->size; offset += 4096) {
+        if (vmm_get_physical(dir, (uint32_t)addr + offset) != phys + offset) {
+            host_fail("bloque de kmalloc_p/kmalloc_ap no contiguo en memoria fisica");
+        }
+    }
+}
+
+/**
+ * kmalloc_p y kmalloc_ap: la dirección física es válida para todo el
+ * bloque (o la asignación falla), también con varias páginas; krealloc
+ * conserva los datos y kfree devuelve los marcos
+ */
+static void stress_physical(uint32_t* rng, long ops) {
+    static slot_t slots[STRESS_PHYS_SLOTS];
+    unsigned int frames_base = host_frames_used();
+    phys_addr_t phys = 0;
+    long failures = 0;
+    long multi = 0;
+
+    // El caso de la revisión: dos páginas alineadas, contiguas o NULL
+    slot_t pair = { kmalloc_ap(2 * 4096, &phys), 2 * 4096, 0x5A };
+    if (pair.ptr != NULL) {
+        check_physical(&pair, phys, 4096);
+        slot_fill(&pair);
+        slot_verify(&pair, pair.size);
+        kfree(pair.ptr);
+    }
+
+    for (long it = 0; it < ops; it++) {
+        slot_t* slot = &slots[rng_next(rng) % STRESS_PHYS_SLOTS];
+
+        if (slot->ptr != NULL) {
+            slot_verify(slot, slot->size);
+            if (rng_next(rng) % 4 == 0) {
+                uint32_t size = stress_size(rng);
+                uint8_t* ptr = krealloc(slot->ptr, size);
+                if (ptr != NULL) {
+                    slot->ptr = ptr;
+                    slot_verify(slot, size < slot->size ? size : slot->size);
+                    slot->size = size;
+                    slot_fill(slot);
+                    continue;
+                }
+            }
+            kfree(slot->ptr);
+            slot->ptr = NULL;
+            continue;
+        }
+
+        uint32_t r = rng_next(rng) % 8;
+        uint32_t align = (rng_next(rng) & 1) ? 4096 : 16;
+        slot->size = r < 5 ? rng_range(rng, 1, 4096) : rng_range(rng, 4097, 64 * 1024);
+        slot->ptr = align == 4096 ? kmalloc_ap(slot->size, &phys) : kmalloc_p(slot->size, &phys);
+        if (slot->ptr == NULL) {
+            failures++;
+            continue;
+        }
+        check_physical(slot, phys, align);
+        multi += slot->size > 4096;
+        slot->tag = (uint8_t)rng_next(rng);
+        slot_fill(slot);
+
+        if (it % 256 == 0) {
+            host_heap_check(0);
+            host_pmm_check();
+        }
+    }
+
+    for (int i = 0; i < STRESS_PHYS_SLOTS; i++) {
+        if (slots[i].ptr != NULL) {
+            slot_verify(&slots[i], slots[i].size);
+            kfree(slots[i].ptr);
+            slots[i].ptr = NULL;
+        }
+    }
+    heap_shrink();
+    host_heap_check(0);
+    host_pmm_check();
+    if (host_frames_used() > frames_base + 2) {
+        host_fail("marcos de kmalloc_p/kmalloc_ap sin devolver");
+    }
+
+    printf("fisica: %ld ops, %ld bloques de varias paginas, %ld fallos por falta de memoria\n",
+           ops, multi, failures);
+}
+
+/**
+ * Operaciones aleatorias sobre el PMM: bloques de todos los órdenes
+ * únicos, alineados a su tamaño y fuera de las zonas protegidas;
+ * liberaciones enteras o página a página; referencias extra que retrasan
+ * la liberación; dobles liberaciones ignoradas;
+ * bitmaps y contadores coherentes. Al liberar todo, los bloques deben
+ * volver a fusionarse como al principio
+ */
+static void stress_pmm(uint32_t* rng, long ops) {
+    static phys_addr_t held[STRESS_FRAMES];
+    static uint8_t held_order[STRESS_FRAMES];
+    static uint8_t held_refs[STRESS_FRAMES];
+    static uint32_t blocks_base[PMM_MAX_ORDER + 1];
+    uint32_t held_count = 0;
+    uint32_t pages = pmm_get_total_pages();
+    uint8_t* owned = calloc(pages, 1);
+    uint32_t free_base = pmm_get_free_pages();
+    unsigned long order_failures = 0;
+    unsigned long shared = 0;
+
+    for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++) {
+        blocks_base[order] = pmm_get_free_blocks(order);
+    }
+
+    for (long it = 0; it < ops; it++) {
+        if ((rng_next(rng) & 1) && held_count < STRESS_FRAMES) {
+            // Orden geométrico: la mitad de las veces una sola página
+            uint32_t order = __builtin_ctz(rng_next(rng) | (1U << PMM_MAX_ORDER));
+            uint32_t count = 1U << order;
+            int dma = order == 0 && rng_next(rng) % 4 == 0;
+            // Con memoria alta, la mitad de los bloques pueden venir de ella
+            uint32_t zone = dma ? ZONE_DMA : high_mb != 0 && (rng_next(rng) & 1) ? ZONE_HIGH : ZONE_LOW;
+            phys_addr_t frame = dma ? pmm_alloc_page_zone(ZONE_DMA) :
+                                zone == ZONE_HIGH ? pmm_alloc_pages_zone(order, ZONE_HIGH) :
+                                order == 0 ? pmm_alloc_page() : pmm_alloc_pages(order);
+            if (dma && frame >= ZONE_DMA_END) {
+                host_fail("pagina de ZONE_DMA por encima de 16MB");
+            }
+            if (frame == 0 && dma) {
+                if (pmm_get_zone_free_pages(ZONE_DMA) != 0) {
+                    host_fail("ZONE_DMA sin servir con paginas libres");
+                }
+                order_failures++;
+                continue;
+            }
+            if (frame == 0) {
+                // Los contadores del buddy suman todas las zonas
+                for (uint32_t larger = order; larger <= PMM_MAX_ORDER; larger++) {
+                    if ((zone == ZONE_HIGH || high_mb == 0) && pmm_get_free_blocks(larger) != 0) {
+                        host_fail("pmm_alloc_pages fallo con bloques libres suficientes");
+                    }
+                }
+                order_failures++;
+                continue;
+            }
+            // Fuera de la memoria baja y de la imagen del kernel
+            if ((frame & (count * 4096 - 1)) != 0 || !host_phys_present(frame, count * 4096) ||
+                (frame + count * 4096 > 0x9F000 && frame < HOST_KERNEL_END)) {
+                host_fail("bloque mal alineado, protegido o fuera de la memoria");
+            }
+            for (uint32_t page = frame / 4096; page < frame / 4096 + count; page++) {
+                if (owned[page]) {
+                    host_fail("el PMM entrego dos veces el mismo marco");
+                }
+                owned[page] = 1;
+            }
+            held[held_count] = frame;
+            held_order[held_count] = (uint8_t)order;
+            held_refs[held_count++] = 0;
+            memset((void*)(uintptr_t)frame, 0xC3, count * 4096);
+        } else if (held_count > 0 && rng_next(rng) % 8 == 0) {
+            // Compartir un bloque: una referencia más en cada página
+            uint32_t index = rng_next(rng) % held_count;
+            if (held_refs[index] == UINT8_MAX) {
+                continue;
+            }
+            for (uint32_t k = 0; k < (1U << held_order[index]); k++) {
+                if (pmm_page_ref(held[index] + k * 4096) != held_refs[index] + 2U) {
+                    host_fail("pmm_page_ref devolvio un contador inesperado");
+                }
+            }
+            held_refs[index]++;
+            shared++;
+        } else if (held_count > 0) {
+            uint32_t index = rng_next(rng) % held_count;
+            phys_addr_t frame = held[index];
+            uint32_t order = held_order[index];
+            uint32_t count = 1U << order;
+
+            if (held_refs[index] > 0) {
+                // Soltar una referencia compartida no libera nada
+                uint32_t before = pmm_get_free_pages();
+                pmm_free_pages(frame, order);
+                held_refs[index]--;
+                if (pmm_get_free_pages() != before) {
+                    host_fail("se libero un marco con referencias pendientes");
+                }
+                continue;
+            }
+            held[index] = held[held_count - 1];
+            held_order[index] = held_order[held_count - 1];
+            held_refs[index] = held_refs[--held_count];
+
+            for (uint32_t page = frame / 4096; page < frame / 4096 + count; page++) {
+                owned[page] = 0;
+            }
+            if (order > 0 && rng_next(rng) % 4 == 0) {
+                // Por partes, de atrás hacia delante
+                for (uint32_t k = count; k > 0; k--) {
+                    pmm_free_page(frame + (k - 1) * 4096);
+                }
+            } else {
+                pmm_free_pages(frame, order);
+            }
+
+            if (rng_next(rng) % 32 == 0) {
+                uint32_t before = pmm_get_free_pages();
+                pmm_free_pages(frame, order);       // Doble liberación
+                if (pmm_get_free_pages() != before) {
+                    host_fail("una doble liberacion cambio el contador");
+                }
+            }
+        }
+        if (it % 1024 == 0) {
+            host_pmm_check();
+        }
+    }
+
+    while (held_count > 0) {
+        held_count--;
+        for (uint32_t ref = 0; ref <= held_refs[held_count]; ref++) {
+            pmm_free_pages(held[held_count], held_order[held_count]);
+        }
+    }
+    memset(owned, 0, pages);
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("paginas libres distintas tras liberar todo");
+    }
+    for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++) {
+        if (pmm_get_free_blocks(order) != blocks_base[order]) {
+            host_fail("los bloques del buddy no se fusionaron como al principio");
+        }
+    }
+
+    // Agotar la memoria, también la alta, y recuperarla entera
+    uint32_t exhausted = 0;
+    for (phys_addr_t frame = pmm_alloc_page_zone(ZONE_HIGH); frame != 0; frame = pmm_alloc_page_zone(ZONE_HIGH)) {
+        held[exhausted % STRESS_FRAMES] = frame;
+        owned[frame / 4096] = 1;
+        exhausted++;
+    }
+    if (exhausted != free_base) {
+        host_fail("no se pudieron asignar todas las paginas libres");
+    }
+    for (uint32_t page = 0; page < pages; page++) {
+        if (owned[page]) {
+            pmm_free_page((phys_addr_t)page * 4096);
+        }
+    }
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("paginas libres distintas tras agotar la memoria");
+    }
+
+    free(owned);
+    printf("pmm: %ld ops, %lu bloques sin hueco, %lu compartidos, %u paginas agotadas y recuperadas\n",
+           ops, order_failures, shared, exhausted);
+}
+
+/**
+ * Lotes y rangos del PMM: pmm_alloc_batch entrega páginas únicas de las
+ * zonas aceptables y solo se queda corto sin páginas libres en ellas;
+ * reservar un rango saca sus páginas libres (dos veces no cambia nada) y
+ * liberarlo las devuelve sin tocar las asignadas que contiene. Al
+ * terminar, los bloques deben fusionarse como al principio
+ */
+static void stress_range(uint32_t* rng, long ops) {
+    static phys_addr_t batch[STRESS_BATCH];
+    static uint32_t blocks_base[PMM_MAX_ORDER + 1];
+    uint32_t pages = pmm_get_total_pages();
+    uint32_t low_pages = (phys_mb << 20) / 4096;
+    uint8_t* owned = calloc(pages, 1);
+    uint32_t free_base = pmm_get_free_pages();
+    unsigned long reserved = 0;
+
+    for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++) {
+        blocks_base[order] = pmm_get_free_blocks(order);
+    }
+
+    for (long it = 0; it < ops; it++) {
+        uint32_t zone = rng_next(rng) % 3;
+        uint32_t wanted = rng_range(rng, 1, STRESS_BATCH);
+        uint32_t zone_free = 0;
+
+        for (uint32_t z = 0; z <= zone; z++) {
+            zone_free += pmm_get_zone_free_pages(z);
+        }
+        uint32_t got = pmm_alloc_batch(wanted, batch, zone);
+        if (got > wanted || (got < wanted && got != zone_free)) {
+            host_fail("pmm_alloc_batch entrego un numero de paginas inesperado");
+        }
+        for (uint32_t i = 0; i < got; i++) {
+            phys_addr_t frame = batch[i];
+            if ((frame & 4095) != 0 || !host_phys_present(frame, 4096) ||
+                (frame >= 0x9F000 && frame < HOST_KERNEL_END) ||
+                (zone == ZONE_DMA && frame >= ZONE_DMA_END)) {
+                host_fail("pagina de un lote protegida o fuera de su zona");
+            }
+            if (owned[frame / 4096]) {
+                host_fail("el lote repitio un marco");
+            }
+            owned[frame / 4096] = 1;
+        }
+
+        // Rango por encima de la imagen del kernel, a veces sin alinear
+        uint32_t first = rng_range(rng, HOST_KERNEL_END / 4096, low_pages - 1);
+        uint32_t count = rng_range(rng, 1, STRESS_RANGE);
+        if (count > low_pages - first) {
+            count = low_pages - first;
+        }
+        uint32_t before = pmm_get_free_pages();
+        if (rng_next(rng) & 1) {
+            pmm_reserve_range(first * 4096 + 100, count * 4096 - 200);
+        } else {
+            pmm_reserve_range(first * 4096, count * 4096);
+        }
+        uint32_t after = pmm_get_free_pages();
+        if (before - after > count) {
+            host_fail("pmm_reserve_range saco paginas fuera del rango");
+        }
+        pmm_reserve_range(first * 4096, count * 4096);
+        if (pmm_get_free_pages() != after) {
+            host_fail("reservar dos veces cambio el contador");
+        }
+        reserved += before - after;
+        if (it % 64 == 0) {
+            host_pmm_check();
+        }
+
+        pmm_free_range(first * 4096, count * 4096);
+        if (pmm_get_free_pages() != before) {
+            host_fail("pmm_free_range no devolvio las paginas reservadas");
+        }
+
+        // Las páginas del lote siguen asignadas con una sola referencia
+        for (uint32_t i = 0; i < got; i++) {
+            if (pmm_page_ref(batch[i]) != 2) {
+                host_fail("una pagina asignada cambio al reservar su rango");
+            }
+            pmm_free_page(batch[i]);
+            pmm_free_page(batch[i]);
+            owned[batch[i] / 4096] = 0;
+        }
+    }
+
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("paginas libres distintas tras reservar y liberar rangos");
+    }
+    for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++) {
+        if (pmm_get_free_blocks(order) != blocks_base[order]) {
+            host_fail("los bloques del buddy no se fusionaron tras los rangos");
+        }
+    }
+
+    free(owned);
+    printf("rangos: %ld ops, %lu paginas reservadas y devueltas\n", ops, reserved);
+}
+
+/**
+ * Pool de marcos limpios: toda página de pmm_alloc_zeroed_page está a cero
+ * aunque su usuario anterior la ensuciara, venga del pool o no; los
+ * contadores cuadran y vaciar el pool devuelve todos sus marcos
+ */
+static void stress_zero(uint32_t* rng, long ops) {
+    static phys_addr_t held[STRESS_BATCH];
+    uint32_t held_count = 0;
+    uint32_t free_base = pmm_get_free_pages();
+    uint32_t hits_base = 0;
+    uint32_t misses_base = 0;
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t pooled = 0;
+
+    pmm_get_zero_stats(&hits_base, &misses_base, NULL);
+
+    for (long it = 0; it < ops; it++) {
+        uint32_t op = rng_next(rng) % 8;
+
+        if (op < 3) {
+            pmm_zero_pool_fill();   // El idle rellena una página
+        } else if (op < 6 && held_count < STRESS_BATCH) {
+            phys_addr_t frame = pmm_alloc_zeroed_page();
+            if (frame == 0) {
+                host_fail("pmm_alloc_zeroed_page sin memoria");
+            }
+            const uint32_t* words = (const uint32_t*)(uintptr_t)frame;
+            for (uint32_t i = 0; i < 4096 / sizeof(uint32_t); i++) {
+                if (words[i] != 0) {
+                    host_fail("pagina de pmm_alloc_zeroed_page sin limpiar");
+                }
+            }
+            memset((void*)(uintptr_t)frame, 0xC3, 4096);
+            held[held_count++] = frame;
+        } else if (held_count > 0) {
+            uint32_t index = rng_next(rng) % held_count;
+            pmm_free_page(held[index]);
+            held[index] = held[--held_count];
+        } else if (rng_next(rng) % 16 == 0) {
+            pmm_zero_pool_drain();
+        }
+    }
+
+    while (held_count > 0) {
+        pmm_free_page(held[--held_count]);
+    }
+
+    // pmm_zero_pages limpia bloques enteros (los de VMM_MAP_LARGE)
+    for (uint32_t order = 0; order <= PMM_MAX_ORDER; order += 5) {
+        phys_addr_t block = pmm_alloc_pages(order);
+        if (block == 0) {
+            continue;
+        }
+        uint32_t bytes = 4096U << order;
+        memset((void*)(uintptr_t)block, 0x3C, bytes);
+        if (!pmm_zero_pages(block, 1U << order)) {
+            host_fail("pmm_zero_pages sin slots de kmap");
+        }
+        const uint32_t* words = (const uint32_t*)(uintptr_t)block;
+        for (uint32_t i = 0; i < bytes / sizeof(uint32_t); i++) {
+            if (words[i] != 0) {
+                host_fail("bloque de pmm_zero_pages sin limpiar");
+            }
+        }
+        pmm_free_pages(block, order);
+    }
+
+    pmm_get_zero_stats(&hits, &misses, &pooled);
+    if (pmm_get_free_pages() + pooled != free_base) {
+        host_fail("el pool de marcos limpios perdio marcos");
+    }
+    if (pmm_zero_pool_drain() != pooled) {
+        host_fail("pmm_zero_pool_drain no devolvio el pool entero");
+    }
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("paginas libres distintas tras vaciar el pool");
+    }
+    printf("ceros: %ld ops, %u del pool, %u limpiadas en el momento\n",
+           ops, hits - hits_base, misses - misses_base);
+}
+
+/**
+ * Memoria por encima de 4GB (-H): los descriptores de marco no caben en
+ * el identity map y se leen por su ventana; con PAE el PMM gestiona y
+ * entrega los marcos altos, que se mapean con su dirección de 64 bits;
+ * sin PAE quedan fuera. Al soltarlo todo, el PMM vuelve a como estaba
+ */
+static void stress_high(uint32_t* rng, int pae) {
+    // El espacio de direcciones reserva memoria del heap: crearlo antes de medir
+    vmm_destroy_address_space(vmm_create_address_space());
+
+    uint32_t pages = pmm_get_total_pages();
+    uint32_t free_base = pmm_get_free_pages();
+    uint32_t high_pages = high_mb << 8;
+    phys_addr_t block = 0;
+    uint32_t block_size = pmm_get_pages_block(&block);
+
+    // Sin PAE los descriptores solo cubren hasta 4GB y caben en el identity map
+    if (pae && block_size == 0) {
+        host_fail("los descriptores de marco no se reubicaron fuera del identity map");
+    }
+    if (block_size != 0 && (!host_phys_present(block, block_size) || block < ((phys_addr_t)phys_mb << 20) ||
+                            (uintptr_t)pmm_get_page(0) != KERNEL_FRAMES_START)) {
+        host_fail("los descriptores de marco no se leen por su ventana");
+    }
+    if (pae) {
+        if (pages != (HOST_HIGH_START >> 12) + high_pages || pmm_get_page(HOST_HIGH_START) == NULL) {
+            host_fail("el PMM con PAE no gestiona la memoria por encima de 4GB");
+        }
+    } else if (pages > (HOST_HIGH_START >> 12) || pmm_get_page(HOST_HIGH_START) != NULL) {
+        host_fail("el PMM sin PAE gestiona memoria por encima de 4GB");
+    }
+
+    // Agotar la memoria: todo marco alto se puede escribir y es único
+    phys_addr_t* held = malloc((size_t)free_base * sizeof(phys_addr_t));
+    uint32_t count = 0;
+    uint32_t above = 0;
+    phys_addr_t frame;
+    while ((frame = pmm_alloc_page_zone(ZONE_HIGH)) != 0) {
+        if (!host_phys_present(frame, 4096) || count == free_base) {
+            host_fail("marco alto fuera de la memoria fisica");
+        }
+        if (frame >= HOST_HIGH_START) {
+            *(volatile uint64_t*)(uintptr_t)frame = frame;
+            above++;
+        }
+        held[count++] = frame;
+    }
+    if (count != free_base) {
+        host_fail("no se pudieron asignar todas las paginas libres");
+    }
+    if (above != (pages > (HOST_HIGH_START >> 12) ? high_pages : 0)) {
+        host_fail("marcos por encima de 4GB sin entregar o entregados sin PAE");
+    }
+
+    // Mapear marcos altos en un espacio de usuario
+    uint32_t mapped = 0;
+    if (above > 0) {
+        static phys_addr_t list[STRESS_MAP_PAGES];
+        void* dir = NULL;
+        for (uint32_t i = 0; i < count && mapped < STRESS_MAP_PAGES; i++) {
+            if (held[i] >= HOST_HIGH_START && rng_next(rng) % 4 == 0) {
+                list[mapped++] = held[i];
+                held[i] = held[--count];
+                i--;
+            }
+        }
+        // Las page tables salen de los marcos retenidos
+        for (uint32_t i = 0; i < 8; i++) {
+            pmm_free_page(held[--count]);
+        }
+        dir = vmm_create_address_space();
+        if (dir == NULL ||
+            host_vmm_map_range(dir, USER_SPACE_START, list, 0, mapped, PAGE_WRITE | PAGE_USER | PAGE_NX) != E_OK) {
+            host_fail("no se pudieron mapear marcos por encima de 4GB");
+        }
+        for (uint32_t i = 0; i < mapped; i++) {
+            unsigned long long entry = host_vmm_entry(dir, USER_SPACE_START + i * 4096);
+            if (host_vmm_get_physical(dir, USER_SPACE_START + i * 4096 + 8) != list[i] + 8 ||
+                (entry & PAGE_FRAME) != list[i] || (nx_mode && !(entry & ENTRY_NX)) ||
+                *(volatile uint64_t*)(uintptr_t)list[i] != list[i]) {
+                host_fail("mapeo de un marco por encima de 4GB truncado");
+            }
+        }
+        if (host_vmm_unmap_range(dir, USER_SPACE_START, mapped, 1) != mapped) {
+            host_fail("no se desmapearon los marcos altos");
+        }
+        vmm_destroy_address_space(dir);
+    }
+
+    while (count > 0) {
+        pmm_free_page(held[--count]);
+    }
+    free(held);
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("paginas libres distintas tras usar la memoria alta");
+    }
+    printf("alta: %u marcos por encima de 4GB, %u mapeados, %u KB de descriptores fuera del identity map\n",
+           above, mapped, block_size >> 10);
+}
+
+/**
+ * Regiones y demand paging: las regiones no se solapan y validan sus
+ * límites; el primer acceso a una página de una región la mapea a cero
+ * con los permisos de la región, una sola vez y con un marco propio; los
+ * accesos fuera de las regiones, las escrituras en regiones de solo
+ * lectura y los fallos de protección acaban en panic; destruir la región
+ * o el espacio devuelve todos los marcos
+ */
+static void stress_vmm_regions(uint32_t* rng, long ops) {
+    // El cache de regiones retiene un slab vacío: crearlo antes de medir
+    void* space = vmm_create_address_space();
+    if (space == NULL || vmm_region_create(space, USER_SPACE_START, 4096, PAGE_USER) != E_OK) {
+        host_fail("vmm_region_create sin memoria");
+    }
+    vmm_destroy_address_space(space);
+
+    uint32_t free_base = pmm_get_free_pages();
+    uint32_t minor_base = 0;
+    uint32_t minor = 0;
+    uint32_t resolved = 0;
+    uint32_t rw = USER_SPACE_START;
+    uint32_t rw_end = rw + STRESS_REGION_PAGES * 4096;
+    uint32_t ro = rw_end + 4096;
+
+    vmm_get_fault_stats(&minor_base, NULL, NULL);
+    space = vmm_create_address_space();
+    void* other = vmm_create_address_space();
+    if (space == NULL || other == NULL) {
+        host_fail("vmm_create_address_space sin memoria");
+    }
+
+    // Límites: el tamaño se redondea a páginas; solapes y rangos inválidos
+    if (vmm_region_create(space, rw, STRESS_REGION_PAGES * 4096 - 100, PAGE_WRITE | PAGE_USER | PAGE_NX) != E_OK ||
+        vmm_region_create(space, ro, 16 * 4096, PAGE_USER) != E_OK) {
+        host_fail("vmm_region_create rechazo una region valida");
+    }
+    if (vmm_region_create(space, rw + 4096, 4096, PAGE_USER) != E_EXISTS ||
+        vmm_region_create(space, rw_end - 4096, 2 * 4096, PAGE_USER) != E_EXISTS ||
+        vmm_region_create(space, ro - 4096, 2 * 4096, PAGE_USER) != E_EXISTS) {
+        host_fail("vmm_region_create acepto regiones solapadas");
+    }
+    if (vmm_region_create(space, rw_end, 4096, PAGE_USER) != E_OK ||
+        vmm_region_destroy(space, rw_end) != E_OK) {
+        host_fail("region en el hueco entre dos regiones rechazada");
+    }
+    if (vmm_region_create(space, rw_end + 100, 4096, PAGE_USER) != E_INVAL ||
+        vmm_region_create(space, 0x00100000, 4096, PAGE_USER) != E_INVAL ||
+        vmm_region_create(space, USER_SPACE_END - 4096, 2 * 4096, PAGE_USER) != E_INVAL ||
+        vmm_region_create(space, rw_end, 0, PAGE_USER) != E_INVAL) {
+        host_fail("vmm_region_create acepto una region invalida");
+    }
+    if (vmm_region_create(other, rw, 4096, PAGE_USER) != E_OK || host_vmm_regions(space) != 2 ||
+        host_vmm_regions(other) != 1) {
+        host_fail("las regiones de dos espacios interfieren");
+    }
+
+    // Accesos aleatorios: cada página se resuelve en su primer acceso
+    for (long it = 0; it < ops; it++) {
+        uint32_t page = rng_next(rng) % STRESS_REGION_PAGES;
+        uint32_t addr = rw + page * 4096 + rng_next(rng) % 4096;
+        uint32_t err = PF_USER | ((rng_next(rng) & 1) ? PF_WRITE : 0);
+
+        if (host_vmm_entry(space, addr) & PAGE_PRESENT) {
+            continue;
+        }
+        if (host_vmm_fault(space, addr, err) != 0) {
+            host_fail("page fault en una region no resuelto");
+        }
+        resolved++;
+
+        unsigned long long entry = host_vmm_entry(space, addr);
+        if ((entry & (PAGE_PRESENT | PAGE_WRITE | PAGE_USER)) != (PAGE_PRESENT | PAGE_WRITE | PAGE_USER)) {
+            host_fail("pagina de demand paging sin los permisos de la region");
+        }
+        uint32_t* words = (uint32_t*)(uintptr_t)(entry & PAGE_FRAME);
+        for (uint32_t i = 0; i < 4096 / sizeof(uint32_t); i++) {
+            if (words[i] != 0) {
+                host_fail("pagina de demand paging sin limpiar");
+            }
+        }
+        words[0] = page + 1;
+        if (it % 64 == 0) {
+            host_vmm_check();
+        }
+    }
+
+    // Cada página resuelta conserva su marco y su contenido
+    for (uint32_t page = 0; page < STRESS_REGION_PAGES; page++) {
+        unsigned long long entry = host_vmm_entry(space, rw + page * 4096);
+        if ((entry & PAGE_PRESENT) && *(uint32_t*)(uintptr_t)(entry & PAGE_FRAME) != page + 1) {
+            host_fail("dos paginas de una region comparten marco");
+        }
+    }
+
+    // Fuera de una región, escritura en solo lectura, ejecución en una
+    // región PAGE_NX o fallo de protección
+    if (host_vmm_fault(space, rw_end, PF_USER) != -1 ||
+        host_vmm_fault(space, rw, PF_USER | PF_FETCH) != -1 ||
+        host_vmm_fault(space, USER_SPACE_END - 4096, PF_USER | PF_WRITE) != -1 ||
+        host_vmm_fault(space, ro, PF_USER | PF_WRITE) != -1 ||
+        host_vmm_fault(space, rw, PF_PRESENT | PF_USER) != -1) {
+        host_fail("un page fault invalido no acabo en panic");
+    }
+    if (host_vmm_fault(space, ro + 4096, PF_USER) != 0 ||
+        (host_vmm_entry(space, ro + 4096) & (PAGE_PRESENT | PAGE_WRITE)) != PAGE_PRESENT) {
+        host_fail("lectura en una region de solo lectura mal resuelta");
+    }
+    if (host_vmm_fault(space, ro + 2 * 4096, PF_USER | PF_FETCH) != 0 ||
+        (host_vmm_entry(space, ro + 2 * 4096) & (ENTRY_NX | PAGE_NX)) != 0) {
+        host_fail("ejecucion en una region ejecutable mal resuelta");
+    }
+    vmm_get_fault_stats(&minor, NULL, NULL);
+    if (minor - minor_base != resolved + 2) {
+        host_fail("contador de page faults resueltos incorrecto");
+    }
+    host_vmm_check();
+
+    // Destruir la región suelta sus páginas; después ya no resuelve faults
+    if (vmm_region_destroy(space, rw) != E_OK || vmm_region_destroy(space, rw) != E_NOENT) {
+        host_fail("vmm_region_destroy no elimino la region una sola vez");
+    }
+    for (uint32_t page = 0; page < STRESS_REGION_PAGES; page++) {
+        if (host_vmm_entry(space, rw + page * 4096) & PAGE_PRESENT) {
+            host_fail("pagina mapeada tras destruir su region");
+        }
+    }
+    if (host_vmm_fault(space, rw, PF_USER) != -1) {
+        host_fail("page fault resuelto en una region destruida");
+    }
+    host_vmm_check();
+
+    vmm_destroy_address_space(other);
+    vmm_destroy_address_space(space);
+    host_vmm_check();
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("marcos sin devolver tras destruir los espacios");
+    }
+    printf("regiones: %ld ops, %u paginas resueltas bajo demanda\n", ops, resolved);
+}
+
+/**
+ * Referencias de un marco (pmm_page_ref suma una y devuelve el total)
+ */
+static uint32_t frame_refs(phys_addr_t frame) {
+    uint32_t refs = pmm_page_ref(frame);
+    if (refs == 0) {
+        host_fail("marco libre o reservado mapeado en un espacio de usuario");
+    }
+    pmm_free_page(frame);
+    return refs - 1;
+}
+
+/**
+ * Marca de contenido de una página de la prueba de copy-on-write
+ */
+static uint32_t* cow_page(void* space, uint32_t addr) {
+    unsigned long long entry = host_vmm_entry(space, addr);
+    if (!(entry & PAGE_PRESENT)) {
+        return NULL;
+    }
+    if (entry & PAGE_LARGE) {
+        return (uint32_t*)(uintptr_t)((entry & PAGE_FRAME & ~(unsigned long long)(large_page_size - 1)) +
+                                      (addr & (large_page_size - 1) & PAGE_FRAME));
+    }
+    return (uint32_t*)(uintptr_t)(entry & PAGE_FRAME);
+}
+
+/**
+ * Copy-on-write: clonar comparte cada marco de usuario con una referencia
+ * más y deja las páginas escribibles de solo lectura con PAGE_COW en los
+ * dos espacios (las páginas grandes se dividen); la primera escritura
+ * copia el marco si sigue compartido o solo devuelve la escritura si es
+ * la última referencia; lo que escribe un espacio no lo ve el otro; y
+ * destruir los espacios suelta exactamente sus referencias
+ */
+static void stress_vmm_cow(uint32_t* rng, long ops) {
+    static uint32_t tags[STRESS_COW_SPACES][STRESS_REGION_PAGES];
+    void* spaces[STRESS_COW_SPACES] = { NULL };
+    uint32_t free_base = pmm_get_free_pages();
+    uint32_t breaks_base = 0;
+    uint32_t copies_base = 0;
+    uint32_t breaks = 0;
+    uint32_t copies = 0;
+    uint32_t expect_breaks = 0;
+    uint32_t expect_copies = 0;
+    uint32_t rw = USER_SPACE_START;
+    uint32_t ro = rw + STRESS_REGION_PAGES * 4096 + 4096;
+    uint32_t large = USER_SPACE_START + 2 * large_page_size;
+
+    vmm_get_cow_stats(&breaks_base, &copies_base);
+    memset(tags, 0, sizeof(tags));
+    spaces[0] = vmm_create_address_space();
+    if (spaces[0] == NULL ||
+        vmm_region_create(spaces[0], rw, STRESS_REGION_PAGES * 4096, PAGE_WRITE | PAGE_USER) != E_OK ||
+        vmm_region_create(spaces[0], ro, 4096, PAGE_USER) != E_OK ||
+        vmm_map_user(spaces[0], &large, large_page_size, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_LARGE) != E_OK) {
+        host_fail("no se pudo preparar el espacio de la prueba de copy-on-write");
+    }
+
+    // La mitad de las páginas tocadas antes de clonar, y una de solo lectura
+    for (uint32_t page = 0; page < STRESS_REGION_PAGES; page += 1 + rng_next(rng) % 3) {
+        if (host_vmm_fault(spaces[0], rw + page * 4096, PF_USER | PF_WRITE) != 0) {
+            host_fail("page fault en una region no resuelto");
+        }
+        tags[0][page] = rng_next(rng) | 1;
+        *cow_page(spaces[0], rw + page * 4096) = tags[0][page];
+    }
+    if (host_vmm_fault(spaces[0], ro, PF_USER) != 0) {
+        host_fail("page fault de lectura no resuelto");
+    }
+    *cow_page(spaces[0], large + 4096) = 0xC0FFEE;
+
+    for (long it = 0; it < ops; it++) {
+        uint32_t index = rng_next(rng) % STRESS_COW_SPACES;
+        void* space = spaces[index];
+        uint32_t op = rng_next(rng) % 16;
+
+        // Clonar un espacio vivo en un hueco, o destruir uno
+        if (op == 0) {
+            uint32_t from = rng_next(rng) % STRESS_COW_SPACES;
+            if (space != NULL || spaces[from] == NULL) {
+                continue;
+            }
+            void* clone = vmm_clone_address_space(spaces[from]);
+            if (clone == NULL) {
+                host_fail("vmm_clone_address_space sin memoria");
+            }
+            spaces[index] = clone;
+            memcpy(tags[index], tags[from], sizeof(tags[index]));
+
+            // Marcos compartidos y escritura retirada en los dos espacios
+            for (uint32_t page = 0; page < STRESS_REGION_PAGES; page++) {
+                unsigned long long a = host_vmm_entry(spaces[from], rw + page * 4096);
+                unsigned long long b = host_vmm_entry(clone, rw + page * 4096);
+                if (a != b) {
+                    host_fail("el clon no comparte las paginas del original");
+                }
+                if ((a & PAGE_PRESENT) && ((a & PAGE_WRITE) || !(a & PAGE_COW) || frame_refs(a & PAGE_FRAME) < 2)) {
+                    host_fail("pagina clonada escribible, sin PAGE_COW o sin referencia extra");
+                }
+            }
+            if ((host_vmm_entry(clone, ro) & (PAGE_WRITE | PAGE_COW)) != 0 ||
+                (host_vmm_entry(clone, large) & PAGE_LARGE) || !(host_vmm_entry(clone, large) & PAGE_COW) ||
+                *cow_page(clone, large + 4096) != 0xC0FFEE) {
+                host_fail("pagina de solo lectura o grande mal clonada");
+            }
+            host_vmm_check();
+            continue;
+        }
+        if (space == NULL) {
+            continue;
+        }
+        if (op == 1) {
+            uint32_t alive = 0;
+            for (uint32_t i = 0; i < STRESS_COW_SPACES; i++) {
+                alive += spaces[i] != NULL;
+            }
+            if (alive > 1) {
+                vmm_destroy_address_space(space);
+                spaces[index] = NULL;
+                host_vmm_check();
+            }
+            continue;
+        }
+
+        // Escritura en una página: bajo demanda, copy-on-write o directa
+        uint32_t page = rng_next(rng) % STRESS_REGION_PAGES;
+        uint32_t addr = rw + page * 4096;
+        unsigned long long entry = host_vmm_entry(space, addr);
+
+        if (!(entry & PAGE_PRESENT)) {
+            if (host_vmm_fault(space, addr, PF_USER | PF_WRITE) != 0) {
+                host_fail("page fault en una region no resuelto");
+            }
+        } else if (entry & PAGE_COW) {
+            if (host_vmm_fault(space, addr, PF_PRESENT | PF_USER) != -1) {
+                host_fail("lectura de una pagina presente resuelta como fault");
+            }
+            uint32_t refs = frame_refs(entry & PAGE_FRAME);
+            if (host_vmm_fault(space, addr, PF_PRESENT | PF_USER | PF_WRITE) != 0) {
+                host_fail("escritura copy-on-write no resuelta");
+            }
+            unsigned long long now = host_vmm_entry(space, addr);
+            if (!(now & PAGE_WRITE) || (now & PAGE_COW) ||
+                ((now & PAGE_FRAME) == (entry & PAGE_FRAME)) != (refs == 1)) {
+                host_fail("copy-on-write copio la ultima referencia o compartio una copia");
+            }
+            if (refs > 1 && frame_refs(entry & PAGE_FRAME) != refs - 1) {
+                host_fail("copy-on-write no solto la referencia al marco compartido");
+            }
+            expect_breaks++;
+            expect_copies += refs > 1;
+        } else if (!(entry & PAGE_WRITE)) {
+            host_fail("pagina de una region escribible sin escritura ni PAGE_COW");
+        }
+
+        uint32_t* data = cow_page(space, addr);
+        if (*data != tags[index][page]) {
+            host_fail("contenido de una pagina copy-on-write distinto del original");
+        }
+        tags[index][page] = rng_next(rng) | 1;
+        *data = tags[index][page];
+
+        if (it % 256 == 0) {
+            host_vmm_check();
+        }
+    }
+
+    // Ningún espacio ve lo que escribieron los demás
+    for (uint32_t index = 0; index < STRESS_COW_SPACES; index++) {
+        for (uint32_t page = 0; spaces[index] != NULL && page < STRESS_REGION_PAGES; page++) {
+            uint32_t* data = cow_page(spaces[index], rw + page * 4096);
+            if ((data != NULL ? *data : 0) != tags[index][page]) {
+                host_fail("una escritura se vio en otro espacio de direcciones");
+            }
+        }
+    }
+    vmm_get_cow_stats(&breaks, &copies);
+    if (breaks - breaks_base != expect_breaks || copies - copies_base != expect_copies) {
+        host_fail("estadisticas de copy-on-write incorrectas");
+    }
+
+    for (uint32_t index = 0; index < STRESS_COW_SPACES; index++) {
+        vmm_destroy_address_space(spaces[index]);
+    }
+    host_vmm_check();
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("marcos sin devolver tras destruir los clones");
+    }
+    printf("copy-on-write: %ld ops, %u escrituras resueltas, %u copias\n", ops, expect_breaks, expect_copies);
+}
+
+/**
+ * Comprueba las invalidaciones del TLB de una operación sobre count
+ * páginas: ninguna fuera del espacio activo; hasta VMM_INVLPG_MAX, un
+ * invlpg por página; por encima, una recarga de CR3 (usuario) o un
+ * vaciado global (kernel, con PGE)
+ */
+static void check_flush(const host_vmm_tlb_t* before, uint32_t count, int kernel, int current) {
+    host_vmm_tlb_t after;
+    host_vmm_tlb(&after);
+
+    unsigned long invlpg = 0, reloads = 0, global = 0;
+    if (kernel || current) {
+        if (count <= VMM_INVLPG_MAX) {
+            invlpg = count;
+        } else if (kernel) {
+            global = 1;
+        } else {
+            reloads = 1;
+        }
+    }
+    if (after.invlpg - before->invlpg != invlpg || after.reloads - before->reloads != reloads ||
+        after.global - before->global != global) {
+        host_fail("invalidaciones del TLB distintas de las esperadas");
+    }
+}
+
+/**
+ * vmm_map_range y vmm_unmap_range: cada rango (con lista de marcos o
+ * contiguo, cruzando page tables) se traduce página a página a sus
+ * marcos, las páginas del kernel son globales, y el TLB se invalida una
+ * vez por llamada: invlpg por página hasta VMM_INVLPG_MAX, después un
+ * vaciado entero, y nada si el espacio no es el activo. Desmapear cuenta
+ * solo las páginas mapeadas, suelta sus marcos y no invalida nada si no
+ * había ninguna. Una página grande se quita entera o se divide antes
+ */
+static void stress_vmm_range(uint32_t* rng, long ops) {
+    static phys_addr_t frames[STRESS_MAP_PAGES];
+    uint32_t window = USER_SPACE_START + 16 * large_page_size;
+    uint32_t margin = 8;
+    unsigned long flushes = 0;
+    host_vmm_tlb_t tlb;
+
+    // Las page tables del kernel no se liberan nunca: crearlas antes de medir
+    if (host_vmm_map_range(host_vmm_get_kernel_directory(), STRESS_MAP_KERNEL, NULL, 0x00100000,
+                           STRESS_MAP_WINDOW / 4096, PAGE_WRITE) != E_OK ||
+        host_vmm_unmap_range(host_vmm_get_kernel_directory(), STRESS_MAP_KERNEL, STRESS_MAP_WINDOW / 4096, 0) !=
+            STRESS_MAP_WINDOW / 4096) {
+        host_fail("no se pudo mapear el rango de prueba del kernel");
+    }
+
+    uint32_t free_base = pmm_get_free_pages();
+    void* active = vmm_create_address_space();
+    void* other = vmm_create_address_space();
+    if (active == NULL || other == NULL ||
+        vmm_region_create(active, window, STRESS_MAP_WINDOW, PAGE_WRITE | PAGE_USER) != E_OK ||
+        vmm_region_create(other, window, STRESS_MAP_WINDOW, PAGE_WRITE | PAGE_USER) != E_OK) {
+        host_fail("no se pudo preparar la prueba de vmm_map_range");
+    }
+    vmm_switch_directory(active);
+
+    for (long it = 0; it < ops; it++) {
+        uint32_t target = rng_next(rng) % 3;
+        void* dir = target == 0 ? active : target == 1 ? other : host_vmm_get_kernel_directory();
+        uint32_t base = target == 2 ? STRESS_MAP_KERNEL : window;
+        uint32_t count = rng_range(rng, 1, STRESS_MAP_PAGES);
+        uint32_t first = rng_range(rng, margin, STRESS_MAP_WINDOW / 4096 - count - margin);
+        uint32_t virt = base + first * 4096;
+        uint32_t flags = target == 2 ? PAGE_WRITE | ((rng_next(rng) & 1) ? PAGE_NX : 0) : PAGE_WRITE | PAGE_USER;
+        phys_addr_t phys = 0;
+        uint32_t order = 0;
+        const phys_addr_t* list = frames;
+
+        // Marcos sueltos de un lote, o un bloque contiguo
+        if (rng_next(rng) & 1) {
+            if (pmm_alloc_batch(count, frames, ZONE_HIGH) != count) {
+                host_fail("pmm_alloc_batch sin memoria");
+            }
+        } else {
+            while ((1U << order) < count) {
+                order++;
+            }
+            phys = pmm_alloc_pages(order);
+            if (phys == 0) {
+                host_fail("pmm_alloc_pages sin memoria");
+            }
+            for (uint32_t i = count; i < (1U << order); i++) {
+                pmm_free_page(phys + i * 4096);   // Solo se mapean count
+            }
+            list = NULL;
+        }
+
+        host_vmm_tlb(&tlb);
+        if (host_vmm_map_range(dir, virt, list, phys, count, flags) != E_OK) {
+            host_fail("vmm_map_range sin memoria");
+        }
+        check_flush(&tlb, count, target == 2, target == 0);
+        for (uint32_t i = 0; i < count; i++) {
+            phys_addr_t frame = list != NULL ? list[i] : phys + i * 4096;
+            unsigned long long entry = host_vmm_entry(dir, virt + i * 4096);
+            if (host_vmm_get_physical(dir, virt + i * 4096 + 123) != frame + 123 ||
+                (entry & (PAGE_WRITE | PAGE_USER | PAGE_NX)) != flags || !(entry & PAGE_GLOBAL) != (target != 2) ||
+                !(entry & ENTRY_NX) != !(nx_mode && (flags & PAGE_NX))) {
+                host_fail("vmm_map_range mapeo otra pagina o con otros flags");
+            }
+        }
+        if (target != 2 && it % 32 == 0) {
+            host_vmm_check();
+        }
+
+        // Desmapear con márgenes sin mapear a los lados; una segunda vez
+        // no quita nada ni invalida
+        uint32_t before = rng_next(rng) % margin;
+        uint32_t after = rng_next(rng) % margin;
+        uint32_t total = before + count + after;
+        host_vmm_tlb(&tlb);
+        if (host_vmm_unmap_range(dir, virt - before * 4096, total, 1) != count) {
+            host_fail("vmm_unmap_range no conto las paginas mapeadas");
+        }
+        check_flush(&tlb, total, target == 2, target == 0);
+        host_vmm_tlb(&tlb);
+        if (host_vmm_unmap_range(dir, virt, count, 1) != 0) {
+            host_fail("vmm_unmap_range desmapeo un rango vacio");
+        }
+        check_flush(&tlb, 0, 0, 0);
+        flushes += count > VMM_INVLPG_MAX && target != 1;
+    }
+
+    // Páginas grandes: una entera se quita sin dividirla, con un solo
+    // vaciado; un trozo de otra la divide
+    for (int whole = 1; whole >= 0; whole--) {
+        uint32_t large = window + (4 + 2 * whole) * large_page_size;
+        uint32_t count = whole ? large_page_size / 4096 : VMM_INVLPG_MAX;
+        uint32_t virt = large + (whole ? 0 : 4096);
+        if (vmm_map_user(active, &large, large_page_size, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_LARGE) != E_OK ||
+            !(host_vmm_entry(active, large) & PAGE_LARGE)) {
+            host_fail("no se pudo mapear la pagina grande de prueba");
+        }
+        host_vmm_tlb(&tlb);
+        if (host_vmm_unmap_range(active, virt, count, 1) != count) {
+            host_fail("vmm_unmap_range no conto las paginas de la pagina grande");
+        }
+        if (whole) {
+            check_flush(&tlb, count, 0, 1);
+        } else {
+            // Dividirla ya vacía el TLB entero; después, un invlpg por página
+            host_vmm_tlb_t after;
+            host_vmm_tlb(&after);
+            if (after.invlpg - tlb.invlpg != count || after.reloads - tlb.reloads + after.global - tlb.global != 1) {
+                host_fail("invalidaciones del TLB distintas de las esperadas al dividir");
+            }
+        }
+        if (!whole != !!(host_vmm_entry(active, virt + count * 4096) & PAGE_PRESENT) ||
+            (host_vmm_entry(active, virt) & PAGE_PRESENT)) {
+            host_fail("vmm_unmap_range dejo mal la pagina grande");
+        }
+        host_vmm_check();
+    }
+
+    vmm_destroy_address_space(other);
+    vmm_destroy_address_space(active);
+    host_vmm_check();
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("marcos sin devolver tras desmapear los rangos");
+    }
+    printf("mapeo de rangos: %ld ops, %lu vaciados enteros del TLB\n", ops, flushes);
+}
+
+/**
+ * Se queda con todos los marcos libres menos keep. Con scattered, los
+ * que quedan libres no son contiguos (no hay bloques de orden 1 o más)
+ *
+ * @return Marcos retenidos, para hold_release
+ */
+static uint32_t hold_frames(phys_addr_t* held, uint32_t keep, int scattered) {
+    uint32_t count = 0;
+    phys_addr_t frame;
+    while ((frame = pmm_alloc_page_zone(ZONE_HIGH)) != 0) {
+        held[count++] = frame;
+    }
+    for (uint32_t i = count; i > 0 && keep > 0; i--) {
+        if (!scattered || (held[i - 1] / 4096) % 2 == 0) {
+            pmm_free_page(held[i - 1]);
+            held[i - 1] = 0;
+            keep--;
+        }
+    }
+    if (keep > 0) {
+        host_fail("no hay marcos para la prueba de vmm_map_user");
+    }
+    return count;
+}
+
+static void hold_release(phys_addr_t* held, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (held[i] != 0) {
+            pmm_free_page(held[i]);
+        }
+    }
+}
+
+/**
+ * Hay un bloque libre del tamaño de una página grande (o mayor)
+ */
+static int large_block_free(void) {
+    for (uint32_t order = __builtin_ctz(large_page_size / 4096); order <= PMM_MAX_ORDER; order++) {
+        if (pmm_get_free_blocks(order) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Todas las páginas de [addr, addr + pages) mapeadas a cero con permisos
+ * de usuario y el NX pedido (bit 63 si la CPU lo admite); large indica si
+ * deben ser páginas grandes
+ */
+static void check_populated(void* space, uint32_t addr, uint32_t pages, uint32_t flags, int large) {
+    for (uint32_t page = 0; page < pages; page++) {
+        unsigned long long entry = host_vmm_entry(space, addr + page * 4096);
+        uint32_t* words = cow_page(space, addr + page * 4096);
+        if (words == NULL || (entry & (PAGE_WRITE | PAGE_USER | PAGE_NX)) != (flags | PAGE_USER) ||
+            !(entry & ENTRY_NX) != !(nx_mode && (flags & PAGE_NX)) || !(entry & PAGE_LARGE) != !large) {
+            host_fail("pagina de vmm_map_user sin mapear o con otros flags");
+        }
+        for (uint32_t i = 0; i < 4096 / sizeof(uint32_t); i++) {
+            if (words[i] != 0) {
+                host_fail("pagina de vmm_map_user sin limpiar");
+            }
+        }
+    }
+}
+
+/**
+ * vmm_map_user y vmm_unmap_user: validación de argumentos; las guardas
+ * separan las regiones (dos guardas entre dos regiones con guarda) y no
+ * se mapean nunca; sin MAP_FIXED se busca un hueco; MAP_POPULATE mapea
+ * todo a cero sin page faults; si falta memoria no queda ni la región ni
+ * sus marcos; MAP_LARGE usa páginas grandes con PSE y un bloque contiguo,
+ * y si no, páginas de 4KB; vmm_unmap_user solo deshace regiones enteras.
+ * Después, operaciones aleatorias contra un modelo de las regiones
+ */
+static void stress_vmm_user(uint32_t* rng, long ops) {
+    static phys_addr_t held[(HOST_PHYS_MAX_MB + HOST_MID_MB + HOST_HIGH_MAX_MB) << 8];
+    uint32_t base = USER_SPACE_START + 4 * large_page_size;
+    uint32_t slot = USER_SPACE_START + 8 * large_page_size;
+    uint32_t addr;
+
+    pmm_zero_pool_drain();
+    uint32_t free_base = pmm_get_free_pages();
+    void* space = vmm_create_address_space();
+    if (space == NULL) {
+        host_fail("vmm_create_address_space sin memoria");
+    }
+
+    // Argumentos
+    addr = base + 100;
+    if (vmm_map_user(space, &addr, 0, PAGE_WRITE, 0) != E_INVAL ||
+        vmm_map_user(space, &addr, 4096, PAGE_WRITE, 0x100) != E_INVAL ||
+        vmm_map_user(space, &addr, 4096, PAGE_WRITE, VMM_MAP_FIXED) != E_INVAL ||
+        vmm_map_user(NULL, &addr, 4096, PAGE_WRITE, 0) != E_INVAL ||
+        vmm_map_user(space, NULL, 4096, PAGE_WRITE, 0) != E_INVAL) {
+        host_fail("vmm_map_user acepto argumentos invalidos");
+    }
+    addr = USER_SPACE_START;
+    if (vmm_map_user(space, &addr, 4096, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_GUARD) != E_INVAL) {
+        host_fail("vmm_map_user acepto una guarda fuera del espacio de usuario");
+    }
+    addr = USER_SPACE_END - 4096;
+    if (vmm_map_user(space, &addr, 2 * 4096, PAGE_WRITE, VMM_MAP_FIXED) != E_INVAL ||
+        vmm_map_user(space, &addr, 4096, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_GUARD) != E_INVAL) {
+        host_fail("vmm_map_user acepto una region tras el espacio de usuario");
+    }
+    if (host_vmm_regions(space) != 0) {
+        host_fail("vmm_map_user dejo una region tras fallar");
+    }
+
+    // Guardas: entre dos regiones con guarda quedan dos páginas libres
+    uint32_t first = base;
+    uint32_t end = first + 4 * 4096;
+    uint32_t second = end + 4096;
+    if (vmm_map_user(space, &first, 4 * 4096, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_GUARD) != E_OK ||
+        vmm_map_user(space, &second, 4096, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_GUARD) != E_EXISTS) {
+        host_fail("region con guarda a una pagina de otra con guarda aceptada");
+    }
+    addr = end;
+    if (vmm_map_user(space, &addr, 4096, PAGE_WRITE, VMM_MAP_FIXED) != E_EXISTS ||
+        vmm_map_user(space, &second, 4096, PAGE_WRITE, VMM_MAP_FIXED) != E_OK ||
+        vmm_unmap_user(space, second, 4096) != E_OK) {
+        host_fail("la guarda de una region no cuenta para los solapes");
+    }
+    second = end + 2 * 4096;
+    if (vmm_map_user(space, &second, 4096, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_GUARD) != E_OK) {
+        host_fail("region con guarda a dos paginas de otra con guarda rechazada");
+    }
+
+    // Sin MAP_FIXED: hueco desde la pista, sin tocar las guardas vecinas
+    addr = first;
+    if (vmm_map_user(space, &addr, 3 * 4096, PAGE_WRITE, VMM_MAP_GUARD) != E_OK ||
+        addr < second + 3 * 4096 || host_vmm_regions(space) != 3) {
+        host_fail("vmm_map_user eligio un hueco solapado con una guarda");
+    }
+    host_vmm_check();
+    if (host_vmm_fault(space, addr - 4096, PF_USER | PF_WRITE) != -1 ||
+        host_vmm_fault(space, addr + 3 * 4096, PF_USER) != -1 ||
+        host_vmm_fault(space, addr, PF_USER | PF_WRITE) != 0) {
+        host_fail("guarda de una region mapeada o region sin demand paging");
+    }
+
+    // vmm_unmap_user solo deshace regiones enteras desde su inicio
+    if (vmm_unmap_user(space, addr, 2 * 4096) != E_INVAL || vmm_unmap_user(space, addr, 0) != E_INVAL ||
+        vmm_unmap_user(space, addr + 100, 3 * 4096) != E_INVAL ||
+        vmm_unmap_user(space, addr + 4096, 2 * 4096) != E_NOENT ||
+        vmm_unmap_user(space, addr - 4096, 4 * 4096) != E_NOENT || host_vmm_regions(space) != 3) {
+        host_fail("vmm_unmap_user acepto un rango que no es una region");
+    }
+    if (vmm_unmap_user(space, addr, 3 * 4096 - 100) != E_OK || vmm_unmap_user(space, addr, 3 * 4096) != E_NOENT ||
+        vmm_unmap_user(space, first, 4 * 4096) != E_OK || vmm_unmap_user(space, second, 4096) != E_OK ||
+        host_vmm_regions(space) != 0) {
+        host_fail("vmm_unmap_user no deshizo la region una sola vez");
+    }
+
+    // MAP_POPULATE: todo mapeado a cero, con los permisos pedidos
+    uint32_t minor_base = 0;
+    uint32_t minor = 0;
+    vmm_get_fault_stats(&minor_base, NULL, NULL);
+    addr = slot;
+    if (vmm_map_user(space, &addr, 64 * 4096, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_POPULATE) != E_OK) {
+        host_fail("vmm_map_user con MAP_POPULATE sin memoria");
+    }
+    check_populated(space, slot, 64, PAGE_WRITE, 0);
+    addr = slot + 128 * 4096;
+    if (vmm_map_user(space, &addr, 8 * 4096, 0, VMM_MAP_FIXED | VMM_MAP_POPULATE) != E_OK) {
+        host_fail("vmm_map_user con MAP_POPULATE sin memoria");
+    }
+    check_populated(space, addr, 8, 0, 0);
+    vmm_get_fault_stats(&minor, NULL, NULL);
+    if (minor != minor_base) {
+        host_fail("MAP_POPULATE dejo paginas para el handler de page faults");
+    }
+    host_vmm_check();
+    if (vmm_unmap_user(space, slot, 64 * 4096) != E_OK || vmm_unmap_user(space, addr, 8 * 4096) != E_OK) {
+        host_fail("vmm_unmap_user rechazo una region poblada");
+    }
+
+    // MAP_LARGE: página grande si PSE (o PAE) y hay un bloque de su
+    // tamaño; el tamaño que no es múltiplo y la pista sin alinear usan 4KB
+    // o se alinean
+    addr = slot;
+    int large = large_block_free();
+    if (vmm_map_user(space, &addr, large_page_size, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_LARGE) != E_OK) {
+        host_fail("vmm_map_user con MAP_LARGE sin memoria");
+    }
+    check_populated(space, slot, large_page_size / 4096, PAGE_WRITE, large);
+    host_vmm_check();
+    if (vmm_unmap_user(space, slot, large_page_size) != E_OK) {
+        host_fail("vmm_unmap_user rechazo una region de paginas grandes");
+    }
+    addr = slot + 4096;
+    large = large_block_free();
+    if (vmm_map_user(space, &addr, large_page_size, PAGE_WRITE, VMM_MAP_LARGE) != E_OK ||
+        (large && (addr & (large_page_size - 1)) != 0)) {
+        host_fail("vmm_map_user con MAP_LARGE no alineo la region");
+    }
+    check_populated(space, addr, large_page_size / 4096, PAGE_WRITE, large && (addr & (large_page_size - 1)) == 0);
+    if (vmm_unmap_user(space, addr, large_page_size) != E_OK) {
+        host_fail("vmm_unmap_user rechazo una region de paginas grandes");
+    }
+    addr = slot;
+    if (vmm_map_user(space, &addr, large_page_size + 4096, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_LARGE) != E_OK ||
+        (host_vmm_entry(space, slot) & PAGE_PRESENT) || vmm_unmap_user(space, slot, large_page_size + 4096) != E_OK) {
+        host_fail("MAP_LARGE de un tamano que no es multiplo de pagina grande no quedo bajo demanda");
+    }
+
+    // Sin PSE: páginas de 4KB
+    host_vmm_set_large(0);
+    addr = slot;
+    if (vmm_map_user(space, &addr, large_page_size, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_LARGE) != E_OK) {
+        host_fail("vmm_map_user con MAP_LARGE sin PSE sin memoria");
+    }
+    host_vmm_set_large(1);
+    check_populated(space, slot, large_page_size / 4096, PAGE_WRITE, 0);
+    host_vmm_check();
+    if (vmm_unmap_user(space, slot, large_page_size) != E_OK) {
+        host_fail("vmm_unmap_user rechazo una region de paginas de 4KB");
+    }
+
+    // Con PSE pero sin bloques grandes: páginas de 4KB sueltas (hace falta
+    // el doble de marcos libres para dejarlos alternos)
+    uint32_t held_count = 0;
+    if (pmm_get_free_pages() >= 2 * (large_page_size / 4096 + 64)) {
+        held_count = hold_frames(held, large_page_size / 4096 + 64, 1);
+        if (pmm_get_free_blocks(PMM_MAX_ORDER) != 0 || pmm_get_free_blocks(1) != 0) {
+            host_fail("memoria libre contigua tras fragmentarla");
+        }
+        addr = slot;
+        if (vmm_map_user(space, &addr, large_page_size, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_LARGE) != E_OK) {
+            host_fail("MAP_LARGE sin bloques grandes no cayo a paginas de 4KB");
+        }
+        check_populated(space, slot, large_page_size / 4096, PAGE_WRITE, 0);
+        host_vmm_check();
+        if (vmm_unmap_user(space, slot, large_page_size) != E_OK) {
+            host_fail("vmm_unmap_user rechazo una region de paginas de 4KB");
+        }
+        hold_release(held, held_count);
+    }
+
+    // Sin memoria: ni la región ni sus marcos se quedan (la page table
+    // del tramo ya existe)
+    held_count = hold_frames(held, large_page_size / 4096 / 2, 0);
+    uint32_t free_before = pmm_get_free_pages();
+    addr = slot;
+    if (vmm_map_user(space, &addr, large_page_size, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_POPULATE) != E_NOMEM ||
+        vmm_map_user(space, &addr, large_page_size, PAGE_WRITE, VMM_MAP_FIXED | VMM_MAP_LARGE) != E_NOMEM) {
+        host_fail("vmm_map_user sin memoria no devolvio E_NOMEM");
+    }
+    if (host_vmm_regions(space) != 0 || pmm_get_free_pages() != free_before || addr != slot ||
+        (host_vmm_entry(space, slot) & PAGE_PRESENT)) {
+        host_fail("vmm_map_user sin memoria dejo la region o sus marcos");
+    }
+    hold_release(held, held_count);
+    host_vmm_check();
+
+    // Operaciones aleatorias contra un modelo de las regiones
+    uint32_t starts[STRESS_USER_REGIONS];
+    uint32_t sizes[STRESS_USER_REGIONS];
+    uint32_t guards[STRESS_USER_REGIONS];
+    uint32_t live = 0;
+    uint32_t rejected = 0;
+    for (long it = 0; it < ops; it++) {
+        if (live > 0 && (live == STRESS_USER_REGIONS || rng_next(rng) % 3 == 0)) {
+            uint32_t victim = rng_next(rng) % live;
+            if (vmm_unmap_user(space, starts[victim], sizes[victim]) != E_OK) {
+                host_fail("vmm_unmap_user rechazo una region del modelo");
+            }
+            live--;
+            starts[victim] = starts[live];
+            sizes[victim] = sizes[live];
+            guards[victim] = guards[live];
+            continue;
+        }
+
+        uint32_t size = rng_range(rng, 1, STRESS_USER_PAGES) * 4096 - rng_next(rng) % 4096;
+        uint32_t pages = (size + 4095) / 4096;
+        uint32_t options = rng_next(rng) & (VMM_MAP_FIXED | VMM_MAP_POPULATE | VMM_MAP_GUARD);
+        uint32_t guard = (options & VMM_MAP_GUARD) ? 4096 : 0;
+        uint32_t flags = ((rng_next(rng) & 1) ? PAGE_WRITE : 0) | ((rng_next(rng) & 1) ? PAGE_NX : 0);
+        addr = base + rng_next(rng) % 1024 * 4096;
+
+        int expected = E_OK;
+        for (uint32_t i = 0; i < live && (options & VMM_MAP_FIXED); i++) {
+            if (starts[i] - guards[i] < addr + pages * 4096 + guard &&
+                starts[i] + sizes[i] + guards[i] > addr - guard) {
+                expected = E_EXISTS;
+            }
+        }
+        uint32_t regions = host_vmm_regions(space);
+        int result = vmm_map_user(space, &addr, size, flags, options);
+        if (result != expected) {
+            host_fail("vmm_map_user no coincide con el modelo de regiones");
+        }
+        if (result != E_OK) {
+            rejected++;
+            if (host_vmm_regions(space) != regions) {
+                host_fail("vmm_map_user rechazado dejo una region");
+            }
+            continue;
+        }
+        if (options & VMM_MAP_POPULATE) {
+            check_populated(space, addr, pages, flags, 0);
+        } else if (host_vmm_entry(space, addr) & PAGE_PRESENT) {
+            host_fail("region sin MAP_POPULATE con paginas mapeadas");
+        }
+        starts[live] = addr;
+        sizes[live] = pages * 4096;
+        guards[live] = guard;
+        live++;
+        if (it % 16 == 0) {
+            host_vmm_check();
+        }
+    }
+    host_vmm_check();
+
+    vmm_destroy_address_space(space);
+    host_vmm_check();
+    host_pmm_check();
+    if (pmm_get_free_pages() != free_base) {
+        host_fail("marcos sin devolver tras vmm_unmap_user");
+    }
+    printf("vmm_map_user: %ld ops, %u rechazadas por solape\n", ops, rejected);
+}
+
+/*
+ * Línea de comandos
+ */
+
+static void usage(void) {
+    fprintf(stderr,
+            "uso: memhost stress [-s semilla] [-n ops] [-P] [-H MB]\n"
+            "     memhost bench [-s semilla]\n"
+            "     memhost replay traza...\n"
+            "     memhost gen boot|churn|ipc|frag [-s semilla]\n"
+            "opciones: -m MB de memoria fisica (max %d), -v salida VGA,\n"
+            "          -P paginacion PAE con NX (stress),\n"
+            "          -H MB de memoria por encima de 4GB (stress, max %d)\n", HOST_PHYS_MAX_MB, HOST_HIGH_MAX_MB);
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+    }
+
+    const char* command = argv[1];
+    long ops = 200000;
+    int opt;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    optind = 2;
+    while ((opt = getopt(argc, argv, "s:n:m:vPH:")) != -1) {
+        switch (opt) {
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'n': ops = strtol(optarg, NULL, 0); break;
+            case 'm': phys_mb = (unsigned int)strtoul(optarg, NULL, 0); break;
+            case 'v': host_vga_echo(1); break;
+            case 'P': cpu_features |= HOST_CPU_PAE | HOST_CPU_NX; break;
+            case 'H': high_mb = (unsigned int)strtoul(optarg, NULL, 0); break;
+            default: usage();
+        }
+    }
+    if (phys_mb < 8 || phys_mb > HOST_PHYS_MAX_MB || high_mb > HOST_HIGH_MAX_MB) {
+        usage();
+    }
+
+    if (strcmp(command, "stress") == 0) {
+        uint32_t rng = seed != 0 ? seed : 1;
+        int pae = host_vmm_select(cpu_features);
+        kernel_setup();
+        if (host_vmm_init() != 0) {
+            host_fail("no se pudo inicializar el VMM");
+        }
+        large_page_size = host_vmm_large_size();
+        nx_mode = host_vmm_nx();
+        stress_heap(&rng, ops);
+        stress_physical(&rng, ops / 16);
+        stress_pmm(&rng, ops);
+        stress_range(&rng, ops / 16);
+        stress_zero(&rng, ops / 4);
+        if (high_mb != 0) {
+            stress_high(&rng, pae);
+        }
+        stress_vmm_regions(&rng, ops / 64);
+        stress_vmm_cow(&rng, ops / 16);
+        stress_vmm_range(&rng, ops / 64);
+        stress_vmm_user(&rng, ops / 64);
+        if (host_vga_errors() != 0) {
+            host_fail("el kernel informo de errores");
+        }
+        printf("ok (semilla %u%s%s)\n", seed, pae ? ", PAE" : "", high_mb != 0 ? ", memoria alta" : "");
+        return 0;
+    }
+
+    if (strcmp(command, "bench") == 0) {
+        int failed = 0;
+        print_header();
+        for (size_t i = 0; i < WORKLOAD_COUNT; i++) {
+            failed |= run_isolated(NULL, &workloads[i], NULL);
+        }
+        return failed ? 1 : 0;
+    }
+
+    if (strcmp(command, "replay") == 0) {
+        int failed = 0;
+        if (optind >= argc) {
+            usage();
+        }
+        print_header();
+        for (int i = optind; i < argc; i++) {
+            failed |= run_isolated(NULL, NULL, argv[i]);
+        }
+        return failed ? 1 : 0;
+    }
+
+    if (strcmp(command, "gen") == 0) {
+        if (optind >= argc) {
+            usage();
+        }
+        for (size_t i = 0; i < WORKLOAD_COUNT; i++) {
+            if (strcmp(argv[optind], workloads[i].name) == 0) {
+                trace_t trace;
+                workload_generate(&workloads[i], &trace);
+                trace_print(&trace, stdout);
+                return 0;
+            }
+        }
+        usage();
+    }
+
+    usage();
+    return 2;
+}
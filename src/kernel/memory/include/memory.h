@@ -4,6 +4,7 @@
  * 
  * El Memory Manager de NeoOS gestiona la memoria del sistema mediante:
  * - PMM (Physical Memory Manager): Gestión de páginas físicas usando bitmap
+ *   y buddy allocator para bloques contiguos
  * - VMM (Virtual Memory Manager): Paginación y memoria virtual
  * - Heap: Asignación dinámica de memoria (kmalloc/kfree)
  */
@@ -22,17 +23,39 @@
 #define PAGE_ALIGN_MASK 0xFFFFF000
 #define PAGE_OFFSET_MASK 0x00000FFF
 
+// Dirección física: 64 bits para poder nombrar marcos por encima de 4GB
+typedef uint64_t phys_addr_t;
+
 // Flags para páginas
 #define PAGE_PRESENT    (1 << 0)  // Página presente en memoria
 #define PAGE_WRITE      (1 << 1)  // Página escribible
 #define PAGE_USER       (1 << 2)  // Página accesible desde modo usuario
 #define PAGE_ACCESSED   (1 << 5)  // Página accedida
 #define PAGE_DIRTY      (1 << 6)  // Página modificada
+#define PAGE_LARGE      (1 << 7)  // Entrada de directorio que mapea 4MB (PSE) o 2MB (PAE)
+#define PAGE_GLOBAL     (1 << 8)  // Entrada que no se invalida al cambiar CR3 (PGE)
+#define PAGE_COW        (1 << 9)  // Copy-on-write: solo lectura hasta la primera escritura (bit libre para el SO)
+#define PAGE_NX         (1 << 11) // No ejecutable: el VMM pone el bit 63 con PAE y NX (bit libre para el SO)
 
 // Direcciones del kernel
 #define KERNEL_START    0x00100000  // 1MB - Inicio del kernel
-#define KERNEL_HEAP_START 0x00400000  // 4MB - Inicio del heap del kernel
-#define KERNEL_HEAP_SIZE  0x00400000  // 4MB - Tamaño del heap
+#define KERNEL_HEAP_START 0xC0000000  // 3GB - Rango virtual reservado para el heap del kernel
+#define KERNEL_HEAP_SIZE  0x10000000  // 256MB - Tamaño máximo del heap (se mapea bajo demanda)
+#define KERNEL_IDENTITY_END 0x08000000  // 128MB - Fin del identity mapping
+#define KERNEL_KV_START   0xD0000000  // Rango virtual de las asignaciones grandes (kvmalloc)
+#define KERNEL_KV_SIZE    0x10000000  // 256MB - Tamaño máximo del rango de kvmalloc
+#define KERNEL_FRAMES_START 0xE0000000  // Descriptores de marco fuera del identity map (PAE con mucha memoria)
+#define KERNEL_FRAMES_SIZE  0x10000000  // 256MB - Tamaño máximo del rango (128MB de page_t con 64GB)
+#define KERNEL_KMAP_START 0xFFC00000  // Ventana de mapeos temporales (kmap)
+#define KERNEL_KMAP_SLOTS 32          // Páginas que pueden estar mapeadas a la vez con kmap
+
+// Espacio de usuario: lo que queda entre el identity map y el heap. El
+// resto del espacio virtual es del kernel y lo comparten todos los procesos
+#define USER_SPACE_START  KERNEL_IDENTITY_END
+#define USER_SPACE_END    KERNEL_HEAP_START
+
+// kmalloc envía a kvmalloc las peticiones de al menos este tamaño
+#define KMALLOC_LARGE_THRESHOLD (16 * PAGE_SIZE)
 
 /*
  * ============================================================================
@@ -42,8 +65,59 @@
  * Cada bit representa una página de 4KB:
  *   0 = página libre
  *   1 = página ocupada
+ *
+ * Las páginas libres se agrupan en un buddy allocator para poder asignar
+ * bloques de 2^orden páginas físicamente contiguas. La API de una página
+ * es el orden 0.
+ *
+ * La memoria se divide en zonas. Una petición nombra la zona más alta que
+ * acepta y, si está agotada, se sirve de las inferiores:
+ *   ZONE_DMA  [0, 16MB)     DMA ISA
+ *   ZONE_LOW  [16MB, 128MB) Identity map: el kernel accede directamente
+ *   ZONE_HIGH [128MB, ...)  Solo accesible a través de un mapeo
+ * Los metadatos del kernel (page tables, slabs) deben venir del identity
+ * map; lo que siempre se mapea (heap, kvmalloc, páginas de usuario) debe
+ * pedir ZONE_HIGH para no agotar la memoria baja.
  */
 
+// Zonas de memoria física
+#define ZONE_DMA        0
+#define ZONE_LOW        1
+#define ZONE_HIGH       2
+#define PMM_ZONE_COUNT  3
+
+// Fin de ZONE_DMA (ZONE_LOW termina en KERNEL_IDENTITY_END)
+#define ZONE_DMA_END 0x01000000  // 16MB
+
+// Orden máximo del buddy allocator: bloques de hasta 2^10 páginas (4MB)
+#define PMM_MAX_ORDER 10
+
+// Marcos que piden de una vez con pmm_alloc_batch quienes mapean rangos
+#define PMM_BATCH_PAGES 32
+
+// Flags de los descriptores de marco (page_t.flags)
+#define PAGE_FRAME_RESERVED (1 << 0)  // Nunca asignable (kernel, metadatos, BIOS)
+#define PAGE_FRAME_SLAB     (1 << 1)  // Slab del slab allocator
+#define PAGE_FRAME_TABLE    (1 << 2)  // Page table del VMM
+#define PAGE_FRAME_CACHE    (1 << 3)  // Page cache
+#define PAGE_FRAME_CONTIG   (1 << 4)  // Bloque contiguo de kmalloc_p/kmalloc_ap (orden en link)
+
+// Referencias máximas a un marco
+#define PAGE_REFCOUNT_MAX 0xFFFF
+
+/**
+ * Descriptor de un marco físico
+ * Hay uno por página en un array indexado por número de marco; con 8
+ * bytes por página el array ocupa un 0.2% de la memoria (12KB con 6MB).
+ * Con PAE y mucha memoria el array no está en el identity map: se accede
+ * por su mapeo en KERNEL_FRAMES_START (pmm_get_pages_block)
+ */
+typedef struct page {
+    uint16_t refcount;              // Referencias (0 = libre)
+    uint16_t flags;                 // PAGE_FRAME_*
+    uint32_t link;                  // Propietario o siguiente marco de una lista (LRU)
+} page_t;
+
 /**
  * Inicializa el Physical Memory Manager
  * 
@@ -53,18 +127,146 @@
 int pmm_init(multiboot_info_t* mbi, bool kdebug __attribute__((unused)), bool kverbose __attribute__((unused)));
 
 /**
- * Asigna una página física
+ * Asigna una página física del identity map (ZONE_LOW o ZONE_DMA)
  * 
  * @return Dirección física de la página asignada, 0 si no hay memoria
  */
-uint32_t pmm_alloc_page(void);
+phys_addr_t pmm_alloc_page(void);
+
+/**
+ * Asigna una página física de una zona o, si está agotada, de las
+ * inferiores
+ * 
+ * @param zone Zona más alta aceptable (ZONE_DMA, ZONE_LOW o ZONE_HIGH)
+ * @return Dirección física de la página asignada, 0 si no hay memoria
+ */
+phys_addr_t pmm_alloc_page_zone(uint32_t zone);
 
 /**
  * Libera una página física
+ * Si la página tiene varias referencias (pmm_page_ref) solo se suelta una;
+ * el marco vuelve al PMM con la última
  * 
  * @param page Dirección física de la página a liberar
  */
-void pmm_free_page(uint32_t page);
+void pmm_free_page(phys_addr_t page);
+
+/**
+ * Asigna un bloque de páginas físicas contiguas del identity map
+ * El bloque está alineado a su tamaño (2^order páginas)
+ * 
+ * @param order Orden del bloque (0..PMM_MAX_ORDER)
+ * @return Dirección física del bloque, 0 si no hay un bloque libre de ese
+ *         tamaño
+ */
+phys_addr_t pmm_alloc_pages(uint32_t order);
+
+/**
+ * Asigna un bloque de páginas físicas contiguas de una zona o, si no
+ * tiene un bloque libre de ese tamaño, de las inferiores
+ * 
+ * @param order Orden del bloque (0..PMM_MAX_ORDER)
+ * @param zone Zona más alta aceptable
+ * @return Dirección física del bloque, 0 si no hay bloque
+ */
+phys_addr_t pmm_alloc_pages_zone(uint32_t order, uint32_t zone);
+
+/**
+ * Libera una referencia a un bloque de páginas físicas contiguas
+ * Las páginas sin más referencias vuelven al buddy allocator y se fusionan
+ * con sus buddies libres. Se puede liberar por partes (p. ej. página a
+ * página con pmm_free_page); si alguna página del bloque es reservada o ya
+ * está libre no se toca ninguna
+ * 
+ * @param addr Dirección física del bloque, alineada a su tamaño
+ * @param order Orden con el que se asignó
+ */
+void pmm_free_pages(phys_addr_t addr, uint32_t order);
+
+/**
+ * Asigna varias páginas físicas de una vez, no necesariamente contiguas
+ * Toma los mayores bloques del buddy allocator que caben en lo pedido, en
+ * la zona indicada primero y después en las inferiores. Cada página se
+ * libera por separado con pmm_free_page
+ *
+ * @param count Número de páginas pedidas
+ * @param frames Array de al menos count entradas para las direcciones
+ * @param zone Zona más alta aceptable
+ * @return Número de páginas asignadas (menos que count si se agota la memoria)
+ */
+uint32_t pmm_alloc_batch(uint32_t count, phys_addr_t* frames, uint32_t zone);
+
+/**
+ * Marca como reservado un rango físico (redondeado hacia fuera a páginas)
+ * Las páginas libres salen del buddy allocator en bloques y el bitmap se
+ * escribe por palabras; las ya asignadas no cambian
+ *
+ * @param addr Dirección física de inicio
+ * @param size Tamaño del rango en bytes
+ */
+void pmm_reserve_range(phys_addr_t addr, uint32_t size);
+
+/**
+ * Devuelve al PMM las páginas reservadas de un rango físico (redondeado
+ * hacia dentro a páginas)
+ * Las páginas libres, asignadas o del kernel no cambian
+ *
+ * @param addr Dirección física de inicio
+ * @param size Tamaño del rango en bytes
+ */
+void pmm_free_range(phys_addr_t addr, uint32_t size);
+
+/**
+ * Asigna una página física con su contenido a cero
+ * La toma del pool de marcos limpios que mantiene el proceso idle; si está
+ * vacío, asigna una página y la limpia en el momento. Los marcos vienen
+ * preferentemente de ZONE_HIGH: se acceden con kmap
+ *
+ * @return Dirección física de la página, 0 si no hay memoria
+ */
+phys_addr_t pmm_alloc_zeroed_page(void);
+
+/**
+ * Escribe ceros en marcos físicos consecutivos con rep stosl
+ * Lo que cae en el identity map se limpia de una pasada; los marcos por
+ * encima se acceden con kmap de uno en uno
+ *
+ * @param addr Dirección física del primer marco (alineada a página)
+ * @param count Número de marcos
+ * @return true si los limpió todos, false si no quedaban slots de kmap
+ */
+bool pmm_zero_pages(phys_addr_t addr, uint32_t count);
+
+/**
+ * Limpia un marco libre y lo añade al pool de marcos limpios
+ * Cada llamada escribe una sola página. Debe llamarse con las
+ * interrupciones deshabilitadas (ver memory_idle)
+ *
+ * @return true si añadió un marco, false si el pool está lleno o no hay
+ *         memoria
+ */
+bool pmm_zero_pool_fill(void);
+
+/**
+ * Devuelve al buddy allocator los marcos del pool de marcos limpios
+ * Los marcos del pool cuentan como ocupados; bajo presión de memoria se
+ * devuelven para que los use cualquiera
+ *
+ * @return Número de marcos devueltos
+ */
+uint32_t pmm_zero_pool_drain(void);
+
+/**
+ * Obtiene estadísticas del pool de marcos limpios
+ *
+ * @param hits Puntero donde se almacenarán las páginas servidas desde el
+ *             pool (puede ser NULL)
+ * @param misses Puntero donde se almacenarán las páginas limpiadas en el
+ *               momento (puede ser NULL)
+ * @param pooled Puntero donde se almacenarán los marcos del pool (puede ser
+ *               NULL)
+ */
+void pmm_get_zero_stats(uint32_t* hits, uint32_t* misses, uint32_t* pooled);
 
 /**
  * Obtiene la cantidad de páginas libres
@@ -80,29 +282,122 @@ uint32_t pmm_get_free_pages(void);
  */
 uint32_t pmm_get_total_pages(void);
 
+/**
+ * Obtiene el descriptor de un marco físico
+ * 
+ * @param addr Dirección física del marco
+ * @return Descriptor, o NULL si la dirección está fuera de la memoria
+ */
+page_t* pmm_get_page(phys_addr_t addr);
+
+/**
+ * Obtiene el bloque de los descriptores de marco cuando no están en el
+ * identity map (con PAE y mucha memoria). pmm_init lo escribe sin
+ * paginación; vmm_init lo mapea en KERNEL_FRAMES_START
+ * 
+ * @param phys Dirección física del bloque (0 si no hay)
+ * @return Tamaño del bloque en bytes (múltiplo de 4MB), 0 si los
+ *         descriptores siguen a los bitmaps del PMM
+ */
+uint32_t pmm_get_pages_block(phys_addr_t* phys);
+
+/**
+ * Cambia la dirección por la que el PMM accede a los descriptores de
+ * marco (la de su mapeo en KERNEL_FRAMES_START, al activar la paginación)
+ * 
+ * @param pages Nueva dirección del array de page_t
+ */
+void pmm_set_pages_address(page_t* pages);
+
+/**
+ * Añade una referencia a un marco físico asignado (para compartirlo entre
+ * espacios de direcciones); cada referencia se suelta con pmm_free_page
+ * 
+ * @param addr Dirección física del marco
+ * @return Nuevo número de referencias, 0 si el marco está libre, es
+ *         reservado o ya tiene PAGE_REFCOUNT_MAX referencias
+ */
+uint32_t pmm_page_ref(phys_addr_t addr);
+
+/**
+ * Obtiene el número de bloques libres de un orden del buddy allocator
+ * 
+ * @param order Orden (0..PMM_MAX_ORDER)
+ * @return Bloques libres maximales de 2^order páginas
+ */
+uint32_t pmm_get_free_blocks(uint32_t order);
+
+/**
+ * Obtiene las páginas libres de una zona
+ * 
+ * @param zone ZONE_DMA, ZONE_LOW o ZONE_HIGH
+ * @return Páginas libres, 0 si la zona no existe en esta máquina
+ */
+uint32_t pmm_get_zone_free_pages(uint32_t zone);
+
+/**
+ * Obtiene el total de páginas de una zona
+ * 
+ * @param zone ZONE_DMA, ZONE_LOW o ZONE_HIGH
+ * @return Páginas de la zona
+ */
+uint32_t pmm_get_zone_total_pages(uint32_t zone);
+
 /*
  * ============================================================================
  * VIRTUAL MEMORY MANAGER (VMM)
  * ============================================================================
- * Gestiona la memoria virtual usando paginación de 2 niveles:
- *   - Page Directory (1024 entradas)
- *   - Page Tables (1024 entradas cada una)
+ * Gestiona la memoria virtual con uno de los dos formatos de paginación,
+ * elegido en el arranque (vmm_select_mode):
+ *   - 2 niveles: Page Directory y Page Tables de 1024 entradas de 32 bits
+ *   - PAE (--pae): PDPT de 4 entradas, Page Directories y Page Tables de
+ *     512 entradas de 64 bits. Las entradas nombran marcos por encima de
+ *     4GB y, si la CPU tiene NX, las páginas con PAGE_NX no son ejecutables
  * 
- * Cada entrada mapea 4KB, permitiendo direccionar 4GB de memoria virtual.
+ * Cada entrada de una page table mapea 4KB, permitiendo direccionar 4GB de
+ * memoria virtual. Si la CPU tiene PSE (o con PAE), el identity map del
+ * kernel usa entradas de directorio de 4MB (2MB con PAE, PAGE_LARGE) sin
+ * page table; vmm_map_page y vmm_unmap_page las dividen en una tabla de
+ * 4KB cuando hace falta. El formato de las entradas es privado del VMM:
+ * page_directory_t es opaco.
+ *
+ * Las page tables pueden estar en cualquier marco físico: el VMM las
+ * accede a través de kmap, una ventana de KERNEL_KMAP_SLOTS páginas al
+ * final del espacio virtual. Los directorios siguen en el identity map.
+ *
+ * Cada proceso puede tener su propio directorio (espacio de direcciones).
+ * La parte del kernel (identity map, heap, kvmalloc) es común: sus page
+ * tables son las del directorio del kernel y las entradas se copian a
+ * todos los directorios. Con PGE, las páginas del kernel son globales y
+ * sobreviven a los cambios de CR3.
+ *
+ * El espacio de usuario se puede reservar por regiones sin respaldo: el
+ * handler de page faults asigna y mapea cada página la primera vez que se
+ * toca (demand paging), así una región grande no cuesta memoria hasta que
+ * se usa. vmm_clone_address_space comparte los marcos de usuario en modo
+ * copy-on-write: la copia de cada página se hace en su primera escritura.
  */
 
-// Tipos de entradas de paginación
-typedef uint32_t page_directory_entry_t;
-typedef uint32_t page_table_entry_t;
+// Directorio de páginas de un espacio de direcciones (opaco: su formato
+// depende de PAE). Su dirección es la física, en el identity map
+typedef struct page_directory page_directory_t;
 
-// Estructuras de paginación
-typedef struct {
-    page_table_entry_t entries[1024];
-} __attribute__((aligned(PAGE_SIZE))) page_table_t;
+/**
+ * Elige el formato de las page tables
+ * Se llama antes de pmm_init: con PAE el PMM gestiona memoria por encima
+ * de 4GB. Si la CPU no tiene PAE se usa la paginación de 2 niveles
+ *
+ * @param pae Usar PAE (--pae en la línea de comandos)
+ * @return true si se usará PAE
+ */
+bool vmm_select_mode(bool pae);
 
-typedef struct {
-    page_directory_entry_t entries[1024];
-} __attribute__((aligned(PAGE_SIZE))) page_directory_t;
+/**
+ * Indica si las page tables son de PAE (entradas de 64 bits)
+ *
+ * @return true con PAE, false con paginación de 2 niveles
+ */
+bool vmm_is_pae(void);
 
 /**
  * Inicializa el Virtual Memory Manager
@@ -114,14 +409,16 @@ int vmm_init(bool kdebug __attribute__((unused)), bool kverbose __attribute__((u
 
 /**
  * Mapea una página virtual a una página física
+ * Las direcciones del kernel se mapean siempre en el directorio del kernel,
+ * compartido por todos los espacios de direcciones
  * 
  * @param page_dir Directorio de páginas
  * @param virt Dirección virtual
  * @param phys Dirección física
- * @param flags Flags de la página (PAGE_PRESENT, PAGE_WRITE, etc.)
+ * @param flags Flags de la página (PAGE_PRESENT, PAGE_WRITE, PAGE_NX, etc.)
  * @return E_OK si fue exitoso, código de error en caso contrario
  */
-int vmm_map_page(page_directory_t* page_dir, uint32_t virt, uint32_t phys, uint32_t flags);
+int vmm_map_page(page_directory_t* page_dir, uint32_t virt, phys_addr_t phys, uint32_t flags);
 
 /**
  * Desmapea una página virtual
@@ -131,6 +428,42 @@ int vmm_map_page(page_directory_t* page_dir, uint32_t virt, uint32_t phys, uint3
  */
 void vmm_unmap_page(page_directory_t* page_dir, uint32_t virt);
 
+// Páginas de un rango a partir de las cuales vmm_map_range/vmm_unmap_range
+// vacían el TLB entero en lugar de invalidar página a página con invlpg
+#define VMM_INVLPG_MAX 32
+
+/**
+ * Mapea un rango de páginas recorriendo cada page table una sola vez
+ * El TLB se invalida al final: con invlpg por página hasta VMM_INVLPG_MAX
+ * páginas y recargándolo entero por encima
+ *
+ * @param page_dir Directorio de páginas
+ * @param virt Dirección virtual inicial (alineada a página)
+ * @param frames Marco de cada página, o NULL para mapear un rango físico
+ *               contiguo desde phys
+ * @param phys Dirección física inicial si frames es NULL
+ * @param count Número de páginas
+ * @param flags Flags de las páginas (PAGE_PRESENT, PAGE_WRITE, etc.)
+ * @return E_OK, E_INVAL si el rango no es válido, o E_NOMEM (sin dejar
+ *         ninguna página del rango mapeada)
+ */
+int vmm_map_range(page_directory_t* page_dir, uint32_t virt, const phys_addr_t* frames, phys_addr_t phys,
+                  uint32_t count, uint32_t flags);
+
+/**
+ * Desmapea un rango de páginas recorriendo cada page table una sola vez
+ * Las páginas no mapeadas se saltan. El TLB se invalida como en
+ * vmm_map_range
+ *
+ * @param page_dir Directorio de páginas
+ * @param virt Dirección virtual inicial (alineada a página)
+ * @param count Número de páginas
+ * @param release Si es true, suelta una referencia a cada marco desmapeado
+ *                (pmm_free_page)
+ * @return Páginas desmapeadas
+ */
+uint32_t vmm_unmap_range(page_directory_t* page_dir, uint32_t virt, uint32_t count, bool release);
+
 /**
  * Obtiene la dirección física de una dirección virtual
  * 
@@ -138,7 +471,7 @@ void vmm_unmap_page(page_directory_t* page_dir, uint32_t virt);
  * @param virt Dirección virtual
  * @return Dirección física correspondiente, 0 si no está mapeada
  */
-uint32_t vmm_get_physical(page_directory_t* page_dir, uint32_t virt);
+phys_addr_t vmm_get_physical(page_directory_t* page_dir, uint32_t virt);
 
 /**
  * Cambia el directorio de páginas activo
@@ -154,6 +487,152 @@ void vmm_switch_directory(page_directory_t* page_dir);
  */
 page_directory_t* vmm_get_kernel_directory(void);
 
+/**
+ * Mapea temporalmente un marco físico en la ventana de kmap
+ * Los marcos del identity map se devuelven directamente sin gastar slot.
+ * Cada kmap debe ir seguido de su kunmap; se pueden anidar hasta
+ * KERNEL_KMAP_SLOTS
+ *
+ * @param phys Dirección física (el desplazamiento dentro de la página se
+ *             conserva)
+ * @return Dirección virtual, NULL si no quedan slots libres
+ */
+void* kmap(phys_addr_t phys);
+
+/**
+ * Deshace un mapeo de kmap
+ *
+ * @param addr Dirección devuelta por kmap
+ */
+void kunmap(void* addr);
+
+/**
+ * Obtiene el directorio de páginas activo
+ *
+ * @return Puntero al directorio cargado en CR3
+ */
+page_directory_t* vmm_get_current_directory(void);
+
+/**
+ * Crea un espacio de direcciones con la parte del kernel ya mapeada
+ * El directorio es un marco del identity map; su espacio de usuario
+ * (USER_SPACE_START..USER_SPACE_END) empieza vacío
+ *
+ * @return Directorio nuevo, NULL si no hay memoria
+ */
+page_directory_t* vmm_create_address_space(void);
+
+/**
+ * Destruye un espacio de direcciones creado con vmm_create_address_space
+ * Libera sus page tables de usuario y suelta una referencia a cada marco
+ * mapeado en ellas: las páginas de usuario pertenecen a su espacio de
+ * direcciones. Si es el directorio activo, antes se carga el del kernel
+ *
+ * @param page_dir Directorio a destruir (NULL o el del kernel no hacen nada)
+ */
+void vmm_destroy_address_space(page_directory_t* page_dir);
+
+/**
+ * Clona un espacio de direcciones con copy-on-write
+ * Solo copia las page tables de usuario: los marcos se comparten (una
+ * referencia más en su descriptor) y las páginas escribibles quedan de
+ * solo lectura con PAGE_COW en ambos espacios. La primera escritura en
+ * cualquiera de los dos hace la copia. Las regiones también se clonan
+ *
+ * @param page_dir Espacio a clonar (creado con vmm_create_address_space)
+ * @return Espacio nuevo, NULL si no hay memoria o page_dir no es válido
+ */
+page_directory_t* vmm_clone_address_space(page_directory_t* page_dir);
+
+/**
+ * Registra el handler de page faults (vector 14)
+ * Se llama después de interrupts_init, que borra los handlers
+ *
+ * @return E_OK, o E_NOMEM si no se pudo crear el cache de regiones
+ */
+int vmm_fault_init(void);
+
+/**
+ * Reserva una región del espacio de usuario respaldada bajo demanda
+ * No asigna nada: cada página se asigna a cero y se mapea en su primer
+ * acceso. Los accesos que la región no permite siguen siendo fallos
+ *
+ * @param page_dir Espacio de direcciones
+ * @param start Inicio (alineado a página, dentro de USER_SPACE_START..USER_SPACE_END)
+ * @param size Tamaño en bytes (se redondea a páginas)
+ * @param flags Protección: PAGE_WRITE, PAGE_USER y/o PAGE_NX
+ * @return E_OK, E_INVAL si el rango no es válido, E_EXISTS si se solapa
+ *         con otra región, E_NOMEM
+ */
+int vmm_region_create(page_directory_t* page_dir, uint32_t start, uint32_t size, uint32_t flags);
+
+/**
+ * Elimina una región: desmapea sus páginas ya tocadas y suelta sus marcos
+ *
+ * @param page_dir Espacio de direcciones
+ * @param start Inicio de la región
+ * @return E_OK, o E_NOENT si no hay una región que empiece ahí
+ */
+int vmm_region_destroy(page_directory_t* page_dir, uint32_t start);
+
+// Opciones de vmm_map_user
+#define VMM_MAP_FIXED     0x01  // Usar exactamente la dirección pedida
+#define VMM_MAP_POPULATE  0x02  // Asignar todas las páginas al mapear
+#define VMM_MAP_LARGE     0x04  // Páginas grandes si el tamaño lo permite (implica POPULATE)
+#define VMM_MAP_GUARD     0x08  // Una página sin mapear a cada lado
+
+/**
+ * Mapea memoria anónima a cero en el espacio de usuario
+ * Crea una región; sin VMM_MAP_POPULATE se respalda bajo demanda. Con
+ * VMM_MAP_LARGE, si la CPU tiene PSE (o con PAE) y el tamaño es múltiplo
+ * de una página grande (4MB, o 2MB con PAE), cada tramo alineado se mapea
+ * con una página grande (si no hay bloque físico contiguo, con páginas de
+ * 4KB). Las guardas no se mapean nunca: tocarlas es un fallo
+ *
+ * @param page_dir Espacio de direcciones
+ * @param addr Entrada: pista (o dirección exacta con VMM_MAP_FIXED).
+ *             Salida: inicio de la región
+ * @param size Tamaño en bytes (se redondea a páginas)
+ * @param flags Protección: PAGE_WRITE y/o PAGE_NX (PAGE_USER siempre)
+ * @param options VMM_MAP_*
+ * @return E_OK, E_INVAL si los argumentos o el rango fijo no son válidos,
+ *         E_EXISTS si el rango fijo se solapa con otra región, E_NOMEM si
+ *         no hay hueco o memoria para poblarla
+ */
+int vmm_map_user(page_directory_t* page_dir, uint32_t* addr, uint32_t size, uint32_t flags, uint32_t options);
+
+/**
+ * Deshace un vmm_map_user: desmapea la región entera y suelta sus marcos
+ *
+ * @param page_dir Espacio de direcciones
+ * @param addr Inicio de la región
+ * @param size Tamaño con el que se mapeó
+ * @return E_OK, E_NOENT si no hay una región que empiece en addr,
+ *         E_INVAL si el tamaño no es el de la región
+ */
+int vmm_unmap_user(page_directory_t* page_dir, uint32_t addr, uint32_t size);
+
+/**
+ * Obtiene las estadísticas de page faults resueltos
+ * Cualquier puntero puede ser NULL
+ *
+ * @param minor Fallos resueltos asignando una página
+ * @param avg_cycles Latencia media del handler en ciclos (media móvil;
+ *                   0 si la CPU no tiene TSC)
+ * @param max_cycles Latencia máxima en ciclos
+ */
+void vmm_get_fault_stats(uint32_t* minor, uint32_t* avg_cycles, uint32_t* max_cycles);
+
+/**
+ * Obtiene las estadísticas de copy-on-write
+ * Cualquier puntero puede ser NULL
+ *
+ * @param breaks Escrituras en páginas PAGE_COW resueltas
+ * @param copies De ellas, las que tuvieron que copiar la página (las demás
+ *               eran la última referencia y solo recuperaron la escritura)
+ */
+void vmm_get_cow_stats(uint32_t* breaks, uint32_t* copies);
+
 /*
  * ============================================================================
  * KERNEL HEAP
@@ -173,14 +652,47 @@ int heap_init(uint32_t start, uint32_t size, bool kdebug __attribute__((unused))
 
 /**
  * Asigna memoria del heap del kernel
+ * El contenido de la memoria es indefinido (usar kzalloc si se necesita a cero)
  * 
  * @param size Tamaño en bytes a asignar
  * @return Puntero a la memoria asignada, NULL si no hay memoria
  */
 void* kmalloc(size_t size);
 
+/**
+ * Asigna memoria del heap del kernel llena de ceros
+ * Si el bloque ya fue limpiado en tiempo idle no se vuelve a limpiar
+ * 
+ * @param size Tamaño en bytes a asignar
+ * @return Puntero a la memoria asignada, NULL si no hay memoria
+ */
+void* kzalloc(size_t size);
+
+/**
+ * Asigna memoria para un array de elementos llena de ceros
+ * 
+ * @param count Número de elementos
+ * @param size Tamaño de cada elemento en bytes
+ * @return Puntero a la memoria asignada, NULL si no hay memoria o
+ *         count * size desborda
+ */
+void* kcalloc(size_t count, size_t size);
+
+/**
+ * Asigna memoria del heap del kernel con los datos alineados
+ * El hueco que queda antes del bloque alineado vuelve a las listas libres,
+ * así que solo se consume size redondeado a 16 bytes
+ * 
+ * @param size Tamaño en bytes a asignar
+ * @param align Alineación en bytes (potencia de dos; menos de 16 equivale a 16)
+ * @return Puntero alineado a la memoria asignada, NULL si no hay memoria o
+ *         align no es potencia de dos
+ */
+void* kmalloc_aligned(size_t size, size_t align);
+
 /**
  * Asigna memoria alineada a página del heap del kernel
+ * Equivale a kmalloc_aligned(size, PAGE_SIZE)
  * 
  * @param size Tamaño en bytes a asignar
  * @return Puntero a la memoria asignada (alineada a 4KB), NULL si no hay memoria
@@ -189,21 +701,25 @@ void* kmalloc_a(size_t size);
 
 /**
  * Asigna memoria del heap del kernel y devuelve también la dirección física
+ * La dirección física es válida para todo el bloque: hasta una página el
+ * bloque no cruza un límite de página; más de una página se sirve con
+ * marcos contiguos del identity map (ZONE_LOW) que también libera kfree
  * 
  * @param size Tamaño en bytes a asignar
  * @param phys Puntero donde se almacenará la dirección física
  * @return Puntero a la memoria asignada, NULL si no hay memoria
  */
-void* kmalloc_p(size_t size, uint32_t* phys);
+void* kmalloc_p(size_t size, phys_addr_t* phys);
 
 /**
  * Asigna memoria alineada del heap del kernel y devuelve la dirección física
+ * Igual que kmalloc_p, con el bloque alineado a página
  * 
  * @param size Tamaño en bytes a asignar
  * @param phys Puntero donde se almacenará la dirección física
  * @return Puntero alineado a la memoria asignada, NULL si no hay memoria
  */
-void* kmalloc_ap(size_t size, uint32_t* phys);
+void* kmalloc_ap(size_t size, phys_addr_t* phys);
 
 /**
  * Libera memoria del heap del kernel
@@ -212,6 +728,389 @@ void* kmalloc_ap(size_t size, uint32_t* phys);
  */
 void kfree(void* ptr);
 
+/**
+ * Cambia el tamaño de una asignación de kmalloc
+ * Crece o encoge en su sitio cuando puede (absorbiendo el bloque libre
+ * siguiente o separando la cola); si no, mueve los datos a un bloque
+ * nuevo. La parte nueva tiene contenido indefinido y, si se mueve, solo
+ * se garantiza la alineación de kmalloc
+ * 
+ * @param ptr Puntero a la memoria (NULL equivale a kmalloc)
+ * @param size Nuevo tamaño en bytes (0 equivale a kfree)
+ * @return Puntero a la memoria redimensionada, NULL si no hay memoria
+ *         (en ese caso ptr sigue siendo válido)
+ */
+void* krealloc(void* ptr, size_t size);
+
+/*
+ * Telemetría del heap
+ */
+
+// Guarda en cada bloque ocupado la dirección de retorno de quien lo pidió
+// y acumula bytes vivos por call site (0 para quitarlo: ahorra 4 bytes
+// por bloque y la búsqueda en la tabla de sitios)
+#define HEAP_PROFILING 1
+
+// Call sites distintos que se pueden seguir (el resto se agrupa en uno)
+#define HEAP_PROFILE_SITES 64
+
+// Call sites con más bytes vivos incluidos en heap_stats_t
+#define HEAP_STATS_TOP_SITES 8
+
+// Cubetas del histograma de bloques libres: la i cuenta los bloques de
+// [16 << i, 16 << (i + 1)) bytes; la última acumula los mayores
+#define HEAP_HISTOGRAM_BUCKETS 16
+
+/**
+ * Uso del heap atribuido a un call site
+ */
+typedef struct {
+    uint32_t site;                  // Dirección de retorno (0 = sitios sin hueco en la tabla)
+    uint32_t live_bytes;            // Bytes de bloques vivos (tags incluidos)
+    uint32_t live_count;            // Bloques vivos
+    uint32_t total_count;           // Asignaciones totales
+} heap_site_stats_t;
+
+/**
+ * Estadísticas del heap (también se devuelven con SYS_GETINFO/INFO_HEAP)
+ */
+typedef struct {
+    uint32_t heap_size;             // Bytes gestionados por el heap
+    uint32_t mapped_bytes;          // Bytes respaldados por marcos del PMM
+    uint32_t used_bytes;            // Bytes en bloques ocupados (tags incluidos)
+    uint32_t used_blocks;           // Bloques ocupados
+    uint32_t free_bytes;            // Bytes en bloques libres
+    uint32_t free_blocks;           // Bloques libres
+    uint32_t largest_free;          // Mayor bloque libre
+    uint32_t fragmentation;         // 0-100: 100 - largest_free * 100 / free_bytes
+    uint32_t alloc_count;           // Asignaciones totales
+    uint32_t free_count;            // Liberaciones totales
+    uint32_t kv_areas;              // Buffers de kvmalloc vivos
+    uint32_t kv_pages;              // Páginas mapeadas por kvmalloc
+    uint32_t free_histogram[HEAP_HISTOGRAM_BUCKETS];
+    uint32_t site_count;            // Entradas válidas en top_sites
+    heap_site_stats_t top_sites[HEAP_STATS_TOP_SITES];  // Ordenados por live_bytes
+} heap_stats_t;
+
+/**
+ * Obtiene las estadísticas del heap
+ * Recorre las listas libres para calcular la fragmentación (O(bloques libres))
+ * 
+ * @param stats Estructura a rellenar
+ */
+void heap_get_stats(heap_stats_t* stats);
+
+/**
+ * Muestra por pantalla las estadísticas del heap, el histograma de
+ * bloques libres y el uso de todos los call sites con bloques vivos
+ */
+void heap_dump(void);
+
+/**
+ * Devuelve al PMM las páginas libres del final del heap
+ * 
+ * @return Bytes devueltos (múltiplo de PAGE_SIZE), 0 si no había nada libre
+ */
+size_t heap_shrink(void);
+
+/**
+ * Limpia un fragmento (hasta una página) de un bloque libre del heap
+ * Al terminar un bloque lo marca como limpio para que kzalloc no tenga
+ * que volver a escribirlo. Debe llamarse con las interrupciones
+ * deshabilitadas (ver memory_idle)
+ * 
+ * @return true si limpió algo, false si no quedan bloques pendientes
+ */
+bool heap_idle_zero(void);
+
+/*
+ * ============================================================================
+ * ASIGNACIONES GRANDES (kvmalloc)
+ * ============================================================================
+ * Buffers de varias páginas construidos con marcos sueltos del PMM,
+ * mapeados de forma contigua en el rango KERNEL_KV_START. kmalloc envía
+ * aquí las peticiones de KMALLOC_LARGE_THRESHOLD bytes o más, y kfree
+ * reconoce estas direcciones, así que no hace falta llamarlas a mano.
+ */
+
+/**
+ * Inicializa el asignador de asignaciones grandes
+ * Requiere el heap (los descriptores de área viven en un cache slab)
+ * 
+ * @return E_OK si fue exitoso, E_NOMEM si no se pudo crear el cache
+ */
+int kvmalloc_init(void);
+
+/**
+ * Asigna un buffer grande, alineado a página y virtualmente contiguo
+ * Las páginas físicas no son contiguas
+ * 
+ * @param size Tamaño en bytes a asignar (se redondea a páginas)
+ * @return Puntero al buffer, NULL si no hay memoria o rango virtual
+ */
+void* kvmalloc(size_t size);
+
+/**
+ * Asigna un buffer grande lleno de ceros
+ * 
+ * @param size Tamaño en bytes a asignar (se redondea a páginas)
+ * @return Puntero al buffer, NULL si no hay memoria o rango virtual
+ */
+void* kvzalloc(size_t size);
+
+/**
+ * Libera un buffer de kvmalloc y devuelve sus páginas al PMM
+ * 
+ * @param ptr Puntero devuelto por kvmalloc/kvzalloc
+ */
+void kvfree(void* ptr);
+
+/**
+ * Cambia el tamaño de un buffer de kvmalloc
+ * Encoge o crece en su sitio (mapeando páginas a continuación) cuando el
+ * rango virtual lo permite; si no, lo mueve a un área nueva
+ * 
+ * @param ptr Puntero devuelto por kvmalloc/kvzalloc (NULL equivale a kvmalloc)
+ * @param size Nuevo tamaño en bytes (0 equivale a kvfree)
+ * @return Puntero al buffer, NULL si no hay memoria (ptr sigue siendo válido)
+ */
+void* kvrealloc(void* ptr, size_t size);
+
+/**
+ * Obtiene el tamaño pedido de un buffer de kvmalloc
+ * 
+ * @param ptr Puntero devuelto por kvmalloc/kvzalloc
+ * @return Tamaño en bytes, 0 si ptr no es un buffer de kvmalloc
+ */
+size_t kvmalloc_size(const void* ptr);
+
+/**
+ * Obtiene estadísticas de las asignaciones grandes
+ * 
+ * @param areas Puntero donde se almacenará el número de buffers (puede ser NULL)
+ * @param pages Puntero donde se almacenarán las páginas mapeadas (puede ser NULL)
+ */
+void kvmalloc_get_stats(uint32_t* areas, uint32_t* pages);
+
+/*
+ * ============================================================================
+ * SLAB ALLOCATOR
+ * ============================================================================
+ * Caches de objetos de tamaño fijo para las estructuras del kernel que se
+ * crean y destruyen constantemente (PCBs, mensajes IPC, módulos).
+ *
+ * Cada cache agrupa sus objetos en slabs: los objetos pequeños usan una
+ * página física del PMM con el descriptor del slab al inicio (se localiza
+ * enmascarando la dirección del objeto); los grandes usan un bloque de
+ * páginas contiguas del buddy allocator (o del heap si no hay ninguno
+ * libre) y guardan un puntero al slab justo antes de cada objeto.
+ * Los objetos libres se enlazan en una lista dentro del propio slab, por lo
+ * que asignar y liberar son O(1) y no hay header por objeto.
+ */
+
+// Alineación por defecto de los objetos (línea de caché)
+#define SLAB_CACHE_LINE 64
+
+// Número máximo de caches en el sistema
+#define SLAB_MAX_CACHES 16
+
+struct kmem_slab;
+
+/**
+ * Cache de objetos
+ * Los contadores son de solo lectura fuera de slab.c
+ */
+typedef struct kmem_cache {
+    const char* name;               // Nombre (para depuración)
+    size_t object_size;             // Tamaño pedido del objeto
+    size_t align;                   // Alineación de cada objeto
+    size_t slot_size;               // Distancia entre objetos consecutivos
+    size_t free_offset;             // Offset del enlace de la lista libre
+    size_t slab_bytes;              // Tamaño de cada slab en bytes
+    uint32_t slab_order;            // Orden del PMM de los slabs grandes
+    uint32_t objects_per_slab;      // Objetos por slab
+    bool large;                     // true si el slab no cabe en una página
+    void (*ctor)(void*);            // Constructor (puede ser NULL)
+
+    struct kmem_slab* partial;      // Slabs con objetos libres y ocupados
+    struct kmem_slab* full;         // Slabs sin objetos libres
+    struct kmem_slab* empty;        // Slabs sin objetos ocupados
+    uint32_t empty_count;           // Número de slabs vacíos retenidos
+
+    // Estadísticas de uso
+    uint32_t active_objects;        // Objetos asignados actualmente
+    uint32_t total_objects;         // Objetos disponibles en todos los slabs
+    uint32_t slab_count;            // Slabs asignados
+    uint32_t alloc_count;           // Asignaciones totales
+    uint32_t free_count;            // Liberaciones totales
+} kmem_cache_t;
+
+/**
+ * Crea un cache de objetos de tamaño fijo
+ *
+ * Si hay constructor, se ejecuta una sola vez por objeto al crear su slab;
+ * quien libera un objeto debe devolverlo a su estado construido.
+ *
+ * @param name Nombre del cache
+ * @param size Tamaño de cada objeto en bytes
+ * @param align Alineación (potencia de dos); 0 para SLAB_CACHE_LINE
+ * @param ctor Constructor de objetos, o NULL
+ * @return Cache creado, NULL si no hay descriptores libres o los
+ *         parámetros no son válidos
+ */
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, void (*ctor)(void*));
+
+/**
+ * Asigna un objeto de un cache
+ *
+ * @param cache Cache del que asignar
+ * @return Objeto asignado (contenido indefinido si no hay constructor),
+ *         NULL si no hay memoria
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+/**
+ * Asigna un objeto de un cache y lo llena de ceros
+ *
+ * @param cache Cache del que asignar
+ * @return Objeto asignado, NULL si no hay memoria
+ */
+void* kmem_cache_zalloc(kmem_cache_t* cache);
+
+/**
+ * Devuelve un objeto a su cache
+ *
+ * @param cache Cache al que pertenece el objeto
+ * @param obj Objeto a liberar
+ */
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+/**
+ * Libera todos los slabs vacíos retenidos por un cache
+ *
+ * @param cache Cache a reducir
+ * @return Número de slabs liberados
+ */
+uint32_t kmem_cache_shrink(kmem_cache_t* cache);
+
+/*
+ * ============================================================================
+ * ARENAS
+ * ============================================================================
+ * Memoria temporal para trabajo de corta duración (una petición IPC, una
+ * búsqueda de ruta...). Cada arena reparte con un puntero que avanza dentro
+ * de chunks de páginas pedidos a kmalloc; los objetos no se liberan uno a
+ * uno, sino todos juntos con arena_reset o hasta un checkpoint con
+ * arena_restore. Los checkpoints permiten ámbitos anidados: lo asignado
+ * después de tomarlo se libera al restaurarlo, lo anterior se conserva.
+ */
+
+// Tamaño por defecto de cada chunk
+#define ARENA_CHUNK_SIZE PAGE_SIZE
+
+// Alineación de arena_alloc
+#define ARENA_ALIGN 8
+
+/**
+ * Chunk de una arena
+ * Los datos empiezan justo después del descriptor
+ */
+typedef struct arena_chunk {
+    struct arena_chunk* prev;       // Chunk anterior (más antiguo)
+    uintptr_t end;                  // Fin del chunk
+} arena_chunk_t;
+
+/**
+ * Arena
+ * Vive al inicio de su primer chunk, que nunca se libera hasta
+ * arena_destroy
+ */
+typedef struct arena {
+    arena_chunk_t* chunk;           // Chunk actual
+    uintptr_t ptr;                  // Siguiente byte libre del chunk actual
+    size_t chunk_size;              // Tamaño de los chunks nuevos
+    uint32_t chunks;                // Chunks asignados
+} arena_t;
+
+/**
+ * Posición de una arena, para volver a ella con arena_restore
+ */
+typedef struct {
+    arena_chunk_t* chunk;
+    uintptr_t ptr;
+} arena_checkpoint_t;
+
+/**
+ * Crea una arena
+ *
+ * @param chunk_size Tamaño de cada chunk (se redondea a páginas);
+ *                   0 para ARENA_CHUNK_SIZE
+ * @return Arena creada, NULL si no hay memoria
+ */
+arena_t* arena_create(size_t chunk_size);
+
+/**
+ * Destruye una arena y libera todos sus chunks
+ *
+ * @param arena Arena a destruir (puede ser NULL)
+ */
+void arena_destroy(arena_t* arena);
+
+/**
+ * Asigna memoria de una arena, alineada a ARENA_ALIGN
+ * Las peticiones que no caben en un chunk reciben uno propio
+ *
+ * @param arena Arena de la que asignar (si es NULL devuelve NULL)
+ * @param size Tamaño en bytes
+ * @return Puntero a la memoria (contenido indefinido), NULL si no hay memoria
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/**
+ * Asigna memoria de una arena con una alineación dada
+ *
+ * @param arena Arena de la que asignar
+ * @param size Tamaño en bytes
+ * @param align Alineación (potencia de dos, como mucho PAGE_SIZE)
+ * @return Puntero a la memoria, NULL si no hay memoria o align no es válida
+ */
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t align);
+
+/**
+ * Asigna memoria de una arena llena de ceros
+ *
+ * @param arena Arena de la que asignar
+ * @param size Tamaño en bytes
+ * @return Puntero a la memoria, NULL si no hay memoria
+ */
+void* arena_zalloc(arena_t* arena, size_t size);
+
+/**
+ * Libera todo lo asignado en una arena
+ * Conserva el primer chunk para reutilizarlo
+ *
+ * @param arena Arena a vaciar (puede ser NULL)
+ */
+void arena_reset(arena_t* arena);
+
+/**
+ * Toma un checkpoint de la posición actual de una arena
+ *
+ * @param arena Arena (si es NULL el checkpoint no tiene efecto)
+ * @return Checkpoint para arena_restore
+ */
+arena_checkpoint_t arena_checkpoint(arena_t* arena);
+
+/**
+ * Vuelve a un checkpoint: libera lo asignado desde que se tomó
+ * Los checkpoints se restauran en orden inverso (LIFO); restaurar uno
+ * invalida los tomados después
+ *
+ * @param arena Arena
+ * @param checkpoint Checkpoint devuelto por arena_checkpoint
+ */
+void arena_restore(arena_t* arena, arena_checkpoint_t checkpoint);
+
 /*
  * ============================================================================
  * INICIALIZACIÓN DEL MEMORY MANAGER
@@ -226,6 +1125,7 @@ void kfree(void* ptr);
  * 1. PMM (Physical Memory Manager)
  * 2. VMM (Virtual Memory Manager)
  * 3. Heap del kernel
+ * 4. Asignaciones grandes (kvmalloc)
  * 
  * @param mbi Información de Multiboot con el mapa de memoria
  * @return E_OK si fue exitoso, código de error en caso contrario
@@ -238,7 +1138,18 @@ int memory_init(multiboot_info_t* mbi, bool kdebug __attribute__((unused)), bool
  * @param total_kb Puntero donde se almacenará la memoria total en KB (puede ser NULL)
  * @param used_kb Puntero donde se almacenará la memoria usada en KB (puede ser NULL)
  * @param free_kb Puntero donde se almacenará la memoria libre en KB (puede ser NULL)
+ * @param zone_free_kb Array de PMM_ZONE_COUNT donde se almacenará la memoria
+ *                     libre de cada zona en KB (puede ser NULL)
+ */
+void memory_get_info(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb, uint32_t* zone_free_kb);
+
+/**
+ * Trabajo de mantenimiento de memoria en tiempo idle
+ * Lo llama el proceso idle en cada vuelta; cada llamada hace una cantidad
+ * acotada de trabajo con las interrupciones deshabilitadas
+ * 
+ * @return true si queda trabajo pendiente, false si el idle puede dormir
  */
-void memory_get_info(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb);
+bool memory_idle(void);
 
 #endif /* _KERNEL_MEMORY_H */
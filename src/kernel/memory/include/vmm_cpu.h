@@ -0,0 +1,213 @@
+/**
+ * NeoOS - VMM CPU Access
+ * Instrucciones privilegiadas que usa el VMM
+ *
+ * Registros de control, EFER, invalidación del TLB, CPUID, interrupciones
+ * y TSC. Solo las incluye vmm.c. El harness del host define VMM_CPU_HOST y
+ * da su propia versión de cada función para ejecutar el VMM sin
+ * privilegios (memory/host/host_vmm.c).
+ */
+
+#ifndef _KERNEL_VMM_CPU_H
+#define _KERNEL_VMM_CPU_H
+
+#include "../../lib/include/types.h"
+
+// Bits de CPUID y de registros de control
+#define CPUID_EFLAGS_ID (1 << 21)   // EFLAGS.ID modificable = hay CPUID
+#define CPUID_EDX_TSC   (1 << 4)    // CPUID(1).EDX: contador de ciclos (rdtsc)
+#define CPUID_EDX_PSE   (1 << 3)    // CPUID(1).EDX: páginas de 4MB
+#define CPUID_EDX_PAE   (1 << 6)    // CPUID(1).EDX: entradas de 64 bits (PAE)
+#define CPUID_EDX_PGE   (1 << 13)   // CPUID(1).EDX: páginas globales
+#define CPUID_EXT_EDX_NX (1 << 20)  // CPUID(0x80000001).EDX: bit NX (solo con PAE)
+#define CR4_PSE         (1 << 4)
+#define CR4_PAE         (1 << 5)
+#define CR4_PGE         (1 << 7)
+#define MSR_EFER        0xC0000080  // Extended Feature Enable Register
+#define EFER_NXE        (1 << 11)   // Bit 63 de las entradas PAE = no ejecutable
+
+#ifndef VMM_CPU_HOST
+
+/**
+ * Carga un directorio de páginas en CR3
+ * También invalida todas las entradas no globales del TLB
+ */
+static inline void cpu_load_cr3(uint32_t phys_addr) {
+    __asm__ volatile("mov %0, %%cr3" : : "r"(phys_addr) : "memory");
+}
+
+/**
+ * Habilita la paginación
+ */
+static inline void cpu_enable_paging(void) {
+    uint32_t cr0;
+    __asm__ volatile(
+        "mov %%cr0, %0\n"
+        "or $0x80010000, %0\n"  // Bits 31 (PG) y 16 (WP: el kernel respeta el solo lectura)
+        "mov %0, %%cr0"
+        : "=r"(cr0)
+        :
+        : "memory"
+    );
+}
+
+/**
+ * Activa bits de CR4 (PSE, PAE, PGE)
+ */
+static inline void cpu_enable_cr4(uint32_t bits) {
+    uint32_t cr4;
+    __asm__ volatile(
+        "mov %%cr4, %0\n"
+        "or %1, %0\n"
+        "mov %0, %%cr4"
+        : "=&r"(cr4)
+        : "r"(bits)
+        : "memory"
+    );
+}
+
+/**
+ * Activa EFER.NXE: el bit 63 de las entradas PAE pasa a ser NX
+ * Solo se debe llamar si cpu_has_nx()
+ */
+static inline void cpu_enable_nx(void) {
+    uint32_t low, high;
+    __asm__ volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(MSR_EFER));
+    low |= EFER_NXE;
+    __asm__ volatile("wrmsr" : : "a"(low), "d"(high), "c"(MSR_EFER) : "memory");
+}
+
+/**
+ * Invalida la entrada TLB para una dirección virtual
+ */
+static inline void cpu_invlpg(uint32_t virt) {
+    __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+/**
+ * Invalida todo el TLB
+ * Sin páginas globales basta con recargar CR3; con ellas hay que apagar y
+ * volver a encender CR4.PGE
+ *
+ * @param global CR4.PGE está activo
+ */
+static inline void cpu_flush_tlb(bool global) {
+    uint32_t reg;
+
+    if (global) {
+        __asm__ volatile(
+            "mov %%cr4, %0\n"
+            "xor %1, %0\n"
+            "mov %0, %%cr4\n"
+            "xor %1, %0\n"
+            "mov %0, %%cr4"
+            : "=&r"(reg)
+            : "i"(CR4_PGE)
+            : "memory"
+        );
+        return;
+    }
+    __asm__ volatile(
+        "mov %%cr3, %0\n"
+        "mov %0, %%cr3"
+        : "=r"(reg)
+        :
+        : "memory"
+    );
+}
+
+/**
+ * Lee la dirección que provocó el último page fault
+ */
+static inline uint32_t cpu_read_cr2(void) {
+    uint32_t addr;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(addr));
+    return addr;
+}
+
+/**
+ * Obtiene las características de la CPU de CPUID(1).EDX
+ * Comprueba primero que existe CPUID (EFLAGS.ID se puede cambiar)
+ *
+ * @return CPUID(1).EDX, 0 si la CPU no tiene CPUID
+ */
+static inline uint32_t cpu_features(void) {
+    uint32_t original, toggled;
+    __asm__ volatile(
+        "pushfl\n"
+        "pop %0\n"
+        "mov %0, %1\n"
+        "xor %2, %1\n"
+        "push %1\n"
+        "popfl\n"
+        "pushfl\n"
+        "pop %1\n"
+        "push %0\n"
+        "popfl"
+        : "=&r"(original), "=&r"(toggled)
+        : "i"(CPUID_EFLAGS_ID)
+        : "cc"
+    );
+    if (((original ^ toggled) & CPUID_EFLAGS_ID) == 0) {
+        return 0;  // CPU sin CPUID
+    }
+
+    uint32_t eax = 1, ebx, ecx = 0, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+    return edx;
+}
+
+/**
+ * Comprueba si la CPU admite el bit NX (no ejecutable)
+ * Solo se debe llamar si la CPU tiene CPUID
+ */
+static inline bool cpu_has_nx(void) {
+    uint32_t eax = 0x80000000, ebx, ecx = 0, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+    if (eax < 0x80000001) {
+        return false;  // Sin la hoja extendida
+    }
+
+    eax = 0x80000001;
+    ecx = 0;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+    return (edx & CPUID_EXT_EDX_NX) != 0;
+}
+
+/**
+ * Deshabilita las interrupciones guardando el estado anterior
+ *
+ * @return EFLAGS para cpu_irq_restore
+ */
+static inline uint32_t cpu_irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile("pushfl\n" "pop %0\n" "cli" : "=r"(eflags) : : "memory");
+    return eflags;
+}
+
+/**
+ * Restaura el estado de las interrupciones de cpu_irq_save
+ */
+static inline void cpu_irq_restore(uint32_t eflags) {
+    __asm__ volatile("push %0\n" "popfl" : : "r"(eflags) : "memory", "cc");
+}
+
+/**
+ * Lee los 32 bits bajos del contador de ciclos
+ */
+static inline uint32_t cpu_read_tsc(void) {
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return low;
+}
+
+/**
+ * Pone a cero un bit de una palabra de forma atómica
+ */
+static inline void cpu_clear_bit(volatile uint32_t* word, uint32_t bit) {
+    __asm__ volatile("lock btrl %1, %0" : "+m"(*word) : "r"(bit) : "memory", "cc");
+}
+
+#endif /* VMM_CPU_HOST */
+
+#endif /* _KERNEL_VMM_CPU_H */
@@ -0,0 +1,198 @@
+/**
+ * NeoOS - Arenas
+ * Asignación por puntero creciente para memoria temporal
+ *
+ * Una arena es una pila de chunks pedidos a kmalloc. Asignar solo avanza
+ * arena->ptr dentro del chunk actual; cuando no cabe se apila un chunk
+ * nuevo (o uno a medida si la petición es mayor que chunk_size) y el resto
+ * del anterior se abandona. Nada se libera por objeto: arena_reset y
+ * arena_restore desapilan chunks y recolocan el puntero.
+ *
+ *   Primer chunk:  [arena_chunk_t][arena_t][datos...]
+ *   Resto:         [arena_chunk_t][datos...]
+ *
+ * El descriptor de la arena vive en su primer chunk, así que crear una
+ * arena cuesta una sola llamada a kmalloc.
+ */
+
+#include "../include/memory.h"
+#include "../../drivers/include/early_vga.h"
+#include "../../lib/include/string.h"
+
+/**
+ * Apila un chunk nuevo de size bytes y lo hace actual
+ *
+ * @return E_OK, o E_NOMEM
+ */
+static int arena_push_chunk(arena_t* arena, size_t size) {
+    arena_chunk_t* chunk = (arena_chunk_t*)kmalloc(size);
+    if (chunk == NULL) {
+        return E_NOMEM;
+    }
+
+    chunk->prev = arena->chunk;
+    chunk->end = (uintptr_t)chunk + size;
+    arena->chunk = chunk;
+    arena->ptr = (uintptr_t)(chunk + 1);
+    arena->chunks++;
+    return E_OK;
+}
+
+/**
+ * Desapila el chunk actual
+ * El llamador recoloca arena->ptr
+ */
+static void arena_pop_chunk(arena_t* arena) {
+    arena_chunk_t* chunk = arena->chunk;
+    arena->chunk = chunk->prev;
+    arena->chunks--;
+    kfree(chunk);
+}
+
+/**
+ * Crea una arena
+ */
+arena_t* arena_create(size_t chunk_size) {
+    if (chunk_size == 0) {
+        chunk_size = ARENA_CHUNK_SIZE;
+    }
+    if (chunk_size > KERNEL_KV_SIZE) {
+        return NULL;
+    }
+    chunk_size = (chunk_size + PAGE_SIZE - 1) & PAGE_ALIGN_MASK;
+
+    arena_chunk_t* chunk = (arena_chunk_t*)kmalloc(chunk_size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->prev = NULL;
+    chunk->end = (uintptr_t)chunk + chunk_size;
+
+    arena_t* arena = (arena_t*)(chunk + 1);
+    arena->chunk = chunk;
+    arena->ptr = (uintptr_t)(arena + 1);
+    arena->chunk_size = chunk_size;
+    arena->chunks = 1;
+    return arena;
+}
+
+/**
+ * Destruye una arena y libera todos sus chunks
+ */
+void arena_destroy(arena_t* arena) {
+    if (arena == NULL) {
+        return;
+    }
+
+    while (arena->chunk->prev != NULL) {
+        arena_pop_chunk(arena);
+    }
+    kfree(arena->chunk);  // Contiene la propia arena
+}
+
+/**
+ * Asigna memoria de una arena con una alineación dada
+ */
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t align) {
+    if (arena == NULL || size == 0 || align == 0 ||
+        (align & (align - 1)) != 0 || align > PAGE_SIZE) {
+        return NULL;
+    }
+
+    uintptr_t start = (arena->ptr + align - 1) & ~(uintptr_t)(align - 1);
+    if (start > arena->chunk->end || arena->chunk->end - start < size) {
+        if (size > KERNEL_KV_SIZE) {
+            return NULL;
+        }
+
+        // El relleno de alineación cuenta; lo que no quepa en un chunk
+        // normal recibe uno a medida
+        size_t needed = sizeof(arena_chunk_t) + align - 1 + size;
+        size_t chunk_size = arena->chunk_size;
+        if (needed > chunk_size) {
+            chunk_size = (needed + PAGE_SIZE - 1) & PAGE_ALIGN_MASK;
+        }
+
+        if (arena_push_chunk(arena, chunk_size) != E_OK) {
+            return NULL;
+        }
+        start = (arena->ptr + align - 1) & ~(uintptr_t)(align - 1);
+    }
+
+    arena->ptr = start + size;
+    return (void*)start;
+}
+
+/**
+ * Asigna memoria de una arena, alineada a ARENA_ALIGN
+ */
+void* arena_alloc(arena_t* arena, size_t size) {
+    return arena_alloc_aligned(arena, size, ARENA_ALIGN);
+}
+
+/**
+ * Asigna memoria de una arena llena de ceros
+ */
+void* arena_zalloc(arena_t* arena, size_t size) {
+    void* ptr = arena_alloc_aligned(arena, size, ARENA_ALIGN);
+    if (ptr != NULL) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+/**
+ * Libera todo lo asignado en una arena
+ */
+void arena_reset(arena_t* arena) {
+    if (arena == NULL) {
+        return;
+    }
+
+    while (arena->chunk->prev != NULL) {
+        arena_pop_chunk(arena);
+    }
+    arena->ptr = (uintptr_t)(arena + 1);
+}
+
+/**
+ * Toma un checkpoint de la posición actual de una arena
+ */
+arena_checkpoint_t arena_checkpoint(arena_t* arena) {
+    arena_checkpoint_t checkpoint = { NULL, 0 };
+
+    if (arena != NULL) {
+        checkpoint.chunk = arena->chunk;
+        checkpoint.ptr = arena->ptr;
+    }
+    return checkpoint;
+}
+
+/**
+ * Vuelve a un checkpoint
+ */
+void arena_restore(arena_t* arena, arena_checkpoint_t checkpoint) {
+    if (arena == NULL || checkpoint.chunk == NULL) {
+        return;
+    }
+
+    // Un checkpoint cuyo chunk ya no está apilado viene de un ámbito que
+    // no se cerró en orden; no se toca la arena
+    arena_chunk_t* chunk = arena->chunk;
+    while (chunk != NULL && chunk != checkpoint.chunk) {
+        chunk = chunk->prev;
+    }
+    if (chunk == NULL || (chunk == arena->chunk && checkpoint.ptr > arena->ptr)) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[ARENA] [ERROR] Checkpoint invalido: ");
+        vga_write_hex((uint32_t)checkpoint.ptr);
+        vga_write("\n");
+        return;
+    }
+
+    while (arena->chunk != checkpoint.chunk) {
+        arena_pop_chunk(arena);
+    }
+    arena->ptr = checkpoint.ptr;
+}
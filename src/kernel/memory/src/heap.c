@@ -2,16 +2,49 @@
  * NeoOS - Kernel Heap
  * Asignación dinámica de memoria para el kernel
  * 
- * Implementa un heap simple con kmalloc/kfree usando una lista enlazada
- * de bloques libres y ocupados.
+ * Implementa un heap con kmalloc/kfree usando boundary tags y listas
+ * segregadas de bloques libres por clase de tamaño (segregated fits).
  * 
- * Estructura de cada bloque:
- * [ header | datos... ]
+ * Estructura de cada bloque (el tamaño incluye el tag y es múltiplo de 16):
+ *
+ *   Ocupado: [ tag | datos...                                 ]
+ *   Libre:   [ tag | free_next | free_prev | ...      | footer ]
  * 
- * El header contiene:
- * - magic: número mágico para detección de corrupción
- * - size: tamaño del bloque (sin incluir el header)
- * - is_free: indica si el bloque está libre
+ * El tag es una palabra de 32 bits con el tamaño del bloque y, en los
+ * 4 bits bajos (siempre 0 en el tamaño), los flags:
+ * - HEAP_USED: el bloque está ocupado
+ * - HEAP_PREV_USED: el bloque anterior (por dirección) está ocupado
+ * - HEAP_ZERO: bloque libre cuyos datos (salvo enlaces y footer) son cero
+ *
+ * Solo los bloques libres tienen footer (una copia del tamaño en su última
+ * palabra). Así el vecino siguiente se obtiene sumando el tamaño y el
+ * anterior, si HEAP_PREV_USED está a 0, restando el valor de su footer:
+ * fusionar es O(1) y un bloque ocupado solo paga 4 bytes de overhead.
+ *
+ * Los datos quedan alineados a 16 bytes porque cada tag está en una
+ * dirección ≡ 12 (mod 16). El heap empieza con 12 bytes de relleno y
+ * termina con un epílogo (tag de tamaño 0 marcado como ocupado) que evita
+ * fusionar más allá del final.
+ *
+ * Clases de tamaño (por tamaño total del bloque libre):
+ * - Clases 0-7: tamaños exactos, múltiplos de 16 bytes (menores a 128 bytes)
+ * - Clases 8-63: cada potencia de dos se divide en 4 sub-clases
+ *   (128-159, 160-191, 192-223, 224-255, 256-319, ...)
+ * - La última clase acumula además todos los bloques más grandes
+ *
+ * Un bitmap indica qué clases tienen bloques libres, así que elegir la
+ * clase es O(1) (bsf) y no depende de cuántos bloques tenga el heap.
+ *
+ * El heap vive en un rango virtual reservado (KERNEL_HEAP_START, hasta
+ * KERNEL_HEAP_SIZE bytes) y solo las páginas que usa están respaldadas:
+ * heap_expand pide marcos al PMM y los mapea con vmm_map_page, y
+ * heap_shrink devuelve las páginas libres del final cuando falta memoria.
+ *
+ * Limpieza perezosa: ni kfree ni heap_expand escriben los datos. kmalloc
+ * devuelve memoria con contenido indefinido y solo kzalloc/kcalloc la
+ * limpian, saltándose el memset si el bloque tiene HEAP_ZERO. El proceso
+ * idle limpia bloques libres por fragmentos (heap_idle_zero) y les pone
+ * HEAP_ZERO, así que liberar y volver a pedir buffers grandes es O(1).
  */
 
 #include "../include/memory.h"
@@ -19,35 +52,76 @@
 #include "../../drivers/include/early_vga.h"
 #include "../../lib/include/string.h"
 
-#define HEAP_MAGIC 0x12345678
-#define HEAP_HEADER_SIZE sizeof(heap_block_t)
-
-// Alineación mínima de bloques (16 bytes para mejor rendimiento)
+// Alineación mínima de los datos (16 bytes para mejor rendimiento)
 #define HEAP_MIN_ALIGN 16
 
-// Tamaño mínimo de bloque
-#define HEAP_MIN_BLOCK_SIZE 64
+// Flags del tag (los 4 bits bajos del tamaño)
+#define HEAP_USED       0x1
+#define HEAP_PREV_USED  0x2
+#define HEAP_ZERO       0x4
+#define HEAP_FLAG_MASK  (HEAP_MIN_ALIGN - 1)
+
+// Clases de tamaño (ver descripción al inicio del archivo)
+#define HEAP_BIN_COUNT         64
+#define HEAP_BIN_WORDS         (HEAP_BIN_COUNT / 32)
+#define HEAP_SMALL_SHIFT       4                              // log2(HEAP_MIN_ALIGN)
+#define HEAP_SMALL_LIMIT_SHIFT 7
+#define HEAP_SMALL_LIMIT       (1 << HEAP_SMALL_LIMIT_SHIFT)  // 128 bytes
+#define HEAP_SMALL_BINS        (HEAP_SMALL_LIMIT >> HEAP_SMALL_SHIFT)
+#define HEAP_SUBBIN_SHIFT      2
+#define HEAP_SUBBINS           (1 << HEAP_SUBBIN_SHIFT)
 
-// Estructura de un bloque del heap
+typedef uint32_t heap_tag_t;
+
+// Bloque del heap; free_next/free_prev solo son válidos si está libre
 typedef struct heap_block {
-    uint32_t magic;                 // Número mágico para verificación
-    size_t size;                    // Tamaño del bloque (sin header)
-    bool is_free;                   // ¿Está libre?
-    struct heap_block* next;        // Siguiente bloque
-    struct heap_block* prev;        // Bloque anterior
-    uint32_t padding[3];            // Padding para alinear a 32 bytes (múltiplo de 16)
+    heap_tag_t tag;                 // Tamaño del bloque | flags
+    struct heap_block* free_next;   // Siguiente bloque libre de la misma clase
+    struct heap_block* free_prev;   // Bloque libre anterior de la misma clase
 } heap_block_t;
 
+#define HEAP_TAG_SIZE sizeof(heap_tag_t)
+
+// Tamaño de los enlaces de la lista libre dentro de los datos
+#define HEAP_LINKS_SIZE (sizeof(heap_block_t) - HEAP_TAG_SIZE)
+
+// Tamaño mínimo de bloque: tag + enlaces + footer, redondeado (16 en x86)
+#define HEAP_MIN_BLOCK_SIZE \
+    ((sizeof(heap_block_t) + HEAP_TAG_SIZE + HEAP_MIN_ALIGN - 1) & ~(HEAP_MIN_ALIGN - 1))
+
+// Call site de una asignación: dirección de retorno de la función pública
+#define HEAP_CALLER() ((uint32_t)(uintptr_t)__builtin_return_address(0))
+
+// Palabra al final de cada bloque ocupado con su call site
+#define HEAP_SITE_SIZE (HEAP_PROFILING ? sizeof(uint32_t) : 0)
+
 // Variables globales del heap
-static uint32_t heap_start = 0;
-static uint32_t heap_end = 0;
-static uint32_t heap_current = 0;  // Puntero para asignación simple antes del heap completo
-static heap_block_t* heap_first_block = NULL;
+static uintptr_t heap_start = 0;
+static uintptr_t heap_end = 0;
+static uintptr_t heap_current = 0;  // Fin de la zona gestionada (el epílogo ocupa la última palabra)
+static uintptr_t heap_mapped_end = 0;  // Fin de la zona respaldada por marcos del PMM (alineado a página)
 static bool heap_initialized = false;
 
-// Verificación estática en tiempo de compilación: el header debe ser múltiplo de HEAP_MIN_ALIGN
-_Static_assert(sizeof(heap_block_t) % HEAP_MIN_ALIGN == 0, 
-               "heap_block_t debe ser múltiplo de HEAP_MIN_ALIGN para garantizar alineación");
+// Listas de bloques libres por clase y bitmap de clases no vacías
+static heap_block_t* heap_bins[HEAP_BIN_COUNT];
+static uint32_t heap_bin_bitmap[HEAP_BIN_WORDS];
+
+// Bytes que limpia cada llamada a heap_idle_zero
+#define HEAP_IDLE_ZERO_CHUNK PAGE_SIZE
+
+// Limpieza en idle: bloques libres sin HEAP_ZERO y bloque a medio limpiar
+static uint32_t heap_dirty_blocks = 0;
+static heap_block_t* heap_zero_cursor = NULL;
+static size_t heap_zero_offset = 0;
+
+// Telemetría: contadores globales y uso por call site (hash abierto por
+// dirección; los sitios que no caben se acumulan en heap_site_other)
+static uint32_t heap_used_bytes = 0;
+static uint32_t heap_used_blocks = 0;
+static uint32_t heap_alloc_count = 0;
+static uint32_t heap_free_count = 0;
+static heap_site_stats_t heap_sites[HEAP_PROFILE_SITES];
+static heap_site_stats_t heap_site_other;
 
 /*
  * Funciones auxiliares
@@ -56,222 +130,495 @@ _Static_assert(sizeof(heap_block_t) % HEAP_MIN_ALIGN == 0,
 /**
  * Alinea un valor hacia arriba al siguiente múltiplo de align
  */
-static inline uint32_t align_up(uint32_t value, uint32_t align) {
+static inline uintptr_t align_up(uintptr_t value, uintptr_t align) {
     return (value + align - 1) & ~(align - 1);
 }
 
 /**
- * Encuentra un bloque libre que sea lo suficientemente grande
+ * Índice del bit más significativo de un valor distinto de cero
  */
-static heap_block_t* heap_find_free_block(size_t size) {
-    heap_block_t* current = heap_first_block;
-    
-    while (current != NULL) {
-        if (current->magic != HEAP_MAGIC) {
-            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-            vga_write("[HEAP] [ERROR] Corrupcion detectada en bloque ");
-            vga_write_hex((uint32_t)current);
-            vga_write("\n");
-            return NULL;
-        }
-        
-        if (current->is_free && current->size >= size) {
-            return current;
-        }
-        
-        current = current->next;
+static inline uint32_t heap_fls(size_t value) {
+    return (uint32_t)(sizeof(size_t) * 8 - 1 - __builtin_clzl(value));
+}
+
+/*
+ * Acceso a los boundary tags
+ */
+
+static inline size_t heap_block_size(heap_block_t* block) {
+    return block->tag & ~(heap_tag_t)HEAP_FLAG_MASK;
+}
+
+static inline bool heap_block_used(heap_block_t* block) {
+    return (block->tag & HEAP_USED) != 0;
+}
+
+static inline bool heap_prev_used(heap_block_t* block) {
+    return (block->tag & HEAP_PREV_USED) != 0;
+}
+
+static inline bool heap_block_zero(heap_block_t* block) {
+    return (block->tag & HEAP_ZERO) != 0;
+}
+
+static inline heap_block_t* heap_next_block(heap_block_t* block) {
+    return (heap_block_t*)((uintptr_t)block + heap_block_size(block));
+}
+
+/**
+ * Bloque anterior por dirección; solo válido si !heap_prev_used(block)
+ */
+static inline heap_block_t* heap_prev_block(heap_block_t* block) {
+    heap_tag_t prev_size = *(heap_tag_t*)((uintptr_t)block - HEAP_TAG_SIZE);
+    return (heap_block_t*)((uintptr_t)block - prev_size);
+}
+
+static inline heap_tag_t* heap_footer(heap_block_t* block) {
+    return (heap_tag_t*)((uintptr_t)block + heap_block_size(block) - HEAP_TAG_SIZE);
+}
+
+static inline heap_block_t* heap_epilogue(void) {
+    return (heap_block_t*)(heap_current - HEAP_TAG_SIZE);
+}
+
+/**
+ * Calcula el tamaño total de bloque para size bytes de datos
+ * (tag, datos y call site, redondeado a 16 y al mínimo de bloque)
+ */
+static inline size_t heap_block_size_for(size_t size) {
+    size = (size + HEAP_TAG_SIZE + HEAP_SITE_SIZE + HEAP_MIN_ALIGN - 1) & ~(size_t)(HEAP_MIN_ALIGN - 1);
+    return size < HEAP_MIN_BLOCK_SIZE ? HEAP_MIN_BLOCK_SIZE : size;
+}
+
+/**
+ * Bytes de datos utilizables de un bloque ocupado
+ */
+static inline size_t heap_block_payload(heap_block_t* block) {
+    return heap_block_size(block) - HEAP_TAG_SIZE - HEAP_SITE_SIZE;
+}
+
+/**
+ * Marca un bloque como libre con el tamaño dado y escribe su footer
+ * Conserva el flag HEAP_PREV_USED y avisa al bloque siguiente
+ */
+static inline void heap_set_free(heap_block_t* block, size_t size, bool zero) {
+    block->tag = (heap_tag_t)size | (block->tag & HEAP_PREV_USED) | (zero ? HEAP_ZERO : 0);
+    *heap_footer(block) = (heap_tag_t)size;
+    heap_next_block(block)->tag &= ~(heap_tag_t)HEAP_PREV_USED;
+}
+
+/**
+ * Marca un bloque como ocupado con el tamaño dado
+ * Conserva el flag HEAP_PREV_USED y avisa al bloque siguiente
+ */
+static inline void heap_set_used(heap_block_t* block, size_t size) {
+    block->tag = (heap_tag_t)size | HEAP_USED | (block->tag & HEAP_PREV_USED);
+    heap_next_block(block)->tag |= HEAP_PREV_USED;
+}
+
+/**
+ * Calcula la clase a la que pertenece un bloque libre de tamaño size
+ */
+static inline uint32_t heap_bin_index(size_t size) {
+    if (size < HEAP_SMALL_LIMIT) {
+        return size >> HEAP_SMALL_SHIFT;
     }
-    
-    return NULL;
+
+    uint32_t fl = heap_fls(size);
+    uint32_t sl = (size >> (fl - HEAP_SUBBIN_SHIFT)) & (HEAP_SUBBINS - 1);
+    uint32_t index = HEAP_SMALL_BINS + (fl - HEAP_SMALL_LIMIT_SHIFT) * HEAP_SUBBINS + sl;
+
+    return index < HEAP_BIN_COUNT ? index : HEAP_BIN_COUNT - 1;
 }
 
 /**
- * Divide un bloque si es lo suficientemente grande
+ * Calcula la primera clase cuyos bloques son todos >= size
+ * (redondea size hacia arriba al límite de su sub-clase)
  */
-static void heap_split_block(heap_block_t* block, size_t size) {
-    // Solo dividir si el espacio restante es útil
-    if (block->size >= size + HEAP_HEADER_SIZE + HEAP_MIN_BLOCK_SIZE) {
-        // Calcular la dirección del nuevo bloque (alineada)
-        uintptr_t new_block_addr = (uintptr_t)block + HEAP_HEADER_SIZE + size;
-        
-        // Alinear la dirección del nuevo bloque
-        new_block_addr = align_up(new_block_addr, HEAP_MIN_ALIGN);
-        
-        // Recalcular el tamaño del nuevo bloque
-        size_t actual_size = (uintptr_t)new_block_addr - ((uintptr_t)block + HEAP_HEADER_SIZE);
-        
-        // Validar que no se salga del heap y que haya espacio suficiente
-        if (new_block_addr + HEAP_HEADER_SIZE > heap_end ||
-            block->size < actual_size + HEAP_HEADER_SIZE + HEAP_MIN_BLOCK_SIZE) {
-            return; // No dividir si se sale del heap o no hay espacio
+static inline uint32_t heap_bin_index_fit(size_t size) {
+    if (size >= HEAP_SMALL_LIMIT) {
+        size_t round = ((size_t)1 << (heap_fls(size) - HEAP_SUBBIN_SHIFT)) - 1;
+        if (size + round > size) {
+            size += round;
         }
-        
-        heap_block_t* new_block = (heap_block_t*)new_block_addr;
-        
-        // Inicializar el nuevo bloque con ceros primero
-        memset(new_block, 0, sizeof(heap_block_t));
-        
-        new_block->magic = HEAP_MAGIC;
-        new_block->size = block->size - actual_size - HEAP_HEADER_SIZE;
-        new_block->is_free = true;
-        new_block->next = block->next;
-        new_block->prev = block;
-        
-        if (block->next != NULL) {
-            block->next->prev = new_block;
+    }
+    return heap_bin_index(size);
+}
+
+/**
+ * Busca la primera clase no vacía a partir de index
+ * @return Índice de la clase, o HEAP_BIN_COUNT si no hay ninguna
+ */
+static uint32_t heap_bin_find_from(uint32_t index) {
+    uint32_t word = index / 32;
+    uint32_t mask = heap_bin_bitmap[word] & (0xFFFFFFFFU << (index % 32));
+
+    while (mask == 0) {
+        if (++word >= HEAP_BIN_WORDS) {
+            return HEAP_BIN_COUNT;
         }
-        
-        block->next = new_block;
-        block->size = actual_size;
+        mask = heap_bin_bitmap[word];
     }
+
+    return word * 32 + (uint32_t)__builtin_ctz(mask);
 }
 
-// Verifica si dos bloques son contiguos en memoria
-static bool are_contiguous(heap_block_t* a, heap_block_t* b) {
-    return ((uint32_t)a + HEAP_HEADER_SIZE + a->size) == (uint32_t)b;
+/**
+ * Inserta un bloque libre en la lista de su clase
+ */
+static void heap_bin_insert(heap_block_t* block) {
+    uint32_t index = heap_bin_index(heap_block_size(block));
+
+    block->free_prev = NULL;
+    block->free_next = heap_bins[index];
+    if (block->free_next != NULL) {
+        block->free_next->free_prev = block;
+    }
+    heap_bins[index] = block;
+    heap_bin_bitmap[index / 32] |= (1U << (index % 32));
+
+    if (!heap_block_zero(block)) {
+        heap_dirty_blocks++;
+    }
 }
 
+/**
+ * Quita un bloque libre de la lista de su clase
+ * Debe llamarse ANTES de modificar el tamaño del bloque
+ */
+static void heap_bin_remove(heap_block_t* block) {
+    uint32_t index = heap_bin_index(heap_block_size(block));
+
+    if (block->free_prev != NULL) {
+        block->free_prev->free_next = block->free_next;
+    } else {
+        heap_bins[index] = block->free_next;
+    }
+    if (block->free_next != NULL) {
+        block->free_next->free_prev = block->free_prev;
+    }
+    if (heap_bins[index] == NULL) {
+        heap_bin_bitmap[index / 32] &= ~(1U << (index % 32));
+    }
+
+    block->free_next = NULL;
+    block->free_prev = NULL;
+
+    if (!heap_block_zero(block)) {
+        heap_dirty_blocks--;
+    }
+
+    // Si el limpiador idle iba por este bloque, que empiece de nuevo
+    if (block == heap_zero_cursor) {
+        heap_zero_cursor = NULL;
+    }
+}
 
 /**
- * Intenta fusionar un bloque con sus vecinos libres
+ * Encuentra un bloque libre que sea lo suficientemente grande
+ * 
+ * Toma el primer bloque de la primera clase no vacía que garantiza
+ * tamaño >= solicitado. Solo la última clase (bloques muy grandes)
+ * requiere recorrer su lista.
  */
-static void heap_merge_blocks(heap_block_t* block) {
-    if (!block) {
-        return;
+static heap_block_t* heap_find_free_block(size_t size) {
+    uint32_t index = heap_bin_find_from(heap_bin_index_fit(size));
+    if (index >= HEAP_BIN_COUNT) {
+        return NULL;
     }
-    
-    // Validar el magic del bloque actual
-    if (block->magic != HEAP_MAGIC) {
+
+    heap_block_t* current = heap_bins[index];
+    if (index == HEAP_BIN_COUNT - 1) {
+        while (current != NULL && heap_block_size(current) < size) {
+            current = current->free_next;
+        }
+        if (current == NULL) {
+            return NULL;
+        }
+    }
+
+    if (heap_block_used(current) || *heap_footer(current) != heap_block_size(current)) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        vga_write("[HEAP] [ERROR] Intento de fusionar bloque corrupto\n");
-        return;
+        vga_write("[HEAP] [ERROR] Corrupcion detectada en bloque ");
+        vga_write_hex((uint32_t)(uintptr_t)current);
+        vga_write("\n");
+        return NULL;
     }
-    
-    // Fusionar con el siguiente si está libre Y es contiguo
-    if (block->next && block->next->magic == HEAP_MAGIC && 
-        block->next->is_free && are_contiguous(block, block->next)) {
-        heap_block_t* next = block->next;
-        block->size += HEAP_HEADER_SIZE + next->size;
-        block->next = next->next;
-        if (block->next) {
-            block->next->prev = block;
+
+    return current;
+}
+
+/**
+ * Ocupa un bloque libre (ya fuera de su lista) con size bytes
+ * Si el sobrante admite un bloque, se separa y se inserta en su clase
+ * (conserva HEAP_ZERO: su contenido no cambia)
+ *
+ * @param zero Si es true, los datos del bloque ocupado quedan a cero
+ */
+static void heap_use_block(heap_block_t* block, size_t size, bool zero) {
+    size_t block_size = heap_block_size(block);
+    bool was_zero = heap_block_zero(block);
+
+    if (block_size - size >= HEAP_MIN_BLOCK_SIZE) {
+        // El footer del bloque original pasa a ser el del sobrante
+        heap_block_t* rest = (heap_block_t*)((uintptr_t)block + size);
+        rest->tag = HEAP_PREV_USED;
+        heap_set_free(rest, block_size - size, was_zero);
+        heap_set_used(block, size);
+        heap_bin_insert(rest);
+    } else {
+        if (zero && was_zero) {
+            *heap_footer(block) = 0;
+        }
+        heap_set_used(block, block_size);
+    }
+
+    if (zero) {
+        if (was_zero) {
+            // Solo los enlaces de la lista libre ensucian el bloque
+            memset((void*)((uintptr_t)block + HEAP_TAG_SIZE), 0, HEAP_LINKS_SIZE);
+        } else {
+            memset((void*)((uintptr_t)block + HEAP_TAG_SIZE), 0, heap_block_size(block) - HEAP_TAG_SIZE);
         }
-        // Invalidar el magic del bloque fusionado para detectar uso después de fusión
-        next->magic = 0;
     }
+}
+
+/**
+ * Devuelve un bloque al heap fusionándolo con sus vecinos libres
+ * 
+ * Los vecinos se localizan por aritmética de direcciones (tamaño propio
+ * hacia delante, footer del anterior hacia atrás), sin recorrer listas.
+ * El bloque resultante queda sin HEAP_ZERO.
+ */
+static void heap_release_block(heap_block_t* block) {
+    size_t size = heap_block_size(block);
+
+    // Fusionar con el siguiente si está libre
+    heap_block_t* next = heap_next_block(block);
+    if (!heap_block_used(next)) {
+        heap_bin_remove(next);
+        size += heap_block_size(next);
+    }
+
+    // Fusionar con el anterior si está libre
+    if (!heap_prev_used(block)) {
+        heap_block_t* prev = heap_prev_block(block);
+        heap_bin_remove(prev);
+        size += heap_block_size(prev);
+        block = prev;
+    }
+
+    heap_set_free(block, size, false);
+    heap_bin_insert(block);
+}
+
+/**
+ * Respalda con marcos del PMM el rango virtual del heap hasta end
+ * Se mapea por lotes; si falla a mitad, los lotes ya mapeados se quedan
+ * (servirán al siguiente intento o los devolverá heap_shrink)
+ *
+ * @return true si todo el rango hasta end queda mapeado
+ */
+static bool heap_map_until(uintptr_t end) {
+    end = align_up(end, PAGE_SIZE);
 
-    // Fusionar con el anterior si está libre Y es contiguo
-    if (block->prev && block->prev->magic == HEAP_MAGIC && 
-        block->prev->is_free && are_contiguous(block->prev, block)) {
-        // Guardar referencias necesarias antes de fusionar
-        heap_block_t* prev_block = block->prev;
-        heap_block_t* next_block = block->next;
-        
-        prev_block->size += HEAP_HEADER_SIZE + block->size;
-        prev_block->next = next_block;
-        if (next_block) {
-            next_block->prev = prev_block;
+    while (heap_mapped_end < end) {
+        phys_addr_t frames[PMM_BATCH_PAGES];
+        uint32_t wanted = (end - heap_mapped_end) / PAGE_SIZE;
+        if (wanted > PMM_BATCH_PAGES) {
+            wanted = PMM_BATCH_PAGES;
         }
-        // Invalidar el magic del bloque fusionado
-        block->magic = 0;
-        // No usar 'block' después de este punto, ya fue fusionado
+
+        // El heap solo se accede por su mapeo: memoria alta primero
+        uint32_t got = pmm_alloc_batch(wanted, frames, ZONE_HIGH);
+        if (got > 0 && vmm_map_range(vmm_get_kernel_directory(), (uint32_t)heap_mapped_end, frames, 0, got,
+                                     PAGE_PRESENT | PAGE_WRITE | PAGE_NX) == E_OK) {
+            heap_mapped_end += (uintptr_t)got * PAGE_SIZE;
+        } else {
+            // El lote no quedó mapeado: vuelve al PMM
+            for (uint32_t i = 0; i < got; i++) {
+                pmm_free_page(frames[i]);
+            }
+            return false;
+        }
+        if (got < wanted) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Desmapea las páginas del heap desde start (alineado a página) y
+ * devuelve sus marcos al PMM
+ */
+static void heap_unmap_from(uintptr_t start) {
+    if (heap_mapped_end > start) {
+        vmm_unmap_range(vmm_get_kernel_directory(), (uint32_t)start,
+                        (uint32_t)((heap_mapped_end - start) / PAGE_SIZE), true);
+        heap_mapped_end = start;
     }
 }
 
 /**
  * Expande el heap asignando más páginas
  * 
- * NOTA: Con identity mapping, solo podemos usar páginas que ya estén mapeadas.
- * Por ahora, usamos el espacio virtual pre-mapeado y asignamos páginas físicas
- * de la región baja de memoria.
+ * Las páginas nuevas se piden al PMM y se mapean en el rango virtual
+ * reservado para el heap, así que no necesitan ser contiguas en memoria
+ * física.
+ *
+ * El epílogo actual pasa a ser el tag del bloque nuevo y se escribe uno
+ * nuevo al final. Si el último bloque estaba libre, solo se crece lo que
+ * le falta y se fusionan.
+ *
+ * @param size Tamaño total de bloque necesario (múltiplo de 16)
+ * @return Bloque libre de al menos size bytes (ya insertado en su
+ *         clase), o NULL si no queda espacio
  */
-static bool heap_expand(size_t needed_size) {
-    // Protección contra integer overflow
-    if (needed_size > (SIZE_MAX - HEAP_HEADER_SIZE)) {
-        if (is_kdebug()) {
-            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-            vga_write("[HEAP] [DEBUG] needed_size causa overflow\n");
+static heap_block_t* heap_expand(size_t size) {
+    heap_block_t* block = heap_epilogue();
+    heap_block_t* last = NULL;
+    size_t grow = size;
+
+    if (!heap_prev_used(block)) {
+        last = heap_prev_block(block);
+        if (heap_block_size(last) >= size) {
+            return last;  // Ya cabe (la clase redondeada lo había descartado)
         }
-        return false;
+        grow = size - heap_block_size(last);
     }
-    
-    size_t total_needed = needed_size + HEAP_HEADER_SIZE;
-    size_t pages_needed = (total_needed + PAGE_SIZE - 1) / PAGE_SIZE;
-    size_t expand_size = pages_needed * PAGE_SIZE;
 
-    // Validar overflow en la suma
-    if (heap_current > heap_end || expand_size > (heap_end - heap_current)) {
+    // Crecer en páginas completas; la última puede quedar parcial
+    size_t available = heap_current <= heap_end ? heap_end - heap_current : 0;
+    available &= ~(size_t)HEAP_FLAG_MASK;
+    if (grow > available) {
         if (is_kdebug()) {
             vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
             vga_write("[HEAP] [DEBUG] heap overflow\n");
         }
-        return false;
+        return NULL;
+    }
+
+    size_t expand_size = align_up(grow, PAGE_SIZE);
+    if (expand_size > available) {
+        expand_size = available;
     }
 
     if (is_kdebug()) {
         vga_write("[HEAP] Expandiendo heap: ");
-        vga_write_dec(pages_needed);
+        vga_write_dec((expand_size + PAGE_SIZE - 1) / PAGE_SIZE);
         vga_write(" paginas\n");
     }
 
-    // Si no hay bloques todavía, crear el primero
-    if (heap_first_block == NULL) {
-        // Asegurar que heap_current esté alineado
-        heap_current = align_up(heap_current, HEAP_MIN_ALIGN);
-        
-        // CRÍTICO: Limpiar toda la región de memoria antes de usarla
-        memset((void*)heap_current, 0, expand_size);
-        
-        heap_block_t* block = (heap_block_t*)heap_current;
-        block->magic = HEAP_MAGIC;
-        block->size = expand_size - HEAP_HEADER_SIZE;
-        block->is_free = true;
-        block->next = NULL;
-        block->prev = NULL;
-
-        heap_first_block = block;
-        heap_current += expand_size;
-        return true;
+    if (!heap_map_until(heap_current + expand_size)) {
+        if (is_kdebug()) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            vga_write("[HEAP] [DEBUG] Sin marcos fisicos para expandir el heap\n");
+        }
+        return NULL;
     }
 
-    // Buscar el último bloque
-    heap_block_t* last = heap_first_block;
-    while (last->next) {
-        last = last->next;
+    // El epílogo viejo es el tag del bloque nuevo; la región nueva no se
+    // limpia (el bloque queda sin HEAP_ZERO)
+    block->tag = (heap_tag_t)expand_size | (block->tag & HEAP_PREV_USED);
+    heap_current += expand_size;
+    heap_epilogue()->tag = HEAP_USED;
+
+    if (last != NULL) {
+        heap_bin_remove(last);
+        expand_size += heap_block_size(last);
+        block = last;
     }
 
-    // Si el último bloque es libre y está al final del heap, extenderlo
-    uintptr_t last_end =
-        (uintptr_t)last + HEAP_HEADER_SIZE + last->size;
+    heap_set_free(block, expand_size, false);
+    heap_bin_insert(block);
+    return block;
+}
 
-    if (last->is_free && last_end == heap_current) {
-        // CRÍTICO: Limpiar la nueva región de memoria que se va a agregar
-        memset((void*)heap_current, 0, expand_size);
-        
-        last->size += expand_size;
-        heap_current += expand_size;
-        return true;
+
+/**
+ * Lee el call site guardado al final de un bloque ocupado
+ */
+static inline uint32_t heap_block_site(heap_block_t* block) {
+    if (!HEAP_PROFILING) {
+        return 0;
     }
+    return *(uint32_t*)((uintptr_t)block + heap_block_size(block) - HEAP_SITE_SIZE);
+}
 
-    // Si no, crear un bloque nuevo
-    // Asegurar que heap_current esté alineado
-    heap_current = align_up(heap_current, HEAP_MIN_ALIGN);
-    
-    // CRÍTICO: Limpiar toda la región de memoria antes de usarla
-    memset((void*)heap_current, 0, expand_size);
-    
-    heap_block_t* new_block = (heap_block_t*)heap_current;
-    new_block->magic = HEAP_MAGIC;
-    new_block->size = expand_size - HEAP_HEADER_SIZE;
-    new_block->is_free = true;
-    new_block->next = NULL;
-    new_block->prev = last;
-
-    last->next = new_block;
-    heap_current += expand_size;
-    return true;
+/**
+ * Busca (o crea) la entrada de un call site
+ */
+static heap_site_stats_t* heap_site_entry(uint32_t site) {
+    uint32_t index = (site >> 2) % HEAP_PROFILE_SITES;
+
+    for (uint32_t probe = 0; probe < HEAP_PROFILE_SITES; probe++) {
+        heap_site_stats_t* entry = &heap_sites[index];
+        if (entry->site == site) {
+            return entry;
+        }
+        if (entry->site == 0) {
+            entry->site = site;
+            return entry;
+        }
+        index = (index + 1) % HEAP_PROFILE_SITES;
+    }
+
+    return &heap_site_other;
+}
+
+/**
+ * Anota un bloque recién ocupado en los contadores (y su call site)
+ */
+static void heap_account_alloc(heap_block_t* block, uint32_t site) {
+    size_t size = heap_block_size(block);
+
+    heap_used_bytes += size;
+    heap_used_blocks++;
+    heap_alloc_count++;
+
+    if (HEAP_PROFILING) {
+        *(uint32_t*)((uintptr_t)block + size - HEAP_SITE_SIZE) = site;
+        heap_site_stats_t* entry = heap_site_entry(site);
+        entry->live_bytes += size;
+        entry->live_count++;
+        entry->total_count++;
+    }
+}
+
+/**
+ * Descuenta un bloque ocupado que se va a liberar
+ */
+static void heap_account_free(heap_block_t* block) {
+    size_t size = heap_block_size(block);
+
+    heap_used_bytes -= size;
+    heap_used_blocks--;
+    heap_free_count++;
+
+    if (HEAP_PROFILING) {
+        heap_site_stats_t* entry = heap_site_entry(heap_block_site(block));
+        entry->live_bytes -= size;
+        entry->live_count--;
+    }
 }
 
+/**
+ * Actualiza los contadores de un bloque ocupado que cambió de tamaño en
+ * su sitio y vuelve a escribir su call site al final
+ */
+static void heap_account_resize(heap_block_t* block, size_t old_size, uint32_t site) {
+    size_t size = heap_block_size(block);
+
+    heap_used_bytes = heap_used_bytes - old_size + size;
+
+    if (HEAP_PROFILING) {
+        *(uint32_t*)((uintptr_t)block + size - HEAP_SITE_SIZE) = site;
+        heap_site_stats_t* entry = heap_site_entry(site);
+        entry->live_bytes = entry->live_bytes - old_size + size;
+    }
+}
 
 /**
  * Inicializa el heap del kernel
@@ -282,11 +629,30 @@ int heap_init(uint32_t start, uint32_t size, bool kdebug __attribute__((unused))
         vga_write("[HEAP] Inicializando heap del kernel...\n");
     }
     
-    // Asegurar que el heap comience alineado a 16 bytes
-    heap_start = align_up(start, HEAP_MIN_ALIGN);
+    // El heap empieza en un límite de página: sus páginas se mapean bajo demanda
+    heap_start = align_up(start, PAGE_SIZE);
     heap_end = start + size;
-    heap_current = heap_start;
-    heap_first_block = NULL;
+    heap_mapped_end = heap_start;
+    memset(heap_bins, 0, sizeof(heap_bins));
+    memset(heap_bin_bitmap, 0, sizeof(heap_bin_bitmap));
+    heap_dirty_blocks = 0;
+    heap_zero_cursor = NULL;
+    heap_used_bytes = 0;
+    heap_used_blocks = 0;
+    heap_alloc_count = 0;
+    heap_free_count = 0;
+    memset(heap_sites, 0, sizeof(heap_sites));
+    memset(&heap_site_other, 0, sizeof(heap_site_other));
+
+    // Relleno de 12 bytes y epílogo inicial: el primer tag queda en una
+    // dirección ≡ 12 (mod 16) y sus datos alineados a 16
+    heap_current = heap_start + HEAP_MIN_ALIGN;
+    if (!heap_map_until(heap_current)) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[HEAP] [FAIL] No se pudo mapear la primera pagina del heap\n");
+        return E_NOMEM;
+    }
+    heap_epilogue()->tag = HEAP_USED | HEAP_PREV_USED;
     
     if (is_kdebug()) {
         vga_write("[HEAP] Rango: ");
@@ -317,10 +683,8 @@ int heap_init(uint32_t start, uint32_t size, bool kdebug __attribute__((unused))
 /**
  * Asignación simple antes de que el heap esté completamente inicializado
  */
-static void* kmalloc_early(size_t size, bool align, uint32_t* phys) {
-    if (align) {
-        heap_current = align_up(heap_current, PAGE_SIZE);
-    }
+static void* kmalloc_early(size_t size, size_t align, phys_addr_t* phys) {
+    heap_current = align_up(heap_current, align);
     
     if (heap_current + size > heap_end) {
         return NULL;
@@ -337,107 +701,271 @@ static void* kmalloc_early(size_t size, bool align, uint32_t* phys) {
 }
 
 /**
- * Asigna memoria del heap del kernel
+ * Separa del principio de un bloque libre (ya fuera de su lista) el hueco
+ * necesario para que sus datos queden alineados a align
+ *
+ * El hueco vuelve a su lista libre como bloque propio (es 0 o al menos
+ * HEAP_MIN_BLOCK_SIZE). Su vecino anterior está ocupado porque el bloque
+ * original era libre, así que no hay nada que fusionar.
+ *
+ * @return Bloque libre alineado, fuera de toda lista
  */
-void* kmalloc(size_t size) {
-    if (size == 0) {
+static heap_block_t* heap_align_block(heap_block_t* block, size_t align) {
+    uintptr_t data = align_up((uintptr_t)block + HEAP_TAG_SIZE, align);
+    while (data != (uintptr_t)block + HEAP_TAG_SIZE &&
+           data - HEAP_TAG_SIZE - (uintptr_t)block < HEAP_MIN_BLOCK_SIZE) {
+        data += align;
+    }
+
+    size_t lead = data - HEAP_TAG_SIZE - (uintptr_t)block;
+    if (lead == 0) {
+        return block;
+    }
+
+    size_t block_size = heap_block_size(block);
+    bool was_zero = heap_block_zero(block);
+
+    heap_set_free(block, lead, was_zero);
+    heap_bin_insert(block);
+
+    heap_block_t* aligned = (heap_block_t*)(data - HEAP_TAG_SIZE);
+    aligned->tag = 0;  // El anterior (el hueco) está libre
+    heap_set_free(aligned, block_size - lead, was_zero);
+    return aligned;
+}
+
+/**
+ * Asigna un bloque del heap
+ * @param align Alineación de los datos (potencia de dos)
+ * @param zero Si es true, los datos se devuelven a cero
+ * @param site Dirección de retorno de quien pide la memoria
+ */
+static void* heap_alloc(size_t size, size_t align, bool zero, uint32_t site) {
+    if (size == 0 || (align & (align - 1)) != 0) {
         return NULL;
     }
+    if (align < HEAP_MIN_ALIGN) {
+        align = HEAP_MIN_ALIGN;
+    }
     
     // Si el heap no está inicializado, usar asignación simple
+    // (la memoria previa al heap no se ha usado nunca)
     if (!heap_initialized) {
-        return kmalloc_early(size, false, NULL);
+        void* ptr = kmalloc_early(size, align, NULL);
+        if (ptr != NULL && zero) {
+            memset(ptr, 0, size);
+        }
+        return ptr;
+    }
+    
+    // Los buffers grandes van a kvmalloc (alineados a página) para no
+    // fragmentar el heap; si kvmalloc falla, se intenta con el heap
+    if (size >= KMALLOC_LARGE_THRESHOLD && align <= PAGE_SIZE) {
+        void* ptr = zero ? kvzalloc(size) : kvmalloc(size);
+        if (ptr != NULL) {
+            return ptr;
+        }
     }
     
-    // Alinear el tamaño
-    size = align_up(size, HEAP_MIN_ALIGN);
+    // Tamaño total del bloque: tag + datos + call site, redondeado a 16
+    if (size > heap_end - heap_start || align > heap_end - heap_start) {
+        return NULL;
+    }
+    size = heap_block_size_for(size);
+    
+    // Con alineación extra, buscar un bloque que admita el peor hueco
+    // inicial; el hueco se devuelve a las listas libres
+    size_t search = size;
+    if (align > HEAP_MIN_ALIGN) {
+        search += align + HEAP_MIN_BLOCK_SIZE - HEAP_MIN_ALIGN;
+    }
     
     // Buscar un bloque libre
-    heap_block_t* block = heap_find_free_block(size);
+    heap_block_t* block = heap_find_free_block(search);
     
     // Si no hay bloque, expandir el heap
     if (block == NULL) {
-        if (!heap_expand(size)) {
-            return NULL;
-        }
-        block = heap_find_free_block(size);
+        block = heap_expand(search);
         if (block == NULL) {
             return NULL;
         }
     }
     
-    // Marcar como ocupado
-    block->is_free = false;
-    
-    // Dividir si es necesario
-    heap_split_block(block, size);
-    
-    // Retornar puntero a los datos (después del header)
-    void* ptr = (void*)((uint32_t)block + HEAP_HEADER_SIZE);
-    
-    // NOTA: No necesitamos memset aquí porque:
-    // 1. heap_expand ya limpia la memoria cuando se crean nuevos bloques
-    // 2. kfree limpia la memoria cuando se libera
-    // Por lo tanto, todos los bloques libres ya están limpios
+    // Sacarlo de su lista libre, alinearlo, marcarlo como ocupado y
+    // separar el sobrante
+    heap_bin_remove(block);
+    if (align > HEAP_MIN_ALIGN) {
+        block = heap_align_block(block, align);
+    }
+    heap_use_block(block, size, zero);
+    heap_account_alloc(block, site);
     
+    return (void*)((uintptr_t)block + HEAP_TAG_SIZE);
+}
+
+/**
+ * Obtiene la dirección física de un bloque recién asignado
+ * Si no se puede traducir, libera el bloque y devuelve NULL
+ *
+ * Las páginas del heap no son contiguas en memoria física: el bloque no
+ * debe cruzar un límite de página (ver heap_alloc_physical)
+ */
+static void* heap_with_physical(void* ptr, phys_addr_t* phys) {
+    if (ptr == NULL || phys == NULL) {
+        return ptr;
+    }
+
+    phys_addr_t physical = vmm_get_physical(vmm_get_kernel_directory(), (uint32_t)(uintptr_t)ptr);
+    if (physical == 0) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[HEAP] [ERROR] No se pudo obtener direccion fisica\n");
+        kfree(ptr);
+        return NULL;
+    }
+    *phys = physical;
     return ptr;
 }
 
+/**
+ * Asigna un bloque del buddy en ZONE_LOW (contiguo e identity-mapped)
+ * El primer marco lleva PAGE_FRAME_CONTIG y el orden en link para que
+ * kfree sepa devolverlo al PMM
+ */
+static void* heap_alloc_contiguous(size_t size, phys_addr_t* phys) {
+    uint32_t order = 0;
+    while ((size_t)(PAGE_SIZE << order) < size) {
+        if (++order > PMM_MAX_ORDER) {
+            return NULL;
+        }
+    }
+
+    phys_addr_t addr = pmm_alloc_pages_zone(order, ZONE_LOW);
+    if (addr == 0) {
+        return NULL;
+    }
+    page_t* page = pmm_get_page(addr);
+    page->flags |= PAGE_FRAME_CONTIG;
+    page->link = order;
+
+    if (phys != NULL) {
+        *phys = addr;
+    }
+    return (void*)(uintptr_t)addr;
+}
+
+/**
+ * Asigna memoria cuya dirección física es válida para todo el bloque
+ *
+ * Hasta una página sale del heap, alineada a la potencia de dos que cubre
+ * el tamaño para que no cruce un límite de página. Lo que no cabe en una
+ * página necesita marcos contiguos y se pide al buddy en ZONE_LOW.
+ */
+static void* heap_alloc_physical(size_t size, size_t align, phys_addr_t* phys, uint32_t site) {
+    if (size == 0 || (align & (align - 1)) != 0) {
+        return NULL;
+    }
+
+    if (size <= PAGE_SIZE) {
+        size_t natural = HEAP_MIN_ALIGN;
+        while (natural < size) {
+            natural <<= 1;
+        }
+        return heap_with_physical(heap_alloc(size, align > natural ? align : natural, false, site), phys);
+    }
+    if (align > PAGE_SIZE << PMM_MAX_ORDER) {
+        return NULL;
+    }
+
+    // Los bloques del buddy están alineados a su tamaño
+    return heap_alloc_contiguous(size > align ? size : align, phys);
+}
+
+/**
+ * Asigna memoria del heap del kernel (contenido indefinido)
+ */
+void* kmalloc(size_t size) {
+    return heap_alloc(size, HEAP_MIN_ALIGN, false, HEAP_CALLER());
+}
+
+/**
+ * Asigna memoria del heap del kernel llena de ceros
+ */
+void* kzalloc(size_t size) {
+    return heap_alloc(size, HEAP_MIN_ALIGN, true, HEAP_CALLER());
+}
+
+/**
+ * Asigna memoria para un array de count elementos llena de ceros
+ */
+void* kcalloc(size_t count, size_t size) {
+    if (size != 0 && count > (size_t)-1 / size) {
+        return NULL;  // count * size desborda
+    }
+    return heap_alloc(count * size, HEAP_MIN_ALIGN, true, HEAP_CALLER());
+}
+
+/**
+ * Asigna memoria con los datos alineados a align bytes
+ */
+void* kmalloc_aligned(size_t size, size_t align) {
+    return heap_alloc(size, align, false, HEAP_CALLER());
+}
+
 /**
  * Asigna memoria alineada a página
  */
 void* kmalloc_a(size_t size) {
-    if (!heap_initialized) {
-        return kmalloc_early(size, true, NULL);
-    }
-    
-    // Por simplicidad, asignar tamaño múltiplo de página
-    size = align_up(size, PAGE_SIZE);
-    return kmalloc(size);
+    return heap_alloc(size, PAGE_SIZE, false, HEAP_CALLER());
 }
 
 /**
  * Asigna memoria y devuelve la dirección física
  */
-void* kmalloc_p(size_t size, uint32_t* phys) {
+void* kmalloc_p(size_t size, phys_addr_t* phys) {
     if (!heap_initialized) {
-        return kmalloc_early(size, false, phys);
-    }
-    
-    void* ptr = kmalloc(size);
-    if (ptr != NULL && phys != NULL) {
-        uint32_t physical = vmm_get_physical(vmm_get_kernel_directory(), (uint32_t)ptr);
-        if (physical == 0) {
-            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-            vga_write("[HEAP] [ERROR] No se pudo obtener direccion fisica\n");
-            kfree(ptr);
-            return NULL;
-        }
-        *phys = physical;
+        return kmalloc_early(size, HEAP_MIN_ALIGN, phys);
     }
-    return ptr;
+    return heap_alloc_physical(size, HEAP_MIN_ALIGN, phys, HEAP_CALLER());
 }
 
 /**
- * Asigna memoria alineada y devuelve la dirección física
+ * Asigna memoria alineada a página y devuelve la dirección física
  */
-void* kmalloc_ap(size_t size, uint32_t* phys) {
+void* kmalloc_ap(size_t size, phys_addr_t* phys) {
     if (!heap_initialized) {
-        return kmalloc_early(size, true, phys);
+        return kmalloc_early(size, PAGE_SIZE, phys);
     }
-    
-    void* ptr = kmalloc_a(size);
-    if (ptr != NULL && phys != NULL) {
-        uint32_t physical = vmm_get_physical(vmm_get_kernel_directory(), (uint32_t)ptr);
-        if (physical == 0) {
-            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-            vga_write("[HEAP] [ERROR] No se pudo obtener direccion fisica\n");
-            kfree(ptr);
-            return NULL;
-        }
-        *phys = physical;
+    return heap_alloc_physical(size, PAGE_SIZE, phys, HEAP_CALLER());
+}
+
+/**
+ * Verifica que un puntero de datos y su tag sean coherentes con el heap
+ * (dentro del rango, alineado, tamaño posible y HEAP_PREV_USED del
+ * siguiente bloque de acuerdo con su estado)
+ */
+static bool heap_valid_pointer(uintptr_t addr) {
+    heap_block_t* block = (heap_block_t*)(addr - HEAP_TAG_SIZE);
+
+    return addr >= heap_start + HEAP_MIN_ALIGN && addr < heap_current &&
+           (addr & HEAP_FLAG_MASK) == 0 &&
+           heap_block_size(block) >= HEAP_MIN_BLOCK_SIZE &&
+           heap_block_size(block) <= heap_current - HEAP_TAG_SIZE - (uintptr_t)block &&
+           !heap_prev_used(heap_next_block(block)) == !heap_block_used(block);
+}
+
+/**
+ * Indica si una dirección es un bloque de heap_alloc_contiguous
+ * Devuelve su descriptor o NULL
+ */
+static page_t* heap_contiguous_page(uintptr_t addr) {
+    if (addr >= KERNEL_IDENTITY_END || (addr & PAGE_OFFSET_MASK) != 0) {
+        return NULL;
     }
-    return ptr;
+    page_t* page = pmm_get_page(addr);
+    if (page == NULL || page->refcount == 0 || !(page->flags & PAGE_FRAME_CONTIG)) {
+        return NULL;
+    }
+    return page;
 }
 
 /**
@@ -448,25 +976,426 @@ void kfree(void* ptr) {
         return;
     }
     
-    // Obtener el bloque a partir del puntero
-    heap_block_t* block = (heap_block_t*)((uint32_t)ptr - HEAP_HEADER_SIZE);
-    
-    // Verificar magic
-    if (block->magic != HEAP_MAGIC) {
+    uintptr_t addr = (uintptr_t)ptr;
+    if (addr >= KERNEL_KV_START && addr - KERNEL_KV_START < KERNEL_KV_SIZE) {
+        kvfree(ptr);
+        return;
+    }
+    page_t* page = heap_contiguous_page(addr);
+    if (page != NULL) {
+        pmm_free_pages(addr, page->link);
+        return;
+    }
+
+    heap_block_t* block = (heap_block_t*)(addr - HEAP_TAG_SIZE);
+    if (!heap_valid_pointer(addr)) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
         vga_write("[HEAP] [ERROR] kfree con puntero invalido: ");
-        vga_write_hex((uint32_t)ptr);
+        vga_write_hex((uint32_t)addr);
         vga_write("\n");
         return;
     }
+
+    // Un bloque libre ya está en una lista: liberarlo dos veces la corrompería
+    if (!heap_block_used(block)) {
+        if (is_kdebug()) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            vga_write("[HEAP] [WARN] Double free detectado: ");
+            vga_write_hex((uint32_t)addr);
+            vga_write("\n");
+        }
+        return;
+    }
     
-    // CRÍTICO: Limpiar la memoria antes de liberarla para evitar
-    // que datos viejos contaminen futuras asignaciones
-    memset(ptr, 0, block->size);
-    
-    // Marcar como libre
-    block->is_free = true;
-    
-    // Fusionar con bloques vecinos si están libres
-    heap_merge_blocks(block);
+    // Sin memset: el bloque queda sin HEAP_ZERO y lo limpiará kzalloc o
+    // el proceso idle. Fusionar con vecinos libres y reinsertar en su clase
+    heap_account_free(block);
+    heap_release_block(block);
+}
+
+/**
+ * Cambia el tamaño de un bloque ocupado sin moverlo
+ *
+ * Para encoger separa la cola y la libera (fusionándola con el siguiente
+ * si está libre). Para crecer absorbe el bloque siguiente si está libre y
+ * es suficiente; si el bloque es el último del heap, antes expande el
+ * heap lo que falte.
+ *
+ * @param size Nuevo tamaño total del bloque (múltiplo de 16)
+ * @return true si el bloque tiene ahora al menos size bytes
+ */
+static bool heap_resize_block(heap_block_t* block, size_t size) {
+    size_t current = heap_block_size(block);
+
+    if (size <= current) {
+        if (current - size >= HEAP_MIN_BLOCK_SIZE) {
+            heap_block_t* tail = (heap_block_t*)((uintptr_t)block + size);
+            tail->tag = (heap_tag_t)(current - size) | HEAP_USED | HEAP_PREV_USED;
+            block->tag = (heap_tag_t)size | HEAP_USED | (block->tag & HEAP_PREV_USED);
+            heap_release_block(tail);
+        }
+        return true;
+    }
+
+    heap_block_t* next = heap_next_block(block);
+    bool next_free = !heap_block_used(next);
+
+    // Al final del heap se puede crecer lo que falte
+    if (next == heap_epilogue() ||
+        (next_free && heap_next_block(next) == heap_epilogue())) {
+        size_t available = current + (next_free ? heap_block_size(next) : 0);
+        if (available < size && heap_expand(size - current) == NULL) {
+            return false;
+        }
+        next = heap_next_block(block);
+        next_free = !heap_block_used(next);
+    }
+
+    if (!next_free || current + heap_block_size(next) < size) {
+        return false;
+    }
+
+    size_t combined = current + heap_block_size(next);
+    heap_bin_remove(next);
+
+    if (combined - size >= HEAP_MIN_BLOCK_SIZE) {
+        heap_block_t* rest = (heap_block_t*)((uintptr_t)block + size);
+        rest->tag = HEAP_PREV_USED;
+        heap_set_free(rest, combined - size, false);
+        heap_set_used(block, size);
+        heap_bin_insert(rest);
+    } else {
+        heap_set_used(block, combined);
+    }
+
+    return true;
+}
+
+/**
+ * Cambia el tamaño de una asignación
+ */
+void* krealloc(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return kmalloc(size);
+    }
+    if (size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+    if (!heap_initialized) {
+        return NULL;
+    }
+
+    uintptr_t addr = (uintptr_t)ptr;
+    if (addr >= KERNEL_KV_START && addr - KERNEL_KV_START < KERNEL_KV_SIZE) {
+        return kvrealloc(ptr, size);
+    }
+
+    // Los bloques contiguos de kmalloc_p/kmalloc_ap se mueven al heap
+    page_t* page = heap_contiguous_page(addr);
+    if (page != NULL) {
+        size_t old_size = (size_t)PAGE_SIZE << page->link;
+        void* new_ptr = heap_alloc(size, HEAP_MIN_ALIGN, false, HEAP_CALLER());
+        if (new_ptr == NULL) {
+            return NULL;
+        }
+        memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+        pmm_free_pages(addr, page->link);
+        return new_ptr;
+    }
+
+    heap_block_t* block = (heap_block_t*)(addr - HEAP_TAG_SIZE);
+    if (!heap_valid_pointer(addr) || !heap_block_used(block)) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[HEAP] [ERROR] krealloc con puntero invalido: ");
+        vga_write_hex((uint32_t)addr);
+        vga_write("\n");
+        return NULL;
+    }
+
+    // El bloque conserva su call site aunque cambie de tamaño o se mueva
+    size_t old_block_size = heap_block_size(block);
+    uint32_t site = heap_block_site(block);
+
+    if (size <= heap_end - heap_start &&
+        heap_resize_block(block, heap_block_size_for(size))) {
+        heap_account_resize(block, old_block_size, site);
+        return ptr;
+    }
+
+    // No cabe en su sitio: mover (buffers grandes acaban en kvmalloc)
+    size_t old_size = heap_block_payload(block);
+    void* new_ptr = heap_alloc(size, HEAP_MIN_ALIGN, false, site);
+    if (new_ptr == NULL) {
+        return NULL;  // El bloque original sigue siendo válido
+    }
+
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    kfree(ptr);
+    return new_ptr;
+}
+
+/**
+ * Devuelve al PMM las páginas completamente libres del final del heap
+ *
+ * Recorta el último bloque (si está libre) hasta el primer límite de
+ * página en el que quepa, mueve allí el epílogo y desmapea el resto.
+ * Siempre se conserva al menos la primera página.
+ */
+size_t heap_shrink(void) {
+    if (!heap_initialized) {
+        return 0;
+    }
+
+    heap_block_t* epilogue = heap_epilogue();
+    if (heap_prev_used(epilogue)) {
+        return 0;  // El último bloque está ocupado
+    }
+
+    heap_block_t* last = heap_prev_block(epilogue);
+    uintptr_t last_start = (uintptr_t)last;
+
+    // Nuevo final: el epílogo queda en el tag del último bloque (si cae
+    // justo en un límite de página) o tras un bloque libre mínimo
+    uintptr_t keep = align_up(last_start + HEAP_TAG_SIZE, PAGE_SIZE);
+    if (keep != last_start + HEAP_TAG_SIZE &&
+        keep - HEAP_TAG_SIZE - last_start < HEAP_MIN_BLOCK_SIZE) {
+        keep += PAGE_SIZE;
+    }
+    if (keep >= heap_current) {
+        return 0;  // No hay ninguna página completa que devolver
+    }
+
+    bool was_zero = heap_block_zero(last);
+    heap_bin_remove(last);
+
+    heap_current = keep;
+    if (keep == last_start + HEAP_TAG_SIZE) {
+        // El bloque desaparece; su anterior siempre está ocupado
+        heap_epilogue()->tag = HEAP_USED | HEAP_PREV_USED;
+    } else {
+        heap_epilogue()->tag = HEAP_USED;
+        heap_set_free(last, keep - HEAP_TAG_SIZE - last_start, was_zero);
+        heap_bin_insert(last);
+    }
+
+    size_t released = heap_mapped_end - keep;
+    heap_unmap_from(keep);
+
+    if (is_kdebug()) {
+        vga_write("[HEAP] Devueltas ");
+        vga_write_dec(released / PAGE_SIZE);
+        vga_write(" paginas al PMM\n");
+    }
+
+    return released;
+}
+
+/**
+ * Busca un bloque libre sin HEAP_ZERO, empezando por las clases grandes
+ */
+static heap_block_t* heap_find_dirty_block(void) {
+    for (int32_t index = HEAP_BIN_COUNT - 1; index >= 0; index--) {
+        if ((heap_bin_bitmap[index / 32] & (1U << (index % 32))) == 0) {
+            continue;
+        }
+        for (heap_block_t* block = heap_bins[index]; block != NULL; block = block->free_next) {
+            if (!heap_block_zero(block)) {
+                return block;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Limpia un fragmento de un bloque libre en tiempo idle
+ */
+bool heap_idle_zero(void) {
+    if (!heap_initialized || heap_dirty_blocks == 0) {
+        return false;
+    }
+
+    heap_block_t* block = heap_zero_cursor;
+    if (block == NULL) {
+        block = heap_find_dirty_block();
+        if (block == NULL) {
+            return false;
+        }
+        heap_zero_cursor = block;
+        heap_zero_offset = sizeof(heap_block_t);  // Tras tag y enlaces
+    }
+
+    // Limpiar hasta el footer como mucho HEAP_IDLE_ZERO_CHUNK bytes
+    size_t end = heap_block_size(block) - HEAP_TAG_SIZE;
+    size_t chunk = end > heap_zero_offset ? end - heap_zero_offset : 0;
+    if (chunk > HEAP_IDLE_ZERO_CHUNK) {
+        chunk = HEAP_IDLE_ZERO_CHUNK;
+    }
+    memset((void*)((uintptr_t)block + heap_zero_offset), 0, chunk);
+    heap_zero_offset += chunk;
+
+    if (heap_zero_offset >= end) {
+        block->tag |= HEAP_ZERO;
+        heap_dirty_blocks--;
+        heap_zero_cursor = NULL;
+    }
+
+    return true;
+}
+
+/**
+ * Obtiene las estadísticas del heap
+ */
+void heap_get_stats(heap_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(heap_stats_t));
+    kvmalloc_get_stats(&stats->kv_areas, &stats->kv_pages);
+    if (!heap_initialized) {
+        return;
+    }
+
+    stats->heap_size = (uint32_t)(heap_current - heap_start);
+    stats->mapped_bytes = (uint32_t)(heap_mapped_end - heap_start);
+    stats->used_bytes = heap_used_bytes;
+    stats->used_blocks = heap_used_blocks;
+    stats->alloc_count = heap_alloc_count;
+    stats->free_count = heap_free_count;
+
+    // Fragmentación: todas las listas libres juntas contienen todos los
+    // bloques libres
+    for (uint32_t index = 0; index < HEAP_BIN_COUNT; index++) {
+        for (heap_block_t* block = heap_bins[index]; block != NULL; block = block->free_next) {
+            uint32_t size = (uint32_t)heap_block_size(block);
+            uint32_t bucket = heap_fls(size >> HEAP_SMALL_SHIFT);
+            if (bucket >= HEAP_HISTOGRAM_BUCKETS) {
+                bucket = HEAP_HISTOGRAM_BUCKETS - 1;
+            }
+
+            stats->free_bytes += size;
+            stats->free_blocks++;
+            stats->free_histogram[bucket]++;
+            if (size > stats->largest_free) {
+                stats->largest_free = size;
+            }
+        }
+    }
+
+    // 100 - largest * 100 / total, sin desbordar con heaps grandes
+    if (stats->free_bytes >= 100) {
+        stats->fragmentation = 100 - stats->largest_free / (stats->free_bytes / 100);
+        if (stats->fragmentation > 100) {
+            stats->fragmentation = 0;  // Redondeo cuando solo hay un bloque
+        }
+    }
+
+    // Selección de los call sites con más bytes vivos
+    for (uint32_t i = 0; i < HEAP_PROFILE_SITES + 1; i++) {
+        heap_site_stats_t* entry = i < HEAP_PROFILE_SITES ? &heap_sites[i] : &heap_site_other;
+        if (entry->live_count == 0) {
+            continue;
+        }
+
+        uint32_t pos = stats->site_count;
+        if (pos == HEAP_STATS_TOP_SITES) {
+            if (entry->live_bytes <= stats->top_sites[pos - 1].live_bytes) {
+                continue;
+            }
+            pos--;
+        } else {
+            stats->site_count++;
+        }
+        while (pos > 0 && stats->top_sites[pos - 1].live_bytes < entry->live_bytes) {
+            stats->top_sites[pos] = stats->top_sites[pos - 1];
+            pos--;
+        }
+        stats->top_sites[pos] = *entry;
+    }
+}
+
+/**
+ * Muestra un call site del heap
+ */
+static void heap_dump_site(const heap_site_stats_t* entry) {
+    vga_write("  ");
+    if (entry->site == 0) {
+        vga_write("(otros)   ");
+    } else {
+        vga_write_hex(entry->site);
+    }
+    vga_write(": ");
+    vga_write_dec(entry->live_bytes);
+    vga_write(" bytes en ");
+    vga_write_dec(entry->live_count);
+    vga_write(" bloques (");
+    vga_write_dec(entry->total_count);
+    vga_write(" asignaciones)\n");
+}
+
+/**
+ * Muestra las estadísticas del heap
+ */
+void heap_dump(void) {
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    vga_write("[HEAP] === Estadisticas del heap ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_write("[HEAP] Tamano: ");
+    vga_write_dec(stats.heap_size / 1024);
+    vga_write(" KB (");
+    vga_write_dec(stats.mapped_bytes / 1024);
+    vga_write(" KB mapeados)\n");
+    vga_write("[HEAP] Ocupado: ");
+    vga_write_dec(stats.used_bytes);
+    vga_write(" bytes en ");
+    vga_write_dec(stats.used_blocks);
+    vga_write(" bloques\n");
+    vga_write("[HEAP] Libre: ");
+    vga_write_dec(stats.free_bytes);
+    vga_write(" bytes en ");
+    vga_write_dec(stats.free_blocks);
+    vga_write(" bloques, mayor ");
+    vga_write_dec(stats.largest_free);
+    vga_write(", fragmentacion ");
+    vga_write_dec(stats.fragmentation);
+    vga_write("%\n");
+    vga_write("[HEAP] Asignaciones: ");
+    vga_write_dec(stats.alloc_count);
+    vga_write(", liberaciones: ");
+    vga_write_dec(stats.free_count);
+    vga_write("\n");
+    vga_write("[HEAP] kvmalloc: ");
+    vga_write_dec(stats.kv_areas);
+    vga_write(" buffers, ");
+    vga_write_dec(stats.kv_pages);
+    vga_write(" paginas\n");
+
+    vga_write("[HEAP] Bloques libres por tamano:\n");
+    for (uint32_t bucket = 0; bucket < HEAP_HISTOGRAM_BUCKETS; bucket++) {
+        if (stats.free_histogram[bucket] == 0) {
+            continue;
+        }
+        vga_write("  >= ");
+        vga_write_dec(HEAP_MIN_ALIGN << bucket);
+        vga_write(": ");
+        vga_write_dec(stats.free_histogram[bucket]);
+        vga_write("\n");
+    }
+
+    if (HEAP_PROFILING) {
+        vga_write("[HEAP] Uso por call site:\n");
+        for (uint32_t i = 0; i < HEAP_PROFILE_SITES; i++) {
+            if (heap_sites[i].live_count != 0) {
+                heap_dump_site(&heap_sites[i]);
+            }
+        }
+        if (heap_site_other.live_count != 0) {
+            heap_dump_site(&heap_site_other);
+        }
+    }
 }
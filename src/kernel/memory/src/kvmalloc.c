@@ -0,0 +1,330 @@
+/**
+ * NeoOS - Large Allocations (kvmalloc)
+ * Asignaciones grandes con páginas sueltas del PMM
+ *
+ * Cada asignación ocupa un área de páginas completas en un rango virtual
+ * propio (KERNEL_KV_START, hasta KERNEL_KV_SIZE bytes). Cada página se
+ * pide por separado al PMM y se mapea con vmm_map_page, así que un buffer
+ * de varios MB no necesita memoria física contigua ni huecos grandes en
+ * el heap general.
+ *
+ * Entre dos áreas siempre queda al menos una página sin mapear (guarda):
+ * desbordar un buffer provoca un page fault en lugar de corromper el
+ * siguiente.
+ *
+ * Los descriptores de área viven en un cache slab y forman una lista
+ * ordenada por dirección; con pocas asignaciones grandes, recorrerla para
+ * buscar hueco o liberar es suficiente.
+ */
+
+#include "../include/memory.h"
+#include "../../core/include/kconfig.h"
+#include "../../drivers/include/early_vga.h"
+#include "../../lib/include/string.h"
+
+// Páginas sin mapear tras cada área
+#define KV_GUARD_PAGES 1
+
+/**
+ * Descriptor de un área asignada
+ */
+typedef struct kv_area {
+    uintptr_t start;                // Dirección virtual (alineada a página)
+    size_t size;                    // Tamaño pedido en bytes
+    uint32_t pages;                 // Páginas mapeadas
+    struct kv_area* next;           // Siguiente área por dirección
+} kv_area_t;
+
+static kmem_cache_t* kv_area_cache = NULL;
+static kv_area_t* kv_areas = NULL;
+
+// Estadísticas
+static uint32_t kv_area_count = 0;
+static uint32_t kv_page_count = 0;
+
+/**
+ * Busca un hueco de pages páginas (más la guarda) en el rango virtual
+ *
+ * @param prev_out Área tras la que insertar el hueco (NULL si va al inicio)
+ * @return Dirección del hueco, 0 si el rango está lleno
+ */
+static uintptr_t kv_find_range(uint32_t pages, kv_area_t** prev_out) {
+    size_t needed = (size_t)(pages + KV_GUARD_PAGES) * PAGE_SIZE;
+    uintptr_t candidate = KERNEL_KV_START;
+    kv_area_t* prev = NULL;
+
+    for (kv_area_t* area = kv_areas; area != NULL; area = area->next) {
+        if (area->start - candidate >= needed) {
+            break;
+        }
+        candidate = area->start + (size_t)(area->pages + KV_GUARD_PAGES) * PAGE_SIZE;
+        prev = area;
+    }
+
+    if (candidate > KERNEL_KV_START + KERNEL_KV_SIZE ||
+        KERNEL_KV_START + KERNEL_KV_SIZE - candidate < needed) {
+        return 0;
+    }
+
+    *prev_out = prev;
+    return candidate;
+}
+
+/**
+ * Desmapea las primeras pages páginas de un área y devuelve sus marcos
+ */
+static void kv_unmap_pages(uintptr_t start, uint32_t pages) {
+    vmm_unmap_range(vmm_get_kernel_directory(), (uint32_t)start, pages, true);
+}
+
+/**
+ * Respalda un área con marcos del PMM
+ * Si se acaban los marcos, pide al heap que devuelva su final libre y
+ * reintenta una vez
+ *
+ * @return E_OK, o E_NOMEM (sin dejar nada mapeado)
+ */
+static int kv_map_pages(uintptr_t start, uint32_t pages) {
+    page_directory_t* dir = vmm_get_kernel_directory();
+    phys_addr_t frames[PMM_BATCH_PAGES];
+    bool shrunk = false;
+    uint32_t mapped = 0;
+
+    while (mapped < pages) {
+        uint32_t wanted = pages - mapped < PMM_BATCH_PAGES ? pages - mapped : PMM_BATCH_PAGES;
+
+        // Las páginas siempre se acceden por su mapeo: memoria alta
+        uint32_t got = pmm_alloc_batch(wanted, frames, ZONE_HIGH);
+        if (got < wanted && !shrunk) {
+            shrunk = true;
+            if (heap_shrink() > 0) {
+                got += pmm_alloc_batch(wanted - got, frames + got, ZONE_HIGH);
+            }
+        }
+
+        if (got < wanted || vmm_map_range(dir, (uint32_t)(start + (size_t)mapped * PAGE_SIZE), frames, 0, got,
+                                          PAGE_PRESENT | PAGE_WRITE | PAGE_NX) != E_OK) {
+            for (uint32_t i = 0; i < got; i++) {
+                pmm_free_page(frames[i]);
+            }
+            kv_unmap_pages(start, mapped);
+            return E_NOMEM;
+        }
+        mapped += got;
+    }
+
+    return E_OK;
+}
+
+/**
+ * Inicializa el asignador de áreas grandes
+ */
+int kvmalloc_init(void) {
+    kv_area_cache = kmem_cache_create("kv_area", sizeof(kv_area_t), sizeof(void*), NULL);
+    if (kv_area_cache == NULL) {
+        return E_NOMEM;
+    }
+
+    kv_areas = NULL;
+    kv_area_count = 0;
+    kv_page_count = 0;
+
+    if (is_kdebug()) {
+        vga_write("[KV] Rango de asignaciones grandes: ");
+        vga_write_hex(KERNEL_KV_START);
+        vga_write(" - ");
+        vga_write_hex(KERNEL_KV_START + KERNEL_KV_SIZE);
+        vga_write("\n");
+    }
+
+    return E_OK;
+}
+
+/**
+ * Asigna un área grande
+ * @param zero Si es true, el área se devuelve a cero
+ */
+static void* kv_alloc(size_t size, bool zero) {
+    if (size == 0 || kv_area_cache == NULL || size > KERNEL_KV_SIZE) {
+        return NULL;
+    }
+
+    uint32_t pages = (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE);
+
+    kv_area_t* prev = NULL;
+    uintptr_t start = kv_find_range(pages, &prev);
+    if (start == 0) {
+        if (is_kdebug()) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            vga_write("[KV] [DEBUG] Rango virtual agotado\n");
+        }
+        return NULL;
+    }
+
+    kv_area_t* area = (kv_area_t*)kmem_cache_alloc(kv_area_cache);
+    if (area == NULL) {
+        return NULL;
+    }
+
+    if (kv_map_pages(start, pages) != E_OK) {
+        kmem_cache_free(kv_area_cache, area);
+        return NULL;
+    }
+
+    area->start = start;
+    area->size = size;
+    area->pages = pages;
+    if (prev != NULL) {
+        area->next = prev->next;
+        prev->next = area;
+    } else {
+        area->next = kv_areas;
+        kv_areas = area;
+    }
+
+    kv_area_count++;
+    kv_page_count += pages;
+
+    // Los marcos vienen del PMM con contenido indefinido
+    if (zero) {
+        memset((void*)start, 0, (size_t)pages * PAGE_SIZE);
+    }
+
+    return (void*)start;
+}
+
+/**
+ * Asigna un área grande (contenido indefinido)
+ */
+void* kvmalloc(size_t size) {
+    return kv_alloc(size, false);
+}
+
+/**
+ * Asigna un área grande llena de ceros
+ */
+void* kvzalloc(size_t size) {
+    return kv_alloc(size, true);
+}
+
+/**
+ * Libera un área grande
+ */
+void kvfree(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    uintptr_t addr = (uintptr_t)ptr;
+    kv_area_t* prev = NULL;
+    kv_area_t* area = kv_areas;
+    while (area != NULL && area->start < addr) {
+        prev = area;
+        area = area->next;
+    }
+
+    if (area == NULL || area->start != addr) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[KV] [ERROR] kvfree con puntero invalido: ");
+        vga_write_hex((uint32_t)addr);
+        vga_write("\n");
+        return;
+    }
+
+    if (prev != NULL) {
+        prev->next = area->next;
+    } else {
+        kv_areas = area->next;
+    }
+
+    kv_unmap_pages(area->start, area->pages);
+    kv_area_count--;
+    kv_page_count -= area->pages;
+    kmem_cache_free(kv_area_cache, area);
+}
+
+/**
+ * Cambia el tamaño de un área grande
+ *
+ * Encoger desmapea las páginas sobrantes. Crecer mapea páginas nuevas a
+ * continuación si el hueco hasta la siguiente área (respetando su guarda)
+ * lo permite; si no, se mueve a un área nueva.
+ */
+void* kvrealloc(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return kvmalloc(size);
+    }
+    if (size == 0) {
+        kvfree(ptr);
+        return NULL;
+    }
+
+    kv_area_t* area = kv_areas;
+    while (area != NULL && area->start != (uintptr_t)ptr) {
+        area = area->next;
+    }
+    if (area == NULL) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[KV] [ERROR] kvrealloc con puntero invalido: ");
+        vga_write_hex((uint32_t)(uintptr_t)ptr);
+        vga_write("\n");
+        return NULL;
+    }
+    if (size > KERNEL_KV_SIZE) {
+        return NULL;
+    }
+
+    uint32_t pages = (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE);
+
+    if (pages <= area->pages) {
+        kv_unmap_pages(area->start + (size_t)pages * PAGE_SIZE, area->pages - pages);
+        kv_page_count -= area->pages - pages;
+        area->pages = pages;
+        area->size = size;
+        return ptr;
+    }
+
+    // Crecer en su sitio si el hueco siguiente (menos la guarda) alcanza
+    uintptr_t limit = area->next != NULL ? area->next->start : KERNEL_KV_START + KERNEL_KV_SIZE;
+    uintptr_t end = area->start + (size_t)area->pages * PAGE_SIZE;
+    size_t extra = (size_t)(pages - area->pages) * PAGE_SIZE;
+    if (limit - end >= extra + KV_GUARD_PAGES * PAGE_SIZE &&
+        kv_map_pages(end, pages - area->pages) == E_OK) {
+        kv_page_count += pages - area->pages;
+        area->pages = pages;
+        area->size = size;
+        return ptr;
+    }
+
+    void* new_ptr = kvmalloc(size);
+    if (new_ptr == NULL) {
+        return NULL;  // El área original sigue siendo válida
+    }
+    memcpy(new_ptr, ptr, area->size < size ? area->size : size);
+    kvfree(ptr);
+    return new_ptr;
+}
+
+/**
+ * Obtiene el tamaño pedido de un área grande
+ */
+size_t kvmalloc_size(const void* ptr) {
+    for (kv_area_t* area = kv_areas; area != NULL; area = area->next) {
+        if (area->start == (uintptr_t)ptr) {
+            return area->size;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Obtiene estadísticas de las asignaciones grandes
+ */
+void kvmalloc_get_stats(uint32_t* areas, uint32_t* pages) {
+    if (areas != NULL) {
+        *areas = kv_area_count;
+    }
+    if (pages != NULL) {
+        *pages = kv_page_count;
+    }
+}
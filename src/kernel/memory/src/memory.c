@@ -7,6 +7,12 @@
 #include "../../core/include/kconfig.h"
 #include "../../drivers/include/early_vga.h"
 
+// Limpieza de bloques libres del heap en tiempo idle (0 para desactivarla)
+#define MEMORY_IDLE_ZEROING 1
+
+// Hay presión de memoria cuando quedan menos de total/N páginas libres
+#define MEMORY_PRESSURE_DIVISOR 16
+
 /**
  * Inicializa el Memory Manager completo
  */
@@ -18,6 +24,10 @@ int memory_init(multiboot_info_t* mbi, bool kdebug __attribute__((unused)), bool
         vga_write("\n=== Inicializando Memory Manager ===\n");
     }
 
+    // 0. Formato de las page tables: el PMM necesita saber si puede
+    // gestionar memoria por encima de 4GB (PAE)
+    vmm_select_mode(is_kpae());
+
     // 1. Inicializar PMM (Physical Memory Manager)
     result = pmm_init(mbi, kdebug, kverbose);
     if (result != E_OK) {
@@ -46,6 +56,16 @@ int memory_init(multiboot_info_t* mbi, bool kdebug __attribute__((unused)), bool
         return result;
     }
 
+    // 4. Inicializar las asignaciones grandes (kvmalloc)
+    result = kvmalloc_init();
+    if (result != E_OK) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[MM] [FAIL] Error al inicializar kvmalloc: ");
+        vga_write(error_to_string(result));
+        vga_write("\n");
+        return result;
+    }
+
     if (is_kverbose()) {
         vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
         vga_write("=== Memory Manager inicializado ===\n\n");
@@ -57,20 +77,58 @@ int memory_init(multiboot_info_t* mbi, bool kdebug __attribute__((unused)), bool
 /**
  * Obtiene información sobre el estado de la memoria
  */
-void memory_get_info(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb) {
+void memory_get_info(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb, uint32_t* zone_free_kb) {
     uint32_t total_pages = pmm_get_total_pages();
     uint32_t free_pages = pmm_get_free_pages();
     uint32_t used_pages = total_pages - free_pages;
 
+    // Páginas a KB sin pasar por bytes: con 4GB o más no cabrían en 32 bits
     if (total_kb != NULL) {
-        *total_kb = (total_pages * PAGE_SIZE) / 1024;
+        *total_kb = total_pages * (PAGE_SIZE / 1024);
     }
 
     if (used_kb != NULL) {
-        *used_kb = (used_pages * PAGE_SIZE) / 1024;
+        *used_kb = used_pages * (PAGE_SIZE / 1024);
     }
 
     if (free_kb != NULL) {
-        *free_kb = (free_pages * PAGE_SIZE) / 1024;
+        *free_kb = free_pages * (PAGE_SIZE / 1024);
+    }
+
+    if (zone_free_kb != NULL) {
+        for (uint32_t zone = 0; zone < PMM_ZONE_COUNT; zone++) {
+            zone_free_kb[zone] = pmm_get_zone_free_pages(zone) * (PAGE_SIZE / 1024);
+        }
     }
 }
+
+/**
+ * Trabajo de mantenimiento de memoria en tiempo idle
+ */
+bool memory_idle(void) {
+    bool pending = false;
+
+    // Bajo presión de memoria, devolver al PMM el final libre del heap y
+    // los marcos limpios de reserva; si no, rellenar el pool de marcos
+    // limpios de página en página
+    uint32_t pressure = pmm_get_total_pages() / MEMORY_PRESSURE_DIVISOR;
+
+    __asm__ volatile("cli");
+    if (pmm_get_free_pages() < pressure) {
+        heap_shrink();
+        pmm_zero_pool_drain();
+    } else if (pmm_get_free_pages() >= 2 * pressure) {
+        // Margen sobre el umbral para no llenar y vaciar el pool en bucle
+        pending = pmm_zero_pool_fill();
+    }
+    __asm__ volatile("sti");
+
+    if (MEMORY_IDLE_ZEROING) {
+        // El heap no tiene locks: que nadie lo toque mientras se limpia
+        __asm__ volatile("cli");
+        pending |= heap_idle_zero();
+        __asm__ volatile("sti");
+    }
+
+    return pending;
+}
@@ -1,10 +1,49 @@
 /**
  * NeoOS - Physical Memory Manager (PMM)
- * Gestión de páginas físicas mediante bitmap
+ * Gestión de páginas físicas mediante bitmap y buddy allocator
  * 
  * El PMM mantiene un bitmap donde cada bit representa una página de 4KB:
  *   0 = página libre
  *   1 = página ocupada
+ *
+ * Sobre el bitmap, un buddy allocator agrupa las páginas libres en bloques
+ * de 2^orden páginas (orden 0..PMM_MAX_ORDER) alineados a su tamaño. Cada
+ * orden tiene su propio bitmap con un bit por bloque: 1 = bloque libre y
+ * maximal (su buddy no está libre entero en el mismo orden). Asignar toma
+ * un bloque del menor orden suficiente y divide; liberar fusiona con el
+ * buddy mientras esté libre. Como los bitmaps no viven dentro de las
+ * páginas libres, funcionan también para la memoria fuera del identity map.
+ *
+ * Cada bitmap de orden tiene dos niveles de resumen: un bit por palabra
+ * no vacía y, encima, un bit por palabra de resumen no vacía. Un cursor
+ * recuerda la primera palabra del nivel superior que puede tener bits.
+ * Encontrar el primer bloque libre son tres bsf desde el cursor, sea cual
+ * sea el tamaño de la memoria (1M páginas = 32K palabras -> 1K -> 32).
+ *
+ * La memoria se divide en zonas (DMA < 16MB, LOW < 128MB, HIGH) y cada
+ * zona tiene su propio buddy allocator. Los límites de zona son múltiplos
+ * del bloque máximo (4MB), así que ningún bloque cruza de una zona a otra.
+ * Una petición nombra la zona más alta aceptable y, si está agotada, baja
+ * a las inferiores (HIGH -> LOW -> DMA).
+ *
+ * Cada marco tiene además un descriptor page_t con su contador de
+ * referencias: un marco compartido solo vuelve al buddy allocator cuando
+ * se libera su última referencia.
+ *
+ * Sin PAE el PMM gestiona hasta 4GB; con PAE, hasta 64GB. Los marcos por
+ * encima de 4GB son de ZONE_HIGH como los demás: solo se acceden por sus
+ * page tables o con kmap. Con tanta memoria el array de page_t (8 bytes
+ * por página, 128MB con 64GB) no cabe detrás del kernel: pmm_init lo
+ * coloca en un bloque de memoria disponible entre el identity map y 4GB
+ * (la paginación aún no está activa y se escribe por su dirección física)
+ * y el VMM lo mapea después en KERNEL_FRAMES_START.
+ *
+ * El proceso idle mantiene un pool de marcos ya limpios (asignados, fuera
+ * del buddy) para que pmm_alloc_zeroed_page no tenga que escribir 4KB en
+ * el camino crítico.
+ *
+ *   [kernel][bitmap de páginas][zona DMA: orden 0 (bloques, resumen,
+ *   superior)...orden PMM_MAX_ORDER][zona LOW...][zona HIGH...][page_t...]
  */
 
 #include "../include/memory.h"
@@ -16,8 +55,70 @@
 static uint32_t* pmm_bitmap = NULL;
 static uint32_t pmm_bitmap_size = 0;  // Tamaño del bitmap en DWORDs (uint32_t)
 static uint32_t pmm_total_pages = 0;
-static uint32_t pmm_free_pages = 0;
-static uint32_t pmm_memory_size = 0;  // Tamaño total de memoria en bytes
+static uint32_t pmm_free_count = 0;
+static uint64_t pmm_memory_size = 0;  // Tamaño total de memoria en bytes
+
+// Memoria física que se puede direccionar: 4GB con paginación de 2
+// niveles, 64GB con PAE (36 bits de dirección física)
+#define PMM_LIMIT_32    0x100000000ULL
+#define PMM_LIMIT_PAE   0x1000000000ULL
+
+// Los descriptores de marco siguen a los bitmaps si acaban por debajo de
+// esta dirección; si no, van a un bloque fuera del identity map alineado
+// a PMM_PAGES_ALIGN (una página grande de 4MB, o dos de 2MB)
+#ifndef PMM_PAGES_LOW_MAX
+#define PMM_PAGES_LOW_MAX 0x01000000
+#endif
+#define PMM_PAGES_ALIGN   0x00400000
+
+/**
+ * Bloques libres de un orden del buddy allocator
+ */
+typedef struct {
+    uint32_t* map;          // Un bit por bloque (1 = libre)
+    uint32_t* summary;      // Un bit por palabra de map no vacía
+    uint32_t* top;          // Un bit por palabra de summary no vacía
+    uint32_t words;         // Tamaño de map en DWORDs
+    uint32_t top_words;     // Tamaño de top en DWORDs
+    uint32_t cursor;        // Primera palabra de top que puede no estar vacía
+    uint32_t free;          // Bloques libres
+} pmm_free_area_t;
+
+/**
+ * Zona de memoria física con su buddy allocator
+ * Los bloques se numeran desde la primera página de la zona
+ */
+typedef struct {
+    uint32_t start;                             // Primera página
+    uint32_t pages;                             // Páginas de la zona
+    uint32_t free;                              // Páginas libres
+    pmm_free_area_t areas[PMM_MAX_ORDER + 1];   // Bloques libres por orden
+} pmm_zone_t;
+
+static pmm_zone_t pmm_zones[PMM_ZONE_COUNT];
+
+// Nombres de las zonas (para depuración)
+static const char* pmm_zone_names[PMM_ZONE_COUNT] = { "DMA", "LOW", "HIGH" };
+
+// Descriptores de marco, indexados por número de página
+static page_t* pmm_pages = NULL;
+
+// Bloque físico de los descriptores cuando no están en el identity map
+// (páginas [first, end); 0 y 0 si siguen a los bitmaps)
+static uint32_t pmm_pages_first = 0;
+static uint32_t pmm_pages_end = 0;
+
+// Fin de las estructuras del PMM (bitmaps) en memoria física
+static uint32_t pmm_metadata_end = 0;
+
+// Marcos limpios que el idle mantiene para pmm_alloc_zeroed_page
+#define PMM_ZERO_POOL_PAGES 32
+
+// Pool de marcos limpios (pila de direcciones físicas) y sus contadores
+static phys_addr_t pmm_zero_pool[PMM_ZERO_POOL_PAGES];
+static uint32_t pmm_zero_count = 0;
+static uint32_t pmm_zero_hits = 0;
+static uint32_t pmm_zero_misses = 0;
 
 // Dirección donde termina el kernel (se actualizará durante la inicialización)
 extern uint32_t kernel_end;
@@ -54,26 +155,459 @@ static inline bool pmm_bitmap_test(uint32_t page_num) {
 }
 
 /**
- * Encuentra la primera página libre en el bitmap
- * @return Número de página, o (uint32_t)-1 si no hay páginas libres
+ * Marca como ocupadas las páginas [first, end)
+ * Los bits sueltos de los extremos se escriben uno a uno y las palabras
+ * completas del medio con memset
  */
-static uint32_t pmm_find_free_page(void) {
-    for (uint32_t i = 0; i < pmm_bitmap_size; i++) {
-        if (pmm_bitmap[i] != 0xFFFFFFFF) {
-            // Hay al menos un bit libre en este DWORD
-            for (uint32_t bit = 0; bit < 32; bit++) {
-                uint32_t page_num = i * 32 + bit;
-                // Verificar que la página esté dentro del rango válido
-                if (page_num >= pmm_total_pages) {
-                    return (uint32_t)-1;
-                }
-                if (!(pmm_bitmap[i] & (1 << bit))) {
-                    return page_num;
-                }
+static void pmm_bitmap_set_range(uint32_t first, uint32_t end) {
+    while (first < end && (first % 32) != 0) {
+        pmm_bitmap_set(first++);
+    }
+    if (end - first >= 32) {
+        uint32_t words = (end - first) / 32;
+        memset(&pmm_bitmap[first / 32], 0xFF, words * sizeof(uint32_t));
+        first += words * 32;
+    }
+    while (first < end) {
+        pmm_bitmap_set(first++);
+    }
+}
+
+/**
+ * Marca como libres las páginas [first, end), por palabras completas
+ */
+static void pmm_bitmap_clear_range(uint32_t first, uint32_t end) {
+    while (first < end && (first % 32) != 0) {
+        pmm_bitmap_clear(first++);
+    }
+    if (end - first >= 32) {
+        uint32_t words = (end - first) / 32;
+        memset(&pmm_bitmap[first / 32], 0, words * sizeof(uint32_t));
+        first += words * 32;
+    }
+    while (first < end) {
+        pmm_bitmap_clear(first++);
+    }
+}
+
+/**
+ * Verifica si una página nunca debe marcarse como libre
+ * Protege la página 0 (0 es el valor de error de pmm_alloc_page), el
+ * kernel con los bitmaps y el bloque de los descriptores de marco. El heap
+ * pide sus marcos al PMM como cualquier otro
+ */
+static inline bool pmm_page_is_protected(uint32_t page_num) {
+    uint32_t kernel_start_page = KERNEL_START / PAGE_SIZE;
+    uint32_t kernel_end_page = (pmm_metadata_end + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    return page_num == 0 ||
+           (page_num >= kernel_start_page && page_num < kernel_end_page) ||
+           (page_num >= pmm_pages_first && page_num < pmm_pages_end);
+}
+
+/*
+ * Buddy allocator
+ */
+
+/**
+ * Obtiene la zona de una página
+ */
+static inline pmm_zone_t* pmm_zone_of(uint32_t page_num) {
+    if (page_num < ZONE_DMA_END / PAGE_SIZE) {
+        return &pmm_zones[ZONE_DMA];
+    }
+    if (page_num < KERNEL_IDENTITY_END / PAGE_SIZE) {
+        return &pmm_zones[ZONE_LOW];
+    }
+    return &pmm_zones[ZONE_HIGH];
+}
+
+/**
+ * Marca un bloque como libre en el bitmap de su orden y en sus resúmenes
+ */
+static inline void pmm_buddy_set(pmm_zone_t* zone, uint32_t order, uint32_t block) {
+    pmm_free_area_t* area = &zone->areas[order];
+    uint32_t word = block / 32;
+    uint32_t group = word / 32;
+
+    if (area->map[word] == 0) {
+        if (area->summary[group] == 0) {
+            area->top[group / 32] |= (1U << (group % 32));
+        }
+        area->summary[group] |= (1U << (word % 32));
+    }
+    area->map[word] |= (1U << (block % 32));
+    area->free++;
+
+    if (group / 32 < area->cursor) {
+        area->cursor = group / 32;
+    }
+}
+
+/**
+ * Quita un bloque del bitmap de su orden y de sus resúmenes
+ */
+static inline void pmm_buddy_clear(pmm_zone_t* zone, uint32_t order, uint32_t block) {
+    pmm_free_area_t* area = &zone->areas[order];
+    uint32_t word = block / 32;
+    uint32_t group = word / 32;
+
+    area->map[word] &= ~(1U << (block % 32));
+    if (area->map[word] == 0) {
+        area->summary[group] &= ~(1U << (word % 32));
+        if (area->summary[group] == 0) {
+            area->top[group / 32] &= ~(1U << (group % 32));
+        }
+    }
+    area->free--;
+}
+
+/**
+ * Verifica si un bloque está libre en su orden
+ */
+static inline bool pmm_buddy_test(pmm_zone_t* zone, uint32_t order, uint32_t block) {
+    return (zone->areas[order].map[block / 32] & (1U << (block % 32))) != 0;
+}
+
+/**
+ * Añade un bloque libre de 2^order páginas, fusionándolo con su buddy
+ * mientras este también esté libre
+ * Los bitmaps tienen un bit más que bloques completos, así que el buddy
+ * del último bloque siempre se puede consultar
+ */
+static void pmm_buddy_insert(uint32_t page_num, uint32_t order) {
+    pmm_zone_t* zone = pmm_zone_of(page_num);
+    uint32_t block = (page_num - zone->start) >> order;
+
+    zone->free += 1U << order;
+    while (order < PMM_MAX_ORDER && pmm_buddy_test(zone, order, block ^ 1)) {
+        pmm_buddy_clear(zone, order, block ^ 1);
+        block >>= 1;
+        order++;
+    }
+    pmm_buddy_set(zone, order, block);
+}
+
+/**
+ * Encuentra el primer bloque libre de un orden
+ * Avanza el cursor sobre las palabras vacías del nivel superior y baja por
+ * los resúmenes con bsf (__builtin_ctz)
+ * @return Número de bloque, o (uint32_t)-1 si no hay
+ */
+static uint32_t pmm_buddy_find(pmm_zone_t* zone, uint32_t order) {
+    pmm_free_area_t* area = &zone->areas[order];
+
+    while (area->cursor < area->top_words && area->top[area->cursor] == 0) {
+        area->cursor++;
+    }
+    if (area->cursor >= area->top_words) {
+        return (uint32_t)-1;
+    }
+
+    uint32_t group = area->cursor * 32 + __builtin_ctz(area->top[area->cursor]);
+    uint32_t word = group * 32 + __builtin_ctz(area->summary[group]);
+    return word * 32 + __builtin_ctz(area->map[word]);
+}
+
+/**
+ * Retira de una zona un bloque de 2^order páginas, dividiendo uno mayor si
+ * hace falta
+ * Las mitades superiores sobrantes quedan libres en los órdenes inferiores
+ * @return Primera página del bloque, o (uint32_t)-1 si no hay bloque
+ */
+static uint32_t pmm_buddy_take(pmm_zone_t* zone, uint32_t order) {
+    uint32_t current = order;
+    while (current <= PMM_MAX_ORDER && zone->areas[current].free == 0) {
+        current++;
+    }
+    if (current > PMM_MAX_ORDER) {
+        return (uint32_t)-1;
+    }
+
+    uint32_t block = pmm_buddy_find(zone, current);
+    pmm_buddy_clear(zone, current, block);
+
+    while (current > order) {
+        current--;
+        block <<= 1;
+        pmm_buddy_set(zone, current, block + 1);
+    }
+    zone->free -= 1U << order;
+    return zone->start + (block << order);
+}
+
+/**
+ * Devuelve una página al buddy allocator y limpia su descriptor
+ */
+static void pmm_release_page(uint32_t page_num) {
+    pmm_pages[page_num].refcount = 0;
+    pmm_pages[page_num].flags = 0;
+    pmm_pages[page_num].link = 0;
+    pmm_bitmap_clear(page_num);
+    pmm_free_count++;
+    pmm_buddy_insert(page_num, 0);
+}
+
+/**
+ * Devuelve las páginas [first, end) al buddy allocator
+ * El bitmap se limpia por palabras y el rango se inserta en los mayores
+ * bloques alineados que caben, no página a página. Los descriptores son
+ * responsabilidad del llamador
+ */
+static void pmm_release_range(uint32_t first, uint32_t end) {
+    pmm_bitmap_clear_range(first, end);
+    pmm_free_count += end - first;
+
+    while (first < end) {
+        uint32_t order = first != 0 ? (uint32_t)__builtin_ctz(first) : PMM_MAX_ORDER;
+        uint32_t fit = 31 - __builtin_clz(end - first);
+
+        if (order > fit) {
+            order = fit;
+        }
+        if (order > PMM_MAX_ORDER) {
+            order = PMM_MAX_ORDER;
+        }
+        pmm_buddy_insert(first, order);
+        first += 1U << order;
+    }
+}
+
+/**
+ * Libera las páginas [first, end) menos las de [skip_first, skip_end)
+ * @return Número de páginas liberadas
+ */
+static uint32_t pmm_release_except(uint32_t first, uint32_t end, uint32_t skip_first, uint32_t skip_end) {
+    uint32_t released = 0;
+
+    // Tramo anterior al hueco
+    if (first < end && first < skip_first) {
+        uint32_t stop = end < skip_first ? end : skip_first;
+        pmm_release_range(first, stop);
+        released += stop - first;
+    }
+
+    // Tramo posterior
+    if (first < skip_end) {
+        first = skip_end;
+    }
+    if (first < end) {
+        pmm_release_range(first, end);
+        released += end - first;
+    }
+    return released;
+}
+
+/**
+ * Libera las páginas [first, end) de una región disponible, saltando la
+ * página 0, el kernel con los metadatos del PMM y el bloque de los
+ * descriptores de marco
+ * @return Número de páginas liberadas
+ */
+static uint32_t pmm_release_available(uint32_t first, uint32_t end) {
+    uint32_t kernel_start_page = KERNEL_START / PAGE_SIZE;
+    uint32_t kernel_end_page = (pmm_metadata_end + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    if (end > pmm_total_pages) {
+        end = pmm_total_pages;
+    }
+    if (first == 0) {
+        first = 1;
+    }
+    if (pmm_pages_end == 0) {
+        return pmm_release_except(first, end, kernel_start_page, kernel_end_page);
+    }
+
+    // El bloque de los descriptores está por encima del identity map, así
+    // que detrás de él no queda nada del kernel
+    uint32_t stop = end < pmm_pages_first ? end : pmm_pages_first;
+    uint32_t released = pmm_release_except(first, stop, kernel_start_page, kernel_end_page);
+    return released + pmm_release_except(first, end, 0, pmm_pages_end);
+}
+
+/**
+ * Retira del buddy allocator la página libre page_num y las siguientes
+ * del mismo bloque libre, sin pasar de end
+ * Divide el bloque que la contiene hasta que empieza en page_num y cabe
+ * antes de end; las mitades sobrantes siguen libres
+ * @return Página siguiente a la última retirada
+ */
+static uint32_t pmm_buddy_remove(uint32_t page_num, uint32_t end) {
+    pmm_zone_t* zone = pmm_zone_of(page_num);
+    uint32_t order = 0;
+
+    while (!pmm_buddy_test(zone, order, (page_num - zone->start) >> order)) {
+        order++;  // Una página libre siempre está en algún bloque libre
+    }
+
+    uint32_t first = zone->start + (((page_num - zone->start) >> order) << order);
+    pmm_buddy_clear(zone, order, (first - zone->start) >> order);
+    zone->free -= 1U << order;
+
+    while (first < page_num || first + (1U << order) > end) {
+        order--;
+        uint32_t half = 1U << order;
+
+        if (page_num >= first + half) {
+            // La mitad inferior queda libre
+            pmm_buddy_set(zone, order, (first - zone->start) >> order);
+            first += half;
+        } else {
+            // La mitad superior queda libre
+            pmm_buddy_set(zone, order, ((first - zone->start) >> order) + 1);
+        }
+        zone->free += half;
+    }
+    return first + (1U << order);
+}
+
+/**
+ * Escribe ceros con rep stosl, sin pasar por el memset byte a byte de la
+ * libc del kernel
+ */
+static inline void pmm_stosl(void* dest, uint32_t bytes) {
+    uintptr_t edi = (uintptr_t)dest;
+    uintptr_t count = bytes / sizeof(uint32_t);
+    __asm__ volatile("rep stosl" : "+D"(edi), "+c"(count) : "a"(0) : "memory");
+}
+
+/**
+ * Escribe ceros en marcos consecutivos
+ */
+bool pmm_zero_pages(phys_addr_t addr, uint32_t count) {
+    // La parte del identity map, de una vez
+    if (addr < KERNEL_IDENTITY_END) {
+        uint32_t identity = (KERNEL_IDENTITY_END - addr) / PAGE_SIZE;
+        if (identity > count) {
+            identity = count;
+        }
+        pmm_stosl((void*)(uintptr_t)addr, identity * PAGE_SIZE);
+        addr += identity * PAGE_SIZE;
+        count -= identity;
+    }
+
+    // El resto se accede con kmap
+    for (; count > 0; count--, addr += PAGE_SIZE) {
+        void* page = kmap(addr);
+        if (page == NULL) {
+            return false;
+        }
+        pmm_stosl(page, PAGE_SIZE);
+        kunmap(page);
+    }
+    return true;
+}
+
+/**
+ * Siguiente entrada del mapa de memoria de Multiboot (el tamaño no incluye
+ * el campo size)
+ */
+static inline multiboot_mmap_entry_t* pmm_mmap_next(multiboot_mmap_entry_t* mmap) {
+    return (multiboot_mmap_entry_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size));
+}
+
+/**
+ * Fin de la memoria física que gestiona el PMM: el de la memoria básica o
+ * el de la última región disponible del mapa, sin pasar de limit
+ */
+static uint64_t pmm_memory_end(multiboot_info_t* mbi, uint64_t limit) {
+    // mem_lower está en KB y va desde 0 hasta 640KB (memoria convencional)
+    // mem_upper está en KB y empieza desde 1MB
+    uint64_t end = ((uint64_t)(mbi->mem_lower) + (uint64_t)(mbi->mem_upper) + 1024ULL) * 1024ULL;
+
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP) {
+        multiboot_mmap_entry_t* mmap = (multiboot_mmap_entry_t*)mbi->mmap_addr;
+        multiboot_mmap_entry_t* mmap_end = (multiboot_mmap_entry_t*)(mbi->mmap_addr + mbi->mmap_length);
+
+        for (; mmap < mmap_end; mmap = pmm_mmap_next(mmap)) {
+            uint64_t region_end = mmap->addr + mmap->len;
+            if (mmap->type != MULTIBOOT_MEMORY_AVAILABLE || mmap->addr >= limit) {
+                continue;
             }
+            if (region_end > end) {
+                end = region_end;
+            }
+        }
+    }
+    return end < limit ? end : limit;
+}
+
+/**
+ * Busca un bloque de memoria disponible para los descriptores de marco:
+ * por encima del identity map, por debajo de 4GB (pmm_init lo escribe sin
+ * paginación) y alineado a PMM_PAGES_ALIGN
+ * @return Dirección física del bloque, 0 si no hay ninguno
+ */
+static uint32_t pmm_find_pages_block(multiboot_info_t* mbi, uint32_t size) {
+    if (!(mbi->flags & MULTIBOOT_INFO_MEM_MAP)) {
+        return 0;
+    }
+
+    multiboot_mmap_entry_t* mmap = (multiboot_mmap_entry_t*)mbi->mmap_addr;
+    multiboot_mmap_entry_t* mmap_end = (multiboot_mmap_entry_t*)(mbi->mmap_addr + mbi->mmap_length);
+
+    for (; mmap < mmap_end; mmap = pmm_mmap_next(mmap)) {
+        uint64_t start = mmap->addr > KERNEL_IDENTITY_END ? mmap->addr : KERNEL_IDENTITY_END;
+        uint64_t end = mmap->addr + mmap->len;
+
+        start = (start + PMM_PAGES_ALIGN - 1) & ~(uint64_t)(PMM_PAGES_ALIGN - 1);
+        if (end > PMM_LIMIT_32) {
+            end = PMM_LIMIT_32;
+        }
+        if (mmap->type == MULTIBOOT_MEMORY_AVAILABLE && start + size <= end) {
+            return (uint32_t)start;
         }
     }
-    return (uint32_t)-1;  // No hay páginas libres
+    return 0;
+}
+
+/**
+ * Coloca los descriptores de marco a partir de low (detrás de los
+ * bitmaps) o, si no caben por debajo de PMM_PAGES_LOW_MAX, en un bloque
+ * fuera del identity map. Sin bloque se reduce la memoria gestionada
+ */
+static void pmm_place_pages(multiboot_info_t* mbi, uint32_t low) {
+    uint32_t bytes = pmm_total_pages * sizeof(page_t);
+
+    pmm_pages = (page_t*)low;
+    pmm_metadata_end = low + bytes;
+    if (low + bytes <= PMM_PAGES_LOW_MAX) {
+        return;
+    }
+
+    uint32_t size = (bytes + PMM_PAGES_ALIGN - 1) & ~(PMM_PAGES_ALIGN - 1);
+    uint32_t block = pmm_find_pages_block(mbi, size);
+    if (block != 0) {
+        pmm_pages = (page_t*)block;
+        pmm_pages_first = block / PAGE_SIZE;
+        pmm_pages_end = (block + size) / PAGE_SIZE;
+        pmm_metadata_end = low;
+        return;
+    }
+
+    // Sin bloque: solo se gestiona la memoria cuyos descriptores caben
+    // detrás de los bitmaps. Las zonas se recortan a la nueva memoria
+    uint32_t pages = low < PMM_PAGES_LOW_MAX ? (PMM_PAGES_LOW_MAX - low) / sizeof(page_t) : 0;
+    if (pages < KERNEL_IDENTITY_END / PAGE_SIZE) {
+        pages = KERNEL_IDENTITY_END / PAGE_SIZE;
+    }
+    if (pages < pmm_total_pages) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[PMM] [WARN] Sin bloque para los descriptores de marco; se usan ");
+        vga_write_dec(pages / (1024 * 1024 / PAGE_SIZE));
+        vga_write(" MB\n");
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+        pmm_total_pages = pages;
+        for (uint32_t z = 0; z < PMM_ZONE_COUNT; z++) {
+            pmm_zone_t* zone = &pmm_zones[z];
+            uint32_t zone_end = zone->start + zone->pages;
+            if (zone_end > pages) {
+                zone->pages = pages > zone->start ? pages - zone->start : 0;
+            }
+        }
+    }
+    pmm_metadata_end = low + pmm_total_pages * sizeof(page_t);
 }
 
 /**
@@ -92,22 +626,18 @@ int pmm_init(multiboot_info_t* mbi, __attribute__((unused)) bool kdebug, __attri
         return E_INVAL;
     }
 
-    // Calcular memoria total (inferior + superior)
-    // mem_lower está en KB y va desde 0 hasta 640KB (memoria convencional)
-    // mem_upper está en KB y empieza desde 1MB
-    uint64_t total_memory = ((uint64_t)(mbi->mem_lower) + (uint64_t)(mbi->mem_upper) + 1024ULL) * 1024ULL;  // Convertir a bytes
-    // Limitar a 4GB para sistemas de 32 bits
-    if (total_memory > 0xFFFFFFFFULL) {
-        pmm_memory_size = 0xFFFFFFFFU;
-    } else {
-        pmm_memory_size = (uint32_t)total_memory;
-    }
+    // Calcular memoria total (hasta el final de la última región
+    // disponible): 4GB como mucho sin PAE, 64GB con PAE
+    uint64_t limit = vmm_is_pae() ? PMM_LIMIT_PAE : PMM_LIMIT_32;
+    pmm_memory_size = pmm_memory_end(mbi, limit);
     pmm_total_pages = (uint32_t)(pmm_memory_size / PAGE_SIZE);
+    pmm_pages_first = 0;
+    pmm_pages_end = 0;
 
     if (is_kdebug()) {
         vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
         vga_write("[PMM] Memoria total: ");
-        vga_write_dec(pmm_memory_size / (1024 * 1024));
+        vga_write_dec((uint32_t)(pmm_memory_size >> 20));
         vga_write(" MB (");
         vga_write_dec(pmm_total_pages);
         vga_write(" paginas)\n");
@@ -134,16 +664,64 @@ int pmm_init(multiboot_info_t* mbi, __attribute__((unused)) bool kdebug, __attri
 
     // Inicializar el bitmap: todas las páginas ocupadas inicialmente
     // Luego marcaremos las libres según el mapa de memoria
-    for (uint32_t i = 0; i < pmm_bitmap_size; i++) {
-        pmm_bitmap[i] = 0xFFFFFFFF;
+    memset(pmm_bitmap, 0xFF, pmm_bitmap_size * sizeof(uint32_t));
+    pmm_free_count = 0;
+
+    // Zonas con sus bitmaps del buddy allocator a continuación, sin
+    // bloques libres. Un bit más que bloques completos para poder
+    // consultar el buddy del último
+    uint32_t zone_ends[PMM_ZONE_COUNT] = {
+        ZONE_DMA_END / PAGE_SIZE, KERNEL_IDENTITY_END / PAGE_SIZE, pmm_total_pages
+    };
+    uint32_t* buddy_map = pmm_bitmap + pmm_bitmap_size;
+    uint32_t zone_start = 0;
+
+    for (uint32_t z = 0; z < PMM_ZONE_COUNT; z++) {
+        pmm_zone_t* zone = &pmm_zones[z];
+        uint32_t zone_end = zone_ends[z] < pmm_total_pages ? zone_ends[z] : pmm_total_pages;
+
+        zone->start = zone_start;
+        zone->pages = zone_end > zone_start ? zone_end - zone_start : 0;
+        zone->free = 0;
+        zone_start += zone->pages;
+
+        for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++) {
+            pmm_free_area_t* area = &zone->areas[order];
+            uint32_t summary_words = 0;
+
+            area->words = (zone->pages >> order) / 32 + 1;
+            summary_words = (area->words + 31) / 32;
+            area->top_words = (summary_words + 31) / 32;
+            area->cursor = area->top_words;
+            area->free = 0;
+
+            area->map = buddy_map;
+            area->summary = area->map + area->words;
+            area->top = area->summary + summary_words;
+            buddy_map = area->top + area->top_words;
+            memset(area->map, 0, (uint32_t)buddy_map - (uint32_t)area->map);
+        }
+    }
+
+    // Descriptores de marco a cero; al final se marcan como reservados los
+    // que el mapa de memoria no haya liberado
+    pmm_place_pages(mbi, (uint32_t)buddy_map);
+    memset(pmm_pages, 0, pmm_total_pages * sizeof(page_t));
+
+    if (is_kdebug()) {
+        vga_write("[PMM] Buddy allocator: ordenes 0-");
+        vga_write_dec(PMM_MAX_ORDER);
+        vga_write(", descriptores de marco en ");
+        vga_write_hex((uint32_t)pmm_pages);
+        vga_write(" (");
+        vga_write_dec(pmm_total_pages * sizeof(page_t));
+        vga_write(pmm_pages_end != 0 ? " bytes, fuera del identity map)\n" : " bytes)\n");
     }
-    pmm_free_pages = 0;
 
-    // Marcar como ocupadas las páginas del kernel y el bitmap ANTES de parsear
-    // Esto asegura que no se marquen como libres accidentalmente
+    // Marcar como ocupadas las páginas del kernel y los metadatos ANTES de
+    // parsear. Esto asegura que no se marquen como libres accidentalmente
     uint32_t kernel_start_page = KERNEL_START / PAGE_SIZE;
-    uint32_t bitmap_end = (uint32_t)pmm_bitmap + pmm_bitmap_size * 4;
-    uint32_t kernel_end_page = (bitmap_end + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t kernel_end_page = (pmm_metadata_end + PAGE_SIZE - 1) / PAGE_SIZE;
 
     if (is_kdebug()) {
         vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
@@ -165,6 +743,7 @@ int pmm_init(multiboot_info_t* mbi, __attribute__((unused)) bool kdebug, __attri
         }
         
         uint32_t entry_count = 0;
+        uint64_t beyond = 0;  // Memoria disponible que no se puede direccionar
         while (mmap < mmap_end) {
             entry_count++;
             if (is_kdebug()) {
@@ -184,10 +763,14 @@ int pmm_init(multiboot_info_t* mbi, __attribute__((unused)) bool kdebug, __attri
                 uint64_t region_start = mmap->addr;
                 uint64_t region_end = mmap->addr + mmap->len;
 
-                // Solo procesar regiones en los primeros 4GB (limitación de 32 bits)
-                if (region_start < 0x100000000ULL) {
-                    if (region_end > 0x100000000ULL) {
-                        region_end = 0x100000000ULL;
+                // Solo procesar la memoria gestionada (4GB, o 64GB con PAE)
+                uint64_t managed = (uint64_t)pmm_total_pages * PAGE_SIZE;
+                if (region_end > limit) {
+                    beyond += region_end - (region_start > limit ? region_start : limit);
+                }
+                if (region_start < managed) {
+                    if (region_end > managed) {
+                        region_end = managed;
                     }
 
                     // Calcular páginas de inicio y fin
@@ -202,15 +785,11 @@ int pmm_init(multiboot_info_t* mbi, __attribute__((unused)) bool kdebug, __attri
                         vga_write(" como libres\n");
                     }
 
-                    // Marcar páginas como libres, excepto las del kernel
+                    // Marcar páginas como libres por rangos, excepto las
+                    // del kernel
                     uint32_t freed_count = 0;
-                    for (uint32_t page = start_page; page < end_page && page < pmm_total_pages; page++) {
-                        // No marcar como libre si está en el rango del kernel
-                        if (page < kernel_start_page || page >= kernel_end_page) {
-                            pmm_bitmap_clear(page);
-                            pmm_free_pages++;
-                            freed_count++;
-                        }
+                    if (start_page < end_page) {
+                        freed_count = pmm_release_available(start_page, end_page);
                     }
                     if (is_kdebug()) {
                         vga_write("[PMM]   -> Liberadas ");
@@ -220,21 +799,35 @@ int pmm_init(multiboot_info_t* mbi, __attribute__((unused)) bool kdebug, __attri
                 }
             }
 
-            // Avanzar al siguiente entry (el tamaño incluye el campo size)
-            mmap = (multiboot_mmap_entry_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size));
+            mmap = pmm_mmap_next(mmap);
+        }
+
+        // Lo que la paginación no puede direccionar: avisar en lugar de
+        // ignorarlo
+        if (beyond != 0 && is_kverbose()) {
+            vga_write("[PMM] ");
+            vga_write_dec((uint32_t)(beyond >> 20));
+            vga_write(vmm_is_pae() ? " MB de memoria por encima de 64GB sin usar\n"
+                                   : " MB de memoria por encima de 4GB sin usar (requiere --pae)\n");
         }
     } else {
         // Si no hay mapa de memoria detallado, usar la información básica
         // Marcar como libre la memoria superior (desde 1MB), excepto el kernel
-        uint32_t start_page = 0x100000 / PAGE_SIZE;  // 1MB
-        uint32_t end_page = pmm_total_pages;
-
-        for (uint32_t page = start_page; page < end_page; page++) {
-            // No marcar como libre si está en el rango del kernel
-            if (page < kernel_start_page || page >= kernel_end_page) {
-                pmm_bitmap_clear(page);
-                pmm_free_pages++;
+        pmm_release_available(0x100000 / PAGE_SIZE, pmm_total_pages);  // Desde 1MB
+    }
+
+    // Las páginas que siguen ocupadas son memoria no disponible, el kernel
+    // o los metadatos. Las palabras a cero (todo libre) se saltan enteras
+    for (uint32_t i = 0; i < pmm_bitmap_size; i++) {
+        uint32_t bits = pmm_bitmap[i];
+
+        while (bits != 0) {
+            uint32_t page = i * 32 + __builtin_ctz(bits);
+            if (page >= pmm_total_pages) {
+                break;
             }
+            pmm_pages[page].flags = PAGE_FRAME_RESERVED;
+            bits &= bits - 1;
         }
     }
 
@@ -243,83 +836,274 @@ int pmm_init(multiboot_info_t* mbi, __attribute__((unused)) bool kdebug, __attri
         vga_write("[PMM] [OK] Inicializacion completada\n");
         vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
         vga_write("[PMM] Paginas libres: ");
-        vga_write_dec(pmm_free_pages);
+        vga_write_dec(pmm_free_count);
         vga_write(" (");
-        vga_write_dec((pmm_free_pages * PAGE_SIZE) / (1024 * 1024));
+        vga_write_dec((pmm_free_count * PAGE_SIZE) / (1024 * 1024));
         vga_write(" MB)\n");
+
+        for (uint32_t z = 0; z < PMM_ZONE_COUNT; z++) {
+            vga_write("[PMM] Zona ");
+            vga_write(pmm_zone_names[z]);
+            vga_write(": ");
+            vga_write_dec(pmm_zones[z].free);
+            vga_write(" de ");
+            vga_write_dec(pmm_zones[z].pages);
+            vga_write(" paginas libres\n");
+        }
     }
 
     return E_OK;
 }
 
 /**
- * Asigna una página física
+ * Asigna un bloque de 2^order páginas físicas contiguas de una zona o de
+ * las inferiores
  */
-uint32_t pmm_alloc_page(void) {
-    if (pmm_free_pages == 0) {
+phys_addr_t pmm_alloc_pages_zone(uint32_t order, uint32_t zone) {
+    if (order > PMM_MAX_ORDER || zone >= PMM_ZONE_COUNT) {
+        return 0;
+    }
+
+    uint32_t count = 1U << order;
+    if (pmm_free_count == 0) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
         vga_write("[PMM] No hay paginas libres\n");
         return 0;  // No hay memoria disponible
     }
 
-    uint32_t page_num = pmm_find_free_page();
+    // Zona pedida primero; después las inferiores
+    uint32_t page_num = (uint32_t)-1;
+    for (uint32_t z = zone + 1; z > 0 && page_num == (uint32_t)-1; z--) {
+        page_num = pmm_buddy_take(&pmm_zones[z - 1], order);
+    }
     if (page_num == (uint32_t)-1) {
-        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        vga_write("[PMM] pmm_find_free_page retorno -1\n");
-        return 0;  // No se encontró página libre (no debería pasar)
+        // Hay páginas libres pero ningún bloque contiguo del tamaño pedido
+        // en las zonas aceptables
+        if (is_kdebug()) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            vga_write("[PMM] [WARN] Sin bloques libres de orden ");
+            vga_write_dec(order);
+            vga_write(" hasta la zona ");
+            vga_write(pmm_zone_names[zone]);
+            vga_write("\n");
+        }
+        return 0;
     }
 
-    pmm_bitmap_set(page_num);
-    pmm_free_pages--;
+    pmm_bitmap_set_range(page_num, page_num + count);
+    for (uint32_t i = 0; i < count; i++) {
+        pmm_pages[page_num + i].refcount = 1;
+    }
+    pmm_free_count -= count;
 
-    return page_num * PAGE_SIZE;  // Retornar dirección física
+    return (phys_addr_t)page_num * PAGE_SIZE;  // Retornar dirección física
 }
 
 /**
- * Libera una página física
+ * Asigna hasta count páginas físicas de una zona o de las inferiores
  */
-void pmm_free_page(uint32_t page) {
-    uint32_t page_num = page / PAGE_SIZE;
+uint32_t pmm_alloc_batch(uint32_t count, phys_addr_t* frames, uint32_t zone) {
+    uint32_t done = 0;
 
-    if (page_num >= pmm_total_pages) {
-        return;  // Página inválida
+    if (zone >= PMM_ZONE_COUNT) {
+        return 0;
     }
 
-    // Proteger el rango del kernel y bitmap
-    uint32_t kernel_start_page = KERNEL_START / PAGE_SIZE;
-    extern uint32_t kernel_end;
-    uint32_t bitmap_end = (uint32_t)pmm_bitmap + pmm_bitmap_size * 4;
-    uint32_t protected_end_page = (bitmap_end + PAGE_SIZE - 1) / PAGE_SIZE;
-    
-    if (page_num >= kernel_start_page && page_num < protected_end_page) {
-        if (is_kdebug()) {
-            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-            vga_write("[PMM] [WARN] Intento de liberar pagina protegida: ");
-            vga_write_dec(page_num);
-            vga_write("\n");
+    // Zona pedida primero; en cada zona, el mayor bloque que no sobrepase
+    // lo que falta, bajando de orden cuando no quedan bloques de ese tamaño
+    for (uint32_t z = zone + 1; z > 0 && done < count; z--) {
+        pmm_zone_t* candidate = &pmm_zones[z - 1];
+
+        while (done < count && candidate->free > 0) {
+            uint32_t order = 31 - __builtin_clz(count - done);
+            uint32_t page_num = (uint32_t)-1;
+
+            if (order > PMM_MAX_ORDER) {
+                order = PMM_MAX_ORDER;
+            }
+            for (;;) {
+                page_num = pmm_buddy_take(candidate, order);
+                if (page_num != (uint32_t)-1 || order == 0) {
+                    break;
+                }
+                order--;
+            }
+            if (page_num == (uint32_t)-1) {
+                break;
+            }
+
+            uint32_t pages = 1U << order;
+            pmm_bitmap_set_range(page_num, page_num + pages);
+            for (uint32_t i = 0; i < pages; i++) {
+                pmm_pages[page_num + i].refcount = 1;
+                frames[done++] = (phys_addr_t)(page_num + i) * PAGE_SIZE;
+            }
+            pmm_free_count -= pages;
         }
-        return;  // Página en rango protegido
     }
+    return done;
+}
 
-    if (!pmm_bitmap_test(page_num)) {
-        if (is_kdebug()) {
-            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-            vga_write("[PMM] [WARN] Double free detectado en pagina: ");
-            vga_write_dec(page_num);
-            vga_write("\n");
+/**
+ * Reserva el rango físico [addr, addr + size)
+ */
+void pmm_reserve_range(phys_addr_t addr, uint32_t size) {
+    phys_addr_t first = addr / PAGE_SIZE;
+    if (first >= pmm_total_pages) {
+        return;  // Fuera de la memoria gestionada
+    }
+    uint32_t page = (uint32_t)first;
+    uint64_t limit = (addr + size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t end = limit < pmm_total_pages ? (uint32_t)limit : pmm_total_pages;
+
+    while (page < end) {
+        // Palabras enteras ya ocupadas se saltan de una vez
+        if ((page % 32) == 0 && end - page >= 32 && pmm_bitmap[page / 32] == 0xFFFFFFFF) {
+            page += 32;
+            continue;
+        }
+        if (pmm_bitmap_test(page)) {
+            page++;  // Ocupada o asignada: no cambia
+            continue;
+        }
+
+        // Retirar del buddy allocator todo el bloque libre que cabe
+        uint32_t run_end = pmm_buddy_remove(page, end);
+        pmm_bitmap_set_range(page, run_end);
+        pmm_free_count -= run_end - page;
+        for (; page < run_end; page++) {
+            pmm_pages[page].flags = PAGE_FRAME_RESERVED;
         }
-        return;  // Página ya está libre (double free)
     }
+}
 
-    pmm_bitmap_clear(page_num);
-    pmm_free_pages++;
+/**
+ * Devuelve al PMM las páginas reservadas del rango físico [addr, addr + size)
+ */
+void pmm_free_range(phys_addr_t addr, uint32_t size) {
+    phys_addr_t start = (addr + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (start >= pmm_total_pages) {
+        return;  // Fuera de la memoria gestionada
+    }
+    uint32_t page = (uint32_t)start;
+    uint64_t limit = (addr + size) / PAGE_SIZE;
+    uint32_t end = limit < pmm_total_pages ? (uint32_t)limit : pmm_total_pages;
+
+    while (page < end) {
+        if (!(pmm_pages[page].flags & PAGE_FRAME_RESERVED) || pmm_page_is_protected(page)) {
+            page++;  // Libre, asignada o protegida: no cambia
+            continue;
+        }
+
+        // Tramo de páginas reservadas que se libera de una vez
+        uint32_t first = page;
+        while (page < end && (pmm_pages[page].flags & PAGE_FRAME_RESERVED) &&
+               !pmm_page_is_protected(page)) {
+            pmm_pages[page].flags = 0;
+            page++;
+        }
+        pmm_release_range(first, page);
+    }
+}
+
+/**
+ * Libera una referencia a un bloque de 2^order páginas físicas contiguas
+ */
+void pmm_free_pages(phys_addr_t addr, uint32_t order) {
+    if (order > PMM_MAX_ORDER || addr / PAGE_SIZE >= pmm_total_pages) {
+        return;  // Orden inválido o fuera de la memoria
+    }
+
+    uint32_t page_num = (uint32_t)(addr / PAGE_SIZE);
+    uint32_t count = 1U << order;
+    if (count > pmm_total_pages - page_num ||
+        (page_num & (count - 1)) != 0) {
+        return;  // Bloque inválido o no alineado a su tamaño
+    }
+
+    // Se valida el bloque entero antes de tocar nada
+    bool shared = false;
+    for (uint32_t i = 0; i < count; i++) {
+        page_t* page = &pmm_pages[page_num + i];
+
+        // Proteger el kernel, los metadatos y la memoria no disponible
+        if (page->flags & PAGE_FRAME_RESERVED) {
+            if (is_kdebug()) {
+                vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+                vga_write("[PMM] [WARN] Intento de liberar pagina protegida: ");
+                vga_write_dec(page_num + i);
+                vga_write("\n");
+            }
+            return;  // Página en rango protegido
+        }
+
+        if (page->refcount == 0) {
+            if (is_kdebug()) {
+                vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+                vga_write("[PMM] [WARN] Double free detectado en pagina: ");
+                vga_write_dec(page_num + i);
+                vga_write("\n");
+            }
+            return;  // Página ya está libre (double free)
+        }
+        shared |= page->refcount > 1;
+    }
+
+    if (!shared) {
+        // Caso común: el bloque entero vuelve de una vez
+        for (uint32_t i = 0; i < count; i++) {
+            pmm_pages[page_num + i].refcount = 0;
+            pmm_pages[page_num + i].flags = 0;
+            pmm_pages[page_num + i].link = 0;
+        }
+        pmm_bitmap_clear_range(page_num, page_num + count);
+        pmm_free_count += count;
+        pmm_buddy_insert(page_num, order);
+        return;
+    }
+
+    // Con marcos compartidos solo vuelven los que pierden su última
+    // referencia
+    for (uint32_t i = 0; i < count; i++) {
+        if (--pmm_pages[page_num + i].refcount == 0) {
+            pmm_release_page(page_num + i);
+        }
+    }
+}
+
+/**
+ * Asigna un bloque de 2^order páginas físicas contiguas del identity map
+ */
+phys_addr_t pmm_alloc_pages(uint32_t order) {
+    return pmm_alloc_pages_zone(order, ZONE_LOW);
+}
+
+/**
+ * Asigna una página física de una zona o de las inferiores
+ */
+phys_addr_t pmm_alloc_page_zone(uint32_t zone) {
+    return pmm_alloc_pages_zone(0, zone);
+}
+
+/**
+ * Asigna una página física del identity map
+ */
+phys_addr_t pmm_alloc_page(void) {
+    return pmm_alloc_pages_zone(0, ZONE_LOW);
+}
+
+/**
+ * Libera una página física
+ */
+void pmm_free_page(phys_addr_t page) {
+    pmm_free_pages(page, 0);
 }
 
 /**
  * Obtiene la cantidad de páginas libres
  */
 uint32_t pmm_get_free_pages(void) {
-    return pmm_free_pages;
+    return pmm_free_count;
 }
 
 /**
@@ -328,3 +1112,136 @@ uint32_t pmm_get_free_pages(void) {
 uint32_t pmm_get_total_pages(void) {
     return pmm_total_pages;
 }
+
+/**
+ * Obtiene el descriptor de un marco físico
+ */
+page_t* pmm_get_page(phys_addr_t addr) {
+    phys_addr_t page_num = addr / PAGE_SIZE;
+    return page_num < pmm_total_pages ? &pmm_pages[(uint32_t)page_num] : NULL;
+}
+
+/**
+ * Obtiene el bloque físico de los descriptores de marco si no están en el
+ * identity map
+ */
+uint32_t pmm_get_pages_block(phys_addr_t* phys) {
+    *phys = (phys_addr_t)pmm_pages_first * PAGE_SIZE;
+    return (pmm_pages_end - pmm_pages_first) * PAGE_SIZE;
+}
+
+/**
+ * Cambia la dirección por la que se accede a los descriptores de marco
+ */
+void pmm_set_pages_address(page_t* pages) {
+    pmm_pages = pages;
+}
+
+/**
+ * Añade una referencia a un marco físico asignado
+ */
+uint32_t pmm_page_ref(phys_addr_t addr) {
+    page_t* page = pmm_get_page(addr);
+
+    if (page == NULL || page->refcount == 0 || (page->flags & PAGE_FRAME_RESERVED) ||
+        page->refcount == PAGE_REFCOUNT_MAX) {
+        return 0;
+    }
+    return ++page->refcount;
+}
+
+/**
+ * Obtiene el número de bloques libres de un orden del buddy allocator
+ */
+uint32_t pmm_get_free_blocks(uint32_t order) {
+    uint32_t blocks = 0;
+
+    if (order <= PMM_MAX_ORDER) {
+        for (uint32_t z = 0; z < PMM_ZONE_COUNT; z++) {
+            blocks += pmm_zones[z].areas[order].free;
+        }
+    }
+    return blocks;
+}
+
+/**
+ * Obtiene las páginas libres de una zona
+ */
+uint32_t pmm_get_zone_free_pages(uint32_t zone) {
+    return zone < PMM_ZONE_COUNT ? pmm_zones[zone].free : 0;
+}
+
+/**
+ * Obtiene el total de páginas de una zona
+ */
+uint32_t pmm_get_zone_total_pages(uint32_t zone) {
+    return zone < PMM_ZONE_COUNT ? pmm_zones[zone].pages : 0;
+}
+
+/**
+ * Asigna una página física con su contenido a cero
+ */
+phys_addr_t pmm_alloc_zeroed_page(void) {
+    if (pmm_zero_count > 0) {
+        pmm_zero_hits++;
+        return pmm_zero_pool[--pmm_zero_count];
+    }
+
+    // Pool vacío: limpiar en el momento
+    phys_addr_t frame = pmm_alloc_page_zone(ZONE_HIGH);
+    if (frame != 0 && !pmm_zero_pages(frame, 1)) {
+        pmm_free_page(frame);
+        return 0;
+    }
+    if (frame != 0) {
+        pmm_zero_misses++;
+    }
+    return frame;
+}
+
+/**
+ * Limpia un marco libre y lo añade al pool de marcos limpios
+ */
+bool pmm_zero_pool_fill(void) {
+    if (pmm_zero_count >= PMM_ZERO_POOL_PAGES || pmm_free_count == 0) {
+        return false;
+    }
+
+    phys_addr_t frame = pmm_alloc_page_zone(ZONE_HIGH);
+    if (frame == 0) {
+        return false;
+    }
+    if (!pmm_zero_pages(frame, 1)) {
+        pmm_free_page(frame);
+        return false;
+    }
+    pmm_zero_pool[pmm_zero_count++] = frame;
+    return true;
+}
+
+/**
+ * Devuelve al buddy allocator los marcos del pool de marcos limpios
+ */
+uint32_t pmm_zero_pool_drain(void) {
+    uint32_t drained = pmm_zero_count;
+
+    while (pmm_zero_count > 0) {
+        pmm_free_page(pmm_zero_pool[--pmm_zero_count]);
+    }
+    return drained;
+}
+
+/**
+ * Obtiene estadísticas del pool de marcos limpios
+ */
+void pmm_get_zero_stats(uint32_t* hits, uint32_t* misses, uint32_t* pooled) {
+    if (hits != NULL) {
+        *hits = pmm_zero_hits;
+    }
+    if (misses != NULL) {
+        *misses = pmm_zero_misses;
+    }
+    if (pooled != NULL) {
+        *pooled = pmm_zero_count;
+    }
+}
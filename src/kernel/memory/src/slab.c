@@ -0,0 +1,405 @@
+/**
+ * NeoOS - Slab Allocator
+ * Caches de objetos de tamaño fijo sobre el asignador de páginas
+ *
+ * Cada cache mantiene tres listas de slabs (parciales, llenos y vacíos).
+ * Un slab es un bloque de memoria con un descriptor kmem_slab_t al inicio
+ * seguido de los objetos, todos alineados a cache->align:
+ *
+ *   Slab pequeño (1 página del PMM):
+ *     [kmem_slab_t][pad][obj 0][obj 1]...[obj N-1]
+ *     El slab de un objeto es (obj & ~(PAGE_SIZE - 1)).
+ *
+ *   Slab grande (2^slab_order páginas contiguas del PMM, o del heap):
+ *     [kmem_slab_t][pad][slab*][obj 0][pad][slab*][obj 1]...
+ *     Cada objeto lleva delante un puntero a su slab.
+ *
+ * Los objetos libres de un slab forman una lista enlazada cuyo enlace vive
+ * dentro del propio objeto (en el offset cache->free_offset).
+ */
+
+#include "../include/memory.h"
+#include "../../core/include/kconfig.h"
+#include "../../drivers/include/early_vga.h"
+#include "../../lib/include/string.h"
+
+// Magic number para validar descriptores de slab
+#define SLAB_MAGIC 0x51AB51AB
+
+// Objetos mayores que esto usan slabs de varias páginas
+#define SLAB_SMALL_LIMIT (PAGE_SIZE / 8)
+
+// Objetos mínimos por slab grande
+#define SLAB_LARGE_OBJECTS 4
+
+// Slabs vacíos que cada cache retiene antes de devolverlos
+#define SLAB_MAX_EMPTY 1
+
+/**
+ * Descriptor de un slab
+ */
+typedef struct kmem_slab {
+    uint32_t magic;                 // SLAB_MAGIC
+    kmem_cache_t* cache;            // Cache al que pertenece
+    struct kmem_slab* next;         // Siguiente slab en la lista del cache
+    struct kmem_slab* prev;         // Slab anterior en la lista del cache
+    void* free_list;                // Primer objeto libre
+    uint32_t in_use;                // Objetos asignados
+} kmem_slab_t;
+
+// Descriptores de cache (estáticos: los caches se crean antes de que
+// existan slabs en los que guardarlos)
+static kmem_cache_t slab_caches[SLAB_MAX_CACHES];
+static uint32_t slab_cache_count = 0;
+
+/**
+ * Alinea un valor hacia arriba
+ */
+static inline uintptr_t slab_align_up(uintptr_t value, size_t align) {
+    return (value + align - 1) & ~((uintptr_t)align - 1);
+}
+
+/**
+ * Enlace de la lista libre de un objeto
+ */
+static inline void** slab_free_link(kmem_cache_t* cache, void* obj) {
+    return (void**)((uintptr_t)obj + cache->free_offset);
+}
+
+/**
+ * Dirección del primer objeto de un slab
+ */
+static inline uintptr_t slab_first_object(kmem_cache_t* cache, kmem_slab_t* slab) {
+    uintptr_t start = (uintptr_t)slab + sizeof(kmem_slab_t);
+    if (cache->large) {
+        start += sizeof(kmem_slab_t*);
+    }
+    return slab_align_up(start, cache->align);
+}
+
+/*
+ * Listas doblemente enlazadas de slabs
+ */
+
+static void slab_list_push(kmem_slab_t** head, kmem_slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
+
+static void slab_list_remove(kmem_slab_t** head, kmem_slab_t* slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *head = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+/**
+ * Crea un slab nuevo para un cache y construye sus objetos
+ */
+static kmem_slab_t* slab_create(kmem_cache_t* cache) {
+    uintptr_t base;
+
+    if (cache->large) {
+        // Bloque contiguo del buddy allocator; si la memoria física está
+        // demasiado fragmentada, del heap
+        base = 0;
+        if (cache->slab_order <= PMM_MAX_ORDER) {
+            base = (uintptr_t)pmm_alloc_pages_zone(cache->slab_order, ZONE_LOW);
+        }
+        if (base == 0) {
+            base = (uintptr_t)kmalloc(cache->slab_bytes);
+        }
+    } else {
+        // Con identity mapping la dirección física es directamente usable
+        base = (uintptr_t)pmm_alloc_page_zone(ZONE_LOW);
+    }
+    if (base == 0) {
+        return NULL;
+    }
+    if (base < KERNEL_IDENTITY_END) {
+        for (size_t offset = 0; offset < cache->slab_bytes; offset += PAGE_SIZE) {
+            pmm_get_page(base + offset)->flags |= PAGE_FRAME_SLAB;
+        }
+    }
+
+    kmem_slab_t* slab = (kmem_slab_t*)base;
+    slab->magic = SLAB_MAGIC;
+    slab->cache = cache;
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->free_list = NULL;
+    slab->in_use = 0;
+
+    // Construir la lista libre de atrás hacia delante para que los objetos
+    // se entreguen en orden ascendente de dirección
+    uintptr_t first = slab_first_object(cache, slab);
+    for (uint32_t i = cache->objects_per_slab; i > 0; i--) {
+        void* obj = (void*)(first + (i - 1) * cache->slot_size);
+        if (cache->large) {
+            ((kmem_slab_t**)obj)[-1] = slab;
+        }
+        if (cache->ctor != NULL) {
+            cache->ctor(obj);
+        }
+        *slab_free_link(cache, obj) = slab->free_list;
+        slab->free_list = obj;
+    }
+
+    cache->slab_count++;
+    cache->total_objects += cache->objects_per_slab;
+
+    if (is_kdebug()) {
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        vga_write("[SLAB] Nuevo slab para '");
+        vga_write(cache->name);
+        vga_write("' en ");
+        vga_write_hex((uint32_t)base);
+        vga_write("\n");
+    }
+
+    return slab;
+}
+
+/**
+ * Devuelve la memoria de un slab vacío
+ */
+static void slab_destroy(kmem_cache_t* cache, kmem_slab_t* slab) {
+    cache->slab_count--;
+    cache->total_objects -= cache->objects_per_slab;
+    slab->magic = 0;
+
+    if (cache->large && (uintptr_t)slab >= KERNEL_HEAP_START) {
+        kfree(slab);
+    } else if (cache->large) {
+        pmm_free_pages((uintptr_t)slab, cache->slab_order);
+    } else {
+        pmm_free_page((uintptr_t)slab);
+    }
+}
+
+/**
+ * Obtiene el slab de un objeto y valida que pertenezca al cache
+ */
+static kmem_slab_t* slab_of(kmem_cache_t* cache, void* obj) {
+    kmem_slab_t* slab;
+
+    if (cache->large) {
+        slab = ((kmem_slab_t**)obj)[-1];
+    } else {
+        slab = (kmem_slab_t*)((uintptr_t)obj & ~((uintptr_t)PAGE_SIZE - 1));
+    }
+
+    if (slab == NULL || slab->magic != SLAB_MAGIC || slab->cache != cache) {
+        return NULL;
+    }
+    return slab;
+}
+
+/**
+ * Crea un cache de objetos de tamaño fijo
+ */
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, void (*ctor)(void*)) {
+    if (size == 0 || size > KERNEL_HEAP_SIZE / SLAB_LARGE_OBJECTS) {
+        return NULL;
+    }
+
+    if (align == 0) {
+        align = SLAB_CACHE_LINE;
+    }
+    if ((align & (align - 1)) != 0 || align > PAGE_SIZE / 2) {
+        return NULL;  // La alineación debe ser potencia de dos
+    }
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+
+    if (slab_cache_count >= SLAB_MAX_CACHES) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[SLAB] [ERROR] No quedan descriptores de cache\n");
+        return NULL;
+    }
+
+    kmem_cache_t* cache = &slab_caches[slab_cache_count++];
+    memset(cache, 0, sizeof(kmem_cache_t));
+    cache->name = name != NULL ? name : "anon";
+    cache->object_size = size;
+    cache->align = align;
+    cache->ctor = ctor;
+
+    // Sin constructor el enlace libre puede pisar el objeto; con constructor
+    // va detrás para no destruir el estado construido
+    size_t stride;
+    if (ctor != NULL) {
+        cache->free_offset = slab_align_up(size, sizeof(void*));
+        stride = cache->free_offset + sizeof(void*);
+    } else {
+        cache->free_offset = 0;
+        stride = size < sizeof(void*) ? sizeof(void*) : size;
+    }
+    stride = slab_align_up(stride, align);
+
+    size_t header = sizeof(kmem_slab_t);
+    if (stride <= SLAB_SMALL_LIMIT) {
+        cache->large = false;
+        cache->slot_size = stride;
+        cache->slab_bytes = PAGE_SIZE;
+        cache->objects_per_slab = (PAGE_SIZE - slab_align_up(header, align)) / stride;
+    } else {
+        // Hueco de 'align' bytes delante de cada objeto para el puntero al
+        // slab; 'align' extra porque kmalloc solo garantiza 16 bytes
+        cache->large = true;
+        cache->slot_size = stride + align;
+        size_t overhead = align + header + sizeof(kmem_slab_t*);
+        size_t needed = overhead + SLAB_LARGE_OBJECTS * cache->slot_size;
+
+        // Potencia de dos páginas para el buddy allocator; los slabs que
+        // no caben en su mayor orden solo pueden venir del heap
+        cache->slab_order = 0;
+        while (cache->slab_order <= PMM_MAX_ORDER && ((size_t)PAGE_SIZE << cache->slab_order) < needed) {
+            cache->slab_order++;
+        }
+        if (cache->slab_order <= PMM_MAX_ORDER) {
+            cache->slab_bytes = (size_t)PAGE_SIZE << cache->slab_order;
+        } else {
+            cache->slab_bytes = slab_align_up(needed, PAGE_SIZE);
+        }
+        cache->objects_per_slab = (cache->slab_bytes - overhead) / cache->slot_size;
+    }
+
+    if (is_kdebug()) {
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        vga_write("[SLAB] Cache '");
+        vga_write(cache->name);
+        vga_write("': objeto ");
+        vga_write_dec(size);
+        vga_write(" bytes, ");
+        vga_write_dec(cache->objects_per_slab);
+        vga_write(" por slab de ");
+        vga_write_dec(cache->slab_bytes);
+        vga_write(" bytes\n");
+    }
+
+    return cache;
+}
+
+/**
+ * Asigna un objeto de un cache
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    kmem_slab_t* slab = cache->partial;
+    if (slab == NULL) {
+        // Reutilizar un slab vacío antes de pedir memoria nueva
+        slab = cache->empty;
+        if (slab != NULL) {
+            slab_list_remove(&cache->empty, slab);
+            cache->empty_count--;
+        } else {
+            slab = slab_create(cache);
+            if (slab == NULL) {
+                return NULL;
+            }
+        }
+        slab_list_push(&cache->partial, slab);
+    }
+
+    void* obj = slab->free_list;
+    slab->free_list = *slab_free_link(cache, obj);
+    slab->in_use++;
+
+    if (slab->in_use == cache->objects_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+
+    cache->active_objects++;
+    cache->alloc_count++;
+
+    return obj;
+}
+
+/**
+ * Asigna un objeto de un cache y lo llena de ceros
+ */
+void* kmem_cache_zalloc(kmem_cache_t* cache) {
+    void* obj = kmem_cache_alloc(cache);
+    if (obj != NULL) {
+        memset(obj, 0, cache->object_size);
+    }
+    return obj;
+}
+
+/**
+ * Devuelve un objeto a su cache
+ */
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    if (cache == NULL || obj == NULL) {
+        return;
+    }
+
+    kmem_slab_t* slab = slab_of(cache, obj);
+    if (slab == NULL || slab->in_use == 0) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[SLAB] [ERROR] Objeto invalido para el cache '");
+        vga_write(cache->name);
+        vga_write("': ");
+        vga_write_hex((uint32_t)(uintptr_t)obj);
+        vga_write("\n");
+        return;
+    }
+
+    if (slab->in_use == cache->objects_per_slab) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+
+    *slab_free_link(cache, obj) = slab->free_list;
+    slab->free_list = obj;
+    slab->in_use--;
+
+    cache->active_objects--;
+    cache->free_count++;
+
+    if (slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->empty_count >= SLAB_MAX_EMPTY) {
+            slab_destroy(cache, slab);
+        } else {
+            slab_list_push(&cache->empty, slab);
+            cache->empty_count++;
+        }
+    }
+}
+
+/**
+ * Libera todos los slabs vacíos retenidos por un cache
+ */
+uint32_t kmem_cache_shrink(kmem_cache_t* cache) {
+    if (cache == NULL) {
+        return 0;
+    }
+
+    uint32_t released = 0;
+    while (cache->empty != NULL) {
+        kmem_slab_t* slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        slab_destroy(cache, slab);
+        released++;
+    }
+    cache->empty_count = 0;
+
+    return released;
+}
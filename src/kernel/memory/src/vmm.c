@@ -2,31 +2,150 @@
  * NeoOS - Virtual Memory Manager (VMM)
  * Gestión de memoria virtual mediante paginación
  * 
- * Implementa paginación de 2 niveles (x86 32-bit):
- * - Page Directory: 1024 entradas (cada una mapea 4MB)
- * - Page Tables: 1024 entradas cada una (cada una mapea 4KB)
- * 
- * Dirección virtual de 32 bits:
- * [31-22: Dir Index | 21-12: Table Index | 11-0: Offset]
+ * Implementa los dos formatos de paginación de x86 32-bit:
+ * - 2 niveles: directorio de 1024 entradas de 32 bits (4MB cada una) y
+ *   page tables de 1024 entradas (4KB cada una).
+ *   [31-22: Dir Index | 21-12: Table Index | 11-0: Offset]
+ * - PAE (--pae): 3 niveles con entradas de 64 bits. CR3 apunta a una PDPT
+ *   de 4 entradas; cada una, a un directorio de 512 entradas (2MB cada
+ *   una) con page tables de 512 entradas.
+ *   [31-30: PDPT | 29-21: Dir Index | 20-12: Table Index | 11-0: Offset]
+ *   Las entradas nombran marcos por encima de 4GB y, si la CPU tiene NX,
+ *   llevan el bit 63 en las páginas que no son ejecutables.
+ *
+ * Los cuatro directorios de PAE se asignan contiguos, así que el resto del
+ * VMM ve siempre un único directorio plano: 1024 entradas de 4MB o 2048
+ * de 2MB, indexadas por virt >> vmm_dir_shift. Las entradas se leen y
+ * escriben con vmm_entry_get/vmm_entry_set y se construyen con
+ * vmm_make_entry, que traduce PAGE_NX al bit 63.
+ *
+ * Si la CPU tiene PSE (o con PAE, que siempre las admite), el identity
+ * map de 0-128MB se hace con páginas grandes: 32 de 4MB o 64 de 2MB, sin
+ * page tables. Sin PSE se construye con tablas pedidas al PMM.
+ *
+ * Las page tables pueden estar en cualquier marco físico: se leen y
+ * escriben a través de kmap, una ventana de KERNEL_KMAP_SLOTS páginas en
+ * la entrada de KERNEL_KMAP_START, cuya tabla es estática. Los marcos del
+ * identity map no gastan slot. Los directorios siguen en el identity map.
+ *
+ * Los espacios de direcciones de los procesos copian las entradas del
+ * kernel de kernel_directory. Cuando una entrada del kernel cambia (tabla
+ * nueva del heap, página grande dividida) se copia a todos ellos, así que
+ * nunca hay que sincronizarlas en un page fault. Con PGE las páginas del
+ * kernel son globales: cambiar de CR3 solo invalida las de usuario.
+ *
+ * Demand paging: cada espacio de direcciones puede reservar regiones de
+ * usuario sin respaldo. El handler del vector 14 busca la región de CR2 y,
+ * si el acceso está permitido, mapea un marco a cero. Las descripciones de
+ * región viven en un cache slab, en una lista única con su directorio; hay
+ * pocas y recorrerla entera es suficiente.
+ *
+ * Copy-on-write: clonar un espacio solo copia sus page tables. Las páginas
+ * escribibles quedan de solo lectura con PAGE_COW en los dos espacios y
+ * cada marco gana una referencia; el handler copia la página en la primera
+ * escritura. CR0.WP hace que las escrituras del kernel también fallen.
  */
 
 #include "../include/memory.h"
+#include "../include/vmm_cpu.h"
 #include "../../core/include/kconfig.h"
+#include "../../core/include/interrupts.h"
 #include "../../drivers/include/early_vga.h"
 #include "../../lib/include/string.h"
 
-// Directorio de páginas del kernel (identity mapping inicial)
+// Entrada de directorio o de page table en cualquiera de los dos formatos
+// (sin PAE solo se usan los 32 bits bajos)
+typedef uint64_t vmm_entry_t;
+
+// Bits de la dirección física de una entrada (hasta 52 bits con PAE)
+#define VMM_FRAME_MASK  0x000FFFFFFFFFF000ULL
+
+// Bit 63 de una entrada PAE: página no ejecutable (con EFER.NXE)
+#define VMM_ENTRY_NX    (1ULL << 63)
+
+// PAE: entradas de la PDPT (una por directorio de 4KB) y orden del bloque
+// con los cuatro directorios
+#define VMM_PDPT_ENTRIES 4
+#define VMM_PAE_DIR_ORDER 2
+
+// Directorio de páginas del kernel (identity mapping inicial). Con PAE son
+// los cuatro directorios seguidos; sin PAE solo se usa la primera página.
 // Usamos memoria estática para evitar problemas de acceso antes de habilitar paginación
-static page_directory_t kernel_directory_data __attribute__((aligned(PAGE_SIZE)));
+static uint8_t kernel_directory_data[VMM_PDPT_ENTRIES * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 static page_directory_t* kernel_directory = NULL;
 static page_directory_t* current_directory = NULL;
 
-// Dirección física del directorio del kernel (para CR3)
-static uint32_t kernel_directory_phys = 0;
+// PDPT del kernel (PAE): CR3 la apunta y debe estar alineada a 32 bytes.
+// Las de los procesos salen de un cache slab
+static uint64_t vmm_kernel_pdpt[VMM_PDPT_ENTRIES] __attribute__((aligned(32)));
+static kmem_cache_t* vmm_pdpt_cache = NULL;
+
+// Bits del código de error de un page fault
+#define PF_PRESENT      (1 << 0)    // La página estaba presente (protección)
+#define PF_WRITE        (1 << 1)    // Escritura
+#define PF_USER         (1 << 2)    // Acceso desde el modo usuario
+#define PF_FETCH        (1 << 4)    // Lectura de una instrucción (solo con NX)
+
+// Formato de las tablas (vmm_select_mode): entradas de 64 bits (PAE) y
+// EFER.NXE activo, con el que PAGE_NX llega al bit 63
+static bool vmm_pae = false;
+static bool vmm_nx = false;
+
+// Geometría del formato: bits que cubre una entrada del directorio (22 o
+// 21), entradas de una page table (1024 o 512) y tamaño y orden del buddy
+// de una página grande (4MB o 2MB)
+static uint32_t vmm_dir_shift = 22;
+static uint32_t vmm_table_entries = 1024;
+static uint32_t vmm_large_size = 0x00400000;
+static uint32_t vmm_large_order = PMM_MAX_ORDER;
+
+// La CPU admite páginas grandes (PSE, o siempre con PAE) y el identity map
+// las usa
+static bool vmm_large = false;
+
+// La CPU admite páginas globales y las del kernel lo son
+static bool vmm_pge = false;
+
+// Page table de la ventana de kmap (estática: siempre accesible) y slots
+// ocupados
+static uint8_t vmm_kmap_table[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t vmm_kmap_used = 0;
+
+// La CPU tiene TSC: se mide la latencia de los page faults
+static bool vmm_tsc = false;
+
+// Fin de la imagen del kernel (linker script): por encima, el identity map
+// no es ejecutable
+extern uint32_t kernel_end;
+
+/**
+ * Región de usuario respaldada bajo demanda
+ */
+typedef struct vmm_region {
+    page_directory_t* page_dir;     // Espacio de direcciones
+    uint32_t start;                 // Inicio (alineado a página)
+    uint32_t end;                   // Fin (exclusivo)
+    uint32_t flags;                 // PAGE_WRITE / PAGE_USER / PAGE_NX
+    uint32_t guard;                 // Bytes reservados sin mapear a cada lado
+    struct vmm_region* next;
+} vmm_region_t;
+
+static kmem_cache_t* vmm_region_cache = NULL;
+static vmm_region_t* vmm_regions = NULL;
+
+// Estadísticas de page faults resueltos
+static uint32_t vmm_fault_minor = 0;
+static uint32_t vmm_fault_avg_cycles = 0;
+static uint32_t vmm_fault_max_cycles = 0;
+
+// Estadísticas de copy-on-write
+static uint32_t vmm_cow_breaks = 0;
+static uint32_t vmm_cow_copies = 0;
 
-// Tablas de páginas estáticas para los primeros 128MB (necesitamos 32 tablas)
-// Cada tabla mapea 4MB, entonces 32 tablas = 128MB
-static page_table_t kernel_tables[32] __attribute__((aligned(PAGE_SIZE)));
+// Directorios de los espacios de direcciones, enlazados por el campo link
+// de sus descriptores de marco (0 = fin de la lista). Con PAE, el link de
+// la segunda página del bloque guarda la PDPT del espacio
+static uint32_t vmm_spaces = 0;
 
 /*
  * Funciones auxiliares
@@ -36,53 +155,229 @@ static page_table_t kernel_tables[32] __attribute__((aligned(PAGE_SIZE)));
  * Extrae el índice del directorio de una dirección virtual
  */
 static inline uint32_t vmm_get_dir_index(uint32_t virt) {
-    return virt >> 22;
+    return virt >> vmm_dir_shift;
+}
+
+/**
+ * Verifica si una entrada del directorio pertenece a la parte del kernel
+ * (todo lo que no es espacio de usuario)
+ */
+static inline bool vmm_is_kernel_index(uint32_t dir_index) {
+    return dir_index < ((uint32_t)USER_SPACE_START >> vmm_dir_shift) ||
+           dir_index >= ((uint32_t)USER_SPACE_END >> vmm_dir_shift);
 }
 
 /**
  * Extrae el índice de la tabla de una dirección virtual
  */
 static inline uint32_t vmm_get_table_index(uint32_t virt) {
-    return (virt >> 12) & 0x3FF;
+    return (virt >> 12) & (vmm_table_entries - 1);
+}
+
+/**
+ * Entradas del directorio: 1024, o 2048 en los cuatro directorios de PAE
+ */
+static inline uint32_t vmm_dir_entries(void) {
+    return 1U << (32 - vmm_dir_shift);
+}
+
+/**
+ * Lee una entrada de un directorio o de una page table
+ */
+static inline vmm_entry_t vmm_entry_get(const void* table, uint32_t index) {
+    if (vmm_pae) {
+        return ((const uint64_t*)table)[index];
+    }
+    return ((const uint32_t*)table)[index];
+}
+
+/**
+ * Escribe una entrada de un directorio o de una page table
+ * Una entrada PAE son dos palabras: primero se quita la presencia (parte
+ * baja), después se escribe la parte alta y por último la baja, así la
+ * MMU nunca ve una entrada presente a medio escribir
+ */
+static inline void vmm_entry_set(void* table, uint32_t index, vmm_entry_t entry) {
+    if (!vmm_pae) {
+        ((uint32_t*)table)[index] = (uint32_t)entry;
+        return;
+    }
+    volatile uint32_t* half = (volatile uint32_t*)((uint64_t*)table + index);
+    half[0] = 0;
+    half[1] = (uint32_t)(entry >> 32);
+    half[0] = (uint32_t)entry;
+}
+
+/**
+ * Construye una entrada con un marco y flags PAGE_*
+ * PAGE_NX se traduce al bit 63 si EFER.NXE está activo; si no, se queda
+ * como bit libre para el SO
+ */
+static inline vmm_entry_t vmm_make_entry(phys_addr_t frame, uint32_t flags) {
+    vmm_entry_t entry = (frame & VMM_FRAME_MASK) | (flags & PAGE_OFFSET_MASK);
+    if (vmm_nx && (flags & PAGE_NX)) {
+        entry |= VMM_ENTRY_NX;
+    }
+    return entry;
+}
+
+/**
+ * Marco al que apunta una entrada (page table o página de 4KB)
+ */
+static inline phys_addr_t vmm_entry_frame(vmm_entry_t entry) {
+    return entry & VMM_FRAME_MASK;
+}
+
+/**
+ * Base de la página grande de una entrada del directorio
+ */
+static inline phys_addr_t vmm_entry_large(vmm_entry_t entry) {
+    return entry & VMM_FRAME_MASK & ~(phys_addr_t)(vmm_large_size - 1);
+}
+
+/**
+ * Flags PAGE_* de una entrada (PAGE_NX incluido)
+ */
+static inline uint32_t vmm_entry_flags(vmm_entry_t entry) {
+    return (uint32_t)entry & PAGE_OFFSET_MASK;
+}
+
+/**
+ * Orden del bloque de un directorio: los cuatro de PAE van seguidos
+ */
+static inline uint32_t vmm_dir_order(void) {
+    return vmm_pae ? VMM_PAE_DIR_ORDER : 0;
+}
+
+/**
+ * Apunta las entradas de una PDPT a los cuatro directorios de un bloque
+ * Una PDPTE solo lleva presencia y dirección: los permisos están en los
+ * niveles inferiores
+ */
+static void vmm_pdpt_fill(uint64_t* pdpt, page_directory_t* page_dir) {
+    for (uint32_t i = 0; i < VMM_PDPT_ENTRIES; i++) {
+        pdpt[i] = ((uint32_t)page_dir + i * PAGE_SIZE) | PAGE_PRESENT;
+    }
+}
+
+/**
+ * Dirección que se carga en CR3 para un espacio de direcciones: su
+ * directorio o, con PAE, su PDPT. Ambos están en el identity map
+ */
+static uint32_t vmm_cr3(page_directory_t* page_dir) {
+    if (!vmm_pae) {
+        return (uint32_t)page_dir;
+    }
+    if (page_dir == kernel_directory) {
+        return (uint32_t)vmm_kernel_pdpt;
+    }
+    return pmm_get_page((uint32_t)page_dir + PAGE_SIZE)->link;
+}
+
+/**
+ * Copia una entrada del kernel a todos los espacios de direcciones
+ */
+static void vmm_sync_kernel_entry(uint32_t dir_index) {
+    vmm_entry_t entry = vmm_entry_get(kernel_directory, dir_index);
+    for (uint32_t dir = vmm_spaces; dir != 0; dir = pmm_get_page(dir)->link) {
+        vmm_entry_set((page_directory_t*)dir, dir_index, entry);
+    }
+}
+
+/**
+ * Divide una página grande de un directorio en una page table con las
+ * mismas páginas de 4KB, para poder cambiar una sola
+ *
+ * @return E_OK, o E_NOMEM si no hay marco para la tabla
+ */
+static int vmm_split_large(page_directory_t* page_dir, uint32_t dir_index) {
+    vmm_entry_t entry = vmm_entry_get(page_dir, dir_index);
+    phys_addr_t base = vmm_entry_large(entry);
+    uint32_t page_flags = vmm_entry_flags(entry) & ~PAGE_LARGE;
+
+    // Todas las entradas se escriben: no hace falta un marco limpio
+    phys_addr_t table_phys = pmm_alloc_page_zone(ZONE_HIGH);
+    if (table_phys == 0) {
+        return E_NOMEM;
+    }
+
+    void* table = kmap(table_phys);
+    if (table == NULL) {
+        pmm_free_page(table_phys);
+        return E_NOMEM;
+    }
+    pmm_get_page(table_phys)->flags |= PAGE_FRAME_TABLE;
+
+    for (uint32_t i = 0; i < vmm_table_entries; i++) {
+        vmm_entry_set(table, i, vmm_make_entry(base + (phys_addr_t)i * PAGE_SIZE, page_flags));
+    }
+    kunmap(table);
+    vmm_entry_set(page_dir, dir_index,
+                  vmm_make_entry(table_phys, page_flags & (PAGE_PRESENT | PAGE_WRITE | PAGE_USER)));
+    if (page_dir == kernel_directory) {
+        vmm_sync_kernel_entry(dir_index);
+    }
+
+    // El TLB puede tener la traducción grande en cualquier dirección del
+    // rango: se invalida entero
+    if (page_dir == current_directory || page_dir == kernel_directory) {
+        cpu_flush_tlb(vmm_pge);
+    }
+    return E_OK;
 }
 
 /**
- * Carga un directorio de páginas en CR3
+ * Elige el formato de las page tables
  */
-static void vmm_load_directory(uint32_t phys_addr) {
-    __asm__ volatile(
-        "mov %0, %%cr3"
-        :
-        : "r"(phys_addr)
-        : "memory"
-    );
+bool vmm_select_mode(bool pae) {
+    uint32_t features = cpu_features();
+    vmm_pae = pae && (features & CPUID_EDX_PAE) != 0;
+    vmm_nx = vmm_pae && cpu_has_nx();
+
+    vmm_dir_shift = vmm_pae ? 21 : 22;
+    vmm_table_entries = vmm_pae ? 512 : 1024;
+    vmm_large_size = 1U << vmm_dir_shift;
+    vmm_large_order = vmm_dir_shift - 12;
+
+    if (pae && !vmm_pae) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[VMM] [WARN] La CPU no admite PAE; se usa paginacion de 2 niveles\n");
+    }
+    return vmm_pae;
 }
 
 /**
- * Habilita la paginación
+ * Indica si las page tables son de PAE
  */
-static void vmm_enable_paging(void) {
-    uint32_t cr0;
-    __asm__ volatile(
-        "mov %%cr0, %0\n"
-        "or $0x80000000, %0\n"  // Establecer bit 31 (PG)
-        "mov %0, %%cr0"
-        : "=r"(cr0)
-        :
-        : "memory"
-    );
+bool vmm_is_pae(void) {
+    return vmm_pae;
 }
 
 /**
- * Invalida la entrada TLB para una dirección virtual
+ * Rellena una entrada del directorio del kernel antes de activar la
+ * paginación: una página grande o, sin PSE, una page table de ZONE_LOW
+ * (se escribe por su dirección física) con las páginas desde base
+ * @return E_OK, o E_NOMEM si no hay marco para la tabla
  */
-static void vmm_invalidate_page(uint32_t virt) {
-    __asm__ volatile(
-        "invlpg (%0)"
-        :
-        : "r"(virt)
-        : "memory"
-    );
+static int vmm_map_boot_entry(uint32_t dir_index, phys_addr_t base, uint32_t page_flags) {
+    if (vmm_large) {
+        // Página grande: la entrada del directorio apunta al marco
+        vmm_entry_set(kernel_directory, dir_index, vmm_make_entry(base, page_flags | PAGE_LARGE));
+        return E_OK;
+    }
+
+    uint32_t table_phys = (uint32_t)pmm_alloc_page_zone(ZONE_LOW);
+    if (table_phys == 0) {
+        return E_NOMEM;
+    }
+    pmm_get_page(table_phys)->flags |= PAGE_FRAME_TABLE;
+
+    void* table = (void*)table_phys;
+    for (uint32_t page_idx = 0; page_idx < vmm_table_entries; page_idx++) {
+        vmm_entry_set(table, page_idx, vmm_make_entry(base + page_idx * PAGE_SIZE, page_flags));
+    }
+    vmm_entry_set(kernel_directory, dir_index, vmm_make_entry(table_phys, PAGE_PRESENT | PAGE_WRITE));
+    return E_OK;
 }
 
 /**
@@ -95,71 +390,130 @@ int vmm_init(bool kdebug __attribute__((unused)), bool kverbose __attribute__((u
     }
 
     // Usar el directorio estático (está en la sección .bss del kernel)
-    kernel_directory = &kernel_directory_data;
-    kernel_directory_phys = (uint32_t)kernel_directory;
+    kernel_directory = (page_directory_t*)kernel_directory_data;
 
     if (is_kdebug()) {
         vga_write("[VMM] Directorio del kernel en: ");
-        vga_write_hex(kernel_directory_phys);
+        vga_write_hex((uint32_t)kernel_directory);
         vga_write("\n");
     }
 
     // Limpiar el directorio
-    memset(kernel_directory, 0, sizeof(page_directory_t));
+    memset(kernel_directory_data, 0, sizeof(kernel_directory_data));
 
-    // Limpiar las tablas estáticas
-    memset(kernel_tables, 0, sizeof(kernel_tables));
+    uint32_t features = cpu_features();
+    vmm_large = vmm_pae || (features & CPUID_EDX_PSE) != 0;
+    vmm_pge = (features & CPUID_EDX_PGE) != 0;
+    vmm_tsc = (features & CPUID_EDX_TSC) != 0;
 
     if (is_kverbose()) {
+        if (!vmm_pae) {
+            vga_write("[VMM] Paginacion de 2 niveles (entradas de 32 bits)\n");
+        } else {
+            vga_write(vmm_nx ? "[VMM] Paginacion PAE (entradas de 64 bits) con NX\n"
+                             : "[VMM] Paginacion PAE (entradas de 64 bits); la CPU no admite NX\n");
+        }
         vga_write("[VMM] Creando identity mapping para los primeros 128MB...\n");
     }
 
-    // Determinar cuánta memoria está realmente disponible
-    uint32_t available_memory = pmm_get_total_pages() * PAGE_SIZE;
-    uint32_t max_map_size = 128 * 1024 * 1024;  // 128MB máximo
-    if (available_memory < max_map_size) {
-        max_map_size = available_memory;
-    }
-    
-    uint32_t tables_needed = (max_map_size + (4 * 1024 * 1024) - 1) / (4 * 1024 * 1024);
-    if (tables_needed > 32) {
-        tables_needed = 32;
+    // Determinar cuánta memoria está realmente disponible (en páginas: con
+    // PAE puede pasar de 4GB)
+    uint32_t max_map_size = KERNEL_IDENTITY_END;
+    if (pmm_get_total_pages() < KERNEL_IDENTITY_END / PAGE_SIZE) {
+        max_map_size = pmm_get_total_pages() * PAGE_SIZE;
     }
 
+    // Entradas del directorio del identity map: hasta 32 de 4MB o 64 de 2MB
+    uint32_t tables_needed = (max_map_size + vmm_large_size - 1) >> vmm_dir_shift;
+
     if (is_kdebug()) {
         vga_write("[VMM] Mapeando ");
-        vga_write_dec(tables_needed * 4);
-        vga_write(" MB de memoria\n");
+        vga_write_dec(tables_needed * (vmm_large_size >> 20));
+        vga_write(vmm_pae ? " MB de memoria con paginas de 2MB (PAE)\n"
+                  : vmm_large ? " MB de memoria con paginas de 4MB (PSE)\n"
+                              : " MB de memoria con paginas de 4KB\n");
     }
 
-    // Crear identity mapping para los primeros 128MB usando tablas estáticas
-    // Cada tabla mapea 4MB, así que necesitamos 32 tablas para 128MB
+    // Crear identity mapping para los primeros 128MB. Con PGE las páginas
+    // son globales. Lo que queda por encima de la imagen del kernel son
+    // datos (metadatos del PMM, slabs, directorios): no es ejecutable
+    uint32_t global = vmm_pge ? PAGE_GLOBAL : 0;
+    uint32_t image_end = (kernel_end + vmm_large_size - 1) & ~(vmm_large_size - 1);
     for (uint32_t table_idx = 0; table_idx < tables_needed; table_idx++) {
-        // Configurar la entrada del directorio para esta tabla
-        uint32_t table_phys = (uint32_t)&kernel_tables[table_idx];
-        kernel_directory->entries[table_idx] = table_phys | PAGE_PRESENT | PAGE_WRITE;
+        uint32_t base = table_idx << vmm_dir_shift;
+        uint32_t page_flags = PAGE_PRESENT | PAGE_WRITE | global | (base >= image_end ? PAGE_NX : 0);
 
-        // Llenar la tabla con identity mapping
-        for (uint32_t page_idx = 0; page_idx < 1024; page_idx++) {
-            uint32_t phys_addr = (table_idx * 1024 + page_idx) * PAGE_SIZE;
-            kernel_tables[table_idx].entries[page_idx] = phys_addr | PAGE_PRESENT | PAGE_WRITE;
+        if (vmm_map_boot_entry(table_idx, base, page_flags) != E_OK) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            vga_write("[VMM] [FAIL] Sin memoria para las tablas del identity mapping\n");
+            return E_NOMEM;
         }
     }
 
     if (is_kverbose()) {
         vga_write("[VMM] Identity mapping completado (0MB - 128MB)\n");
     }
+
+    // Descriptores de marco fuera del identity map (PAE con mucha
+    // memoria): pmm_init los dejó en un bloque alineado por debajo de 4GB.
+    // Se mapean en KERNEL_FRAMES_START y el PMM pasa a usar esa dirección
+    // en cuanto se activa la paginación
+    phys_addr_t frames_phys = 0;
+    uint32_t frames_size = pmm_get_pages_block(&frames_phys);
+    if (frames_size > KERNEL_FRAMES_SIZE) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[VMM] [FAIL] Los descriptores de marco no caben en KERNEL_FRAMES_SIZE\n");
+        return E_NOMEM;
+    }
+    for (uint32_t offset = 0; offset < frames_size; offset += vmm_large_size) {
+        if (vmm_map_boot_entry(vmm_get_dir_index(KERNEL_FRAMES_START + offset), frames_phys + offset,
+                               PAGE_PRESENT | PAGE_WRITE | global | PAGE_NX) != E_OK) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            vga_write("[VMM] [FAIL] Sin memoria para mapear los descriptores de marco\n");
+            return E_NOMEM;
+        }
+    }
     
-    // También pre-mapear el rango del heap del kernel
-    // El heap está en KERNEL_HEAP_START (4MB) y tiene KERNEL_HEAP_SIZE (4MB)
-    // Esto ya está incluido en los primeros 128MB, así que no hace falta más
+    // El heap del kernel (KERNEL_HEAP_START) queda fuera del identity
+    // mapping: heap_expand mapea sus páginas bajo demanda con vmm_map_page
 
-    // Activar el directorio de páginas del kernel
+    // Ventana de kmap: su tabla está en el kernel (identity map)
+    memset(vmm_kmap_table, 0, sizeof(vmm_kmap_table));
+    vmm_entry_set(kernel_directory, vmm_get_dir_index(KERNEL_KMAP_START),
+                  vmm_make_entry((uint32_t)vmm_kmap_table, PAGE_PRESENT | PAGE_WRITE));
+
+    // Activar el directorio de páginas del kernel. Con PAE, CR3 apunta a
+    // la PDPT y CR4.PSE no hace falta: las páginas de 2MB siempre existen
     current_directory = kernel_directory;
-    vmm_load_directory(kernel_directory_phys);
+    if (vmm_pae) {
+        vmm_pdpt_fill(vmm_kernel_pdpt, kernel_directory);
+        cpu_enable_cr4(CR4_PAE);
+    } else if (vmm_large) {
+        cpu_enable_cr4(CR4_PSE);
+    }
+
+    // EFER.NXE antes de la paginación: sin él, el bit 63 es un bit
+    // reservado y cualquier entrada con NX provoca un page fault
+    if (vmm_nx) {
+        cpu_enable_nx();
+    }
+    cpu_load_cr3(vmm_cr3(kernel_directory));
 
     // Habilitar paginación
-    vmm_enable_paging();
+    cpu_enable_paging();
+    if (frames_size != 0) {
+        pmm_set_pages_address((page_t*)KERNEL_FRAMES_START);
+        if (is_kdebug()) {
+            vga_write("[VMM] Descriptores de marco mapeados en ");
+            vga_write_hex(KERNEL_FRAMES_START);
+            vga_write("\n");
+        }
+    }
+
+    // Páginas globales: el TLB conserva las del kernel al cambiar de CR3
+    if (vmm_pge) {
+        cpu_enable_cr4(CR4_PGE);
+    }
 
     if (is_kdebug()) {
         vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
@@ -170,51 +524,110 @@ int vmm_init(bool kdebug __attribute__((unused)), bool kverbose __attribute__((u
 }
 
 /**
- * Mapea una página virtual a una página física
+ * Asegura que una entrada del directorio apunta a una page table de 4KB
+ * Crea la tabla si no existe (y la copia a todos los espacios si es del
+ * kernel) o divide la página grande que la ocupa. Las entradas del
+ * kernel se preparan siempre en kernel_directory
+ *
+ * @param flags Flags de las páginas que se van a mapear (PAGE_USER)
+ * @return E_OK, o E_NOMEM
  */
-int vmm_map_page(page_directory_t* page_dir, uint32_t virt, uint32_t phys, uint32_t flags) {
-    uint32_t dir_index = vmm_get_dir_index(virt);
-    uint32_t table_index = vmm_get_table_index(virt);
+static int vmm_prepare_table(page_directory_t* page_dir, uint32_t dir_index, uint32_t flags) {
+    // Las tablas del kernel solo se crean en su directorio: creada en el
+    // de un proceso, la siguiente sincronización la perdería
+    if (vmm_is_kernel_index(dir_index)) {
+        page_dir = kernel_directory;
+    }
 
-    // Verificar si la tabla de páginas existe
-    if (!(page_dir->entries[dir_index] & PAGE_PRESENT)) {
-        // Necesitamos crear una nueva tabla de páginas
-        uint32_t table_phys = pmm_alloc_page();
-        if (table_phys == 0) {
-            return E_NOMEM;
-        }
+    vmm_entry_t entry = vmm_entry_get(page_dir, dir_index);
+    if (entry & PAGE_LARGE) {
+        // Dentro de una página grande: pasar a páginas de 4KB
+        return vmm_split_large(page_dir, dir_index);
+    }
+    if (entry & PAGE_PRESENT) {
+        return E_OK;
+    }
 
-        // CRÍTICO: Verificar que la página física esté en el rango de identity mapping
-        // Solo podemos acceder directamente a direcciones < 128MB
-        if (table_phys >= 128 * 1024 * 1024) {
-            pmm_free_page(table_phys);
-            return E_NOMEM;
+    // Necesitamos crear una nueva tabla de páginas. Puede estar en
+    // cualquier marco (se accede con kmap) y llega limpia (normalmente
+    // del pool del idle)
+    phys_addr_t table_phys = pmm_alloc_zeroed_page();
+    if (table_phys == 0) {
+        return E_NOMEM;
+    }
+
+    pmm_get_page(table_phys)->flags |= PAGE_FRAME_TABLE;
+
+    // Agregar la tabla al directorio (y a todos si es del kernel)
+    vmm_entry_set(page_dir, dir_index, vmm_make_entry(table_phys, PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER)));
+    if (page_dir == kernel_directory) {
+        vmm_sync_kernel_entry(dir_index);
+    }
+    return E_OK;
+}
+
+/**
+ * Invalida el TLB tras cambiar un rango de páginas
+ * Hasta VMM_INVLPG_MAX páginas usa invlpg; por encima es más barato
+ * vaciarlo entero (solo lo de usuario si el rango no toca el kernel)
+ *
+ * @param kernel El rango incluye páginas del kernel (globales)
+ * @param current El rango incluye páginas del directorio activo
+ */
+static void vmm_flush_range(uint32_t virt, uint32_t count, bool kernel, bool current) {
+    if (!kernel && !current) {
+        return;  // Ninguna traducción afectada puede estar en el TLB
+    }
+
+    if (count > VMM_INVLPG_MAX) {
+        if (kernel) {
+            cpu_flush_tlb(vmm_pge);
+        } else {
+            cpu_load_cr3(vmm_cr3(current_directory));
         }
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        cpu_invlpg(virt + i * PAGE_SIZE);
+    }
+}
 
-        // Limpiar la tabla (acceso directo por identity mapping)
-        page_table_t* table = (page_table_t*)table_phys;
-        memset(table, 0, sizeof(page_table_t));
+/**
+ * Mapea una página virtual a una página física
+ */
+int vmm_map_page(page_directory_t* page_dir, uint32_t virt, phys_addr_t phys, uint32_t flags) {
+    uint32_t dir_index = vmm_get_dir_index(virt);
+    uint32_t table_index = vmm_get_table_index(virt);
+    bool kernel = vmm_is_kernel_index(dir_index);
 
-        // Agregar la tabla al directorio
-        page_dir->entries[dir_index] = table_phys | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
+    // La parte del kernel es común: vive en el directorio del kernel y sus
+    // páginas son globales
+    if (kernel) {
+        page_dir = kernel_directory;
+        if (vmm_pge) {
+            flags |= PAGE_GLOBAL;
+        }
     }
 
     // Obtener la tabla de páginas
-    uint32_t table_phys = page_dir->entries[dir_index] & PAGE_ALIGN_MASK;
-    
-    // CRÍTICO: Validar que esté en identity mapping
-    if (table_phys >= 128 * 1024 * 1024) {
+    int result = vmm_prepare_table(page_dir, dir_index, flags);
+    if (result != E_OK) {
+        return result;
+    }
+    void* table = kmap(vmm_entry_frame(vmm_entry_get(page_dir, dir_index)));
+    if (table == NULL) {
         return E_NOMEM;
     }
-    
-    page_table_t* table = (page_table_t*)table_phys;
 
     // Mapear la página
-    table->entries[table_index] = (phys & PAGE_ALIGN_MASK) | (flags & 0xFFF) | PAGE_PRESENT;
+    vmm_entry_set(table, table_index, vmm_make_entry(phys, flags | PAGE_PRESENT));
+    kunmap(table);
 
-    // Invalidar TLB si este es el directorio actual
-    if (page_dir == current_directory) {
-        vmm_invalidate_page(virt);
+    // Invalidar TLB si este es el directorio actual (el kernel está en
+    // todos)
+    if (kernel || page_dir == current_directory) {
+        cpu_invlpg(virt);
     }
 
     return E_OK;
@@ -226,50 +639,218 @@ int vmm_map_page(page_directory_t* page_dir, uint32_t virt, uint32_t phys, uint3
 void vmm_unmap_page(page_directory_t* page_dir, uint32_t virt) {
     uint32_t dir_index = vmm_get_dir_index(virt);
     uint32_t table_index = vmm_get_table_index(virt);
+    bool kernel = vmm_is_kernel_index(dir_index);
+
+    if (kernel) {
+        page_dir = kernel_directory;
+    }
 
     // Verificar si la tabla existe
-    if (!(page_dir->entries[dir_index] & PAGE_PRESENT)) {
+    vmm_entry_t entry = vmm_entry_get(page_dir, dir_index);
+    if (!(entry & PAGE_PRESENT)) {
         return;  // La página ya no está mapeada
     }
 
+    // Dentro de una página grande: pasar a páginas de 4KB para quitar
+    // solo esta. Sin memoria para la tabla, el mapeo se queda
+    if (entry & PAGE_LARGE) {
+        if (vmm_split_large(page_dir, dir_index) != E_OK) {
+            return;
+        }
+        entry = vmm_entry_get(page_dir, dir_index);
+    }
+
     // Obtener la tabla de páginas
-    uint32_t table_phys = page_dir->entries[dir_index] & PAGE_ALIGN_MASK;
-    page_table_t* table = (page_table_t*)table_phys;
+    void* table = kmap(vmm_entry_frame(entry));
+    if (table == NULL) {
+        return;
+    }
 
     // Desmarcar la página
-    table->entries[table_index] = 0;
+    vmm_entry_set(table, table_index, 0);
+    kunmap(table);
 
-    // Invalidar TLB si este es el directorio actual
-    if (page_dir == current_directory) {
-        vmm_invalidate_page(virt);
+    // Invalidar TLB si este es el directorio actual (el kernel está en
+    // todos)
+    if (kernel || page_dir == current_directory) {
+        cpu_invlpg(virt);
+    }
+}
+
+/**
+ * Mapea un rango de páginas
+ */
+int vmm_map_range(page_directory_t* page_dir, uint32_t virt, const phys_addr_t* frames, phys_addr_t phys,
+                  uint32_t count, uint32_t flags) {
+    if (count == 0) {
+        return E_OK;
+    }
+    if ((virt & PAGE_OFFSET_MASK) != 0 || count - 1 > (PAGE_ALIGN_MASK - virt) / PAGE_SIZE) {
+        return E_INVAL;
+    }
+
+    uint32_t done = 0;
+    bool kernel_seen = false;
+    bool current_seen = false;
+    int result = E_OK;
+
+    // Una vuelta por page table
+    while (done < count) {
+        uint32_t addr = virt + done * PAGE_SIZE;
+        uint32_t dir_index = vmm_get_dir_index(addr);
+        uint32_t table_index = vmm_get_table_index(addr);
+        uint32_t pages = vmm_table_entries - table_index;
+        if (pages > count - done) {
+            pages = count - done;
+        }
+
+        // La parte del kernel es común: directorio del kernel y páginas
+        // globales
+        bool kernel = vmm_is_kernel_index(dir_index);
+        page_directory_t* dir = kernel ? kernel_directory : page_dir;
+        uint32_t entry_flags = (flags & PAGE_OFFSET_MASK) | PAGE_PRESENT;
+        if (kernel && vmm_pge) {
+            entry_flags |= PAGE_GLOBAL;
+        }
+
+        result = vmm_prepare_table(dir, dir_index, entry_flags);
+        void* table = result == E_OK ? kmap(vmm_entry_frame(vmm_entry_get(dir, dir_index))) : NULL;
+        if (table == NULL) {
+            result = E_NOMEM;
+            break;
+        }
+
+        for (uint32_t i = 0; i < pages; i++) {
+            phys_addr_t frame = frames != NULL ? frames[done + i] : phys + (phys_addr_t)(done + i) * PAGE_SIZE;
+            vmm_entry_set(table, table_index + i, vmm_make_entry(frame, entry_flags));
+        }
+        kunmap(table);
+
+        kernel_seen |= kernel;
+        current_seen |= dir == current_directory;
+        done += pages;
+    }
+
+    vmm_flush_range(virt, done, kernel_seen, current_seen);
+
+    // Sin memoria para una tabla: no dejar el rango a medias
+    if (result != E_OK) {
+        vmm_unmap_range(page_dir, virt, done, false);
+    }
+    return result;
+}
+
+/**
+ * Desmapea un rango de páginas
+ */
+uint32_t vmm_unmap_range(page_directory_t* page_dir, uint32_t virt, uint32_t count, bool release) {
+    if (count == 0 || (virt & PAGE_OFFSET_MASK) != 0 || count - 1 > (PAGE_ALIGN_MASK - virt) / PAGE_SIZE) {
+        return 0;
+    }
+
+    uint32_t done = 0;
+    uint32_t unmapped = 0;
+    bool kernel_seen = false;
+    bool current_seen = false;
+
+    // Una vuelta por page table
+    while (done < count) {
+        uint32_t addr = virt + done * PAGE_SIZE;
+        uint32_t dir_index = vmm_get_dir_index(addr);
+        uint32_t table_index = vmm_get_table_index(addr);
+        uint32_t pages = vmm_table_entries - table_index;
+        if (pages > count - done) {
+            pages = count - done;
+        }
+        done += pages;
+
+        bool kernel = vmm_is_kernel_index(dir_index);
+        page_directory_t* dir = kernel ? kernel_directory : page_dir;
+        vmm_entry_t entry = vmm_entry_get(dir, dir_index);
+
+        // Una página grande entera se quita de una vez, sin dividirla
+        if ((entry & (PAGE_PRESENT | PAGE_LARGE)) == (PAGE_PRESENT | PAGE_LARGE) && pages == vmm_table_entries) {
+            vmm_entry_set(dir, dir_index, 0);
+            if (kernel) {
+                vmm_sync_kernel_entry(dir_index);
+            }
+            for (uint32_t i = 0; release && i < vmm_table_entries; i++) {
+                pmm_free_page(vmm_entry_large(entry) + (phys_addr_t)i * PAGE_SIZE);
+            }
+            unmapped += vmm_table_entries;
+            kernel_seen |= kernel;
+            current_seen |= dir == current_directory;
+            continue;
+        }
+
+        // Sin tabla no hay nada que quitar. Dentro de una página grande se
+        // divide primero; sin memoria para la tabla, el mapeo se queda
+        if (!(entry & PAGE_PRESENT) || ((entry & PAGE_LARGE) && vmm_split_large(dir, dir_index) != E_OK)) {
+            continue;
+        }
+
+        void* table = kmap(vmm_entry_frame(vmm_entry_get(dir, dir_index)));
+        if (table == NULL) {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < pages; i++) {
+            vmm_entry_t pte = vmm_entry_get(table, table_index + i);
+            if (!(pte & PAGE_PRESENT)) {
+                continue;
+            }
+            vmm_entry_set(table, table_index + i, 0);
+            if (release) {
+                pmm_free_page(vmm_entry_frame(pte));
+            }
+            unmapped++;
+        }
+        kunmap(table);
+
+        kernel_seen |= kernel;
+        current_seen |= dir == current_directory;
     }
+
+    if (unmapped > 0) {
+        vmm_flush_range(virt, count, kernel_seen, current_seen);
+    }
+    return unmapped;
 }
 
 /**
  * Obtiene la dirección física de una dirección virtual
  */
-uint32_t vmm_get_physical(page_directory_t* page_dir, uint32_t virt) {
+phys_addr_t vmm_get_physical(page_directory_t* page_dir, uint32_t virt) {
     uint32_t dir_index = vmm_get_dir_index(virt);
     uint32_t table_index = vmm_get_table_index(virt);
     uint32_t offset = virt & PAGE_OFFSET_MASK;
 
     // Verificar si la tabla existe
-    if (!(page_dir->entries[dir_index] & PAGE_PRESENT)) {
+    vmm_entry_t pde = vmm_entry_get(page_dir, dir_index);
+    if (!(pde & PAGE_PRESENT)) {
         return 0;  // No mapeado
     }
 
-    // Obtener la tabla de páginas
-    uint32_t table_phys = page_dir->entries[dir_index] & PAGE_ALIGN_MASK;
-    page_table_t* table = (page_table_t*)table_phys;
+    // Página grande: la entrada del directorio tiene la base
+    if (pde & PAGE_LARGE) {
+        return vmm_entry_large(pde) + (virt & (vmm_large_size - 1));
+    }
+
+    // Leer la entrada de la tabla de páginas
+    void* table = kmap(vmm_entry_frame(pde));
+    if (table == NULL) {
+        return 0;
+    }
+    vmm_entry_t entry = vmm_entry_get(table, table_index);
+    kunmap(table);
 
     // Verificar si la página está presente
-    if (!(table->entries[table_index] & PAGE_PRESENT)) {
+    if (!(entry & PAGE_PRESENT)) {
         return 0;  // No mapeado
     }
 
     // Retornar dirección física
-    uint32_t page_phys = table->entries[table_index] & PAGE_ALIGN_MASK;
-    return page_phys + offset;
+    return vmm_entry_frame(entry) + offset;
 }
 
 /**
@@ -277,23 +858,10 @@ uint32_t vmm_get_physical(page_directory_t* page_dir, uint32_t virt) {
  */
 void vmm_switch_directory(page_directory_t* page_dir) {
     current_directory = page_dir;
-    
-    // Obtener la dirección física del directorio
-    uint32_t phys;
-    
-    // Si es el directorio del kernel, usar la dirección física conocida
-    if (page_dir == kernel_directory) {
-        phys = kernel_directory_phys;
-    } else {
-        // Para otros directorios, obtener la dirección física
-        phys = vmm_get_physical(kernel_directory, (uint32_t)page_dir);
-        if (phys == 0) {
-            // Si no se puede obtener, asumir identity mapping
-            phys = (uint32_t)page_dir;
-        }
-    }
-    
-    vmm_load_directory(phys);
+
+    // Los directorios (y las PDPT) están en el identity map: su dirección
+    // es la física
+    cpu_load_cr3(vmm_cr3(page_dir));
 }
 
 /**
@@ -302,3 +870,753 @@ void vmm_switch_directory(page_directory_t* page_dir) {
 page_directory_t* vmm_get_kernel_directory(void) {
     return kernel_directory;
 }
+
+/**
+ * Mapea temporalmente un marco físico en la ventana de kmap
+ */
+void* kmap(phys_addr_t phys) {
+    if (phys < KERNEL_IDENTITY_END) {
+        return (void*)(uintptr_t)phys;  // Identity map
+    }
+
+    // Tomar un slot con las interrupciones deshabilitadas: un kmap desde
+    // una IRQ no puede quedarse con el mismo
+    uint32_t eflags = cpu_irq_save();
+
+    if (vmm_kmap_used == (uint32_t)((1ULL << KERNEL_KMAP_SLOTS) - 1)) {
+        cpu_irq_restore(eflags);
+        return NULL;
+    }
+    uint32_t slot = __builtin_ctz(~vmm_kmap_used);
+    vmm_kmap_used |= 1U << slot;
+
+    cpu_irq_restore(eflags);
+
+    uint32_t virt = KERNEL_KMAP_START + slot * PAGE_SIZE;
+    vmm_entry_set(vmm_kmap_table, slot, vmm_make_entry(phys, PAGE_PRESENT | PAGE_WRITE | PAGE_NX));
+    cpu_invlpg(virt);
+
+    return (void*)(virt + ((uint32_t)phys & PAGE_OFFSET_MASK));
+}
+
+/**
+ * Deshace un mapeo de kmap
+ */
+void kunmap(void* addr) {
+    uint32_t virt = (uint32_t)addr;
+    if (virt < KERNEL_KMAP_START) {
+        return;  // Identity map: kmap no gastó slot
+    }
+
+    uint32_t slot = (virt - KERNEL_KMAP_START) / PAGE_SIZE;
+    if (slot >= KERNEL_KMAP_SLOTS) {
+        return;
+    }
+
+    vmm_entry_set(vmm_kmap_table, slot, 0);
+    cpu_invlpg(virt);
+    cpu_clear_bit(&vmm_kmap_used, slot);
+}
+
+/**
+ * Obtiene el directorio de páginas activo
+ */
+page_directory_t* vmm_get_current_directory(void) {
+    return current_directory;
+}
+
+/**
+ * Crea un espacio de direcciones con la parte del kernel ya mapeada
+ */
+page_directory_t* vmm_create_address_space(void) {
+    // Con PAE, CR3 apunta a una PDPT propia (32 bytes del cache slab)
+    uint64_t* pdpt = NULL;
+    if (vmm_pae) {
+        if (vmm_pdpt_cache == NULL) {
+            vmm_pdpt_cache = kmem_cache_create("vmm_pdpt", VMM_PDPT_ENTRIES * sizeof(uint64_t), 32, NULL);
+        }
+        pdpt = vmm_pdpt_cache != NULL ? (uint64_t*)kmem_cache_alloc(vmm_pdpt_cache) : NULL;
+        if (pdpt == NULL) {
+            return NULL;
+        }
+    }
+
+    // Los directorios se acceden por el identity map. Se escriben todas
+    // las entradas: el espacio de usuario empieza vacío
+    uint32_t dir_phys = (uint32_t)pmm_alloc_pages_zone(vmm_dir_order(), ZONE_LOW);
+    if (dir_phys == 0) {
+        if (pdpt != NULL) {
+            kmem_cache_free(vmm_pdpt_cache, pdpt);
+        }
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < (1U << vmm_dir_order()); i++) {
+        pmm_get_page(dir_phys + i * PAGE_SIZE)->flags |= PAGE_FRAME_TABLE;
+    }
+
+    page_directory_t* page_dir = (page_directory_t*)dir_phys;
+    for (uint32_t i = 0; i < vmm_dir_entries(); i++) {
+        vmm_entry_set(page_dir, i, vmm_is_kernel_index(i) ? vmm_entry_get(kernel_directory, i) : 0);
+    }
+    if (pdpt != NULL) {
+        vmm_pdpt_fill(pdpt, page_dir);
+        pmm_get_page(dir_phys + PAGE_SIZE)->link = (uint32_t)pdpt;
+    }
+
+    // Enlazar para recibir los cambios de las entradas del kernel
+    page_t* frame = pmm_get_page(dir_phys);
+    frame->link = vmm_spaces;
+    vmm_spaces = dir_phys;
+
+    return page_dir;
+}
+
+/**
+ * Destruye un espacio de direcciones
+ */
+void vmm_destroy_address_space(page_directory_t* page_dir) {
+    if (page_dir == NULL || page_dir == kernel_directory) {
+        return;
+    }
+
+    // Sacarlo de la lista; si no está, no es un espacio de direcciones
+    uint32_t dir_phys = (uint32_t)page_dir;
+    uint32_t* link = &vmm_spaces;
+    while (*link != 0 && *link != dir_phys) {
+        link = &pmm_get_page(*link)->link;
+    }
+    if (*link == 0) {
+        return;
+    }
+    *link = pmm_get_page(dir_phys)->link;
+    pmm_get_page(dir_phys)->link = 0;
+
+    // Sus regiones: los marcos ya tocados se sueltan con las page tables
+    uint32_t eflags = cpu_irq_save();
+    vmm_region_t** region_link = &vmm_regions;
+    vmm_region_t* dead = NULL;
+    while (*region_link != NULL) {
+        vmm_region_t* region = *region_link;
+        if (region->page_dir == page_dir) {
+            *region_link = region->next;
+            region->next = dead;
+            dead = region;
+        } else {
+            region_link = &region->next;
+        }
+    }
+    cpu_irq_restore(eflags);
+
+    while (dead != NULL) {
+        vmm_region_t* next = dead->next;
+        kmem_cache_free(vmm_region_cache, dead);
+        dead = next;
+    }
+
+    // No se puede liberar el directorio cargado en CR3
+    if (page_dir == current_directory) {
+        vmm_switch_directory(kernel_directory);
+    }
+
+    // Page tables de usuario y una referencia a cada marco mapeado
+    for (uint32_t i = USER_SPACE_START >> vmm_dir_shift; i < USER_SPACE_END >> vmm_dir_shift; i++) {
+        vmm_entry_t entry = vmm_entry_get(page_dir, i);
+        if (!(entry & PAGE_PRESENT)) {
+            continue;
+        }
+
+        // Página grande (vmm_map_user): cada marco con su propia referencia
+        if (entry & PAGE_LARGE) {
+            for (uint32_t j = 0; j < vmm_table_entries; j++) {
+                pmm_free_page(vmm_entry_large(entry) + (phys_addr_t)j * PAGE_SIZE);
+            }
+            continue;
+        }
+
+        void* table = kmap(vmm_entry_frame(entry));
+        if (table == NULL) {
+            continue;  // Sin slots de kmap: la tabla y sus marcos se pierden
+        }
+        for (uint32_t j = 0; j < vmm_table_entries; j++) {
+            vmm_entry_t pte = vmm_entry_get(table, j);
+            if (pte & PAGE_PRESENT) {
+                pmm_free_page(vmm_entry_frame(pte));
+            }
+        }
+        kunmap(table);
+        pmm_free_page(vmm_entry_frame(entry));
+    }
+
+    if (vmm_pae) {
+        page_t* second = pmm_get_page(dir_phys + PAGE_SIZE);
+        kmem_cache_free(vmm_pdpt_cache, (void*)second->link);
+        second->link = 0;
+    }
+    pmm_free_pages(dir_phys, vmm_dir_order());
+}
+
+/**
+ * Clona un espacio de direcciones con copy-on-write
+ */
+page_directory_t* vmm_clone_address_space(page_directory_t* page_dir) {
+    if (page_dir == NULL || page_dir == kernel_directory) {
+        return NULL;
+    }
+
+    page_directory_t* clone = vmm_create_address_space();
+    if (clone == NULL) {
+        return NULL;
+    }
+
+    // Copiar las page tables de usuario; los marcos se comparten
+    bool failed = false;
+    for (uint32_t i = USER_SPACE_START >> vmm_dir_shift; i < USER_SPACE_END >> vmm_dir_shift && !failed; i++) {
+        vmm_entry_t entry = vmm_entry_get(page_dir, i);
+        if (!(entry & PAGE_PRESENT)) {
+            continue;
+        }
+
+        // Las páginas grandes se comparten en páginas de 4KB: se dividen
+        if (entry & PAGE_LARGE) {
+            if (vmm_split_large(page_dir, i) != E_OK) {
+                failed = true;
+                break;
+            }
+            entry = vmm_entry_get(page_dir, i);
+        }
+
+        // Todas las entradas se escriben: no hace falta un marco limpio
+        phys_addr_t table_phys = pmm_alloc_page_zone(ZONE_HIGH);
+        void* src = table_phys != 0 ? kmap(vmm_entry_frame(entry)) : NULL;
+        void* dst = src != NULL ? kmap(table_phys) : NULL;
+        if (dst == NULL) {
+            kunmap(src);
+            if (table_phys != 0) {
+                pmm_free_page(table_phys);
+            }
+            failed = true;
+            break;
+        }
+        pmm_get_page(table_phys)->flags |= PAGE_FRAME_TABLE;
+
+        for (uint32_t j = 0; j < vmm_table_entries; j++) {
+            vmm_entry_t pte = failed ? 0 : vmm_entry_get(src, j);
+            page_t* frame = (pte & PAGE_PRESENT) ? pmm_get_page(vmm_entry_frame(pte)) : NULL;
+
+            // Los marcos reservados (no gestionados por el PMM) se comparten
+            // tal cual; los demás ganan una referencia y pierden la escritura
+            if (frame != NULL && !(frame->flags & PAGE_FRAME_RESERVED)) {
+                if (pmm_page_ref(vmm_entry_frame(pte)) == 0) {
+                    failed = true;  // PAGE_REFCOUNT_MAX referencias
+                    pte = 0;
+                } else if (pte & PAGE_WRITE) {
+                    pte = (pte & ~(vmm_entry_t)PAGE_WRITE) | PAGE_COW;
+                    vmm_entry_set(src, j, pte);
+                }
+            }
+            vmm_entry_set(dst, j, pte);
+        }
+
+        kunmap(dst);
+        kunmap(src);
+        vmm_entry_set(clone, i,
+                      vmm_make_entry(table_phys, vmm_entry_flags(entry) & (PAGE_PRESENT | PAGE_WRITE | PAGE_USER)));
+    }
+
+    // Las páginas del original pasaron a solo lectura: invalidar sus
+    // traducciones (las del kernel son globales o se recargan igual)
+    if (page_dir == current_directory) {
+        cpu_load_cr3(vmm_cr3(page_dir));
+    }
+
+    // Regiones: el clon también se respalda bajo demanda
+    for (vmm_region_t* region = vmm_regions; region != NULL && !failed; region = region->next) {
+        if (region->page_dir != page_dir) {
+            continue;
+        }
+
+        vmm_region_t* copy = (vmm_region_t*)kmem_cache_alloc(vmm_region_cache);
+        if (copy == NULL) {
+            failed = true;
+            break;
+        }
+        *copy = *region;
+        copy->page_dir = clone;
+
+        uint32_t eflags = cpu_irq_save();
+        copy->next = vmm_regions;
+        vmm_regions = copy;
+        cpu_irq_restore(eflags);
+    }
+
+    // Destruir el clon suelta las referencias que llegó a tomar
+    if (failed) {
+        vmm_destroy_address_space(clone);
+        return NULL;
+    }
+
+    return clone;
+}
+
+/*
+ * Demand paging
+ */
+
+/**
+ * Busca la región de un espacio de direcciones que contiene una dirección
+ */
+static vmm_region_t* vmm_region_find(page_directory_t* page_dir, uint32_t addr) {
+    for (vmm_region_t* region = vmm_regions; region != NULL; region = region->next) {
+        if (region->page_dir == page_dir && addr >= region->start && addr < region->end) {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Registra la latencia de un page fault resuelto
+ *
+ * @param begin Lectura del TSC al entrar en el handler
+ */
+static void vmm_fault_account(uint32_t begin) {
+    if (!vmm_tsc) {
+        return;
+    }
+
+    uint32_t cycles = cpu_read_tsc() - begin;
+    if (cycles > vmm_fault_max_cycles) {
+        vmm_fault_max_cycles = cycles;
+    }
+    // Media móvil con peso 1/8 para la última muestra
+    vmm_fault_avg_cycles = vmm_fault_avg_cycles - vmm_fault_avg_cycles / 8 + cycles / 8;
+}
+
+/**
+ * Resuelve una escritura en una página copy-on-write del espacio activo
+ * Si el marco aún está compartido se copia; si este espacio tiene la
+ * última referencia, la página solo recupera la escritura
+ *
+ * @return E_OK, E_PERM si la página no es copy-on-write (o es de
+ *         supervisor y el acceso es de usuario), E_NOMEM
+ */
+static int vmm_cow_break(uint32_t addr, uint32_t err_code) {
+    vmm_entry_t pde = vmm_entry_get(current_directory, vmm_get_dir_index(addr));
+    if (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE)) {
+        return E_PERM;
+    }
+
+    void* table = kmap(vmm_entry_frame(pde));
+    if (table == NULL) {
+        return E_NOMEM;
+    }
+
+    uint32_t index = vmm_get_table_index(addr);
+    vmm_entry_t entry = vmm_entry_get(table, index);
+    if (!(entry & PAGE_COW) || ((err_code & PF_USER) && !(entry & PAGE_USER))) {
+        kunmap(table);
+        return E_PERM;
+    }
+
+    phys_addr_t frame = vmm_entry_frame(entry);
+    if (pmm_get_page(frame)->refcount > 1) {
+        phys_addr_t copy = pmm_alloc_page_zone(ZONE_HIGH);
+        void* src = copy != 0 ? kmap(frame) : NULL;
+        void* dst = src != NULL ? kmap(copy) : NULL;
+        if (dst == NULL) {
+            kunmap(src);
+            if (copy != 0) {
+                pmm_free_page(copy);
+            }
+            kunmap(table);
+            return E_NOMEM;
+        }
+        memcpy(dst, src, PAGE_SIZE);
+        kunmap(dst);
+        kunmap(src);
+
+        // Soltar la referencia de este espacio al marco compartido
+        pmm_free_page(frame);
+        frame = copy;
+        vmm_cow_copies++;
+    }
+
+    vmm_entry_set(table, index, vmm_make_entry(frame, (vmm_entry_flags(entry) & ~PAGE_COW) | PAGE_WRITE));
+    kunmap(table);
+    cpu_invlpg(addr);
+
+    vmm_cow_breaks++;
+    return E_OK;
+}
+
+/**
+ * Handler de page faults (vector 14)
+ * Resuelve los accesos a páginas no presentes de una región y las
+ * escrituras copy-on-write; cualquier otro fallo detiene el kernel
+ */
+static void vmm_page_fault(registers_t* regs) {
+    uint32_t begin = vmm_tsc ? cpu_read_tsc() : 0;
+
+    uint32_t addr = cpu_read_cr2();
+
+    // Escritura en una página presente: solo puede ser copy-on-write
+    if (regs->err_code & PF_PRESENT) {
+        int result = (regs->err_code & PF_WRITE) ? vmm_cow_break(addr, regs->err_code) : E_PERM;
+        if (result == E_NOMEM) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            vga_write("[VMM] [FAIL] Sin memoria para copiar una pagina copy-on-write\n");
+        }
+        if (result != E_OK) {
+            interrupts_panic(regs);
+        }
+        vmm_fault_account(begin);
+        return;
+    }
+
+    // Las regiones son de usuario: se buscan en el espacio activo
+    vmm_region_t* region = vmm_region_find(current_directory, addr);
+    if (region == NULL ||
+        ((regs->err_code & PF_WRITE) && !(region->flags & PAGE_WRITE)) ||
+        ((regs->err_code & PF_FETCH) && (region->flags & PAGE_NX)) ||
+        ((regs->err_code & PF_USER) && !(region->flags & PAGE_USER))) {
+        interrupts_panic(regs);
+    }
+
+    phys_addr_t frame = pmm_alloc_zeroed_page();
+    if (frame == 0 ||
+        vmm_map_page(current_directory, addr & PAGE_ALIGN_MASK, frame, region->flags | PAGE_PRESENT) != E_OK) {
+        if (frame != 0) {
+            pmm_free_page(frame);
+        }
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_write("[VMM] [FAIL] Sin memoria para resolver un page fault\n");
+        interrupts_panic(regs);
+    }
+
+    vmm_fault_minor++;
+    vmm_fault_account(begin);
+}
+
+/**
+ * Registra el handler de page faults
+ */
+int vmm_fault_init(void) {
+    vmm_region_cache = kmem_cache_create("vmm_region", sizeof(vmm_region_t), sizeof(void*), NULL);
+    if (vmm_region_cache == NULL) {
+        return E_NOMEM;
+    }
+
+    interrupts_register_handler(ISR_PAGE_FAULT, vmm_page_fault);
+
+    if (is_kverbose()) {
+        vga_write("[VMM] Handler de page faults registrado (demand paging)\n");
+    }
+
+    return E_OK;
+}
+
+/**
+ * Añade una región ya validada a la lista
+ * Las guardas cuentan para los solapamientos: entre dos regiones siempre
+ * quedan las guardas de ambas
+ *
+ * @return E_OK, E_EXISTS si se solapa con otra región, E_NOMEM
+ */
+static int vmm_region_add(page_directory_t* page_dir, uint32_t start, uint32_t end, uint32_t flags,
+                          uint32_t guard) {
+    vmm_region_t* region = (vmm_region_t*)kmem_cache_alloc(vmm_region_cache);
+    if (region == NULL) {
+        return E_NOMEM;
+    }
+    region->page_dir = page_dir;
+    region->start = start;
+    region->end = end;
+    region->flags = flags & (PAGE_WRITE | PAGE_USER | PAGE_NX);
+    region->guard = guard;
+
+    // El handler recorre la lista: se modifica sin interrupciones
+    uint32_t eflags = cpu_irq_save();
+    for (vmm_region_t* other = vmm_regions; other != NULL; other = other->next) {
+        if (other->page_dir == page_dir && other->start - other->guard < end + guard &&
+            other->end + other->guard > start - guard) {
+            cpu_irq_restore(eflags);
+            kmem_cache_free(vmm_region_cache, region);
+            return E_EXISTS;
+        }
+    }
+    region->next = vmm_regions;
+    vmm_regions = region;
+    cpu_irq_restore(eflags);
+
+    return E_OK;
+}
+
+/**
+ * Reserva una región de usuario respaldada bajo demanda
+ */
+int vmm_region_create(page_directory_t* page_dir, uint32_t start, uint32_t size, uint32_t flags) {
+    if (page_dir == NULL || vmm_region_cache == NULL || size == 0 || (start & PAGE_OFFSET_MASK) != 0 ||
+        start < USER_SPACE_START || start >= USER_SPACE_END || size > USER_SPACE_END - start) {
+        return E_INVAL;
+    }
+
+    return vmm_region_add(page_dir, start, start + ((size + PAGE_SIZE - 1) & PAGE_ALIGN_MASK), flags, 0);
+}
+
+/**
+ * Elimina una región y suelta las páginas que llegaron a asignarse
+ */
+int vmm_region_destroy(page_directory_t* page_dir, uint32_t start) {
+    uint32_t eflags = cpu_irq_save();
+    vmm_region_t** link = &vmm_regions;
+    while (*link != NULL && ((*link)->page_dir != page_dir || (*link)->start != start)) {
+        link = &(*link)->next;
+    }
+    vmm_region_t* region = *link;
+    if (region != NULL) {
+        *link = region->next;
+    }
+    cpu_irq_restore(eflags);
+
+    if (region == NULL) {
+        return E_NOENT;
+    }
+
+    vmm_unmap_range(page_dir, region->start, (region->end - region->start) / PAGE_SIZE, true);
+
+    kmem_cache_free(vmm_region_cache, region);
+    return E_OK;
+}
+
+/**
+ * Busca un hueco libre en el espacio de usuario
+ * Primer ajuste desde la pista y, si no cabe, desde el principio. Las
+ * guardas de las regiones vecinas y las del hueco no se solapan
+ *
+ * @return Inicio del hueco, 0 si no hay
+ */
+static uint32_t vmm_find_user_range(page_directory_t* page_dir, uint32_t hint, uint32_t size, uint32_t guard,
+                                    uint32_t align) {
+    uint32_t low = USER_SPACE_START + guard;
+    uint32_t from = hint > low ? hint : low;
+
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t addr = (from + align - 1) & ~(align - 1);
+        while (addr >= from && addr <= USER_SPACE_END - guard && size <= USER_SPACE_END - guard - addr) {
+            vmm_region_t* conflict = NULL;
+            for (vmm_region_t* other = vmm_regions; other != NULL; other = other->next) {
+                if (other->page_dir == page_dir && other->start - other->guard < addr + size + guard &&
+                    other->end + other->guard > addr - guard) {
+                    conflict = other;
+                    break;
+                }
+            }
+            if (conflict == NULL) {
+                return addr;
+            }
+            addr = (conflict->end + conflict->guard + guard + align - 1) & ~(align - 1);
+        }
+        if (from == low) {
+            break;
+        }
+        from = low;
+    }
+    return 0;
+}
+
+/**
+ * Mapea una página grande de usuario ya asignada en una entrada vacía
+ * Una page table sin páginas presentes se suelta; si tiene alguna, la
+ * entrada se deja como está
+ *
+ * @return E_OK, E_EXISTS si la entrada tiene páginas de 4KB
+ */
+static int vmm_map_user_large(page_directory_t* page_dir, uint32_t dir_index, phys_addr_t block, uint32_t flags) {
+    vmm_entry_t entry = vmm_entry_get(page_dir, dir_index);
+    if (entry & PAGE_PRESENT) {
+        if (entry & PAGE_LARGE) {
+            return E_EXISTS;
+        }
+        void* table = kmap(vmm_entry_frame(entry));
+        if (table == NULL) {
+            return E_EXISTS;
+        }
+        bool empty = true;
+        for (uint32_t i = 0; i < vmm_table_entries && empty; i++) {
+            empty = !(vmm_entry_get(table, i) & PAGE_PRESENT);
+        }
+        kunmap(table);
+        if (!empty) {
+            return E_EXISTS;
+        }
+        pmm_free_page(vmm_entry_frame(entry));
+    }
+
+    vmm_entry_set(page_dir, dir_index, vmm_make_entry(block, PAGE_PRESENT | PAGE_LARGE | flags));
+    return E_OK;
+}
+
+/**
+ * Asigna y mapea a cero todas las páginas de una región recién creada
+ * Con large, cada tramo alineado usa una página grande (4MB, o 2MB con
+ * PAE) si hay un bloque físico contiguo; si no, cae a páginas de 4KB
+ *
+ * @return E_OK o E_NOMEM (lo ya mapeado queda en la región)
+ */
+static int vmm_populate_user(page_directory_t* page_dir, uint32_t start, uint32_t end, uint32_t flags, bool large) {
+    phys_addr_t frames[PMM_BATCH_PAGES];
+    bool reload = false;
+    int result = E_OK;
+
+    uint32_t addr = start;
+    while (addr < end && result == E_OK) {
+        // Tramo entero de una página grande: un bloque del buddy de su
+        // tamaño (orden 10, u orden 9 con PAE)
+        if (large && (addr & (vmm_large_size - 1)) == 0 && end - addr >= vmm_large_size) {
+            phys_addr_t block = pmm_alloc_pages_zone(vmm_large_order, ZONE_HIGH);
+            bool zeroed = block != 0 && (block & (vmm_large_size - 1)) == 0 &&
+                          pmm_zero_pages(block, 1U << vmm_large_order);
+            if (zeroed && vmm_map_user_large(page_dir, vmm_get_dir_index(addr), block, flags) == E_OK) {
+                reload = true;
+                addr += vmm_large_size;
+                continue;
+            }
+            if (block != 0) {
+                pmm_free_pages(block, vmm_large_order);
+            }
+        }
+
+        uint32_t count = (end - addr) / PAGE_SIZE;
+        if (count > PMM_BATCH_PAGES) {
+            count = PMM_BATCH_PAGES;
+        }
+        // Con large, el lote no cruza el siguiente tramo
+        if (large) {
+            uint32_t to_boundary = (vmm_large_size - (addr & (vmm_large_size - 1))) / PAGE_SIZE;
+            if (count > to_boundary) {
+                count = to_boundary;
+            }
+        }
+
+        uint32_t got = 0;
+        while (got < count && (frames[got] = pmm_alloc_zeroed_page()) != 0) {
+            got++;
+        }
+        if (got < count || vmm_map_range(page_dir, addr, frames, 0, count, flags) != E_OK) {
+            for (uint32_t i = 0; i < got; i++) {
+                pmm_free_page(frames[i]);
+            }
+            result = E_NOMEM;
+            break;
+        }
+        addr += count * PAGE_SIZE;
+    }
+
+    // Las entradas nuevas del directorio pueden sustituir a tablas ya cacheadas
+    if (reload && page_dir == current_directory) {
+        cpu_flush_tlb(vmm_pge);
+    }
+    return result;
+}
+
+/**
+ * Mapea memoria en el espacio de usuario (base de SYS_MAP)
+ */
+int vmm_map_user(page_directory_t* page_dir, uint32_t* addr, uint32_t size, uint32_t flags, uint32_t options) {
+    if (page_dir == NULL || addr == NULL || vmm_region_cache == NULL || size == 0 ||
+        size > USER_SPACE_END - USER_SPACE_START ||
+        (options & ~(VMM_MAP_FIXED | VMM_MAP_POPULATE | VMM_MAP_LARGE | VMM_MAP_GUARD)) != 0) {
+        return E_INVAL;
+    }
+
+    size = (size + PAGE_SIZE - 1) & PAGE_ALIGN_MASK;
+    flags = (flags & (PAGE_WRITE | PAGE_NX)) | PAGE_USER;
+    uint32_t guard = (options & VMM_MAP_GUARD) ? PAGE_SIZE : 0;
+
+    // Solo los tamaños múltiplos de una página grande (4MB, o 2MB con PAE)
+    // la usan, y siempre poblados, también sin PSE: el handler de page
+    // faults mapea páginas de 4KB
+    bool multiple = (size & (vmm_large_size - 1)) == 0;
+    bool populate = (options & VMM_MAP_POPULATE) || ((options & VMM_MAP_LARGE) && multiple);
+    bool large = (options & VMM_MAP_LARGE) && vmm_large && multiple;
+    uint32_t start = *addr & PAGE_ALIGN_MASK;
+
+    if (options & VMM_MAP_FIXED) {
+        if ((*addr & PAGE_OFFSET_MASK) != 0 || start < USER_SPACE_START + guard ||
+            start > USER_SPACE_END - guard || size > USER_SPACE_END - guard - start) {
+            return E_INVAL;
+        }
+    } else {
+        start = vmm_find_user_range(page_dir, start, size, guard, large ? vmm_large_size : PAGE_SIZE);
+        if (start == 0 && large) {
+            // Sin hueco alineado a una página grande: páginas de 4KB donde
+            // quepan
+            start = vmm_find_user_range(page_dir, *addr & PAGE_ALIGN_MASK, size, guard, PAGE_SIZE);
+        }
+        if (start == 0) {
+            return E_NOMEM;
+        }
+    }
+
+    int result = vmm_region_add(page_dir, start, start + size, flags, guard);
+    if (result != E_OK) {
+        return result;
+    }
+
+    if (populate) {
+        if (vmm_populate_user(page_dir, start, start + size, flags, large) != E_OK) {
+            vmm_region_destroy(page_dir, start);
+            return E_NOMEM;
+        }
+    }
+
+    *addr = start;
+    return E_OK;
+}
+
+/**
+ * Deshace un vmm_map_user completo (base de SYS_UNMAP)
+ */
+int vmm_unmap_user(page_directory_t* page_dir, uint32_t addr, uint32_t size) {
+    if (page_dir == NULL || size == 0 || (addr & PAGE_OFFSET_MASK) != 0) {
+        return E_INVAL;
+    }
+
+    vmm_region_t* region = vmm_region_find(page_dir, addr);
+    if (region == NULL || region->start != addr) {
+        return E_NOENT;
+    }
+    if (((size + PAGE_SIZE - 1) & PAGE_ALIGN_MASK) != region->end - region->start) {
+        return E_INVAL;  // No se desmapean trozos de una región
+    }
+
+    return vmm_region_destroy(page_dir, addr);
+}
+
+/**
+ * Obtiene las estadísticas de page faults resueltos
+ */
+void vmm_get_fault_stats(uint32_t* minor, uint32_t* avg_cycles, uint32_t* max_cycles) {
+    if (minor != NULL) {
+        *minor = vmm_fault_minor;
+    }
+    if (avg_cycles != NULL) {
+        *avg_cycles = vmm_fault_avg_cycles;
+    }
+    if (max_cycles != NULL) {
+        *max_cycles = vmm_fault_max_cycles;
+    }
+}
+
+/**
+ * Obtiene las estadísticas de copy-on-write
+ */
+void vmm_get_cow_stats(uint32_t* breaks, uint32_t* copies) {
+    if (breaks != NULL) {
+        *breaks = vmm_cow_breaks;
+    }
+    if (copies != NULL) {
+        *copies = vmm_cow_copies;
+    }
+}
@@ -7,10 +7,14 @@
 #include "../../core/include/module.h"
 #include "../../core/include/error.h"
 #include "../../core/include/timer.h"
+#include "../../core/include/scheduler.h"
 #include "../../memory/include/memory.h"
 #include "../../lib/include/string.h"
 #include "../../drivers/include/early_vga.h"
 
+// Tamaño del buffer de trabajo de find_path
+#define EARLY_NEOFS_PATH_BUFFER 256
+
 // Estado global del filesystem
 static uint8_t* fs_buffer = NULL;
 static early_neofs_superblock_t* superblock = NULL;
@@ -198,23 +202,13 @@ static early_neofs_inode_t* get_inode(uint32_t inode) {
 // ========== Funciones de paths y búsqueda ==========
 
 /**
- * Busca un archivo/directorio por su ruta
- * @return Número de inodo, o -1 si no se encuentra
+ * Busca un archivo/directorio por su ruta usando los buffers dados
+ * path_copy tiene EARLY_NEOFS_PATH_BUFFER bytes y block_buffer un bloque
  */
-static int find_path(const char* path) {
-    if (path == NULL || path[0] != '/') {
-        return -1;
-    }
-    
-    // Si es la raíz
-    if (strcmp(path, "/") == 0) {
-        return superblock->root_inode;
-    }
-    
+static int find_path_in(const char* path, char* path_copy, uint8_t* block_buffer) {
     // Copiar el path para poder modificarlo
-    char path_copy[256];
-    strncpy(path_copy, path + 1, 255);  // Saltar el '/' inicial
-    path_copy[255] = '\0';
+    strncpy(path_copy, path + 1, EARLY_NEOFS_PATH_BUFFER - 1);  // Saltar el '/' inicial
+    path_copy[EARLY_NEOFS_PATH_BUFFER - 1] = '\0';
     
     uint32_t current_inode = superblock->root_inode;
     char* token = path_copy;
@@ -235,7 +229,6 @@ static int find_path(const char* path) {
         }
         
         // Leer el contenido del directorio
-        uint8_t block_buffer[EARLY_NEOFS_BLOCK_SIZE];
         bool found = false;
         
         for (uint32_t i = 0; i < EARLY_NEOFS_DIRECT_BLOCKS && !found; i++) {
@@ -267,17 +260,41 @@ static int find_path(const char* path) {
 }
 
 /**
- * Añade una entrada a un directorio
+ * Busca un archivo/directorio por su ruta
+ * Los buffers de trabajo salen de la arena temporal del contexto y no
+ * del stack del kernel
+ * @return Número de inodo, o -1 si no se encuentra
  */
-static int add_dir_entry(uint32_t dir_inode, uint32_t child_inode, const char* name, inode_type_t type) {
-    early_neofs_inode_t* dir = get_inode(dir_inode);
-    if (dir == NULL || dir->type != INODE_TYPE_DIR) {
-        return E_INVAL;
+static int find_path(const char* path) {
+    if (path == NULL || path[0] != '/') {
+        return -1;
     }
     
-    // Buscar un espacio libre en el directorio
-    uint8_t block_buffer[EARLY_NEOFS_BLOCK_SIZE];
+    // Si es la raíz
+    if (strcmp(path, "/") == 0) {
+        return superblock->root_inode;
+    }
+    
+    arena_t* scratch = scheduler_get_scratch_arena();
+    arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
+    char* path_copy = (char*)arena_alloc(scratch, EARLY_NEOFS_PATH_BUFFER);
+    uint8_t* block_buffer = (uint8_t*)arena_alloc(scratch, EARLY_NEOFS_BLOCK_SIZE);
     
+    int result = -1;
+    if (path_copy != NULL && block_buffer != NULL) {
+        result = find_path_in(path, path_copy, block_buffer);
+    }
+    
+    arena_restore(scratch, checkpoint);
+    return result;
+}
+
+/**
+ * Añade una entrada a un directorio usando block_buffer como buffer de bloque
+ */
+static int add_dir_entry_in(early_neofs_inode_t* dir, uint32_t child_inode, const char* name,
+                            inode_type_t type, uint8_t* block_buffer) {
+    // Buscar un espacio libre en el directorio
     for (uint32_t i = 0; i < EARLY_NEOFS_DIRECT_BLOCKS; i++) {
         // Si el bloque no está asignado, asignarlo
         if (dir->direct_blocks[i] == 0) {
@@ -313,16 +330,31 @@ static int add_dir_entry(uint32_t dir_inode, uint32_t child_inode, const char* n
 }
 
 /**
- * Elimina una entrada de un directorio
+ * Añade una entrada a un directorio
  */
-static int remove_dir_entry(uint32_t dir_inode, const char* name) {
+static int add_dir_entry(uint32_t dir_inode, uint32_t child_inode, const char* name, inode_type_t type) {
     early_neofs_inode_t* dir = get_inode(dir_inode);
     if (dir == NULL || dir->type != INODE_TYPE_DIR) {
         return E_INVAL;
     }
     
-    uint8_t block_buffer[EARLY_NEOFS_BLOCK_SIZE];
+    arena_t* scratch = scheduler_get_scratch_arena();
+    arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
+    uint8_t* block_buffer = (uint8_t*)arena_alloc(scratch, EARLY_NEOFS_BLOCK_SIZE);
     
+    int result = E_NOMEM;
+    if (block_buffer != NULL) {
+        result = add_dir_entry_in(dir, child_inode, name, type, block_buffer);
+    }
+    
+    arena_restore(scratch, checkpoint);
+    return result;
+}
+
+/**
+ * Elimina una entrada de un directorio usando block_buffer como buffer de bloque
+ */
+static int remove_dir_entry_in(early_neofs_inode_t* dir, const char* name, uint8_t* block_buffer) {
     for (uint32_t i = 0; i < EARLY_NEOFS_DIRECT_BLOCKS; i++) {
         if (dir->direct_blocks[i] == 0) {
             continue;
@@ -346,6 +378,28 @@ static int remove_dir_entry(uint32_t dir_inode, const char* name) {
     return E_NOENT;
 }
 
+/**
+ * Elimina una entrada de un directorio
+ */
+static int remove_dir_entry(uint32_t dir_inode, const char* name) {
+    early_neofs_inode_t* dir = get_inode(dir_inode);
+    if (dir == NULL || dir->type != INODE_TYPE_DIR) {
+        return E_INVAL;
+    }
+    
+    arena_t* scratch = scheduler_get_scratch_arena();
+    arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
+    uint8_t* block_buffer = (uint8_t*)arena_alloc(scratch, EARLY_NEOFS_BLOCK_SIZE);
+    
+    int result = E_NOMEM;
+    if (block_buffer != NULL) {
+        result = remove_dir_entry_in(dir, name, block_buffer);
+    }
+    
+    arena_restore(scratch, checkpoint);
+    return result;
+}
+
 // ========== API Pública ==========
 
 /**
@@ -431,8 +485,8 @@ int early_neofs_init(void) {
         return E_EXISTS;
     }
     
-    // Asignar memoria para el filesystem
-    fs_buffer = (uint8_t*)kmalloc(EARLY_NEOFS_SIZE);
+    // Asignar memoria para el filesystem (con páginas sueltas del PMM)
+    fs_buffer = (uint8_t*)kvmalloc(EARLY_NEOFS_SIZE);
     if (fs_buffer == NULL) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
         vga_write("[EARLY_NEOFS] Error: No hay memoria suficiente\n");
@@ -449,7 +503,7 @@ int early_neofs_init(void) {
     // Formatear el filesystem
     int result = early_neofs_format("NeoOS Early FS");
     if (result != E_OK) {
-        kfree(fs_buffer);
+        kvfree(fs_buffer);
         fs_buffer = NULL;
         fs_initialized = false;
         return result;
@@ -474,7 +528,7 @@ int early_neofs_cleanup(void) {
     }
     
     if (fs_buffer != NULL) {
-        kfree(fs_buffer);
+        kvfree(fs_buffer);
         fs_buffer = NULL;
     }
     
@@ -741,8 +795,14 @@ int early_neofs_read(int fd, void* buffer, uint32_t count) {
         count = file->size - pos;
     }
     
+    arena_t* scratch = scheduler_get_scratch_arena();
+    arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
+    uint8_t* block_buffer = (uint8_t*)arena_alloc(scratch, EARLY_NEOFS_BLOCK_SIZE);
+    if (block_buffer == NULL) {
+        return E_NOMEM;
+    }
+    
     uint32_t bytes_read = 0;
-    uint8_t block_buffer[EARLY_NEOFS_BLOCK_SIZE];
     
     while (bytes_read < count) {
         uint32_t block_index = pos / EARLY_NEOFS_BLOCK_SIZE;
@@ -767,6 +827,8 @@ int early_neofs_read(int fd, void* buffer, uint32_t count) {
         pos += bytes_to_read;
     }
     
+    arena_restore(scratch, checkpoint);
+    
     file_descriptors[fd].position = pos;
     file->access_time = timer_get_ticks();
     
@@ -792,8 +854,14 @@ int early_neofs_write(int fd, const void* buffer, uint32_t count) {
     }
     
     uint32_t pos = file_descriptors[fd].position;
+    arena_t* scratch = scheduler_get_scratch_arena();
+    arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
+    uint8_t* block_buffer = (uint8_t*)arena_alloc(scratch, EARLY_NEOFS_BLOCK_SIZE);
+    if (block_buffer == NULL) {
+        return E_NOMEM;
+    }
+    
     uint32_t bytes_written = 0;
-    uint8_t block_buffer[EARLY_NEOFS_BLOCK_SIZE];
     
     while (bytes_written < count) {
         uint32_t block_index = pos / EARLY_NEOFS_BLOCK_SIZE;
@@ -826,6 +894,8 @@ int early_neofs_write(int fd, const void* buffer, uint32_t count) {
         pos += bytes_to_write;
     }
     
+    arena_restore(scratch, checkpoint);
+    
     // Actualizar el tamaño del archivo si es necesario
     if (pos > file->size) {
         file->size = pos;
@@ -926,7 +996,13 @@ int early_neofs_rmdir(const char* path) {
     }
     
     // Verificar que esté vacío (solo debe tener "." y "..")
-    uint8_t block_buffer[EARLY_NEOFS_BLOCK_SIZE];
+    arena_t* scratch = scheduler_get_scratch_arena();
+    arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
+    uint8_t* block_buffer = (uint8_t*)arena_alloc(scratch, EARLY_NEOFS_BLOCK_SIZE);
+    if (block_buffer == NULL) {
+        return E_NOMEM;
+    }
+    
     uint32_t entry_count = 0;
     
     for (uint32_t i = 0; i < EARLY_NEOFS_DIRECT_BLOCKS; i++) {
@@ -945,6 +1021,8 @@ int early_neofs_rmdir(const char* path) {
         }
     }
     
+    arena_restore(scratch, checkpoint);
+    
     // Si tiene más de 2 entradas (. y ..), no está vacío
     if (entry_count > 2) {
         return E_INVAL;
@@ -1035,8 +1113,14 @@ int early_neofs_readdir(const char* path, early_neofs_dir_entry_t* entries, uint
         return E_INVAL;
     }
     
+    arena_t* scratch = scheduler_get_scratch_arena();
+    arena_checkpoint_t checkpoint = arena_checkpoint(scratch);
+    uint8_t* block_buffer = (uint8_t*)arena_alloc(scratch, EARLY_NEOFS_BLOCK_SIZE);
+    if (block_buffer == NULL) {
+        return E_NOMEM;
+    }
+    
     uint32_t entry_count = 0;
-    uint8_t block_buffer[EARLY_NEOFS_BLOCK_SIZE];
     
     for (uint32_t i = 0; i < EARLY_NEOFS_DIRECT_BLOCKS && entry_count < max_entries; i++) {
         if (dir->direct_blocks[i] == 0) {
@@ -1055,6 +1139,8 @@ int early_neofs_readdir(const char* path, early_neofs_dir_entry_t* entries, uint
         }
     }
     
+    arena_restore(scratch, checkpoint);
+    
     dir->access_time = timer_get_ticks();
     
     return entry_count;
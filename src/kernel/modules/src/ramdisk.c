@@ -22,17 +22,14 @@ int ramdisk_init(void) {
         return E_EXISTS;
     }
     
-    // Asignar memoria para el ramdisk
-    ramdisk_buffer = (uint8_t*)kmalloc(RAMDISK_SIZE);
+    // Asignar memoria para el ramdisk (limpia, con páginas sueltas del PMM)
+    ramdisk_buffer = (uint8_t*)kvzalloc(RAMDISK_SIZE);
     if (ramdisk_buffer == NULL) {
         vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
         vga_write("[RAMDISK] Error: No hay memoria suficiente\n");
         return E_NOMEM;
     }
     
-    // Limpiar el ramdisk
-    memset(ramdisk_buffer, 0, RAMDISK_SIZE);
-    
     ramdisk_initialized = true;
     
     return E_OK;
@@ -47,7 +44,7 @@ int ramdisk_cleanup(void) {
     }
     
     if (ramdisk_buffer != NULL) {
-        kfree(ramdisk_buffer);
+        kvfree(ramdisk_buffer);
         ramdisk_buffer = NULL;
     }
     